@@ -0,0 +1,131 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bump-pointer arena: memory is handed out from large blocks and only released all at once.
+ *
+ * One arena owns everything a compilation builds out of many small pieces (parse tree, AST, symbol table, diagnostics),
+ * so the allocator is called once per block instead of once per node, and tearing the compilation down is a single `arena_free`
+ * instead of a recursive walk over every tree.
+ * Nothing allocated in an arena may be passed to `free` or `realloc`, use `arena_grow` instead.
+ */
+typedef struct _ArenaBlock
+{
+    struct _ArenaBlock *next; // Previously allocated block.
+    size_t used;              // Number of bytes of `data` handed out.
+    size_t size;              // Number of bytes of `data`.
+    alignas(max_align_t) unsigned char data[];
+} ArenaBlock;
+
+typedef struct _Arena
+{
+    ArenaBlock *blocks; // Most recently allocated block first, allocations are made from its end.
+    size_t block_size;  // Size of new blocks, a larger allocation gets a block of its own.
+    size_t block_count; // Number of blocks currently allocated (that is, calls to malloc).
+} Arena;
+
+// Position in an arena to go back to with `arena_reset`.
+typedef struct _ArenaMark
+{
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+#define ARENA_DEFAULT_BLOCK_SIZE ((size_t)1 << 16)
+
+/**
+ * Initialize an empty arena, nothing is allocated until the first allocation.
+ * @param block_size Size of the blocks, 0 for `ARENA_DEFAULT_BLOCK_SIZE`.
+ */
+void arena_init(Arena *a, size_t block_size);
+
+/**
+ * Release every block of the arena, all the memory allocated in it becomes invalid. The arena is empty and can be reused afterwards.
+ */
+void arena_free(Arena *a);
+
+/**
+ * Allocate a new block big enough for `size` bytes aligned to `alignment` and allocate from it. Called by `arena_alloc_aligned` when the current block is full.
+ */
+void *arena_alloc_block(Arena *a, size_t size, size_t alignment);
+
+/**
+ * Allocate `size` bytes aligned to `alignment` (a power of two, at most `alignof(max_align_t)`), exits on allocation failure.
+ * @return The uninitialized memory, valid until the arena is freed or reset before it.
+ */
+static inline void *arena_alloc_aligned(Arena *const a, const size_t size, const size_t alignment)
+{
+    ArenaBlock *const block = a->blocks;
+    if (block != NULL) {
+        const size_t start = (block->used + alignment - 1) & ~(alignment - 1);
+        if (start <= block->size && size <= block->size - start) {
+            block->used = start + size;
+            return block->data + start;
+        }
+    }
+    return arena_alloc_block(a, size, alignment);
+}
+
+/**
+ * Allocate `size` bytes suitably aligned for any type, see `arena_alloc_aligned`.
+ */
+static inline void *arena_alloc(Arena *const a, const size_t size)
+{
+    return arena_alloc_aligned(a, size, alignof(max_align_t));
+}
+
+/**
+ * Resize an allocation of the arena, like `realloc`.
+ * If `ptr` is the last allocation of the arena and there is room it grows in place, otherwise the contents are copied to a new allocation (the old one is not reclaimed).
+ * @param ptr An allocation of `a` of `old_size` bytes, or NULL if `old_size` is 0.
+ * @return The resized allocation.
+ */
+void *arena_grow(Arena *a, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Copy `length` characters of `s` and a null character into the arena (without alignment).
+ * @return The null-terminated copy.
+ */
+char *arena_strndup(Arena *a, const char *s, size_t length);
+
+/**
+ * @return The current position of the arena, to release what is allocated after it with `arena_reset` (e.g. temporary strings).
+ */
+static inline ArenaMark arena_mark(const Arena *const a)
+{
+    return (ArenaMark){.block = a->blocks, .used = a->blocks == NULL ? 0 : a->blocks->used};
+}
+
+/**
+ * Release everything allocated after `mark` was taken. Allocations made before it stay valid.
+ * @param mark A mark of `a` taken since the last `arena_free` or reset to an earlier mark.
+ */
+void arena_reset(Arena *a, ArenaMark mark);
+
+/**
+ * Move every block of `from` into `a`: what was allocated in `from` stays valid until `a` is freed, `from` is empty afterwards.
+ * Allocations go on in the current block of `a`, and `arena_reset` to a mark of `a` taken before keeps the moved blocks (unless `a` was empty).
+ * Used to gather the trees that threads built in arenas of their own.
+ */
+void arena_adopt(Arena *a, Arena *from);
+
+/**
+ * Push (append) an item to the end of a dynamic array (see simple_dynamic_array.h) whose items are allocated in `arena`.
+ * @param arena The arena of the items, they are never freed individually (`da_clear` must not be used on the array).
+ */
+#define arena_da_push(arena, da, item)                                                  \
+    do {                                                                                \
+        if ((da)->count >= (da)->capacity) {                                            \
+            const size_t da_new_capacity = (da)->capacity == 0 ? 1 : 2 * (da)->capacity;   \
+            (da)->items = arena_grow((arena), (da)->items,                              \
+                (da)->capacity * sizeof(*(da)->items), da_new_capacity * sizeof(*(da)->items)); \
+            (da)->capacity = da_new_capacity;                                             \
+        }                                                                               \
+        (da)->items[(da)->count++] = (item);                                            \
+    } while (0)
+
+#endif /* ARENA_H */
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "arena.h"
+
 // Array data structure
 // TODO: implement memory allocation failure checking
 // TODO: update this data structure with stuff that I learned from the implementation in tree.c
@@ -29,6 +31,15 @@ typedef void *Element;
  */
 Array *array_new(size_t capacity, size_t element_size);
 
+/**
+ * Allocates a new array in `arena`, like `array_new`. Its elements are allocated in the arena too, so the array is released with the arena.
+ * @param arena The arena that owns the array. `array_free` does nothing for such an array.
+ * @param capacity The initial capacity of the array.
+ * @param element_size The size of the elements in the array.
+ * @return A pointer to the newly allocated array.
+ */
+Array *array_new_in_arena(Arena *arena, size_t capacity, size_t element_size);
+
 /**
  * Frees the memory allocated for the array.
  * @param a The array to free. If `a` is NULL or invalid, Undefined behavior.
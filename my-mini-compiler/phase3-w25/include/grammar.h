@@ -2,6 +2,7 @@
 #define GRAMMAR_H
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "parse_tokens.h"
@@ -68,6 +69,122 @@ size_t find_indirect_left_recursive(const CFG_GrammarRule grammar[ParseToken_COU
  */
 bool ParseToken_can_start_with(ParseToken t, ParseToken s, const CFG_GrammarRule *grammar, size_t grammar_size);
 
+/**
+ * Panic-mode error recovery at the items of a list: when an item fails to parse, the tokens are skipped up to the end of the item and the list goes on after it,
+ * instead of the error failing every node it is in (see `CFG_Recovery_skip` in parser.h):
+ * - up to and including the next `end` terminal, then the list goes on with the next item,
+ * - or up to the `block_end` terminal that closes the block the list is in (or the end of the input), which is left to the enclosing nodes, then the list ends there.
+ * The blocks inside the item (from `block_begin` to the matching `block_end`) are skipped as a whole.
+ *
+ * The item keeps its errors, the list and every node above it get PARSE_ERROR_RECOVERED instead of PARSE_ERROR_CHILD_ERROR (unless one of them fails on its own),
+ * so every independent syntax error is reported and the AST is converted without the items that failed.
+ */
+typedef struct _CFG_Recovery
+{
+    ParseToken list;        // Non-terminal whose first production rule is `list -> item list`, with `item` a non-terminal.
+    ParseToken end;         // Terminal ending an item (the PT_STATEMENT_END of program_grammar).
+    ParseToken block_begin; // Terminal opening a block (the PT_BLOCK_BEGIN of program_grammar).
+    ParseToken block_end;   // Terminal closing a block (the PT_BLOCK_END of program_grammar), the list of a block only ends there or at PT_EOF.
+} CFG_Recovery;
+
+/**
+ * LL(1) tables of a grammar, computed once by `CFG_PredictTable_init` so that choosing a production rule while parsing is an array lookup
+ * instead of a walk through the grammar with `ParseToken_can_start_with` for every candidate rule.
+ *
+ * Like `ParseToken_can_start_with`, only the first token of each production rule is considered and direct left-recursive rules are skipped.
+ */
+typedef struct _CFG_PredictTable
+{
+    const CFG_GrammarRule *grammar;
+    // Bit `s` of first[n] is set if non-terminal `n + ParseToken_FIRST_NONTERMINAL` can start with terminal `s`.
+    uint64_t first[ParseToken_COUNT_NONTERMINAL];
+    // Whether the non-terminal can start with the empty string (it has a rule whose first token is PT_NULL or such a non-terminal), it can then start with any token.
+    bool nullable[ParseToken_COUNT_NONTERMINAL];
+    // Index plus one of the production rule to parse non-terminal `n + ParseToken_FIRST_NONTERMINAL` with when the next token is terminal `s`, 0 if no rule matches.
+    uint8_t predict[ParseToken_COUNT_NONTERMINAL][ParseToken_FIRST_NONTERMINAL];
+    // Index plus one of the direct left-recursive rule of each non-terminal, 0 if it has none.
+    uint8_t left_recursive[ParseToken_COUNT_NONTERMINAL];
+    // The error recovery of the parsers using the table, NULL if a syntax error fails every node it is in (see `CFG_PredictTable_recover`).
+    const CFG_Recovery *recovery;
+    // Whether the grammar passes `check_cfg_grammar`, so that the predicted rule is the only one that can match. Otherwise only the backtracking parser (`parse_cfg_packrat_parse_tree` in parser.h) parses it correctly.
+    bool deterministic;
+} CFG_PredictTable;
+
+_Static_assert(ParseToken_FIRST_NONTERMINAL <= 64, "CFG_PredictTable stores sets of terminals in 64 bits");
+
+/**
+ * Compute the FIRST and nullable sets of every non-terminal of `grammar` (iterating to a fixed point, so unlike `ParseToken_can_start_with` it terminates on any grammar)
+ * and the predict table from them.
+ *
+ * WARNING: every non-terminal must have fewer than 255 production rules. The grammar must outlive the table.
+ */
+void CFG_PredictTable_init(CFG_PredictTable *table, const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL]);
+
+/**
+ * Make the parsers using `table` recover from the syntax errors in the items of `recovery->list`.
+ * The list then only ends at `recovery->block_end` or PT_EOF: any other token starts an item, so a token that cannot start one is an error in an item (that is recovered from)
+ * rather than the end of the list (which would fail the enclosing block).
+ *
+ * WARNING: `recovery` must outlive the table.
+ */
+void CFG_PredictTable_recover(CFG_PredictTable *table, const CFG_Recovery *recovery);
+
+/**
+ * Same as `ParseToken_can_start_with(t, s, table->grammar, ...)` for a terminal `s`, in constant time.
+ */
+static inline bool CFG_PredictTable_can_start_with(const CFG_PredictTable *const table, const ParseToken t, const ParseToken s)
+{
+    if (ParseToken_IS_NONTERMINAL(t))
+        return table->nullable[t - ParseToken_FIRST_NONTERMINAL] || ((table->first[t - ParseToken_FIRST_NONTERMINAL] >> s) & 1);
+    return t == s || t == PT_NULL;
+}
+
+/**
+ * @return The production rule to parse non-terminal `t` with when the next token is terminal `s`: the first rule (that is not direct left-recursive) whose first token can start with `s`. NULL if there is none.
+ */
+static inline const ProductionRule *CFG_PredictTable_rule(const CFG_PredictTable *const table, const ParseToken t, const ParseToken s)
+{
+    const unsigned rule = table->predict[t - ParseToken_FIRST_NONTERMINAL][s];
+    return rule == 0 ? NULL : table->grammar[t - ParseToken_FIRST_NONTERMINAL].rules + rule - 1;
+}
+
+/**
+ * Binding powers of the operators of an expression, derived by `CFG_PrecedenceTable_init` from the chain of non-terminals (one per precedence level) the grammar parses it with,
+ * so that an expression can be parsed by precedence climbing instead of going through every level for every operand.
+ *
+ * Levels are numbered from 1 (the loosest, the first of the chain), 0 means the terminal is not such an operator.
+ */
+typedef struct _CFG_PrecedenceTable
+{
+    // The non-terminal at the top of the chain, PT_NULL if the grammar below it is not a chain of operator levels.
+    ParseToken expression;
+    // The non-terminal at the bottom of the chain, the operands of the operators are parsed by following the grammar from it.
+    ParseToken primary;
+    // Level of each terminal as a binary operator, and the ASTNodeType of its node (whose items are the two operands).
+    uint8_t binary[ParseToken_FIRST_NONTERMINAL];
+    ASTNodeType binary_type[ParseToken_FIRST_NONTERMINAL];
+    // Level of each terminal as a prefix operator, its operand is parsed at the same level. And the ASTNodeType of its node (whose item is the operand).
+    uint8_t prefix[ParseToken_FIRST_NONTERMINAL];
+    ASTNodeType prefix_type[ParseToken_FIRST_NONTERMINAL];
+    // Whether the binary operators of a level group to the right (`a = b = c` is `a = (b = c)`) instead of the left.
+    bool right_associative[ParseToken_COUNT_NONTERMINAL + 1];
+} CFG_PrecedenceTable;
+
+_Static_assert(ParseToken_COUNT_NONTERMINAL < UINT8_MAX, "CFG_PrecedenceTable stores levels in a byte");
+
+/**
+ * Derive the precedence table of the expressions parsed as `expression` by the grammar of `predict`. Going down from `expression`, each non-terminal must be one of:
+ * - a promotion of a single non-terminal: `E -> N` (AST_FROM_PROMOTION, promoted), it adds no level;
+ * - a left-associative level: `L -> L OP N | N`, the left-recursive rule first, every token AST_FROM_PROMOTION and the operator promoted;
+ * - a right-associative level: `R -> N REST` with `REST -> OP R | ε` (in that order), every token AST_FROM_PROMOTION, REST promoted with N as its alternate;
+ * - a prefix level: `U -> OP U | N`, every token AST_FROM_PROMOTION and the first one promoted;
+ * and the first non-terminal that is none of them is the primary. Each rule of an operator non-terminal `OP` must be a single terminal, or a non-terminal with a single rule of a single AST_SKIP terminal,
+ * converted with an ASTNodeType that has no token. These are the shapes whose AST is the operator node with its operands as items.
+ *
+ * @return false (and `table->expression` is PT_NULL) if the grammar below `expression` does not have that shape or a terminal is the operator of two levels.
+ */
+bool CFG_PrecedenceTable_init(CFG_PrecedenceTable *table, const CFG_PredictTable *predict, ParseToken expression);
+
 /**
  * Check an array of CFG_GrammarRule for the following properties:
  * - Prefix-freeness: true when no two production rules for a given non-terminal have the same starting token.
@@ -77,12 +194,18 @@ bool ParseToken_can_start_with(ParseToken t, ParseToken s, const CFG_GrammarRule
  * @param grammar Array of CFG_GrammarRule to check.
  */
 CFG_GrammarCheckResult check_cfg_grammar(FILE *stream, const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL]);
+
+/**
+ * @return true if the grammar checked by `check_cfg_grammar` can be parsed without backtracking: it has every rule, properly terminated, is prefix-free, and has no left recursion the parsers cannot handle.
+ */
+bool CFG_GrammarCheckResult_passed(const CFG_GrammarCheckResult *result);
 // Some checks that are not made but should be considered if a more general grammar is used:
 //
 // Would it be necessary to rollback if left-recursive parsing fails even when the second token matches? 
 // This is possible only if the second token of the left-recursive rule may start with the first token of a non-terminal token that may follow immediatly after this left-recursive rule. For example, you began parsing S and are now left-recursively parsing A, S -> A D; A -> A B | C; B -> w...; D -> w...;  where w\in first(B) and w\in first(D). 
 // So if you had expression statements followed by a semicolon, and if you had semi-colon as a left-recursive operation, then if you parse the semicolon but fail to parse the remainder of the expression, then you should rollback the semicolon and end parsing before the semicolon.
 // This rollback scenario would only be possible if the grammar is not deterministic (i.e. B and D may share a common prefix). Since the grammar is assumed to be deterministic prior to this function being called, then this is not a problem.
+// (`parse_cfg_packrat_parse_tree` in parser.h, which parses the grammars that are not deterministic, does roll back a repetition that fails.)
 //
 // What if the left-recursive rule base case is epsilon and the first token of the left-recursive rule may also be epsilon?
 // For example, A -> A B | B; B -> C | epsilon; 
@@ -882,4 +1005,12 @@ static const CFG_GrammarRule program_grammar[ParseToken_COUNT_NONTERMINAL] = {
         .num_rules = 1U},
 };
 
+// The statements of program_grammar are recovered from at the end of the statement or of the enclosing block.
+static const CFG_Recovery program_recovery = {
+    .list = PT_STATEMENT_LIST,
+    .end = PT_SEMICOLON,
+    .block_begin = PT_LEFT_BRACE,
+    .block_end = PT_RIGHT_BRACE,
+};
+
 #endif /* GRAMMAR_H */
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Intern table: maps strings to dense 32-bit IDs (0, 1, 2, ... in order of first insertion).
+ *
+ * Every distinct string is copied once into an arena owned by the table, so two strings are equal if and only if their IDs are equal.
+ * The lexer interns every keyword, identifier and string literal lexeme, later phases compare names by comparing `Token.id`.
+ */
+typedef struct InternTable_t InternTable;
+
+// ID of a token whose lexeme is not interned.
+#define INTERN_ID_NONE UINT32_MAX
+
+/**
+ * Allocates a new empty intern table.
+ * @return A pointer to the newly allocated table.
+ */
+InternTable *intern_table_new(void);
+
+/**
+ * Frees the table and every string interned in it.
+ * @param t The table to free. If `t` is NULL, nothing is done.
+ */
+void intern_table_free(InternTable *t);
+
+/**
+ * Returns the number of distinct strings in the table (which is also the next ID that will be given out).
+ * @param t The table. If `t` is NULL or invalid, Undefined behavior.
+ */
+uint32_t intern_table_size(const InternTable *t);
+
+/**
+ * Interns the string `s`.
+ * @param t The table. If `t` is NULL or invalid, Undefined behavior.
+ * @param s The characters of the string, it does not need to be null-terminated. It is copied if it is not already in the table.
+ * @param length The number of characters in `s`.
+ * @return The ID of the string, the same ID is returned every time the same string is interned.
+ */
+uint32_t intern(InternTable *t, const char *s, size_t length);
+
+/**
+ * Returns the interned string with the given ID.
+ * @param t The table. If `t` is NULL or invalid, Undefined behavior.
+ * @param id The ID returned by `intern`. (id < intern_table_size(t))
+ * @param length If not NULL, set to the length of the string.
+ * @return The null-terminated string, valid until the table is freed.
+ */
+const char *intern_get(const InternTable *t, uint32_t id, size_t *length);
+
+#endif /* INTERN_H */
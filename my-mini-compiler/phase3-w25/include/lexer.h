@@ -6,13 +6,16 @@
 
 #include "tokens.h"
 
-#include "dynamic_array.h"
+#include "intern.h"
+#include "line_index.h"
+#include "token_stream.h"
 
 typedef struct _Lexer {
     const char *input_string;
-    int current_position;
-    int current_line;
-    Array *line_start_positions;
+    size_t input_length;  // Number of characters before the null character that ends `input_string`.
+    size_t current_position;
+    LineIndex lines;      // Line starts of the input, built the first time a token position is resolved (`Token_position(&token, &l->lines)`).
+    InternTable *symbols; // Interned lexemes of keywords, identifiers and string literals, see `Token.id`.
     bool is_initialized;
 } Lexer;
 
@@ -23,9 +26,17 @@ typedef struct _Lexer {
  * 
  * @param l The lexer to initialize. Must be a pointer to a `Lexer` struct. 
  * @param input_string The input string to tokenize. This string must be terminated by a null character `'\0'`. This string will not be modified by the lexer. The memory will not be freed by the lexer. 
- * @param start_position The position in the input where the lexer should start. This is required to track positions of the start of each newline.
+ * @param start_position The position in the input where the lexer should start.
+ * 
+ * If `l->symbols` is NULL a new intern table is created with the keywords interned first, so the ID of a keyword is its position among the keywords of the TokenType enum.
+ * Otherwise the existing table (which must have been created by `init_lexer`) is kept, so that IDs stay the same across inputs.
+ */
+void init_lexer(Lexer *l, const char *input_string, const size_t start_position);
+
+/**
+ * @brief Frees the memory owned by the lexer (including the line index and the intern table, so token IDs can no longer be looked up).
  */
-void init_lexer(Lexer *l, const char *input_string, const int start_position);
+void free_lexer(Lexer *l);
 
 /**
  * @brief Get the next token from the input.
@@ -37,4 +48,106 @@ void init_lexer(Lexer *l, const char *input_string, const int start_position);
  */
 Token get_next_token(Lexer *l);
 
+/**
+ * @brief Lex the rest of the input, appending every token up to and including `TOKEN_EOF` to `tokens`.
+ *
+ * Gives the same tokens as calling `get_next_token` until `TOKEN_EOF`, in a single loop that writes straight into the stream.
+ * WARNING: You must call `init_lexer` before calling this function. The lexer is at the end of the input afterwards.
+ */
+void lex_all(Lexer *l, TokenStream *tokens);
+
+/* Which tokens of a TokenStream `relex_edit` replaced. */
+typedef struct _RelexResult
+{
+    size_t first;          // Index of the first token that was replaced.
+    size_t removed_count;  // Number of tokens of the old stream that were removed, starting at `first`.
+    size_t inserted_count; // Number of new tokens that took their place, starting at `first`.
+} RelexResult;
+
+/**
+ * @brief Update the tokens of the input after an edit, relexing only the part of the input the edit can affect.
+ *
+ * Lexing restarts at the end of the last token that ends before the edit (the lexer is between tokens there, whatever the edit is),
+ * and stops as soon as a new token ends where a token of the old stream ended after the edit: from there on both inputs are the same
+ * and the lexer is in the same state, so the rest of the old tokens are kept with their offsets shifted by the change in length.
+ * An edit that opens or closes a block comment or a string literal relexes up to the point where the old and new tokens agree again (possibly the end of the input).
+ * The result is the same as `lex_all` on the new input, except that new identifiers and strings are interned after all the old ones.
+ *
+ * The line index is rebuilt the next time a position is resolved.
+ *
+ * @param l A lexer whose `input_string` is the input before the edit, the lexer is moved to the end of `new_input`.
+ * @param tokens All the tokens of the input before the edit (from offset 0 up to and including `TOKEN_EOF`), updated in place.
+ * @param new_input The whole input after the edit, terminated by a null character. It must stay valid as long as the lexer is used.
+ * @param edit_offset Offset of the first character that changed.
+ * @param removed_length Number of characters of the old input, starting at `edit_offset`, that were replaced.
+ * @param inserted_length Number of characters of `new_input`, starting at `edit_offset`, that replaced them.
+ * @return The range of tokens that changed.
+ */
+RelexResult relex_edit(Lexer *l, TokenStream *tokens, const char *new_input, size_t edit_offset, size_t removed_length, size_t inserted_length);
+
+/**
+ * Lexer that reads its input from a file descriptor through a fixed-size buffer instead of requiring the whole input in memory.
+ *
+ * It produces the same tokens as `get_next_token` on the whole input (up to the first null character).
+ * Tokens and comments may span buffer refills: the unfinished part of a lexeme is moved to the front of the buffer before reading more,
+ * comments are dropped as they are read. Memory use is the buffer plus the intern table, the buffer only grows if a single token does not fit in it.
+ * There is no line index since the input is not kept, instead the lexer counts lines as it goes and returns the position of every token.
+ */
+typedef struct _StreamLexer {
+    int fd;
+    char *buffer;           // Input from `buffer_offset` to `buffer_offset + buffer_length`, followed by a null character.
+    size_t buffer_size;     // Capacity of `buffer` (excluding the null character).
+    size_t buffer_offset;   // Input offset of `buffer[0]`.
+    size_t buffer_length;
+    bool at_end_of_input;   // Set once reading `fd` returned end of file or failed.
+    int read_error;         // errno of the failed read, 0 if the input ended normally.
+    size_t current_position;
+    size_t current_line;
+    size_t current_line_start;  // Offset of the first character of `current_line`.
+    InternTable *symbols;   // See `Lexer.symbols`.
+} StreamLexer;
+
+#define STREAM_LEXER_DEFAULT_BUFFER_SIZE ((size_t)1 << 16)
+
+/**
+ * @brief Initializes a streaming lexer reading from `fd`, which is not closed by the lexer.
+ * 
+ * @param buffer_size Size of the refill buffer, or 0 for `STREAM_LEXER_DEFAULT_BUFFER_SIZE`.
+ * The intern table is created like in `init_lexer` (`l->symbols` must be NULL or a table created by a lexer).
+ */
+void init_stream_lexer(StreamLexer *l, int fd, size_t buffer_size);
+
+/**
+ * @brief Frees the buffer and the intern table of the lexer.
+ */
+void free_stream_lexer(StreamLexer *l);
+
+/**
+ * @brief Get the next token from the input.
+ * 
+ * `token.offset` is the offset of the lexeme in the whole input, which is no longer available, use `lexeme` or `token.id` to get the text.
+ * 
+ * @param lexeme If not NULL, set to the first character of the token's lexeme. It is only valid until the next call.
+ * @param position If not NULL, set to the position of the token's lexeme.
+ * @return Token The next token in the input, `TOKEN_EOF` at the end of the input or on a read error (see `l->read_error`).
+ */
+Token stream_get_next_token(StreamLexer *l, const char **lexeme, LexemePosition *position);
+
+#define PARALLEL_LEXER_DEFAULT_MIN_CHUNK_SIZE ((size_t)1 << 18)
+
+/**
+ * @brief Lex the rest of the input on several threads.
+ *
+ * The input is split into chunks at line starts. Every chunk is lexed as if the line before it ended outside a block comment,
+ * then (only up to the point where it lexes the same tokens) as if it ended inside one, and the chunks are stitched together in order.
+ * The result is exactly what `lex_all` appends: same tokens, positions, errors and IDs (identifiers and strings are interned in order of first appearance).
+ *
+ * WARNING: You must call `init_lexer` before calling this function. The lexer is at the end of the input afterwards.
+ *
+ * @param thread_count Maximum number of threads to use, 0 for the number of online processors.
+ * @param min_chunk_size Minimum number of characters per chunk, 0 for `PARALLEL_LEXER_DEFAULT_MIN_CHUNK_SIZE` (inputs smaller than two chunks are lexed on the calling thread).
+ * @param tokens The stream to append the tokens to, up to and including `TOKEN_EOF`.
+ */
+void lex_parallel(Lexer *l, unsigned thread_count, size_t min_chunk_size, TokenStream *tokens);
+
 #endif /* LEXER_H */
\ No newline at end of file
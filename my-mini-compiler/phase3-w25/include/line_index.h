@@ -0,0 +1,59 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+
+#include "tokens.h"
+
+/**
+ * Offsets of the start of every line of an input, used to turn a byte offset into a line and column.
+ *
+ * Tokens only record their offset, positions are resolved when a diagnostic or a tree is printed.
+ * The index is built on first use, in a single vectorized pass over the input looking for newlines (AVX2 or SSE2 when available, otherwise memchr),
+ * after that resolving an offset is a binary search.
+ */
+typedef struct _LineIndex
+{
+    const char *input;
+    size_t length;       // Number of characters of `input` to index, LINE_INDEX_UNTIL_NUL to index up to the first null character.
+    size_t *line_starts; // line_starts[i] is the offset of the first character of line i + 1, NULL until the index is built.
+    size_t line_count;
+} LineIndex;
+
+#define LINE_INDEX_UNTIL_NUL ((size_t)-1)
+
+/**
+ * Prepare an index over `input`, nothing is read until the index is first used.
+ * @param length Number of characters in `input`, or LINE_INDEX_UNTIL_NUL if `input` is null-terminated.
+ */
+void line_index_init(LineIndex *index, const char *input, size_t length);
+
+/**
+ * Free the index, it can be initialized again afterwards. Freeing a zero-initialized index does nothing.
+ */
+void line_index_free(LineIndex *index);
+
+/**
+ * @return The number of lines in the input (at least 1).
+ */
+size_t line_index_line_count(LineIndex *index);
+
+/**
+ * @param line A line number (1 <= line <= line_index_line_count(index)).
+ * @return The offset of the first character of `line`.
+ */
+size_t line_index_line_start(LineIndex *index, size_t line);
+
+/**
+ * Find the line and column of the character at `offset`.
+ * @param line Set to the line number (starting at 1).
+ * @param column Set to the column number (starting at 1).
+ */
+void line_index_find(LineIndex *index, size_t offset, size_t *line, size_t *column);
+
+/**
+ * Resolve the position of `token`'s lexeme in the input the index was built over.
+ */
+LexemePosition Token_position(const Token *token, LineIndex *index);
+
+#endif /* LINE_INDEX_H */
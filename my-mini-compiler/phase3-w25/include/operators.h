@@ -75,9 +75,17 @@ static const char *const reduced_operators[] = {
 };
 
 /**
+ * Finds the longest operator at the start of `s` in constant time (the matcher is generated from reduced_operators at build time, see tools/gen_operator_switch.c).
  * @param s Input string to check for operator.
- * @return the index of the operator in the reduced_operators array.
+ * @return the index of the operator in the reduced_operators array, or -1 if `s` does not start with an operator.
  */
 int operator_index(const char *const s);
 
+/**
+ * @param s Input string to check for operator.
+ * @param length Set to the number of characters of the operator, unchanged if there is none.
+ * @return the TokenType of the longest operator at the start of `s`, or TOKEN_NULL if `s` does not start with an operator.
+ */
+TokenType operator_token(const char *const s, size_t *const length);
+
 #endif
\ No newline at end of file
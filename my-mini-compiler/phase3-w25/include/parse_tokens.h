@@ -153,8 +153,12 @@ typedef enum _ParseErrorType {
     PARSE_ERROR_NO_RULE_MATCHES,
     PARSE_ERROR_CHILD_ERROR,
     PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE,
+    PARSE_ERROR_RECOVERED, // the node parsed, but a node below it failed and was recovered from (see `CFG_Recovery` in grammar.h).
 } ParseErrorType;
 
+// Whether a node with `error` failed to parse, a node that recovered from the errors below it did not.
+#define ParseErrorType_FAILED(error) ((error) != PARSE_ERROR_NONE && (error) != PARSE_ERROR_RECOVERED)
+
 const char *ParseErrorType_to_string(ParseErrorType error);
 
 #endif /* PARSE_TOKENS_H */
\ No newline at end of file
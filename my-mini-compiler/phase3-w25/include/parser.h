@@ -3,19 +3,26 @@
 #define PARSER_H
 
 #include <stdbool.h>
+#include "arena.h"
 #include "grammar.h"
+#include "simple_dynamic_array.h"
 #include "tokens.h"
+#include "token_stream.h"
 
 /**
- * @param token must remain a valid pointer for the lifetime of the ParseTreeNode.
+ * The position of a node is not stored in it: it follows from the spans of the nodes before it (see `ParseTreeNode_child_start`), so a subtree does not change when the tokens before it shift.
+ * Nor does a list when the tokens after it do: the span of a list node stops where the rest of the list starts (see `ParseTreeNode_is_list`).
+ * @param has_token the token of the node is the first token of the node.
  * @param rule must remain a valid pointer for the lifetime of the ParseTreeNode.
  * @param children must remain a valid pointer to an block of memory of size `capacity * sizeof(ParseTreeNode)` for the lifetime of the ParseTreeNode, or NULL if capacity is 0. The first `count` elements of the array must be valid ParseTreeNode.
+ * The parsers allocate the children in an arena, the whole tree is released with it.
  * @param count must be less than or equal to `capacity`.
  */
 typedef struct _ParseTreeNode {
     ParseToken type;
     ParseErrorType error;
-    const Token *token; // Token associated with this node. When initialized: `NULL` if and only if `ParseToken_IS_NONTERMINAL(type)` and `error == PARSE_ERROR_NONE || error == PARSE_ERROR_CHILD_ERROR`.
+    bool has_token; // Whether the node is associated with the token it starts at. When initialized: false if and only if `ParseToken_IS_NONTERMINAL(type)` and `error` is PARSE_ERROR_NONE, PARSE_ERROR_CHILD_ERROR or PARSE_ERROR_RECOVERED.
+    size_t span; // Number of tokens the node was parsed from (up to where it failed), except for a list: up to the rest of the list.
     const ProductionRule *rule; // Rule used to parse this node. NULL iff ParseToken_IS_TERMINAL(type).
     size_t finalized_promo_index;
     size_t count;
@@ -27,7 +34,8 @@ typedef struct _ParseTreeNode {
 typedef struct _ParseTreeNodeWithPromo {
     ParseToken const type;
     ParseErrorType const error;
-    const Token *const token; // Token associated with this node. NULL iff ParseToken_IS_NONTERMINAL(type).
+    bool const has_token; // Whether the node is associated with the token it starts at, false iff ParseToken_IS_NONTERMINAL(type).
+    size_t const span;
     const ProductionRule *const rule; // Rule used to parse this node. NULL iff ParseToken_IS_TERMINAL(type).
     size_t finalized_promo_index;
     size_t const count;
@@ -35,6 +43,39 @@ typedef struct _ParseTreeNodeWithPromo {
     struct _ParseTreeNodeWithPromo *const children; // Array of `count` children. `capacity` is the allocated size of the array.
 } ParseTreeNodeWithPromo;
 
+/**
+ * @return Whether `node` is a list: its rule is right-recursive (e.g. PT_STATEMENT_LIST -> PT_STATEMENT PT_STATEMENT_LIST), so its last child is the rest of the list.
+ * The span of a list node only counts the tokens before the rest of the list (the item, and the tokens skipped after it if it failed, see `CFG_Recovery_skip`),
+ * so that an edit in a long list does not change the nodes of the items before it.
+ */
+static inline bool ParseTreeNode_is_list(const ParseTreeNode *const node) {
+    // a left-recursive rule starts with the non-terminal, its node may have more children than the rule has tokens (see `ParseTreeNode_continue_left_recursion`).
+    return node->rule != NULL && node->count > 1 && node->rule->tokens[0] != node->type && node->rule->tokens[node->count - 1] == node->type;
+}
+
+/**
+ * @return The index of the token after `node`, which starts at token `start`: after its span, and after the rest of the list if it is a list.
+ */
+static inline size_t ParseTreeNode_end(const ParseTreeNode *node, size_t start) {
+    for (; ParseTreeNode_is_list(node); node = node->children + node->count - 1)
+        start += node->span;
+    return start + node->span;
+}
+
+/**
+ * @return The index of the first token of child `i` of `node`, which starts at token `start`.
+ * A child starts where the previous one ends (at `start` for the first one), the previous one starting at `previous_start`. The rest of a list starts after the span of the list node.
+ * Another last child ends where `node` does (the packrat parser puts the only child of a node that failed where it failed), unless it is a list.
+ * So the end of a list is only followed for a list followed by a child that is not the last one, which program_grammar only has in its expressions.
+ */
+static inline size_t ParseTreeNode_child_start(const ParseTreeNode *const node, const size_t start, const size_t i, const size_t previous_start) {
+    if (i + 1 == node->count && ParseTreeNode_is_list(node))
+        return start + node->span;
+    if (i + 1 == node->count && !ParseTreeNode_is_list(node->children + i))
+        return start + node->span - node->children[i].span;
+    return i == 0 ? start : ParseTreeNode_end(node->children + i - 1, previous_start);
+}
+
 // Abstract Syntax Tree Node structure
 typedef struct ASTNode {
     ASTNodeType type;           // Type of node
@@ -42,41 +83,238 @@ typedef struct ASTNode {
     Token token;               // Token associated with this node, TOKEN_NULL if none.
     size_t count;
     size_t capacity;
-    struct ASTNode *items; // Array of child nodes
+    struct ASTNode *items; // Array of child nodes, allocated in the arena given to `ASTNode_from_ParseTreeNode`.
 } ASTNode;
+
+// A token that could not be parsed: the grammar expected `expected` at the token at `token_index`.
+typedef struct _SyntaxError {
+    ParseToken expected;
+    size_t token_index;
+} SyntaxError;
+
+DA_DEFINE(SyntaxErrors, SyntaxError);
  
 
-void ParseTreeNode_free_children(ParseTreeNode *node);
 void ParseTreeNode_print_simple(ParseTreeNode *node, int level, void (*print_node)(ParseTreeNode*));
 
+/**
+ * Make room in `node` for one more repetition of its direct left-recursive production rule `rule` (A -> A ...), after the node was parsed with another rule of A or with `rule` already.
+ *
+ * The first repetition nests the node parsed so far as the first child of `rule`, the next ones append the rest of `rule` (`length - 1` children) to the same children array, which grows geometrically.
+ * So a chain of n operators is one node of 1 + n * (length - 1) children, with linear memory and depth, instead of n nested nodes each copied into the next.
+ * `ASTNode_from_ParseTreeNode` converts the node to the same left-associative AST as the nested nodes, and a syntax error pads only the children of the last repetition.
+ *
+ * @param length The number of tokens of `rule`, at least 2.
+ * @return The index in `node->children` of the second child of the repetition, the first one parsed after the node. `node->count` is set to it and `node->capacity` has room for the rest of the rule.
+ */
+size_t ParseTreeNode_continue_left_recursion(ParseTreeNode *const node, const ProductionRule *const rule, const size_t length, Arena *const arena);
+
+/**
+ * Skip the tokens of an item of `recovery->list` that failed to parse: up to and including the next `recovery->end` outside of the blocks opened in the skipped tokens,
+ * or up to (excluding) the `recovery->block_end` of the enclosing block or PT_EOF, where the list ends.
+ *
+ * @param index The index of the token the item failed at.
+ * @return The index of the token the list goes on with.
+ */
+size_t CFG_Recovery_skip(const CFG_Recovery *const recovery, const TokenStream *const input, size_t index);
+
 
 /**
  * Parse a deterministic CFG_GrammarRule using the given tokens and return the resulting ParseTreeNode.
  * 
+ * The nodes being parsed are kept on an explicit stack (allocated with malloc) instead of the call stack, so the depth of the tree is only limited by memory.
+ * A direct left-recursive rule repeated n times gives one node with the children of every repetition, see `ParseTreeNode_continue_left_recursion`.
+ *
  * WARNING: 
- * - This can go into infinite recursion when parsing indirect-left-recursive grammar rules. (direct left recursion will be handled by the parser). Ensure that the grammar does not have indirect left recursion using `is_indirect_left_recursive` function on each grammar rule.
- * - This function assumes that the grammar is deterministic (no common prefixes in the production rules for a given non-terminal). This is ensured by `check_cfg_grammar` in `grammar.h`.
+ * - This can loop forever (growing its stack until memory runs out) when parsing indirect-left-recursive grammar rules. (direct left recursion will be handled by the parser). Ensure that the grammar does not have indirect left recursion using `is_indirect_left_recursive` function on each grammar rule.
+ * - This function assumes that the grammar is deterministic (no common prefixes in the production rules for a given non-terminal). This is ensured by `check_cfg_grammar` in `grammar.h`, otherwise use `parse_cfg_packrat_parse_tree`.
+ * 
+ * If the table recovers from errors (see `CFG_PredictTable_recover`), an item of the recovery list that fails is kept with its errors, its tokens are skipped with `CFG_Recovery_skip` and the list goes on:
+ * the list and every node it is in get PARSE_ERROR_RECOVERED (unless they fail themselves), so every independent syntax error is in the tree.
  * 
- * @param node The node to parse into. This node must have `node->type` set to the token desired to be parsed, all other fields are ignored (ensure that `node->children` array is deallocated prior to parsing as otherwise there will be a memory leak).
+ * @param node The node to parse into. This node must have `node->type` set to the token desired to be parsed, all other fields are ignored.
  * @param index The index of the current token to parse, upon termination, this index will point to the next token to parse (if parsing fails, it will point to the first token that could not be parsed).
- * @param input The tokens coming from the Lexer to use for parsing. This array must be terminated with TokenType of TOKEN_EOF.
- * @param grammar An array of `grammar_size` context-free grammar rules to follow to parse `node`.
- * @param grammar_size The size of the grammar array.
+ * @param input The tokens coming from the Lexer to use for parsing (only their types are read). The stream must end with TokenType of TOKEN_EOF.
+ * @param table The predict table of the context-free grammar to follow to parse `node` (see `CFG_PredictTable_init`).
+ * @param arena The arena the children arrays of the tree are allocated in.
+ * @return true if the node was successfully parsed and node->error is PARSE_ERROR_NONE (nothing was recovered from), false otherwise.
+ */
+bool parse_cfg_recursive_descent_parse_tree(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena);
+
+/**
+ * Parse like `parse_cfg_recursive_descent_parse_tree`, for grammars that need more than the next token to choose a production rule (that do not pass `check_cfg_grammar`).
+ * If the grammar of `table` is deterministic (see `CFG_PredictTable.deterministic`), it is parsed by `parse_cfg_recursive_descent_parse_tree` instead.
+ *
+ * The production rules of a non-terminal are tried in order (among those whose first token can start with the next token), the first one that parses is taken,
+ * and a repetition of a direct left-recursive rule that fails is undone instead of failing the node. Backtracking would take exponential time in the worst case,
+ * so the result of each non-terminal (with more than one rule) at each token is memoized (packrat parsing): the time is linear in the number of tokens, the memory too.
+ * Like `parse_cfg_recursive_descent_parse_tree`, the nodes being parsed are kept on an explicit stack. A left recursion through other non-terminals fails instead of looping.
+ *
+ * The tree of a successful parse has the same shape as the one of the deterministic parser. The errors are not recovered from (`table->recovery` is not used here):
+ * if `node` fails, its only child is the token that could not be parsed, the farthest one any rule got to (with the terminal or non-terminal that was expected there).
+ *
+ * @param node The node to parse into, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param index The index of the current token to parse, upon termination the next token to parse (or the token that could not be parsed).
+ * @param input The tokens to parse. The stream must end with TokenType of TOKEN_EOF.
+ * @param table The predict table of the grammar (only its FIRST sets and left-recursive rules are used to backtrack).
+ * @param arena The arena the children arrays of the tree are allocated in, the rules that failed leave theirs in it.
+ * @return true if the node was successfully parsed, false otherwise.
+ */
+bool parse_cfg_packrat_parse_tree(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena);
+
+// A production rule being recognized by `parse_cfg_recognize`: the tokens of the rule left to recognize, and the direct left-recursive rule to continue the node with once they are (NULL if none).
+typedef struct _RecognizerFrame {
+    const ParseToken *next;
+    const ProductionRule *left_recursive_rule;
+} RecognizerFrame;
+
+/**
+ * Check that the tokens from `*index` parse as a `type` node, like `parse_cfg_recursive_descent_parse_tree` without building the tree: nothing is allocated,
+ * the explicit stack of the rules being recognized is the memory given by the caller.
+ *
+ * The production rules are chosen with the same predict table, so the first syntax error is the one the parser fails (or recovers) at first,
+ * which is the first error `report_syntax_errors` reports for its tree. It stops there, nothing is recovered from.
+ * A rule whose last token is a non-terminal is replaced by that non-terminal (a tail call), so a list of statements takes a single frame, the stack only grows with the nesting of the input.
+ *
+ * @param type The token to recognize.
+ * @param index The index of the current token, upon termination the next token after the node (or the token of the syntax error).
+ * @param input The tokens to recognize (only their types are read). The stream must end with TokenType of TOKEN_EOF.
+ * @param table The predict table of the grammar to follow, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param stack Memory for `capacity` frames (at least 1), e.g. an array of the caller.
+ * @param error Set to the syntax error if the tokens do not parse: the terminal or non-terminal expected at the token that could not be parsed.
+ *              If the input is nested deeper than `capacity` frames, the error is PT_NULL at the token where the stack ran out.
+ * @return true if the tokens parse as a `type` node.
+ */
+bool parse_cfg_recognize(const ParseToken type, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, RecognizerFrame *const stack, const size_t capacity, SyntaxError *const error);
+
+#define PARALLEL_PARSER_DEFAULT_MIN_CHUNK_TOKENS ((size_t)1 << 16)
+
+/**
+ * @return The number of chunks `parse_cfg_recursive_descent_parse_tree_parallel` splits the tokens from `index` on into with these arguments (see there),
+ *         1 if it parses them on the calling thread.
+ */
+size_t parse_cfg_parallel_chunk_count(size_t index, const TokenStream *input, const CFG_PredictTable *table, unsigned thread_count, size_t min_chunk_tokens);
+
+/**
+ * Parse like `parse_cfg_recursive_descent_parse_tree`, with the items of the recovery list (the statements) parsed on several threads. The tree is exactly the same.
+ *
+ * A pre-scan of the token types finds where items may start: after a `recovery->end` or a `recovery->block_end` outside of any block (the lexer already took care of strings and comments).
+ * The tokens are split into chunks at those boundaries, and each thread parses the items of a chunk one after the other, in an arena of its own that is then moved into `arena`.
+ * Then the tree is parsed on the calling thread, which takes every item that starts where it expects one from the chunks instead of parsing it:
+ * an item does not depend on the nodes it is in, so it is the same tree. A boundary that is not the start of an item (e.g. the `else` after an `if` block) only costs parsing again.
+ *
+ * @param table Must recover from errors (see `CFG_PredictTable_recover`), otherwise the tree is parsed on the calling thread.
+ * @param thread_count Maximum number of threads to use, 0 for the number of online processors.
+ * @param min_chunk_tokens Minimum number of tokens per chunk, 0 for `PARALLEL_PARSER_DEFAULT_MIN_CHUNK_TOKENS` (inputs smaller than two chunks are parsed on the calling thread).
+ * @return see `parse_cfg_recursive_descent_parse_tree`.
+ */
+bool parse_cfg_recursive_descent_parse_tree_parallel(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, unsigned thread_count, size_t min_chunk_tokens, Arena *const arena);
+
+/**
+ * Parse `node` with program_grammar, giving the same tree as `parse_cfg_recursive_descent_parse_tree` with the predict table of program_grammar recovering with program_recovery.
+ *
+ * The parser is generated from program_grammar at build time (see tools/gen_parser.c): one function per non-terminal with a `switch` on the next token,
+ * instead of looking up production rules and walking their tokens at runtime. The `rule` pointers of the tree point into the program_grammar of the generated parser.
+ *
+ * @param node The node to parse into, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param index The index of the current token to parse, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param input The tokens to parse. The stream must end with TokenType of TOKEN_EOF.
+ * @param arena The arena the children arrays of the tree are allocated in.
  * @return true if the node was successfully parsed and node->error is PARSE_ERROR_NONE, false otherwise.
  */
-bool parse_cfg_recursive_descent_parse_tree(ParseTreeNode *const node, size_t *const index, const Token *const input, const CFG_GrammarRule *const grammar, const size_t grammar_size);
+bool parse_program_grammar(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, Arena *const arena);
 
-void ASTNode_free_children(ASTNode *const node);
+// The tokens `[start, old_end)` of the stream a tree was parsed from are replaced by the tokens `[start, new_end)` of the new stream, the tokens after them are the same (shifted by `new_end - old_end`).
+typedef struct _TokenEdit {
+    size_t start;
+    size_t old_end;
+    size_t new_end;
+} TokenEdit;
+
+/**
+ * @return The smallest edit that turns the token types of `old_input` into those of `input`, the parse tree only depends on them (not on the lexemes).
+ */
+TokenEdit TokenEdit_between(const TokenStream *const old_input, const TokenStream *const input);
+
+// An item of the list indexed by a `ParseTreeIndex`: the list node it is the first child of (or the empty one at the end of the list), and the index of its first token.
+typedef struct _ParseTreeIndexEntry {
+    ParseTreeNode *list;
+    size_t start;
+} ParseTreeIndexEntry;
+
+/**
+ * The nodes of the outermost recovery list of a tree (the statements of the program) in order, so that `parse_cfg_recursive_descent_reparse` finds the item an edit is in
+ * with a binary search instead of following the list down to it. Initialized with `da_init` and freed with `da_clear` (see simple_dynamic_array.h).
+ */
+DA_DEFINE(ParseTreeIndex, ParseTreeIndexEntry);
+
+/**
+ * Update `node` to the tree `parse_cfg_recursive_descent_parse_tree` would parse from `input` (from token 0), reusing what does not change.
+ *
+ * The tree must have been parsed from token 0 of the stream before `edit` with the same `table` (by any of the parsers, they build the same trees).
+ * The innermost list of the recovery list around the edit (the statements of a block, or of the program) is parsed again from the item before the edit,
+ * until it is back in step with the old list: the rest of the list and the other nodes around it are kept by reference, as they are (the nodes do not store their positions, see `ParseTreeNode_child_start`,
+ * and the nodes of the items before the edit do not count the tokens after it, see `ParseTreeNode_is_list`).
+ * If the edit changes where the list ends (e.g. removes a '}'), the list around it is parsed again instead, and so on up to the whole tree.
+ *
+ * So the time is that of parsing the statements around the edit, plus following the path down to it: through `index` in the outermost list, item by item in the lists of the blocks.
+ * The nodes replaced by new ones stay in `arena` until it is freed.
+ *
+ * @param node The root of the tree, updated in place. `finalized_promo_index` is reset on the path to the edit, so the tree can be converted again with `ASTNode_from_ParseTreeNode`.
+ * @param edit The difference between the stream the tree was parsed from and `input`, see `TokenEdit_between`.
+ * @param table Must recover from errors (see `CFG_PredictTable_recover`), otherwise the whole tree is parsed again.
+ * @param index The index of the tree, or NULL to follow the outermost list too. It is filled when it is empty, and kept up to date for the next reparse of the tree:
+ * it must be empty or have been used by every reparse of the tree since it was filled.
+ * @param arena The arena of the tree, the new nodes are allocated in it.
+ * @return see `parse_cfg_recursive_descent_parse_tree`.
+ */
+bool parse_cfg_recursive_descent_reparse(ParseTreeNode *const node, const TokenEdit *const edit, const TokenStream *const input, const CFG_PredictTable *const table, ParseTreeIndex *const index, Arena *const arena);
 
 /**
  * Convert a ParseTreeNode to an ASTNode.
  * 
- * WARNING: Ensure that the memory at address `ast_node->items` is deallocated prior to calling this function as otherwise there will be a memory leak.
+ * Like the parser, the conversion walks the tree with explicit stacks instead of recursion, so it works for trees of any depth.
  * 
+ * The items of a recovery list (PARSE_ERROR_RECOVERED) that failed are left out of the AST, so the AST of a program with syntax errors has its valid statements.
+ * The nodes that recovered still get AST_ERROR_CHILD_ERROR (the root of such a program has it), but the conversion goes on and succeeds.
+ *
  * @param ast_node The ASTNode to construct from the ParseTreeNode. If `parse_node->rule->promote_index` is specified, then `ast_node->type` will be set by a promoted child, otherwise it will be left unchanged. Other fields will be filled in by the contents of `parse_node`.
  * @param parse_node The ParseTreeNode to convert to an ASTNode. This node and its children must have a valid pointer to the ProductionRule used to parse it.
+ * @param tokens The tokens `parse_node` was parsed from (from the first one), the tokens of the tree are copied into the ASTNodes.
+ * @param arena The arena the children arrays of the AST are allocated in.
+ */
+bool ASTNode_from_ParseTreeNode(ASTNode *const ast_node, ParseTreeNodeWithPromo *const parse_node, const TokenStream *const tokens, Arena *const arena);
+
+/**
+ * Parse a `type` node like `parse_cfg_recursive_descent_parse_tree` and build the ASTNode `ASTNode_from_ParseTreeNode` would convert the parse tree to, without building the parse tree.
+ *
+ * Each node is converted as soon as its children are, from what they were converted to: the promotion of a node is only known once all its children are parsed,
+ * so the children are converted with the type given by their production rule and then either moved into the node (promoted or AST_FROM_CHILDREN) or added as its items.
+ * This halves the nodes allocated and the passes over the input compared to building the parse tree and converting it.
+ *
+ * With a precedence table, the expressions (converted with AST_FROM_PROMOTION) are parsed by precedence climbing, which builds the same AST without a call per level of the grammar for every operand.
+ * An expression with a syntax error is parsed again by following the grammar, so the partial AST and the syntax errors do not change.
+ * Errors are recovered from like `parse_cfg_recursive_descent_parse_tree` does if the table recovers from them, the items that failed are left out of the AST.
+ *
+ * WARNING: the grammar of `table` must satisfy `CFG_supports_direct_ast`, otherwise the AST may differ from the one converted from the parse tree.
+ *
+ * @param ast_node The ASTNode to build. `ast_node->type` must be set to the type to convert the node with, all other fields are ignored.
+ * @param type The token to parse.
+ * @param index The index of the current token to parse, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param input The tokens to parse. The stream must end with TokenType of TOKEN_EOF.
+ * @param table The predict table of the grammar to follow, see `parse_cfg_recursive_descent_parse_tree`.
+ * @param precedence The precedence table of the expressions of the same grammar (see `CFG_PrecedenceTable_init`), NULL to parse them by following the grammar.
+ * @param arena The arena the children arrays of the AST (and the syntax errors) are allocated in.
+ * @param errors The syntax errors are appended to it (allocated in `arena`), in the order `report_syntax_errors` would find them in the parse tree.
+ * @return true if the node was successfully parsed (without recovering from any error), false otherwise.
  */
-bool ASTNode_from_ParseTreeNode(ASTNode *const ast_node, ParseTreeNodeWithPromo *const parse_node);
+bool parse_cfg_recursive_descent_ast(ASTNode *const ast_node, const ParseToken type, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence, Arena *const arena, SyntaxErrors *const errors);
 
+/**
+ * Check that `parse_cfg_recursive_descent_ast` builds the same AST as `ASTNode_from_ParseTreeNode` for `grammar`, which requires that:
+ * - a rule with an AST_FROM_CHILDREN token is never promoted through (its `promote_index` is not less than its length), since the type of those children depends on the promotion.
+ * - every occurrence (not AST_SKIP) of a non-terminal with a direct left-recursive rule has the ASTNodeType of the first token of that rule, since the node is converted before it is known whether it continues left-recursively.
+ */
+bool CFG_supports_direct_ast(const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL]);
 
 #endif /* PARSER_H */
\ No newline at end of file
@@ -12,14 +12,16 @@
  * Semantically verify the given ASTNode `ctx` and populate the symbol table `symbol_table`.
  * 
  * @param ctx The ASTNode to semantically verify. Must be of ASTNodeType `AST_PROGRAM`, otherwise undefined behavior.
+ * @param input The input the tokens of the tree were lexed from.
+ * @param arena The arena of the compilation, the scope strings of the symbol table and the returned array of errors are allocated in it.
  */
-Array* ProcessProgram(ASTNode *head, Array *symbol_table, FILE *stream);
+Array* ProcessProgram(ASTNode *head, const char *input, Array *symbol_table, FILE *stream, Arena *arena);
 
 // Symbol table entry
 typedef struct _symEntry {
     ASTNodeType type;
     const ASTNode *symNode;
-    char *scope;    // String representation of the scope (e.g., "0.1.0"), must be freed when this entry is freed.
+    char *scope;    // String representation of the scope (e.g., "0.1.0"), allocated in the arena given to `ProcessProgram`.
 }symEntry;
 
 typedef Array* ScopeStackType;
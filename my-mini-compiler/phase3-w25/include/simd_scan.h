@@ -0,0 +1,41 @@
+#ifndef SIMD_SCAN_H
+#define SIMD_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * Vectorized scanners used by the lexer to skip runs of characters that cannot end the current token (or whitespace/comment) in one step,
+ * and by the parser to skip runs of token types (one byte each, see `TokenStream`) that cannot end a statement.
+ *
+ * Each scanner looks at `s[0, n)` and returns the index of the first character it stops on, or `n` if there is none.
+ * They process 32 (AVX2) or 16 (SSE2) bytes at a time, the instruction set is detected at runtime, with a scalar fallback for other targets.
+ * They never read past `s + n`.
+ */
+
+/* Instruction sets the scanners can use, from slowest to fastest. */
+typedef enum _SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+} SimdLevel;
+
+/* The best instruction set supported by the CPU (and the compiler). */
+SimdLevel simd_level(void);
+
+/* Stops on the first character that is not whitespace (' ', '\t', '\n', '\v', '\f', '\r'). */
+size_t simd_skip_whitespace(const char *s, size_t n);
+
+/* Stops on the first '\n' or null character (the end of a "??" comment). */
+size_t simd_find_line_end(const char *s, size_t n);
+
+/* Stops on the first '!' or null character (a possible end of a "?! ... !?" comment). */
+size_t simd_find_bang(const char *s, size_t n);
+
+/* Stops on the first character that is not allowed inside a string literal: '"', or anything that is not printable ASCII. */
+size_t simd_skip_string_chars(const char *s, size_t n);
+
+/* Stops on the first byte equal to `a`, `b` or `c`. */
+size_t simd_find_any_of3(const unsigned char *s, size_t n, unsigned char a, unsigned char b, unsigned char c);
+
+#endif /* SIMD_SCAN_H */
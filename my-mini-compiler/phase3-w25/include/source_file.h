@@ -0,0 +1,39 @@
+#ifndef SOURCE_FILE_H
+#define SOURCE_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Read-only contents of an input file.
+ *
+ * Regular files are memory-mapped (on POSIX systems) so loading costs no copying, the pages are read as the lexer reaches them.
+ * Anything that cannot be mapped (pipes, empty files, systems without mmap) is read into memory with large `read` calls instead.
+ * In both cases `text[length]` is a null character, so `text` can be passed directly to `init_lexer`.
+ *
+ * WARNING: the lexer treats the first null character as the end of the input, so anything after a null character in the file is ignored.
+ * WARNING: if a mapped file is truncated by another process while it is open, accessing the missing pages raises SIGBUS.
+ */
+typedef struct _SourceFile
+{
+    const char *text; // Contents of the file followed by a null character.
+    size_t length;    // Number of bytes in the file.
+    void *mapping;    // Start of the memory mapping, or NULL if the file was read into `buffer`.
+    size_t mapping_size;
+    char *buffer;     // Heap copy of the file, or NULL if the file is mapped.
+} SourceFile;
+
+/**
+ * Open and load the file at `path`.
+ * @param f The SourceFile to fill in. Must be closed with `source_file_close` when `true` is returned.
+ * @param path Path of the file to load.
+ * @return `true` on success, otherwise `false` with `errno` describing the error (and `f` left empty).
+ */
+bool source_file_open(SourceFile *f, const char *path);
+
+/**
+ * Release the contents of `f`, `f->text` is no longer valid afterwards. Closing an empty (zero-initialized) SourceFile does nothing.
+ */
+void source_file_close(SourceFile *f);
+
+#endif /* SOURCE_FILE_H */
@@ -0,0 +1,91 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tokens.h"
+
+/**
+ * The tokens of a whole input stored as parallel arrays (one per Token field) instead of an array of Token.
+ *
+ * The parser only looks at token types while deciding what to parse, with the types in a dense byte array 64 tokens share a cache line
+ * instead of each token pulling in a line of its own. The other fields are only read for the tokens that end up in the tree or in an error message.
+ * Filled by `lex_all` or `lex_parallel` (see lexer.h).
+ */
+typedef struct _TokenStream
+{
+    uint8_t *types;      // TokenType of every token.
+    uint8_t *errors;     // ErrorType of every token.
+    size_t *offsets;     // See `Token.offset`.
+    uint32_t *lengths;   // See `Token.length`.
+    uint32_t *ids;       // See `Token.id`.
+    TokenValue *values;  // See `Token.value`.
+    size_t count;
+    size_t capacity;
+} TokenStream;
+
+_Static_assert(TokenType_MAX <= UINT8_MAX, "TokenStream stores token types in a byte");
+_Static_assert(ERROR_LEXEME_TOO_LONG <= UINT8_MAX, "TokenStream stores error types in a byte");
+
+/**
+ * Initialize an empty stream, nothing is allocated until a token is added.
+ */
+void token_stream_init(TokenStream *tokens);
+
+/**
+ * Free the arrays of the stream, it can be reused after `token_stream_init`.
+ */
+void token_stream_free(TokenStream *tokens);
+
+/**
+ * Make room for at least `capacity` tokens.
+ */
+void token_stream_reserve(TokenStream *tokens, size_t capacity);
+
+/**
+ * Replace the tokens [begin, end) of `tokens` with all the tokens of `replacement`, moving the tokens after `end` as needed.
+ * Offsets are copied as they are, the caller adjusts them if the input changed.
+ */
+void token_stream_replace(TokenStream *tokens, size_t begin, size_t end, const TokenStream *replacement);
+
+/**
+ * Store `token` at index `i` (i < tokens->capacity), without changing the number of tokens.
+ */
+static inline void token_stream_set(TokenStream *const tokens, const size_t i, const Token *const token)
+{
+    tokens->types[i] = (uint8_t)token->type;
+    tokens->errors[i] = (uint8_t)token->error;
+    tokens->offsets[i] = token->offset;
+    tokens->lengths[i] = token->length;
+    tokens->ids[i] = token->id;
+    tokens->values[i] = token->value;
+}
+
+/**
+ * Append `token` to the stream.
+ */
+static inline void token_stream_push(TokenStream *const tokens, const Token *const token)
+{
+    if (tokens->count == tokens->capacity)
+        token_stream_reserve(tokens, tokens->capacity == 0 ? 64 : 2 * tokens->capacity);
+    token_stream_set(tokens, tokens->count++, token);
+}
+
+/**
+ * @param i Index of the token (i < tokens->count).
+ * @return A copy of the token at index `i`.
+ */
+static inline Token token_stream_get(const TokenStream *const tokens, const size_t i)
+{
+    return (Token){
+        .offset = tokens->offsets[i],
+        .length = tokens->lengths[i],
+        .id = tokens->ids[i],
+        .type = (TokenType)tokens->types[i],
+        .error = (ErrorType)tokens->errors[i],
+        .value = tokens->values[i],
+    };
+}
+
+#endif /* TOKEN_STREAM_H */
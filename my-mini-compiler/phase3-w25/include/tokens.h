@@ -6,6 +6,11 @@
 #ifndef TOKENS_H
 #define TOKENS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 /* Token types that need to be recognized by the lexer */
 typedef enum _TokenType
 {
@@ -76,8 +81,8 @@ typedef enum _ErrorType
     ERROR_INVALID_CHAR,
     ERROR_INVALID_NUMBER,
     ERROR_UNTERMINATED_STRING,
-    ERROR_STRING_TOO_LONG,
     ERROR_UNTERMINATED_COMMENT,
+    ERROR_LEXEME_TOO_LONG,
 } ErrorType;
 
 const char *ErrorType_to_error_message(ErrorType error);
@@ -85,18 +90,55 @@ const char *ErrorType_to_error_message(ErrorType error);
 /* Details for positions of tokens in a file. */
 typedef struct _LexemePosition
 {
-    int line;      // Line number of the token in the file.
-    int col_start; // Column number of the first character of the token in the line.
-    int col_end;   // Column number of the last character of the token in the line.
+    size_t line;      // Line number of the token in the file.
+    size_t col_start; // Column number of the first character of the token in the line.
+    size_t col_end;   // Column number of the last character of the token in the line.
 } LexemePosition;
 
-/* Token structure to store token information */
+/* Value of a number token. */
+typedef union _TokenValue
+{
+    int64_t integer; // Value of a TOKEN_INTEGER_CONST.
+    double real;     // Value of a TOKEN_FLOAT_CONST, correctly rounded.
+} TokenValue;
+
+/**
+ * Token structure to store token information.
+ * The lexeme is not copied into the token, it is the slice [offset, offset + length) of the input the token was lexed from.
+ * Offsets are 64-bit so inputs can be larger than 4 GiB, a single lexeme is limited to 4 GiB (a longer one is an ERROR_LEXEME_TOO_LONG with an empty lexeme).
+ * The line and columns of the lexeme are not stored, they are resolved from the offset when needed (see `Token_position` in line_index.h).
+ */
 typedef struct _Token
 {
+    size_t offset;           // Index of the first character of the lexeme in the input.
+    uint32_t length;         // Number of characters in the lexeme.
+    uint32_t id;             // Interned ID of the lexeme for keywords, identifiers and string literals (see intern.h), INTERN_ID_NONE otherwise.
     TokenType type;
     ErrorType error;         // Error type if the token is an TOKEN_ERROR.
-    LexemePosition position; // Position of this token's lexeme in the input
-    char lexeme[100];        // Actual text of the token
+    TokenValue value;        // Parsed by the lexer, 0 for every other token (including numbers too large for their type, which are ERROR_INVALID_NUMBER).
 } Token;
 
+/* Pointer to the first character of `token`'s lexeme in `input`, the lexeme is not null-terminated (print it with "%.*s"). */
+static inline const char *Token_lexeme(const Token *const token, const char *const input)
+{
+    return input + token->offset;
+}
+
+/**
+ * Column of the last character of `token`'s lexeme, given the column of its first character.
+ * Tokens with an empty lexeme (end of input, unterminated comments) end where they start, operators report one column past their last character.
+ */
+static inline size_t Token_col_end(const Token *const token, const size_t col_start)
+{
+    if (token->type >= TokenType_FIRST_OPERATOR)
+        return col_start + token->length;
+    return token->length == 0 ? col_start : col_start + token->length - 1;
+}
+
+/* Whether tokens `a` and `b`, both lexed from `input`, have the same lexeme. */
+static inline bool Token_lexeme_equal(const Token *const a, const Token *const b, const char *const input)
+{
+    return a->length == b->length && memcmp(input + a->offset, input + b->offset, a->length) == 0;
+}
+
 #endif /* TOKENS_H */
@@ -4,6 +4,7 @@
 typedef const void *(const_voidp_to_const_voidp)(const void *);
 typedef size_t (const_voidp_to_size_t)(const void *);
 typedef void (const_voidp_to_void)(const void *);
+typedef void (const_voidp_voidp_to_void)(const void *, void *);
 
 /**
  * Function pointers for printing a tree.
@@ -12,7 +13,8 @@ typedef void (const_voidp_to_void)(const void *);
  * @param children A function that returns the beginning of the children of a node.
  * @param count A function that returns the number of children of a node.
  * @param size The size of the node in bytes. 
- * @param print_head A function that prints the head of a node
+ * @param print_head A function that prints the head of a node, it is passed the node and `context`.
+ * @param context Passed to `print_head` with every node (e.g. the lexer that produced the tokens of the tree).
  */
 typedef struct _print_tree_t
 {
@@ -20,7 +22,8 @@ typedef struct _print_tree_t
     const_voidp_to_const_voidp *children;
     const_voidp_to_size_t *count;
     const size_t size;
-    const_voidp_to_void *print_head;
+    const_voidp_voidp_to_void *print_head;
+    void *context;
 } print_tree_t;
 
 /**
@@ -0,0 +1,94 @@
+#include "../include/arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void arena_init(Arena *const a, const size_t block_size)
+{
+    a->blocks = NULL;
+    a->block_size = block_size == 0 ? ARENA_DEFAULT_BLOCK_SIZE : block_size;
+    a->block_count = 0;
+}
+
+void arena_free(Arena *const a)
+{
+    for (ArenaBlock *block = a->blocks, *next; block != NULL; block = next) {
+        next = block->next;
+        free(block);
+    }
+    a->blocks = NULL;
+    a->block_count = 0;
+}
+
+void *arena_alloc_block(Arena *const a, const size_t size, const size_t alignment)
+{
+    (void)alignment; // the data of a block is aligned for any type.
+    const size_t block_size = size > a->block_size ? size : a->block_size;
+    ArenaBlock *const block = malloc(sizeof(ArenaBlock) + block_size);
+    if (block == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    block->next = a->blocks;
+    block->used = size;
+    block->size = block_size;
+    a->blocks = block;
+    ++a->block_count;
+    return block->data;
+}
+
+void *arena_grow(Arena *const a, void *const ptr, const size_t old_size, const size_t new_size)
+{
+    if (ptr != NULL && new_size <= old_size)
+        return ptr;
+    ArenaBlock *const block = a->blocks;
+    // the last allocation of the arena can grow into the rest of its block.
+    if (ptr != NULL && block != NULL && (unsigned char *)ptr + old_size == block->data + block->used
+        && new_size - old_size <= block->size - block->used) {
+        block->used += new_size - old_size;
+        return ptr;
+    }
+    void *const grown = arena_alloc(a, new_size);
+    if (old_size != 0)
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+char *arena_strndup(Arena *const a, const char *const s, const size_t length)
+{
+    char *const copy = arena_alloc_aligned(a, length + 1, 1);
+    memcpy(copy, s, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_reset(Arena *const a, const ArenaMark mark)
+{
+    while (a->blocks != mark.block) {
+        ArenaBlock *const next = a->blocks->next;
+        free(a->blocks);
+        a->blocks = next;
+        --a->block_count;
+    }
+    if (a->blocks != NULL)
+        a->blocks->used = mark.used;
+}
+
+void arena_adopt(Arena *const a, Arena *const from)
+{
+    if (from->blocks == NULL)
+        return;
+    ArenaBlock *last = from->blocks;
+    while (last->next != NULL)
+        last = last->next;
+    // behind the current block of `a`, or as the whole list if `a` is empty.
+    if (a->blocks == NULL) {
+        a->blocks = from->blocks;
+    } else {
+        last->next = a->blocks->next;
+        a->blocks->next = from->blocks;
+    }
+    a->block_count += from->block_count;
+    from->blocks = NULL;
+    from->block_count = 0;
+}
@@ -10,6 +10,7 @@ typedef struct Array_t
     size_t element_size;
     void *elements;
     size_t capacity;
+    Arena *arena; // Owner of the array and its elements, NULL if they are allocated with malloc.
 } Array;
 
 Array *array_new(const size_t capacity, const size_t element_size)
@@ -18,6 +19,19 @@ Array *array_new(const size_t capacity, const size_t element_size)
     a->element_size = element_size;
     a->capacity = 0;
     a->elements = NULL;
+    a->arena = NULL;
+    array_increase_capacity(a, capacity);
+    a->size = 0;
+    return a;
+}
+
+Array *array_new_in_arena(Arena *const arena, const size_t capacity, const size_t element_size)
+{
+    Array *a = (Array *)arena_alloc(arena, sizeof(Array));
+    a->element_size = element_size;
+    a->capacity = 0;
+    a->elements = NULL;
+    a->arena = arena;
     array_increase_capacity(a, capacity);
     a->size = 0;
     return a;
@@ -26,6 +40,9 @@ Array *array_new(const size_t capacity, const size_t element_size)
 // TODO: implement null pointer checking before freeing.
 void array_free(Array *a)
 {
+    // released with the arena.
+    if (a->arena != NULL)
+        return;
     free(a->elements);
     free(a);
 }
@@ -53,12 +70,15 @@ void array_decrease_capacity(Array *const a, const size_t decrease)
     assert(a != NULL);
     if (decrease >= a->capacity)
     {
-        free(a->elements);
+        if (a->arena == NULL)
+            free(a->elements);
         a->elements = NULL;
         a->size = 0;
         return;
     }
     a->capacity -= decrease;
+    if (a->arena != NULL)
+        return;
     a->elements = (Element *)realloc(a->elements, a->capacity * a->element_size);
     assert(a->elements != NULL);
 }
@@ -66,6 +86,12 @@ void array_decrease_capacity(Array *const a, const size_t decrease)
 void array_increase_capacity(Array *const a, const size_t increase)
 {
     assert(a != NULL);
+    if (a->arena != NULL)
+    {
+        a->elements = arena_grow(a->arena, a->elements, a->capacity * a->element_size, (a->capacity + increase) * a->element_size);
+        a->capacity += increase;
+        return;
+    }
     a->capacity += increase;
     if (a->elements == NULL)
     {
@@ -81,7 +107,8 @@ void array_set_capacity(Array *const a, const size_t new_capacity)
 {
     if (new_capacity == 0)
     {
-        free(a->elements);
+        if (a->arena == NULL)
+            free(a->elements);
         a->elements = NULL;
         a->size = 0;
     }
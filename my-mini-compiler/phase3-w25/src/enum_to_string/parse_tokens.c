@@ -246,6 +246,8 @@ const char *ParseErrorType_to_string(const ParseErrorType error)
         return "PARSE_ERROR_CHILD_ERROR";
     case PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE:
         return "PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE";
+    case PARSE_ERROR_RECOVERED:
+        return "PARSE_ERROR_RECOVERED";
     }   
     return "UNKNOWN";
 }
\ No newline at end of file
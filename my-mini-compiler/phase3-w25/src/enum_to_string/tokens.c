@@ -115,10 +115,10 @@ const char *ErrorType_to_error_message(const ErrorType error)
         return "error: invalid number format";
     case ERROR_UNTERMINATED_STRING:
         return "error: unterminated string literal";
-    case ERROR_STRING_TOO_LONG:
-        return "error: string literal too long";
     case ERROR_UNTERMINATED_COMMENT:
         return "error: unterminated comment, missing matching '!?'";
+    case ERROR_LEXEME_TOO_LONG:
+        return "error: lexeme longer than 4 GiB";
     }
     return "Unknown error";
 }
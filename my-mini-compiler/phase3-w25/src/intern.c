@@ -0,0 +1,124 @@
+#include "../include/intern.h"
+#include "../include/arena.h"
+#include "../include/simple_dynamic_array.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Size of the arena blocks the strings are copied to, strings longer than this get a block of their own.
+#define INTERN_ARENA_BLOCK_SIZE 4096
+// Initial number of hash slots (must be a power of two).
+#define INTERN_INITIAL_SLOTS 64
+
+typedef struct _InternEntry
+{
+    const char *text; // null-terminated copy in the arena.
+    size_t length;
+    uint32_t hash;
+} InternEntry;
+
+DA_DEFINE(InternEntries, InternEntry);
+
+typedef struct InternTable_t
+{
+    InternEntries entries; // indexed by ID.
+    uint32_t *slots;       // open addressing (linear probing), each slot is ID + 1, or 0 if the slot is empty.
+    size_t slot_count;     // power of two, kept at least twice the number of entries.
+    Arena strings;         // copies of the interned strings.
+} InternTable;
+
+static void *checked_malloc(const size_t size)
+{
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+// FNV-1a
+static uint32_t intern_hash(const char *const s, const size_t length)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static void intern_table_grow(InternTable *const t)
+{
+    free(t->slots);
+    t->slot_count *= 2;
+    t->slots = calloc(t->slot_count, sizeof(uint32_t));
+    if (t->slots == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    const size_t mask = t->slot_count - 1;
+    for (size_t id = 0; id < t->entries.count; ++id) {
+        size_t i = t->entries.items[id].hash & mask;
+        while (t->slots[i] != 0)
+            i = (i + 1) & mask;
+        t->slots[i] = (uint32_t)id + 1;
+    }
+}
+
+InternTable *intern_table_new(void)
+{
+    InternTable *t = checked_malloc(sizeof(InternTable));
+    da_init(&t->entries);
+    t->slot_count = INTERN_INITIAL_SLOTS;
+    t->slots = calloc(t->slot_count, sizeof(uint32_t));
+    if (t->slots == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    arena_init(&t->strings, INTERN_ARENA_BLOCK_SIZE);
+    return t;
+}
+
+void intern_table_free(InternTable *t)
+{
+    if (t == NULL)
+        return;
+    arena_free(&t->strings);
+    da_clear(&t->entries);
+    free(t->slots);
+    free(t);
+}
+
+uint32_t intern_table_size(const InternTable *const t)
+{
+    assert(t != NULL);
+    return (uint32_t)t->entries.count;
+}
+
+uint32_t intern(InternTable *const t, const char *const s, const size_t length)
+{
+    assert(t != NULL);
+    const uint32_t hash = intern_hash(s, length);
+    const size_t mask = t->slot_count - 1;
+    size_t i = hash & mask;
+    for (; t->slots[i] != 0; i = (i + 1) & mask) {
+        const InternEntry *const e = t->entries.items + (t->slots[i] - 1);
+        if (e->hash == hash && e->length == length && memcmp(e->text, s, length) == 0)
+            return t->slots[i] - 1;
+    }
+    assert(t->entries.count < INTERN_ID_NONE - 1);
+    const uint32_t id = (uint32_t)t->entries.count;
+    da_push(&t->entries, ((InternEntry){.text = arena_strndup(&t->strings, s, length), .length = length, .hash = hash}));
+    t->slots[i] = id + 1;
+    if (2 * t->entries.count > t->slot_count)
+        intern_table_grow(t);
+    return id;
+}
+
+const char *intern_get(const InternTable *const t, const uint32_t id, size_t *const length)
+{
+    assert(t != NULL && id < t->entries.count);
+    if (length != NULL)
+        *length = t->entries.items[id].length;
+    return t->entries.items[id].text;
+}
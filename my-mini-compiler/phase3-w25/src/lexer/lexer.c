@@ -1,281 +1,976 @@
 /* lexer.c */
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define read _read
+typedef int ssize_t;
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 #include "../../include/lexer.h"
-#include "../../include/dynamic_array.h"
-#include "../../include/operators.h"
+#include "../../include/simd_scan.h"
+#include "../../include/simple_dynamic_array.h"
+// generated from tokens.h at build time by tools/gen_keyword_hash.c
+#include "keyword_hash.h"
+// generated from operators.h at build time by tools/gen_operator_switch.c
+#include "operator_dfa.h"
+
+/**
+ * The lexer is a table-driven DFA.
+ *
+ * Every input byte is first mapped to a CharClass through `char_class`, then the pair (current state, character class) is looked up in `transitions` to get the next state.
+ * A transition to `S_DONE` ends the current token without consuming the character, the token is then built from the state it ended in (see `accepts`).
+ * A transition to `S_START` consumes the character and discards everything consumed so far (whitespace and comments).
+ *
+ * The tables replace the old chain of `isspace`/`isdigit`/`isalpha` checks, the linear `strncmp` scan over the operators and the `strchr` over the punctuators.
+ * They do not depend on the current locale.
+ * The operator part of the tables (a class per operator character, a state per operator) is generated from reduced_operators, so the lexer recognises exactly the operators of the table.
+ */
+
+// Character classes, every byte of the input belongs to exactly one of these.
+typedef enum _CharClass
+{
+    CC_OTHER,       // non-printable characters that are not whitespace (and every byte >= 0x80)
+    CC_NUL,         // '\0', end of input
+    CC_SPACE,       // ' ' (printable whitespace, allowed in string literals)
+    CC_WHITESPACE,  // '\t', '\v', '\f', '\r' (non-printable whitespace)
+    CC_NEWLINE,     // '\n'
+    CC_ALPHA,       // [a-zA-Z_]
+    CC_DIGIT,       // [0-9]
+    CC_DOT,         // '.'
+    CC_QUOTE,       // '"'
+    CC_QUESTION,    // '?'
+    CC_BANG,        // '!' (an operator character too, see OPERATOR_START_TRANSITIONS)
+    CC_FIRST_OPERATOR, // the other characters of the operators, one class each (see OPERATOR_CHAR_CLASS_TABLE)
+    CC_LAST_OPERATOR = CC_FIRST_OPERATOR + OPERATOR_CHAR_CLASS_COUNT - 1,
+    CC_PUNCTUATOR,  // ; { } ( )
+    CC_PRINTABLE,   // any other printable character
+    CC_COUNT
+} CharClass;
+
+// DFA states. S_DONE must be 0 so that every transition left out of `transitions` ends the token.
+typedef enum _LexerState
+{
+    S_DONE,
+    S_START,
+    S_IDENTIFIER,
+    S_INTEGER,
+    S_FLOAT,
+    S_STRING,
+    S_STRING_END,
+    S_QUESTION,
+    S_LINE_COMMENT,
+    S_BLOCK_COMMENT,
+    S_BLOCK_COMMENT_BANG,
+    S_FIRST_OPERATOR, // the operators, in the order of reduced_operators (see OPERATOR_TRANSITIONS)
+    S_LAST_OPERATOR = S_FIRST_OPERATOR + OPERATOR_STATE_COUNT - 1,
+    S_PUNCTUATOR,
+    S_INVALID,
+    S_COUNT
+} LexerState;
+
+// Every character class that can appear inside a comment without affecting it (all but '\0', '\n', '!' and '?').
+#define COMMENT_TEXT_CLASSES(next)                                                  \
+    [CC_SPACE] = next, [CC_WHITESPACE] = next, [CC_ALPHA] = next, [CC_DIGIT] = next, \
+    [CC_DOT] = next, [CC_QUOTE] = next, OPERATOR_CHAR_CLASSES_TO(next)              \
+    [CC_PUNCTUATOR] = next, [CC_PRINTABLE] = next, [CC_OTHER] = next
+
+static const unsigned char char_class[256] = {
+    ['\0'] = CC_NUL,
+    [' '] = CC_SPACE,
+    ['\t'] = CC_WHITESPACE, ['\v'] = CC_WHITESPACE, ['\f'] = CC_WHITESPACE, ['\r'] = CC_WHITESPACE,
+    ['\n'] = CC_NEWLINE,
+    ['a'] = CC_ALPHA, ['b'] = CC_ALPHA, ['c'] = CC_ALPHA, ['d'] = CC_ALPHA, ['e'] = CC_ALPHA, ['f'] = CC_ALPHA, ['g'] = CC_ALPHA,
+    ['h'] = CC_ALPHA, ['i'] = CC_ALPHA, ['j'] = CC_ALPHA, ['k'] = CC_ALPHA, ['l'] = CC_ALPHA, ['m'] = CC_ALPHA, ['n'] = CC_ALPHA,
+    ['o'] = CC_ALPHA, ['p'] = CC_ALPHA, ['q'] = CC_ALPHA, ['r'] = CC_ALPHA, ['s'] = CC_ALPHA, ['t'] = CC_ALPHA, ['u'] = CC_ALPHA,
+    ['v'] = CC_ALPHA, ['w'] = CC_ALPHA, ['x'] = CC_ALPHA, ['y'] = CC_ALPHA, ['z'] = CC_ALPHA,
+    ['A'] = CC_ALPHA, ['B'] = CC_ALPHA, ['C'] = CC_ALPHA, ['D'] = CC_ALPHA, ['E'] = CC_ALPHA, ['F'] = CC_ALPHA, ['G'] = CC_ALPHA,
+    ['H'] = CC_ALPHA, ['I'] = CC_ALPHA, ['J'] = CC_ALPHA, ['K'] = CC_ALPHA, ['L'] = CC_ALPHA, ['M'] = CC_ALPHA, ['N'] = CC_ALPHA,
+    ['O'] = CC_ALPHA, ['P'] = CC_ALPHA, ['Q'] = CC_ALPHA, ['R'] = CC_ALPHA, ['S'] = CC_ALPHA, ['T'] = CC_ALPHA, ['U'] = CC_ALPHA,
+    ['V'] = CC_ALPHA, ['W'] = CC_ALPHA, ['X'] = CC_ALPHA, ['Y'] = CC_ALPHA, ['Z'] = CC_ALPHA,
+    ['_'] = CC_ALPHA,
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT, ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+    ['.'] = CC_DOT,
+    ['"'] = CC_QUOTE,
+    ['?'] = CC_QUESTION,
+    ['!'] = CC_BANG,
+    OPERATOR_CHAR_CLASS_TABLE
+    [';'] = CC_PUNCTUATOR, ['{'] = CC_PUNCTUATOR, ['}'] = CC_PUNCTUATOR, ['('] = CC_PUNCTUATOR, [')'] = CC_PUNCTUATOR,
+    ['#'] = CC_PRINTABLE, ['$'] = CC_PRINTABLE, ['\''] = CC_PRINTABLE, [','] = CC_PRINTABLE, [':'] = CC_PRINTABLE,
+    ['@'] = CC_PRINTABLE, ['['] = CC_PRINTABLE, ['\\'] = CC_PRINTABLE, [']'] = CC_PRINTABLE, ['`'] = CC_PRINTABLE,
+};
+
+static const unsigned char transitions[S_COUNT][CC_COUNT] = {
+    [S_START] = {
+        [CC_SPACE] = S_START, [CC_WHITESPACE] = S_START, [CC_NEWLINE] = S_START,
+        [CC_ALPHA] = S_IDENTIFIER,
+        [CC_DIGIT] = S_INTEGER,
+        [CC_QUOTE] = S_STRING,
+        [CC_QUESTION] = S_QUESTION,
+        OPERATOR_START_TRANSITIONS
+        [CC_PUNCTUATOR] = S_PUNCTUATOR,
+        [CC_DOT] = S_INVALID, [CC_PRINTABLE] = S_INVALID, [CC_OTHER] = S_INVALID},
+    [S_IDENTIFIER] = {[CC_ALPHA] = S_IDENTIFIER, [CC_DIGIT] = S_IDENTIFIER},
+    [S_INTEGER] = {[CC_DIGIT] = S_INTEGER, [CC_DOT] = S_FLOAT},
+    [S_FLOAT] = {[CC_DIGIT] = S_FLOAT},
+    [S_STRING] = {
+        [CC_SPACE] = S_STRING, [CC_ALPHA] = S_STRING, [CC_DIGIT] = S_STRING, [CC_DOT] = S_STRING,
+        [CC_QUESTION] = S_STRING, [CC_BANG] = S_STRING, OPERATOR_CHAR_CLASSES_TO(S_STRING)
+        [CC_PUNCTUATOR] = S_STRING, [CC_PRINTABLE] = S_STRING,
+        [CC_QUOTE] = S_STRING_END},
+    [S_QUESTION] = {[CC_QUESTION] = S_LINE_COMMENT, [CC_BANG] = S_BLOCK_COMMENT},
+    [S_LINE_COMMENT] = {
+        COMMENT_TEXT_CLASSES(S_LINE_COMMENT), [CC_BANG] = S_LINE_COMMENT, [CC_QUESTION] = S_LINE_COMMENT,
+        [CC_NEWLINE] = S_START},
+    [S_BLOCK_COMMENT] = {
+        COMMENT_TEXT_CLASSES(S_BLOCK_COMMENT), [CC_NEWLINE] = S_BLOCK_COMMENT, [CC_QUESTION] = S_BLOCK_COMMENT,
+        [CC_BANG] = S_BLOCK_COMMENT_BANG},
+    [S_BLOCK_COMMENT_BANG] = {
+        COMMENT_TEXT_CLASSES(S_BLOCK_COMMENT), [CC_NEWLINE] = S_BLOCK_COMMENT,
+        [CC_BANG] = S_BLOCK_COMMENT_BANG,
+        [CC_QUESTION] = S_START},
+    OPERATOR_TRANSITIONS
+    // every other state accepts exactly the characters consumed so far, so all of its transitions are S_DONE.
+};
+
+#undef COMMENT_TEXT_CLASSES
+
+// What kind of token a state produces when the DFA stops in it.
+// A `type` of TOKEN_NULL means that the type is determined by the first character of the lexeme (see `single_char_token`).
+typedef struct _Accept
+{
+    TokenType type;
+    ErrorType error;
+} Accept;
+
+static const Accept accepts[S_COUNT] = {
+    [S_START] = {TOKEN_EOF, ERROR_NONE},
+    [S_IDENTIFIER] = {TOKEN_IDENTIFIER, ERROR_NONE},
+    [S_INTEGER] = {TOKEN_INTEGER_CONST, ERROR_NONE},
+    [S_FLOAT] = {TOKEN_FLOAT_CONST, ERROR_NONE},
+    [S_STRING] = {TOKEN_ERROR, ERROR_UNTERMINATED_STRING},
+    [S_STRING_END] = {TOKEN_STRING_CONST, ERROR_NONE},
+    [S_QUESTION] = {TOKEN_ERROR, ERROR_INVALID_CHAR},
+    [S_LINE_COMMENT] = {TOKEN_EOF, ERROR_NONE},
+    [S_BLOCK_COMMENT] = {TOKEN_ERROR, ERROR_UNTERMINATED_COMMENT},
+    [S_BLOCK_COMMENT_BANG] = {TOKEN_ERROR, ERROR_UNTERMINATED_COMMENT},
+    OPERATOR_ACCEPTS
+    [S_PUNCTUATOR] = {TOKEN_NULL, ERROR_NONE},
+    [S_INVALID] = {TOKEN_ERROR, ERROR_INVALID_CHAR},
+};
+
+// Token type of the single character tokens whose state does not determine the type (the punctuators).
+static const TokenType single_char_token[256] = {
+    [';'] = TOKEN_SEMICOLON,
+    ['{'] = TOKEN_LEFT_BRACE,
+    ['}'] = TOKEN_RIGHT_BRACE,
+    ['('] = TOKEN_LEFT_PAREN,
+    [')'] = TOKEN_RIGHT_PAREN,
+};
+
+// Progress of the DFA through the input, kept between calls to `scan` so that a token can be resumed after the streaming lexer refills its buffer.
+typedef struct _Scan
+{
+    LexerState state;
+    size_t position;         // offset of the next character to read.
+    size_t start;            // offset of the start of the lexeme, updated every time the DFA returns to S_START.
+    // only maintained by the streaming lexer, which has no line index.
+    size_t line;             // line of the next character to read.
+    size_t line_start;       // offset of the first character of `line`.
+    size_t start_line;       // line of `start`.
+    size_t start_line_start; // offset of the first character of `start_line`.
+} Scan;
+
+static InternTable *new_symbol_table(void)
+{
+    // keywords are interned first, so their ID is their keyword index.
+    InternTable *const symbols = intern_table_new();
+    for (int i = 0; i < KEYWORD_COUNT; ++i)
+        intern(symbols, keyword_list[i].lexeme, keyword_list[i].length);
+    return symbols;
+}
+
+/**
+ * Skip the rest of a run of characters that keep the DFA in `state`: whitespace, comment text or string characters.
+ * Called when the DFA enters one of those states, the scanners in simd_scan.h look at 16 or 32 characters at a time instead of one transition per character.
+ * They stop on every character that can leave the state (or on `end`), so the DFA takes exactly the same transitions afterwards.
+ * @param end Offset of the null character that ends the input (or the streaming lexer's buffer).
+ */
+static inline void skip_run(const char *const input, const size_t end, const LexerState state, Scan *const t, const bool count_lines)
+{
+    const size_t from = t->position;
+    // most runs are a single character (a space between two tokens), do not bother with the scanners for those.
+    if (transitions[state][char_class[(unsigned char)input[from]]] != state)
+        return;
+    switch (state)
+    {
+    case S_START:
+        t->position += simd_skip_whitespace(input + from, end - from);
+        break;
+    case S_LINE_COMMENT:
+        t->position += simd_find_line_end(input + from, end - from);
+        break;
+    case S_BLOCK_COMMENT:
+        t->position += simd_find_bang(input + from, end - from);
+        break;
+    case S_STRING:
+        t->position += simd_skip_string_chars(input + from, end - from);
+        break;
+    default:
+        return;
+    }
+    if (count_lines && (state == S_START || state == S_BLOCK_COMMENT))
+    {
+        const char *p = input + from, *const stop = input + t->position;
+        while ((p = memchr(p, '\n', (size_t)(stop - p))) != NULL)
+        {
+            ++p;
+            ++t->line;
+            t->line_start = (size_t)(p - input);
+        }
+    }
+}
+
+/**
+ * Run the DFA until it stops (on a character that cannot extend the current token, or on a null character).
+ * @param buffer The input from offset `buffer_offset` on, `s->position` must be inside it.
+ * @param end Offset of the null character after the last character of `buffer`, or of the end of a parallel lexer's chunk.
+ * @param count_lines Whether to maintain the line fields of `s` (a constant at every call site, so the check is compiled out).
+ * @param stop_at_end Whether to stop at `end` even if the character there is not a null character (also a constant at every call site).
+ */
+static inline void scan(const char *const buffer, const size_t buffer_offset, const size_t end, Scan *const s, const bool count_lines, const bool stop_at_end)
+{
+    const char *const input = buffer - buffer_offset;
+    Scan t = *s;
+    while (!(stop_at_end && t.position == end))
+    {
+        const unsigned char c = (unsigned char)input[t.position];
+        const LexerState next = (LexerState)transitions[t.state][char_class[c]];
+        if (next == S_DONE)
+            break;
+        ++t.position;
+        if (count_lines && c == '\n')
+        {
+            ++t.line;
+            t.line_start = t.position;
+        }
+        // S_START stays in S_START on whitespace, so the run is skipped from its first character on.
+        if (next != t.state || next == S_START)
+            skip_run(input, end, next, &t, count_lines);
+        if (next == S_START)
+        {
+            t.start = t.position;
+            if (count_lines)
+            {
+                t.start_line = t.line;
+                t.start_line_start = t.line_start;
+            }
+        }
+        t.state = next;
+    }
+    *s = t;
+}
 
+// Powers of ten up to the largest one that is exactly representable as a double.
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const uint64_t powers_of_ten[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+    1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+// Most decimal digits that always fit in a uint64_t.
+#define MAX_UINT64_DIGITS 19
+
+/**
+ * Parse 8 decimal digits at once (SWAR): the digits are loaded as a single 64-bit word,
+ * then neighbouring digits, pairs and quadruples are combined with one multiplication each.
+ */
+static inline uint32_t parse_eight_digits(const char *const digits)
+{
+    uint64_t v;
+    memcpy(&v, digits, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v); // the first digit must be the lowest byte.
+#endif
+    v = (v & 0x0f0f0f0f0f0f0f0full) * 2561 >> 8;             // 10 * even digit + odd digit in every 16 bits.
+    v = (v & 0x00ff00ff00ff00ffull) * 6553601 >> 16;         // 100 * pair + next pair in every 32 bits.
+    return (uint32_t)((v & 0x0000ffff0000ffffull) * 42949672960001 >> 32); // 10000 * quadruple + next quadruple.
+}
 
+/**
+ * @param length Number of digits, at most MAX_UINT64_DIGITS.
+ */
+static uint64_t parse_digits(const char *digits, size_t length)
+{
+    uint64_t value = 0;
+    for (; length >= 8; digits += 8, length -= 8)
+        value = value * 100000000 + parse_eight_digits(digits);
+    for (; length > 0; ++digits, --length)
+        value = value * 10 + (uint64_t)(*digits - '0');
+    return value;
+}
+
+/**
+ * Parse the lexeme of a TOKEN_INTEGER_CONST ([0-9]+).
+ * @return false if the value does not fit in an int64_t.
+ */
+static bool parse_integer(const char *digits, size_t length, int64_t *const value)
+{
+    while (length > 1 && *digits == '0')
+    {
+        ++digits;
+        --length;
+    }
+    if (length > MAX_UINT64_DIGITS)
+        return false;
+    const uint64_t v = parse_digits(digits, length);
+    if (v > (uint64_t)INT64_MAX)
+        return false;
+    *value = (int64_t)v;
+    return true;
+}
+
+/**
+ * Parse the lexeme of a TOKEN_FLOAT_CONST ([0-9]+\.[0-9]*) to the nearest double.
+ *
+ * When the significant digits fit in 53 bits and there are at most 22 decimals, the digits and the power of ten are both exact doubles,
+ * so a single (correctly rounded) division gives the correctly rounded value. Other values are left to `strtod`.
+ * @return false if the value is too large for a double.
+ */
+static bool parse_float(const char *const lexeme, const size_t length, double *const value)
+{
+    const char *integer = lexeme;
+    size_t integer_length = (size_t)((const char *)memchr(lexeme, '.', length) - lexeme);
+    const char *const fraction = lexeme + integer_length + 1;
+    size_t fraction_length = length - integer_length - 1;
+    // leading zeros of the integer part and trailing zeros of the fraction do not change the value.
+    for (; integer_length > 0 && *integer == '0'; ++integer, --integer_length)
+        ;
+    for (; fraction_length > 0 && fraction[fraction_length - 1] == '0'; --fraction_length)
+        ;
+    if (integer_length + fraction_length <= MAX_UINT64_DIGITS && fraction_length < sizeof(exact_powers_of_ten) / sizeof(exact_powers_of_ten[0]))
+    {
+        const uint64_t digits = parse_digits(integer, integer_length) * powers_of_ten[fraction_length] + parse_digits(fraction, fraction_length);
+        if (digits <= (uint64_t)1 << 53)
+        {
+            *value = (double)digits / exact_powers_of_ten[fraction_length];
+            return true;
+        }
+    }
+    // strtod needs a null-terminated copy, the lexeme is followed by the rest of the input (in which "1.5e3" would be a single number).
+    // The compiler never changes the locale, so '.' is the decimal point.
+    char small[64];
+    char *const copy = length < sizeof(small) ? small : malloc(length + 1);
+    if (copy == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, lexeme, length);
+    copy[length] = '\0';
+    *value = strtod(copy, NULL);
+    if (copy != small)
+        free(copy);
+    return !isinf(*value);
+}
 
-// keywords
-// to check if a string is a keyword
-// return the offset of the keyword in the keywords array
-// return -1 if it is not a keyword
-static inline int is_keyword(const char *str)
+/**
+ * Build the token the DFA stopped on.
+ * @param buffer The input from offset `buffer_offset` on, it must contain the whole lexeme.
+ */
+static Token make_token(const char *const buffer, const size_t buffer_offset, const Scan *const s, InternTable *const symbols)
 {
-    static const char *const keywords[] = {
-        "int", "float", "string", "print", "read", "if", "then", "else", "while",
-        "repeat", "until", "factorial"};
-    static const int num_keywords = 12;
+    const Accept accept = accepts[s->state];
+    Token token = {
+        .type = accept.type,
+        .error = accept.error,
+        .offset = s->start,
+        .length = 0,
+        .id = INTERN_ID_NONE,
+    };
+    switch (s->state)
+    {
+    case S_LINE_COMMENT:
+        // a comment that runs to the end of the input is skipped entirely, the EOF token is at the end of the input.
+        token.offset = s->position;
+        return token;
+    case S_START:
+    case S_BLOCK_COMMENT:
+    case S_BLOCK_COMMENT_BANG:
+        // end of input and unterminated comments have an empty lexeme (which may no longer be in a streaming lexer's buffer).
+        return token;
+    default:
+        break;
+    }
 
-    for (int i = 0; i < num_keywords; i++)
+    const size_t length = s->position - s->start;
+    if (length > UINT32_MAX)
     {
-        if (strcmp(str, keywords[i]) == 0)
+        // Token.length is 32-bit, the lexeme is left empty like the ones of unterminated comments and the lexer goes on after all of it.
+        token.type = TOKEN_ERROR;
+        token.error = ERROR_LEXEME_TOO_LONG;
+        return token;
+    }
+    token.length = (uint32_t)length;
+    const char *const lexeme = buffer + (s->start - buffer_offset);
+    if (token.type == TOKEN_NULL)
+        token.type = single_char_token[(unsigned char)lexeme[0]];
+    else if (s->state == S_IDENTIFIER)
+    {
+        const int keyword = keyword_index(lexeme, length);
+        token.type = keyword < 0 ? TOKEN_IDENTIFIER : keyword_list[keyword].type;
+        token.id = keyword < 0 ? intern(symbols, lexeme, length) : (uint32_t)keyword;
+    }
+    else if (s->state == S_STRING_END)
+        token.id = intern(symbols, lexeme, length);
+    else if (s->state == S_INTEGER || s->state == S_FLOAT)
+    {
+        const bool fits = s->state == S_INTEGER ? parse_integer(lexeme, length, &token.value.integer) : parse_float(lexeme, length, &token.value.real);
+        if (!fits)
         {
-            return i; 
+            token.type = TOKEN_ERROR;
+            token.error = ERROR_INVALID_NUMBER;
+            token.value.integer = 0;
         }
     }
-    return -1;
+    return token;
 }
 
-void init_lexer(Lexer *const l, const char *input_string, const int start_position)
+void init_lexer(Lexer *const l, const char *input_string, const size_t start_position)
 {
     l->input_string = input_string;
+    l->input_length = strlen(input_string);
     l->current_position = start_position;
-    l->current_line = 1;
-    if (l->line_start_positions != NULL) array_free(l->line_start_positions);
-    l->line_start_positions = array_new(1, sizeof(int));
-    array_push(l->line_start_positions, (Element *)&l->current_position);
+    line_index_free(&l->lines);
+    line_index_init(&l->lines, input_string, l->input_length);
+    if (l->symbols == NULL)
+        l->symbols = new_symbol_table();
     l->is_initialized = true;
 }
 
-
-// Call this function to record a newline character.
-// If the l->input_string[l->current_position] is a newline character, it will record the position of the next character.
-// if the l->input_string[l->current_position] is not a newline character, nothing will happen.
-static inline void record_if_newline(Lexer *const l)
+void free_lexer(Lexer *const l)
 {
-    if (l->input_string[l->current_position] != '\n')
-        return;
-    ++l->current_line;
-    const int temp_position = l->current_position + 1;
-    array_push(l->line_start_positions, (Element *)&temp_position);
+    line_index_free(&l->lines);
+    intern_table_free(l->symbols);
+    l->symbols = NULL;
+    l->is_initialized = false;
 }
 
-
 /* Get next token from l->input_string */
 Token get_next_token(Lexer *const l)
 {
-    char c, cn; // first char and the following for checking operations
+    Scan s = {
+        .state = S_START,
+        .position = l->current_position,
+        .start = l->current_position,
+    };
+    scan(l->input_string, 0, l->input_length, &s, false, false);
+    l->current_position = s.position;
+    return make_token(l->input_string, 0, &s, l->symbols);
+}
 
-    // Skip whitespace and track line numbers
-    while ((c = l->input_string[l->current_position]) != '\0' && isspace(c))
+void lex_all(Lexer *const l, TokenStream *const tokens)
+{
+    // a first guess at the number of tokens, to skip the first few doublings.
+    token_stream_reserve(tokens, tokens->count + (l->input_length - l->current_position) / 8 + 1);
+    Scan s = {.state = S_START, .position = l->current_position, .start = l->current_position};
+    Token token;
+    do
     {
-        record_if_newline(l);
-        l->current_position++;
-    }
+        scan(l->input_string, 0, l->input_length, &s, false, false);
+        token = make_token(l->input_string, 0, &s, l->symbols);
+        token_stream_push(tokens, &token);
+        s = (Scan){.state = S_START, .position = s.position, .start = s.position};
+    } while (token.type != TOKEN_EOF);
+    l->current_position = s.position;
+}
 
-    Token token = {
-        .type = TOKEN_ERROR,
-        .lexeme = "",
-        .position = (LexemePosition){
-            .line = l->current_line, 
-            .col_start = l->current_position - *(int *)array_get(l->line_start_positions, l->current_line - 1) + 1, 
-            .col_end = l->current_position - *(int *)array_get(l->line_start_positions, l->current_line - 1) + 1},
-        .error = ERROR_NONE};
-
-    if (l->input_string[l->current_position] == '\0')
-    {
-        token.type = TOKEN_EOF;
-        strcpy(token.lexeme, "\0");
-        return token;
-    }
+/* ---------------------------------------------------------------------------------------------- */
+/* Incremental relexing                                                                            */
+/* ---------------------------------------------------------------------------------------------- */
 
-    c = l->input_string[l->current_position];
-    cn = l->input_string[l->current_position + 1];
+// Offset one past the last character of token `i`.
+static inline size_t stream_token_end(const TokenStream *const tokens, const size_t i)
+{
+    return tokens->offsets[i] + tokens->lengths[i];
+}
+
+RelexResult relex_edit(Lexer *const l, TokenStream *const tokens, const char *const new_input, const size_t edit_offset, const size_t removed_length, const size_t inserted_length)
+{
+    assert(tokens->count > 0 && tokens->types[tokens->count - 1] == TOKEN_EOF);
+    const size_t old_edit_end = edit_offset + removed_length;
 
-    // Handle comments
-    if (c == '?' && cn == '?')
+    // the first token that ends at or after the edit, the one before it did not look at any character of the edit (a token only looks one character past its end).
+    // ends are non-decreasing and the last token (TOKEN_EOF) ends at the end of the input, so the search always finds one.
+    size_t first = 0, last = tokens->count - 1;
+    while (first < last)
     {
-        // Single-line comment
-        while (l->input_string[l->current_position] != '\n' && l->input_string[l->current_position] != '\0')
+        const size_t middle = first + (last - first) / 2;
+        if (stream_token_end(tokens, middle) < edit_offset)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+    // an unterminated comment is reported at its start, but the comment runs to the end of the input.
+    if (first == tokens->count - 1 && first > 0 && tokens->errors[first - 1] == ERROR_UNTERMINATED_COMMENT)
+        --first;
+    const size_t start = first == 0 ? 0 : stream_token_end(tokens, first - 1);
+
+    l->input_string = new_input;
+    l->input_length = l->input_length - removed_length + inserted_length;
+    line_index_free(&l->lines);
+    line_index_init(&l->lines, new_input, l->input_length);
+
+    TokenStream relexed;
+    token_stream_init(&relexed);
+    size_t old = first; // the old tokens before `old` end before the last relexed token.
+    size_t resume = tokens->count;
+    Scan s = {.state = S_START, .position = start, .start = start};
+    Token token;
+    do
+    {
+        scan(l->input_string, 0, l->input_length, &s, false, false);
+        token = make_token(l->input_string, 0, &s, l->symbols);
+        token_stream_push(&relexed, &token);
+        s = (Scan){.state = S_START, .position = s.position, .start = s.position};
+        // empty tokens (end of input, unterminated comments) do not end where the lexer stopped.
+        if (token.length == 0 || s.position < edit_offset + inserted_length)
+            continue;
+        // old token ends after the edit, shifted to where they are in the new input.
+        const size_t end = s.position - inserted_length + removed_length;
+        while (old < tokens->count && (stream_token_end(tokens, old) < old_edit_end || stream_token_end(tokens, old) < end))
+            ++old;
+        if (old < tokens->count && tokens->lengths[old] > 0 && stream_token_end(tokens, old) == end)
         {
-            l->current_position++;
+            resume = old + 1;
+            break;
         }
-        return get_next_token(l); // Skip and get next token
+    } while (token.type != TOKEN_EOF);
+    l->current_position = l->input_length;
+
+    const RelexResult result = {.first = first, .removed_count = resume - first, .inserted_count = relexed.count};
+    const size_t kept = tokens->count - resume;
+    token_stream_replace(tokens, first, resume, &relexed);
+    token_stream_free(&relexed);
+    for (size_t i = tokens->count - kept; i < tokens->count; ++i)
+        tokens->offsets[i] = tokens->offsets[i] - removed_length + inserted_length;
+    return result;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Streaming lexer                                                                                 */
+/* ---------------------------------------------------------------------------------------------- */
+
+void init_stream_lexer(StreamLexer *const l, const int fd, const size_t buffer_size)
+{
+    l->fd = fd;
+    l->buffer_size = buffer_size > 0 ? buffer_size : STREAM_LEXER_DEFAULT_BUFFER_SIZE;
+    l->buffer = malloc(l->buffer_size + 1);
+    if (l->buffer == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
     }
+    l->buffer[0] = '\0';
+    l->buffer_offset = 0;
+    l->buffer_length = 0;
+    l->at_end_of_input = false;
+    l->read_error = 0;
+    l->current_position = 0;
+    l->current_line = 1;
+    l->current_line_start = 0;
+    if (l->symbols == NULL)
+        l->symbols = new_symbol_table();
+}
 
-    if (c == '?' && cn == '!')
+void free_stream_lexer(StreamLexer *const l)
+{
+    free(l->buffer);
+    intern_table_free(l->symbols);
+    l->buffer = NULL;
+    l->symbols = NULL;
+}
+
+/**
+ * Drop everything before offset `keep_from` from the buffer and read more input after what is left.
+ * The buffer only grows if everything in it must be kept (a single token longer than the buffer).
+ */
+static void stream_refill(StreamLexer *const l, const size_t keep_from)
+{
+    const size_t keep = l->buffer_offset + l->buffer_length - keep_from;
+    memmove(l->buffer, l->buffer + (keep_from - l->buffer_offset), keep);
+    l->buffer_offset = keep_from;
+    l->buffer_length = keep;
+    if (keep == l->buffer_size)
     {
-        // Block/Multi-line comment
-        l->current_position += 2; // Skip `?!`
-        while (!(l->input_string[l->current_position] == '!' && l->input_string[l->current_position + 1] == '?') && l->input_string[l->current_position] != '\0')
-        {
-            record_if_newline(l);
-            l->current_position++;
-        }
-        if (l->input_string[l->current_position] == '\0')
+        char *const grown = realloc(l->buffer, 2 * l->buffer_size + 1);
+        if (grown == NULL)
         {
-            token.error = ERROR_UNTERMINATED_COMMENT;
-            return token;
+            perror("realloc");
+            exit(EXIT_FAILURE);
         }
-        if (l->input_string[l->current_position] == '!' && l->input_string[l->current_position + 1] == '?')
-        {
-            l->current_position += 2; // Skip `!?`
-        }
-        return get_next_token(l); // Skip and get next token
+        l->buffer = grown;
+        l->buffer_size *= 2;
     }
-
-    // Handle numbers
-    /**
-     * TODO: Length checking as it is a lexical error. (current max length is set by the size of token.lexeme)
-     */
-    if (isdigit(c))
+    ssize_t n;
+    do
+        n = read(l->fd, l->buffer + keep, l->buffer_size - keep);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0)
     {
-        int i = 0;
-        token.type = TOKEN_INTEGER_CONST;
-        int float_found = 0;
-
-        do
-        {
-            if (cn == '.' && float_found == 0)
-            {
-                token.lexeme[i++] = c;
-                token.lexeme[i++] = cn;
-                l->current_position += 2; // skip over the starter and dot so not to return error for unknown character
-                token.type = TOKEN_FLOAT_CONST;
-                float_found = 1;
-            }
-            else
-            {
-                token.lexeme[i++] = c;
-                l->current_position++;
-            }
-            c = l->input_string[l->current_position];
-            cn = l->input_string[l->current_position + 1];
-        } while (isdigit(c) && i < (int)(sizeof(token.lexeme) - 1));
-        token.position.col_end += i - 1;
-        token.lexeme[i] = '\0';
-        return token;
+        l->at_end_of_input = true;
+        l->read_error = n < 0 ? errno : 0;
     }
+    else
+        l->buffer_length += (size_t)n;
+    l->buffer[l->buffer_length] = '\0';
+}
 
-    // handle keywords and identifiers
-    if (isalpha(c) || c == '_')
+Token stream_get_next_token(StreamLexer *const l, const char **const lexeme, LexemePosition *const position)
+{
+    Scan s = {
+        .state = S_START,
+        .position = l->current_position,
+        .line = l->current_line,
+        .line_start = l->current_line_start,
+        .start = l->current_position,
+        .start_line = l->current_line,
+        .start_line_start = l->current_line_start,
+    };
+    while (true)
     {
-        int i = 0;
-        do
-        {
-            token.lexeme[i++] = c;
-            l->current_position++;
-            c = l->input_string[l->current_position];
-        } while ((isalnum(c) || c == '_') && i < (int)(sizeof(token.lexeme) - 1));
+        scan(l->buffer, l->buffer_offset, l->buffer_offset + l->buffer_length, &s, true, false);
+        // the DFA stopped on a character of the input, or on the null character after the last one.
+        if (s.position < l->buffer_offset + l->buffer_length || l->at_end_of_input)
+            break;
+        // the DFA ran into the end of the buffer, keep the unfinished lexeme (comments have none) and continue in the same state after refilling.
+        const bool in_comment = s.state == S_LINE_COMMENT || s.state == S_BLOCK_COMMENT || s.state == S_BLOCK_COMMENT_BANG;
+        stream_refill(l, in_comment ? s.position : s.start);
+    }
+    l->current_position = s.position;
+    l->current_line = s.line;
+    l->current_line_start = s.line_start;
+    const Token token = make_token(l->buffer, l->buffer_offset, &s, l->symbols);
+    if (lexeme != NULL)
+        *lexeme = token.length > 0 ? l->buffer + (token.offset - l->buffer_offset) : "";
+    if (position != NULL)
+    {
+        // the EOF token after a comment that runs to the end of the input is on the last line.
+        const bool at_end = token.offset == s.position;
+        position->line = at_end ? s.line : s.start_line;
+        position->col_start = token.offset - (at_end ? s.line_start : s.start_line_start) + 1;
+        position->col_end = Token_col_end(&token, position->col_start);
+    }
+    return token;
+}
 
-        token.lexeme[i] = '\0';
-        token.position.col_end += i - 1;
+/* ---------------------------------------------------------------------------------------------- */
+/* Parallel lexer                                                                                  */
+/* ---------------------------------------------------------------------------------------------- */
 
-        // Check if it's a keyword
-        int keyword_id = is_keyword(token.lexeme);
-        if (keyword_id != -1)
+/**
+ * Every token ends before the newline at the end of its line, except block comments, so at the start of a line the DFA is either in S_START or in S_BLOCK_COMMENT.
+ * Chunks start at line starts and are lexed under both assumptions, the assumption that turns out to hold is decided in order once all chunks are lexed.
+ * Once the "inside a comment" run ends a token where the "outside" run also ends one, the rest of the chunk is the same, so it usually only costs a comment's worth of work.
+ *
+ * Each chunk interns into a table of its own, the chosen tokens' IDs are then mapped to the lexer's table in order of first appearance,
+ * which gives the IDs sequential lexing would.
+ */
+
+DA_DEFINE(Tokens, Token);
+DA_DEFINE(LocalIds, uint32_t);
+
+// Tokens of a chunk lexed under one assumption about the state at its start.
+typedef struct _ChunkRun
+{
+    Tokens tokens;
+    const Token *rest;      // Tokens after `tokens` that are the same as the end of another run of the chunk (not copied), NULL if none.
+    size_t rest_count;
+    bool ends_in_comment;
+    size_t comment_start; // Offset of the comment the chunk ends in, SIZE_MAX if it started before the chunk.
+} ChunkRun;
+
+typedef struct _Chunk
+{
+    const char *input;
+    size_t input_length;
+    size_t begin;
+    size_t end;                 // Offset after the last character of the chunk, a line start or the end of the input.
+    bool may_start_in_comment;  // False for the first chunk, which starts where the lexer is.
+    InternTable *symbols;       // IDs of the chunk's tokens. Keywords are interned first like in every table, so keyword IDs are already final.
+    ChunkRun runs[2];           // [0]: the chunk starts outside a block comment, [1]: inside one.
+    const ChunkRun *chosen;     // The run whose assumption holds.
+    TokenStream *result;
+    size_t out;                 // Index of the first chosen token in `result`.
+    LocalIds first_seen;        // IDs of identifiers and strings in order of first appearance in the chosen tokens.
+    uint32_t *global_ids;       // Lexer table ID of every ID of `symbols`.
+} Chunk;
+
+static inline size_t token_end(const Token *const token)
+{
+    return token->offset + token->length;
+}
+
+/**
+ * Lex `c` from its start in `start_state` (S_START or S_BLOCK_COMMENT).
+ * @param converge_with A run of the same chunk from S_START, whose tokens are reused from the first token both runs end at the same offset. May be NULL.
+ */
+static void lex_chunk_run(Chunk *const c, const LexerState start_state, ChunkRun *const run, const ChunkRun *const converge_with)
+{
+    const bool is_last = c->end == c->input_length;
+    Scan s = {.state = start_state, .position = c->begin, .start = c->begin};
+    da_init(&run->tokens);
+    run->rest = NULL;
+    run->rest_count = 0;
+    run->ends_in_comment = false;
+    run->comment_start = SIZE_MAX;
+    if (start_state == S_BLOCK_COMMENT)
+        skip_run(c->input, c->end, S_BLOCK_COMMENT, &s, false);
+    size_t j = 0; // first token of `converge_with` that may end at or after the last token of this run.
+    while (true)
+    {
+        scan(c->input, 0, c->end, &s, false, true);
+        if (!is_last && s.position == c->end)
         {
-            token.type = (TokenType)(keyword_id+TOKEN_INT_KEYWORD);
+            // a line start, see above.
+            assert(s.state == S_START || s.state == S_BLOCK_COMMENT);
+            run->ends_in_comment = s.state == S_BLOCK_COMMENT;
+            // `start` is only still at the start of the chunk if the comment the chunk started in never ended.
+            if (run->ends_in_comment && !(start_state == S_BLOCK_COMMENT && s.start == c->begin))
+                run->comment_start = s.start;
+            return;
         }
-        else
+        const Token token = make_token(c->input, 0, &s, c->symbols);
+        da_push(&run->tokens, token);
+        if (token.type == TOKEN_EOF)
+            return;
+        // an unterminated comment has an empty lexeme but ends the input, so only tokens with a lexeme are compared.
+        if (converge_with != NULL && token.length > 0)
         {
-            token.type = TOKEN_IDENTIFIER;
+            const Token *const other = converge_with->tokens.items;
+            const size_t other_count = converge_with->tokens.count;
+            while (j < other_count && token_end(&other[j]) < token_end(&token))
+                ++j;
+            if (j < other_count && token_end(&other[j]) == token_end(&token) && other[j].type != TOKEN_EOF)
+            {
+                // both runs continue from S_START at the same offset from here on.
+                run->rest = other + j + 1;
+                run->rest_count = other_count - j - 1;
+                run->ends_in_comment = converge_with->ends_in_comment;
+                run->comment_start = converge_with->comment_start;
+                return;
+            }
         }
-
-        return token;
+        s = (Scan){.state = S_START, .position = s.position, .start = s.position};
     }
+}
 
-    // handling string literals (these string literals do not support escape characters)
-    if (c == '"')
-    {
-        int i = 0;
-        token.lexeme[i++] = c; // store opening quote
-        l->current_position++;
+static void *lex_chunk(void *const arg)
+{
+    Chunk *const c = arg;
+    c->symbols = new_symbol_table();
+    lex_chunk_run(c, S_START, &c->runs[0], NULL);
+    if (c->may_start_in_comment)
+        lex_chunk_run(c, S_BLOCK_COMMENT, &c->runs[1], &c->runs[0]);
+    else
+        da_init(&c->runs[1].tokens);
+    return NULL;
+}
 
-        // keep reading until we find the closing quote, a non-printable character, or EOF
-        while (isprint(c = l->input_string[l->current_position]) && c != '"' && c != '\0')
+// List the IDs the chosen tokens use, in order of first appearance.
+static void *list_chunk_ids(void *const arg)
+{
+    Chunk *const c = arg;
+    bool *const seen = calloc(intern_table_size(c->symbols), sizeof(bool));
+    if (seen == NULL)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    da_init(&c->first_seen);
+    const Token *const spans[2] = {c->chosen->tokens.items, c->chosen->rest};
+    const size_t counts[2] = {c->chosen->tokens.count, c->chosen->rest_count};
+    for (int k = 0; k < 2; ++k)
+        for (size_t i = 0; i < counts[k]; ++i)
         {
-            // if adding this character would make the string too long, report error
-            // need room for: current chars + this char + closing quote + '\0'. - 1 for zero index
-            if (i >= (int)(sizeof(token.lexeme) - 2))
+            const uint32_t id = spans[k][i].id;
+            if (id != INTERN_ID_NONE && id >= KEYWORD_COUNT && !seen[id])
             {
-                // hit max length, report error
-                // keep reading until closing quote, non-printable character, or EOF, but don't store
-                while (isprint(c = l->input_string[l->current_position]) && c != '"' && c != '\0')
-                {
-                    l->current_position++;
-                }
-
-                // If we found a closing quote, consume it and terminate with too long string error
-                if (c == '"')
-                {
-                    l->current_position++;
-                    // terminate with string too long error
-                    token.lexeme[i] = '\0';
-                    token.type = TOKEN_ERROR;
-                    token.error = ERROR_STRING_TOO_LONG;
-                    token.position.col_end += i - 1;
-                    return token;
-                }
-
-                // here the string is both too long and there is a non-printable character/EOF before the closing quote
-                // terminate with unterminated string error
-                token.lexeme[i] = '\0';
-                token.type = TOKEN_ERROR;
-                token.error = ERROR_UNTERMINATED_STRING;
-                token.position.col_end += i - 1;
-                return token;
+                seen[id] = true;
+                da_push(&c->first_seen, id);
             }
-
-            token.lexeme[i++] = c; // add characters
-            l->current_position++;
         }
+    free(seen);
+    return NULL;
+}
 
-        // if we found the closing quote and the string wasn't too long, terminate normally
-        if (c == '"')
+// Copy the chosen tokens to the result with their IDs in the lexer's table.
+static void *copy_chunk(void *const arg)
+{
+    Chunk *const c = arg;
+    size_t out = c->out;
+    const Token *const spans[2] = {c->chosen->tokens.items, c->chosen->rest};
+    const size_t counts[2] = {c->chosen->tokens.count, c->chosen->rest_count};
+    for (int k = 0; k < 2; ++k)
+        for (size_t i = 0; i < counts[k]; ++i, ++out)
         {
-            token.lexeme[i++] = c; // store closing quote
-            token.lexeme[i] = '\0';
-            l->current_position++;
-            token.type = TOKEN_STRING_CONST;
-            token.position.col_end += i - 1;
-            return token;
+            Token token = spans[k][i];
+            if (token.id != INTERN_ID_NONE)
+                token.id = c->global_ids[token.id];
+            token_stream_set(c->result, out, &token);
         }
+    return NULL;
+}
 
-        // if we got here without returning, loop was exited without finding closing quote
-        // terminate with unterminated string error
-        record_if_newline(l);
-        token.lexeme[i] = '\0';
-        token.type = TOKEN_ERROR;
-        token.error = ERROR_UNTERMINATED_STRING;
-        token.position.col_end += i - 1;
-        return token;
+// Run `f` on every chunk, one thread per chunk (the calling thread takes the first one).
+static void for_each_chunk(Chunk *const chunks, const size_t count, void *(*const f)(void *))
+{
+#ifndef _WIN32
+    pthread_t *const threads = malloc(count * sizeof(pthread_t));
+    bool *const started = calloc(count, sizeof(bool));
+    if (threads == NULL || started == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
     }
+    for (size_t i = 1; i < count; ++i)
+        started[i] = pthread_create(&threads[i], NULL, f, &chunks[i]) == 0;
+    f(&chunks[0]);
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            f(&chunks[i]); // out of threads, do it here.
+    }
+    free(threads);
+    free(started);
+#else
+    for (size_t i = 0; i < count; ++i)
+        f(&chunks[i]);
+#endif
+}
+
+static unsigned online_processors(void)
+{
+#ifndef _WIN32
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned)count : 1;
+#else
+    return 1;
+#endif
+}
 
-    // Handle operators
-    int operator_id = operator_index(l->input_string + l->current_position);
-    if (operator_id != -1)
+void lex_parallel(Lexer *const l, unsigned thread_count, size_t min_chunk_size, TokenStream *const tokens)
+{
+    if (thread_count == 0)
+        thread_count = online_processors();
+    if (min_chunk_size == 0)
+        min_chunk_size = PARALLEL_LEXER_DEFAULT_MIN_CHUNK_SIZE;
+    const size_t begin = l->current_position, length = l->input_length - begin;
+    size_t chunk_count = length / min_chunk_size;
+    if (chunk_count > thread_count)
+        chunk_count = thread_count;
+    if (chunk_count < 2)
     {
-        size_t operator_len = strlen(reduced_operators[operator_id]);
-        token.type = (TokenType)(TokenType_FIRST_OPERATOR + operator_id);
-        strncpy(token.lexeme, l->input_string + l->current_position, operator_len);
-        token.lexeme[operator_len] = '\0';
-        token.position.col_end += operator_len;
-        l->current_position += operator_len;
-        return token;
+        lex_all(l, tokens);
+        return;
     }
 
-    // Handle punctuation & delimiters
-    const char *const punctuation = ";{}(),";
-    char* punctcheck = strchr(punctuation, c);
-    if (punctcheck)
+    // split at the line start after every 1/chunk_count of the input, lines longer than a chunk make for fewer chunks.
+    Chunk *const chunks = calloc(chunk_count, sizeof(Chunk));
+    if (chunks == NULL)
     {
-        token.type = (TokenType)((punctcheck-punctuation)+TOKEN_SEMICOLON);
-        token.lexeme[0] = c;
-        token.lexeme[1] = '\0';
-        l->current_position++;
-        return token;
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 0;
+    for (size_t position = begin; position < l->input_length; ++count)
+    {
+        const size_t target = begin + (count + 1) * (length / chunk_count);
+        const size_t from = target - 1 > position ? target - 1 : position;
+        const char *const newline = count + 1 < chunk_count ? memchr(l->input_string + from, '\n', l->input_length - from) : NULL;
+        chunks[count].input = l->input_string;
+        chunks[count].input_length = l->input_length;
+        chunks[count].begin = position;
+        chunks[count].end = newline != NULL ? (size_t)(newline - l->input_string) + 1 : l->input_length;
+        chunks[count].may_start_in_comment = count > 0;
+        position = chunks[count].end;
     }
+    for_each_chunk(chunks, count, lex_chunk);
 
-    // Handle invalid characters
-    token.error = ERROR_INVALID_CHAR;
-    token.lexeme[0] = c;
-    token.lexeme[1] = '\0';
-    l->current_position++;
-    return token;
+    // pick the run of every chunk in order.
+    bool in_comment = false;
+    size_t comment_start = SIZE_MAX, token_count = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        ChunkRun *const run = &chunks[i].runs[in_comment];
+        if (in_comment && run->rest == NULL && run->tokens.count > 1)
+        {
+            // a comment that started in an earlier chunk and never ends: the error (before EOF) is reported where it started.
+            Token *const error = &run->tokens.items[run->tokens.count - 2];
+            if (error->error == ERROR_UNTERMINATED_COMMENT && error->offset == chunks[i].begin)
+                error->offset = comment_start;
+        }
+        if (run->ends_in_comment && run->comment_start != SIZE_MAX)
+            comment_start = run->comment_start;
+        in_comment = run->ends_in_comment;
+        chunks[i].chosen = run;
+        token_count += run->tokens.count + run->rest_count;
+    }
+
+    token_stream_reserve(tokens, tokens->count + token_count);
+    for (size_t i = 0, out = tokens->count; i < count; out += chunks[i].chosen->tokens.count + chunks[i].chosen->rest_count, ++i)
+    {
+        chunks[i].result = tokens;
+        chunks[i].out = out;
+    }
+    for_each_chunk(chunks, count, list_chunk_ids);
+
+    // intern in order, so that IDs are given in order of first appearance like sequential lexing does.
+    for (size_t i = 0; i < count; ++i)
+    {
+        Chunk *const c = &chunks[i];
+        c->global_ids = malloc(intern_table_size(c->symbols) * sizeof(uint32_t));
+        if (c->global_ids == NULL)
+        {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t id = 0; id < KEYWORD_COUNT; ++id)
+            c->global_ids[id] = id;
+        for (size_t k = 0; k < c->first_seen.count; ++k)
+        {
+            size_t lexeme_length;
+            const char *const lexeme = intern_get(c->symbols, c->first_seen.items[k], &lexeme_length);
+            c->global_ids[c->first_seen.items[k]] = intern(l->symbols, lexeme, lexeme_length);
+        }
+    }
+    for_each_chunk(chunks, count, copy_chunk);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        da_clear(&chunks[i].runs[0].tokens);
+        da_clear(&chunks[i].runs[1].tokens);
+        da_clear(&chunks[i].first_seen);
+        free(chunks[i].global_ids);
+        intern_table_free(chunks[i].symbols);
+    }
+    free(chunks);
+    l->current_position = l->input_length;
+    tokens->count += token_count;
 }
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../include/line_index.h"
+#include "../include/simd_scan.h"
+#include "../include/simple_dynamic_array.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINE_INDEX_X86
+#include <immintrin.h>
+#endif
+
+DA_DEFINE(Offsets, size_t);
+
+// Push the offset after every '\n' in input[0, length) (which starts at offset `base` of the whole input).
+static void push_line_starts_scalar(const char *const input, const size_t length, const size_t base, Offsets *const out)
+{
+    const char *p = input, *const end = input + length;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        ++p;
+        da_push(out, base + (size_t)(p - input));
+    }
+}
+
+#ifdef LINE_INDEX_X86
+// Push the offset after every newline flagged in `mask` (bit i is input[base + i]).
+#define PUSH_MASKED_LINE_STARTS(out, mask, base)                             \
+    while (mask) {                                                        \
+        da_push(out, (base) + (size_t)__builtin_ctz(mask) + 1);            \
+        mask &= mask - 1;                                                 \
+    }
+
+__attribute__((target("sse2")))
+static void push_line_starts_sse2(const char *const input, const size_t length, Offsets *const out)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(input + i)), newline));
+        PUSH_MASKED_LINE_STARTS(out, mask, i);
+    }
+    push_line_starts_scalar(input + i, length - i, i, out);
+}
+
+__attribute__((target("avx2")))
+static void push_line_starts_avx2(const char *const input, const size_t length, Offsets *const out)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(input + i)), newline));
+        PUSH_MASKED_LINE_STARTS(out, mask, i);
+    }
+    push_line_starts_scalar(input + i, length - i, i, out);
+}
+
+#undef PUSH_MASKED_LINE_STARTS
+#endif
+
+static void line_index_build(LineIndex *const index)
+{
+    if (index->line_starts != NULL)
+        return;
+    if (index->length == LINE_INDEX_UNTIL_NUL)
+        index->length = strlen(index->input);
+    Offsets starts;
+    da_init(&starts);
+    da_push(&starts, (size_t)0);
+    switch (simd_level())
+    {
+#ifdef LINE_INDEX_X86
+    case SIMD_AVX2:
+        push_line_starts_avx2(index->input, index->length, &starts);
+        break;
+    case SIMD_SSE2:
+        push_line_starts_sse2(index->input, index->length, &starts);
+        break;
+#endif
+    default:
+        push_line_starts_scalar(index->input, index->length, 0, &starts);
+        break;
+    }
+    index->line_starts = starts.items;
+    index->line_count = starts.count;
+}
+
+void line_index_init(LineIndex *const index, const char *const input, const size_t length)
+{
+    index->input = input;
+    index->length = length;
+    index->line_starts = NULL;
+    index->line_count = 0;
+}
+
+void line_index_free(LineIndex *const index)
+{
+    free(index->line_starts);
+    index->line_starts = NULL;
+    index->line_count = 0;
+}
+
+size_t line_index_line_count(LineIndex *const index)
+{
+    line_index_build(index);
+    return index->line_count;
+}
+
+size_t line_index_line_start(LineIndex *const index, const size_t line)
+{
+    line_index_build(index);
+    assert(line >= 1 && line <= index->line_count);
+    return index->line_starts[line - 1];
+}
+
+void line_index_find(LineIndex *const index, const size_t offset, size_t *const line, size_t *const column)
+{
+    line_index_build(index);
+    // find the last line that starts at or before `offset` (line_starts[0] == 0 so there always is one).
+    size_t low = 0, high = index->line_count;
+    while (high - low > 1) {
+        const size_t mid = low + (high - low) / 2;
+        if (index->line_starts[mid] <= offset)
+            low = mid;
+        else
+            high = mid;
+    }
+    *line = low + 1;
+    *column = offset - index->line_starts[low] + 1;
+}
+
+LexemePosition Token_position(const Token *const token, LineIndex *const index)
+{
+    LexemePosition position;
+    line_index_find(index, token->offset, &position.line, &position.col_start);
+    position.col_end = Token_col_end(token, position.col_start);
+    return position;
+}
@@ -3,23 +3,45 @@
 #include <string.h>
 #include <assert.h>
 #include <stdint.h>
+#include <errno.h>
+#include "../include/arena.h"
 #include "../include/dynamic_array.h"
 #include "../include/grammar.h"
 #include "../include/lexer.h"
 #include "../include/parser.h"
 #include "../include/tree.h"
 #include "../include/semantic.h"
+#include "../include/source_file.h"
 /**
  * Print Token information to stdout.
  * 
  * Prints the type, lexeme, line, col_start, col_end, and error message of the token.
+ * 
+ * @param lexeme The first character of the token's lexeme.
+ * @param position The position of the token's lexeme.
  */
-void print_token(Token token)
+void print_token_at(const Token *const token, const char *const lexeme, const LexemePosition position)
 {
-    printf("Token type=%-10s(%d), lexeme=\"%s\", line=%-2d, column:%d-%d, error_message=\"%s\"",
-           TokenType_to_string(token.type), token.type, token.lexeme, token.position.line, token.position.col_start, token.position.col_end, ErrorType_to_error_message(token.error));
+    printf("Token type=%-10s(%d), lexeme=\"%.*s\", line=%-2zu, column:%zu-%zu, error_message=\"%s\"",
+           TokenType_to_string(token->type), token->type, (int)token->length, lexeme, position.line, position.col_start, position.col_end, ErrorType_to_error_message(token->error));
 }
 
+/**
+ * Print Token information to stdout, see `print_token_at`.
+ * 
+ * @param l The lexer the token was produced by (its line index resolves the position).
+ */
+void print_token(Lexer *const l, const Token token)
+{
+    print_token_at(&token, Token_lexeme(&token, l->input_string), Token_position(&token, &l->lines));
+}
+
+/* What the ParseTreeNodes refer to: tokens by index in `tokens`, lexemes and positions through `lexer`. */
+typedef struct _LexedInput {
+    Lexer *lexer;
+    const TokenStream *tokens;
+} LexedInput;
+
 /**
  * WARNING: this function does not check if the pointer is NULL.
  * @return n->children.
@@ -34,24 +56,63 @@ ParseTreeNode *ParseTreeNode_children_begin(const ParseTreeNode *const n) {
 size_t ParseTreeNode_num_children(const ParseTreeNode *const n) {
     return n->count;
 }
+// A node printed by `ParseTreeNode_print_head`: it starts at token `start`, its child `child` is printed next, after the one that starts at token `previous`.
+typedef struct _PrintedNode {
+    const ParseTreeNode *node;
+    size_t start;
+    size_t child;
+    size_t previous;
+} PrintedNode;
+
+DA_DEFINE(PrintedNodes, PrintedNode);
+
+/* The context of `ParseTreeNode_print_head`: the nodes do not store their positions, so the printer follows them from the root down. */
+typedef struct _ParseTreePrinter {
+    const LexedInput *in;
+    PrintedNodes path; // The node printed last and the nodes above it.
+} ParseTreePrinter;
+
+/**
+ * @return The index of the first token of `node`, which is printed right after the nodes of `printer->path` (the root if it is empty) and is then pushed onto it.
+ */
+static size_t ParseTreePrinter_start(ParseTreePrinter *const printer, const ParseTreeNode *const node) {
+    PrintedNodes *const path = &printer->path;
+    // the nodes whose children were all printed.
+    while (path->count > 0 && path->items[path->count - 1].child == path->items[path->count - 1].node->count)
+        --path->count;
+    size_t start = 0;
+    if (path->count > 0) {
+        PrintedNode *const parent = path->items + path->count - 1;
+        start = ParseTreeNode_child_start(parent->node, parent->start, parent->child++, parent->previous);
+        parent->previous = start;
+    }
+    da_push(path, ((PrintedNode){.node = node, .start = start, .child = 0, .previous = start}));
+    return start;
+}
+
 /**
  * Print ParseTreeNode to stdout. Prints the type and error types of the node, then the same for the token (if the token is not null) followed by a newline.
+ * The nodes must be printed in the order of `print_tree`, from the root.
  * 
  * WARNING: this function does not check if the pointer is NULL.
  * 
  * @param node Pointer to node to print.
+ * @param printer The lexer and tokens the tree was parsed from, and the nodes printed before.
  */
-void ParseTreeNode_print_head(const ParseTreeNode *const node) {
+void ParseTreeNode_print_head(const ParseTreeNode *const node, ParseTreePrinter *const printer) {
+    const LexedInput *const in = printer->in;
+    const size_t start = ParseTreePrinter_start(printer, node);
     printf("%s", ParseToken_to_string(node->type));
     if (node->error) 
         printf(" (%s)", ParseErrorType_to_string(node->error));
-    if (node->token)
+    if (node->has_token)
     {
+        const Token token = token_stream_get(in->tokens, start);
         printf(" -> ");
-        if (node->error || node->token->error)
-            print_token(*node->token);
+        if (node->error || token.error)
+            print_token(in->lexer, token);
         else
-            printf("%s \"%s\"", TokenType_to_string(node->token->type), node->token->lexeme);
+            printf("%s \"%.*s\"", TokenType_to_string(token.type), (int)token.length, Token_lexeme(&token, in->lexer->input_string));
     }
 }
 const ASTNode *ASTNode_children_begin(const ASTNode *const n) {
@@ -66,8 +127,9 @@ size_t ASTNode_num_children(const ASTNode *const n) {
  * WARNING: this function does not check if the pointer is NULL.
  * 
  * @param node Pointer to node to print.
+ * @param l The lexer the tokens of the tree were produced by.
  */
-void ASTNode_print_head(const ASTNode *const node) {
+void ASTNode_print_head(const ASTNode *const node, Lexer *const l) {
     printf("%s", ASTNodeType_to_string(node->type));
     if (node->error) 
         printf(" (%s)", ASTErrorType_to_string(node->error));
@@ -75,49 +137,61 @@ void ASTNode_print_head(const ASTNode *const node) {
     {
         printf(" -> ");
         if (node->error || node->token.error)
-            print_token(node->token);
+            print_token(l, node->token);
         else
-            printf("%s \"%s\"", TokenType_to_string(node->token.type), node->token.lexeme);
+            printf("%s \"%.*s\"", TokenType_to_string(node->token.type), (int)node->token.length, Token_lexeme(&node->token, l->input_string));
     }
 }
 
-void print_token_compiler_message(FILE *const stream, const Lexer *const l, const char *input_file_path, const Token *const token, const char *const error_message)
+void print_token_compiler_message(FILE *const stream, Lexer *const l, const char *input_file_path, const Token *const token, const char *const error_message)
 {
-    const int line_start_pos = *(int *)array_get(l->line_start_positions, token->position.line - 1);
-    const char *const line_end = strchr(l->input_string + line_start_pos, '\n');
-    const int line_length = line_end == NULL ? (int)strlen(l->input_string + line_start_pos) : line_end - (l->input_string + line_start_pos);
-    // tildes is supposed to be as long as the longest token lexeme so that it can always be chopped to the right length.
-    static const char *const tildes = "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~";
+    const LexemePosition position = Token_position(token, &l->lines);
+    const char *const line_start = l->input_string + line_index_line_start(&l->lines, position.line);
+    const char *const line_end = strchr(line_start, '\n');
+    const size_t line_length = line_end == NULL ? strlen(line_start) : (size_t)(line_end - line_start);
     fprintf(stream,
-        "%s:%d:%d: %s\n"
-        "%.*s\n"
-        "%*s%.*s\n",
-        input_file_path, token->position.line, token->position.col_start, error_message,
-        line_length, l->input_string + line_start_pos,
-        token->position.col_start, "^", token->position.col_end - token->position.col_start, tildes);
+        "%s:%zu:%zu: %s\n",
+        input_file_path, position.line, position.col_start, error_message);
+    // lines and lexemes have no length limit, so they are written with fwrite/putc instead of a "%.*s" precision (an int).
+    fwrite(line_start, 1, line_length, stream);
+    putc('\n', stream);
+    for (size_t col = 1; col < position.col_start; ++col)
+        putc(' ', stream);
+    putc('^', stream);
+    for (size_t col = position.col_start; col < position.col_end; ++col)
+        putc('~', stream);
+    putc('\n', stream);
+}
+
+/**
+ * Print the compiler message of a syntax error.
+ * @param in The lexer and tokens the error refers to.
+ */
+void report_syntax_error(FILE *const stream, const LexedInput *const in, const SyntaxError *const error, const char *const filepath) {
+    const Token token = token_stream_get(in->tokens, error->token_index);
+    char message[100];
+    snprintf(message, sizeof(message), "error: expected a %s", ParseToken_to_string(error->expected));
+    print_token_compiler_message(stream, in->lexer, filepath, &token, message);
 }
 
-// Enhanced syntax error reporting function using new print function
-void report_syntax_errors(FILE *const stream, const Lexer *const l, const ParseTreeNode *const node, const char *const filepath) {
+// Enhanced syntax error reporting function using new print function, `node` starts at token `start`.
+void report_syntax_errors(FILE *const stream, const LexedInput *const in, const ParseTreeNode *const node, const size_t start, const char *const filepath) {
     // print error message if the node has an error and it has a token that was not already reported as an error by the lexer
     switch (node->error) {
         case PARSE_ERROR_NONE:
         case PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE:
             break;
         case PARSE_ERROR_CHILD_ERROR:
-            for (const ParseTreeNode *child = node->children; child != node->children + node->count; ++child) {
-                report_syntax_errors(stream, l, child, filepath);
+        case PARSE_ERROR_RECOVERED:
+            for (size_t i = 0, child_start = start; i < node->count; ++i) {
+                child_start = ParseTreeNode_child_start(node, start, i, child_start);
+                report_syntax_errors(stream, in, node->children + i, child_start, filepath);
             }
             break;
         case PARSE_ERROR_NO_RULE_MATCHES:
         case PARSE_ERROR_WRONG_TOKEN:
-            if (node->token) {
-                const unsigned int MESSAGE_SIZE = 100;
-                char *message = malloc(MESSAGE_SIZE);
-                snprintf(message, MESSAGE_SIZE, "error: expected a %s", ParseToken_to_string(node->type));
-                print_token_compiler_message(stream, l, filepath, node->token, message);
-                free(message);
-            }
+            if (node->has_token)
+                report_syntax_error(stream, in, &(SyntaxError){.expected = node->type, .token_index = start}, filepath);
             break;
     }
 }
@@ -145,17 +219,150 @@ struct debug_flags {
 // File extension for input files
 const char *const FILE_EXT = ".cisc";
 
+bool has_file_ext(const char *const path) {
+    const size_t file_path_len = strlen(path);
+    return file_path_len >= 5 && strncmp(path + file_path_len - 5, FILE_EXT, 5) == 0;
+}
+
+/**
+ * Lex the file at `input_file_path` with the streaming lexer and report lexical errors, without parsing.
+ * 
+ * Memory use does not depend on the size of the input, which makes this usable to check very large (generated) files.
+ * Error messages only have the position of the token since the source line is no longer in memory.
+ * 
+ * @return 0 if there were no lexical errors, 1 if there were, -1 if the file could not be read.
+ */
+int lex_file_streaming(const char *const input_file_path) {
+    FILE *file = fopen(input_file_path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s: %s\n", input_file_path, strerror(errno));
+        return -1;
+    }
+    StreamLexer l = {0};
+    init_stream_lexer(&l, fileno(file), 0);
+    size_t token_count = 0, error_count = 0;
+    Token token;
+    do {
+        const char *lexeme;
+        LexemePosition position;
+        token = stream_get_next_token(&l, &lexeme, &position);
+        ++token_count;
+        if (token.error != ERROR_NONE) {
+            ++error_count;
+            fprintf(stderr, "%s:%zu:%zu: %s\n", input_file_path, position.line, position.col_start, ErrorType_to_error_message(token.error));
+        }
+        if (DEBUG.print_tokens) {
+            print_token_at(&token, lexeme, position);
+            printf("\n");
+        }
+    } while (token.type != TOKEN_EOF);
+    const int read_error = l.read_error;
+    free_stream_lexer(&l);
+    fclose(file);
+    if (read_error != 0) {
+        fprintf(stderr, "Error: Unable to read file %s: %s\n", input_file_path, strerror(read_error));
+        return -1;
+    }
+    printf("%s: %zu tokens, %zu lexical error(s)\n", input_file_path, token_count, error_count);
+    return error_count > 0 ? 1 : 0;
+}
+
+// Initial number of frames of the stack of the recognizer in `check_files`, enough for a few thousand levels of nesting.
+#define CHECK_RECOGNIZER_FRAMES (1 << 16)
+
+/**
+ * Check the syntax of the files at `paths` without building a tree, and report the lexical errors and the first syntax error of each.
+ * The predict table recovers like the compiler's, so the first syntax error is the first one the compiler reports.
+ *
+ * The lexer, its intern table, the token stream and the stack of the recognizer are reused from one file to the next (the stack is doubled and the file checked again when it runs out),
+ * so checking many files does not allocate once the buffers fit the largest file. Nothing is printed for a file without errors.
+ *
+ * @return 0 if no file had errors, 1 if some did, -1 if a file could not be read or does not have the right extension.
+ */
+int check_files(const char *const *const paths, const size_t count) {
+    size_t capacity = CHECK_RECOGNIZER_FRAMES;
+    RecognizerFrame *stack = malloc(capacity * sizeof(RecognizerFrame));
+    if (stack == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    CFG_PredictTable_recover(&table, &program_recovery);
+    Lexer l = {0};
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    int result = 0;
+    for (size_t f = 0; f < count; ++f) {
+        const char *const input_file_path = paths[f];
+        if (!has_file_ext(input_file_path)) {
+            fprintf(stderr, "%s: Incorrect file extension, the correct extension is .cisc\n", input_file_path);
+            result = -1;
+            continue;
+        }
+        SourceFile source = {0};
+        if (!source_file_open(&source, input_file_path)) {
+            fprintf(stderr, "Error: Unable to open file %s: %s\n", input_file_path, strerror(errno));
+            result = -1;
+            continue;
+        }
+        init_lexer(&l, source.text, 0);
+        tokens.count = 0;
+        lex_all(&l, &tokens);
+        bool has_errors = false;
+        for (size_t i = 0; i < tokens.count; ++i) {
+            if (tokens.errors[i] == ERROR_NONE)
+                continue;
+            const Token token = token_stream_get(&tokens, i);
+            print_token_compiler_message(stderr, &l, input_file_path, &token, ErrorType_to_error_message(token.error));
+            has_errors = true;
+        }
+        size_t token_index = 0;
+        SyntaxError error;
+        bool recognized;
+        // the input is nested deeper than the stack: check it again with a stack twice as large.
+        while (!(recognized = parse_cfg_recognize(PT_PROGRAM, &token_index, &tokens, &table, stack, capacity, &error)) && error.expected == PT_NULL) {
+            capacity *= 2;
+            free(stack);
+            stack = malloc(capacity * sizeof(RecognizerFrame));
+            if (stack == NULL) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+            }
+            token_index = 0;
+        }
+        // a token with a lexical error was already reported.
+        if (!recognized && tokens.errors[error.token_index] == ERROR_NONE) {
+            const LexedInput lexed = {.lexer = &l, .tokens = &tokens};
+            report_syntax_error(stderr, &lexed, &error, input_file_path);
+        }
+        has_errors = has_errors || !recognized;
+        source_file_close(&source);
+        if (has_errors && result == 0)
+            result = 1;
+    }
+    free(stack);
+    token_stream_free(&tokens);
+    free_lexer(&l);
+    return result;
+}
+
 int main(int const argc, const char *const argv[]) {
     // TODO: Add command line argument parsing for debug flags.
+    if (argc == 3 && strcmp(argv[1], "--lex") == 0) {
+        if (!has_file_ext(argv[2])) {
+            fprintf(stderr, "Incorrect file extension, the correct extension is .cisc\n");
+            return -1;
+        }
+        return lex_file_streaming(argv[2]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--check") == 0)
+        return check_files(argv + 2, (size_t)argc - 2);
     if (DEBUG.grammar_check) {
         if (DEBUG.grammar_check_verbose)
             printf("Validating grammar:\n");
         CFG_GrammarCheckResult result = check_cfg_grammar(DEBUG.grammar_check_verbose ? stdout : NULL, program_grammar);
-        if (result.missing_or_mismatched_rules
-            || result.contains_improperly_terminated_production_rules
-            || !result.is_prefix_free 
-            || result.contains_direct_left_recursive_rule_as_last_rule 
-            || result.contains_indirect_left_recursion) {
+        if (!CFG_GrammarCheckResult_passed(&result)) {
             fprintf(stderr, "Grammar is invalid, compilation cannot be proceed.\n");
             return -1;  // early return
         }
@@ -164,38 +371,21 @@ int main(int const argc, const char *const argv[]) {
     }
     
     const char *input_file_path = NULL;
-    char *input = NULL;
-    bool must_free_input = false;
+    const char *input = NULL;
+    SourceFile source = {0};
     if (argc == 2) {
         // Input file extension check
-        const int file_path_len = strlen(argv[1]);
         input_file_path = argv[1];
-        if (file_path_len < 5 || strncmp(input_file_path + file_path_len - 5, FILE_EXT, 5) != 0) {
+        if (!has_file_ext(input_file_path)) {
             fprintf(stderr, "Incorrect file extension, the correct extension is .cisc\n");
             return -1;
         }
-        // Load file into input.
-        FILE *file = fopen(input_file_path, "r");
-        if (file == NULL) {
-            fprintf(stderr, "Error: Unable to open file %s\n", input_file_path);
-            return -1;
-        }
-        fseek(file, 0, SEEK_END);
-        size_t file_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        input = malloc(file_size + 1);
-        if (input == NULL) {
-            fprintf(stderr, "Error: Unable to allocate memory for file %s\n", input_file_path);
+        // Map (or read) the file, the input ends at the first null character.
+        if (!source_file_open(&source, input_file_path)) {
+            fprintf(stderr, "Error: Unable to open file %s: %s\n", input_file_path, strerror(errno));
             return -1;
         }
-        must_free_input = true;
-
-        size_t bytes_read = 0;
-        char ch;
-        while (bytes_read < file_size && (ch = fgetc(file)) != EOF && ch != '\0')
-            input[bytes_read++] = ch;
-        input[bytes_read] = '\0';
-        fclose(file);
+        input = source.text;
     }
     else {
         input_file_path = "<input-file-name>.cisc";
@@ -254,41 +444,75 @@ int main(int const argc, const char *const argv[]) {
     // Tokenize the input
     if (DEBUG.print_tokens) 
         printf("\nTokenizing:\n");
-    Array *tokens = array_new(8, sizeof(Token));
     Lexer l = {0};
     init_lexer(&l, input, 0);
-    Token token;
-    do {
-        token = get_next_token(&l);
-        array_push(tokens, (Element *)&token);
+    // large inputs are lexed on all processors, the tokens are the same as lexing them one by one.
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_parallel(&l, 0, 0, &tokens);
+    for (size_t i = 0; i < tokens.count; ++i) {
+        if (tokens.errors[i] == ERROR_NONE && !DEBUG.print_tokens)
+            continue;
+        const Token token = token_stream_get(&tokens, i);
         if (token.error != ERROR_NONE)
             print_token_compiler_message(stderr, &l, input_file_path, &token, ErrorType_to_error_message(token.error));
         if (DEBUG.print_tokens) {
-            print_token(token); 
+            print_token(&l, token);
             printf("\n");
         }
-    } while (token.type != TOKEN_EOF);
+    }
+    const LexedInput lexed = {.lexer = &l, .tokens = &tokens};
+    // the parse tree (if any), the AST, the symbol table and the semantic errors are all allocated in this arena and released together at the end.
+    Arena arena;
+    arena_init(&arena, 0);
 
     // Parse the input
     size_t token_index = 0;
-    ParseTreeNode pt_root; pt_root.type = PT_PROGRAM;
-    parse_cfg_recursive_descent_parse_tree(&pt_root, &token_index, (Token *)array_begin(tokens), program_grammar, ParseToken_COUNT_NONTERMINAL);
-    // currently, the parser does not perform error recovery, so at most one syntax error can be reported.
-    report_syntax_errors(stderr, &l, &pt_root, input_file_path);
-    if (DEBUG.print_parse_tree) {
-        printf("\nParse Tree:\n");
-        print_tree(&(print_tree_t){
-            .root = &pt_root,
-            .children = (const_voidp_to_const_voidp*)ParseTreeNode_children_begin,
-            .count = (const_voidp_to_size_t*)ParseTreeNode_num_children,
-            .size = sizeof(ParseTreeNode),
-            .print_head = (const_voidp_to_void*)ParseTreeNode_print_head,
-        });
-    }
-
-    // Convert to Abstract Syntax Tree
     ASTNode ast_root; ast_root.type = AST_PROGRAM;
-    ASTNode_from_ParseTreeNode(&ast_root, (ParseTreeNodeWithPromo *)&pt_root);
+    if (DEBUG.print_parse_tree || !CFG_supports_direct_ast(program_grammar)) {
+        ParseTreeNode pt_root; pt_root.type = PT_PROGRAM;
+        parse_program_grammar(&pt_root, &token_index, &tokens, &arena);
+        // the parser recovers from a syntax error at the end of the statement (or of the block) it is in, so every statement with an error is reported.
+        report_syntax_errors(stderr, &lexed, &pt_root, 0, input_file_path);
+        if (DEBUG.print_parse_tree) {
+            printf("\nParse Tree:\n");
+            ParseTreePrinter printer = {.in = &lexed};
+            da_init(&printer.path);
+            print_tree(&(print_tree_t){
+                .root = &pt_root,
+                .children = (const_voidp_to_const_voidp*)ParseTreeNode_children_begin,
+                .count = (const_voidp_to_size_t*)ParseTreeNode_num_children,
+                .size = sizeof(ParseTreeNode),
+                .print_head = (const_voidp_voidp_to_void*)ParseTreeNode_print_head,
+                .context = &printer,
+            });
+            da_clear(&printer.path);
+        }
+        // Convert to Abstract Syntax Tree
+        ASTNode_from_ParseTreeNode(&ast_root, (ParseTreeNodeWithPromo *)&pt_root, &tokens, &arena);
+    } else {
+        CFG_PredictTable table;
+        CFG_PredictTable_init(&table, program_grammar);
+        // recover like the generated parser does, the AST has the statements without syntax errors.
+        CFG_PredictTable_recover(&table, &program_recovery);
+        if (parse_cfg_parallel_chunk_count(token_index, &tokens, &table, 0, 0) > 1) {
+            // a large input is parsed on all processors: the statements are parsed into a parse tree (building the AST while parsing is sequential), which is then converted.
+            ParseTreeNode pt_root; pt_root.type = PT_PROGRAM;
+            parse_cfg_recursive_descent_parse_tree_parallel(&pt_root, &token_index, &tokens, &table, 0, 0, &arena);
+            report_syntax_errors(stderr, &lexed, &pt_root, 0, input_file_path);
+            ASTNode_from_ParseTreeNode(&ast_root, (ParseTreeNodeWithPromo *)&pt_root, &tokens, &arena);
+        } else {
+            // the parse tree is not needed, so the Abstract Syntax Tree is built while parsing.
+            // expressions are parsed by precedence climbing if their grammar allows it, and by following the grammar otherwise.
+            CFG_PrecedenceTable precedence;
+            CFG_PrecedenceTable_init(&precedence, &table, PT_EXPRESSION);
+            SyntaxErrors syntax_errors;
+            da_init(&syntax_errors);
+            parse_cfg_recursive_descent_ast(&ast_root, PT_PROGRAM, &token_index, &tokens, &table, &precedence, &arena, &syntax_errors);
+            for (size_t i = 0; i < syntax_errors.count; ++i)
+                report_syntax_error(stderr, &lexed, syntax_errors.items + i, input_file_path);
+        }
+    }
     if (DEBUG.print_abstract_syntax_tree) {
         printf("\nAbstract Syntax Tree:\n");
         print_tree(&(print_tree_t){
@@ -296,7 +520,8 @@ int main(int const argc, const char *const argv[]) {
             .children = (const_voidp_to_const_voidp*)ASTNode_children_begin,
             .count = (const_voidp_to_size_t*)ASTNode_num_children,
             .size = sizeof(ASTNode),
-            .print_head = (const_voidp_to_void*)ASTNode_print_head,
+            .print_head = (const_voidp_voidp_to_void*)ASTNode_print_head,
+            .context = &l,
         });
     }
 
@@ -304,8 +529,8 @@ int main(int const argc, const char *const argv[]) {
     
     if (DEBUG.print_semantic_analysis)
         printf("\nStarting Semantic Analysis:\n");
-    Array *symbol_table = array_new(8, sizeof(symEntry));
-    Array* semanticErrors = ProcessProgram(&ast_root, symbol_table, DEBUG.print_semantic_analysis ? stdout : NULL);
+    Array *symbol_table = array_new_in_arena(&arena, 8, sizeof(symEntry));
+    Array* semanticErrors = ProcessProgram(&ast_root, input, symbol_table, DEBUG.print_semantic_analysis ? stdout : NULL, &arena);
     // Print semantic errors
     for (size_t i = 0; i < array_size(semanticErrors); i++){
         ASTNode *entry = (ASTNode *)array_get(semanticErrors, i);
@@ -313,29 +538,26 @@ int main(int const argc, const char *const argv[]) {
         if(entry->error) printf("Error Detected -> %s @ %s\n", ASTErrorType_to_string(entry->error), TokenType_to_string(entry->token.type));
     }
 
-    array_free(semanticErrors);
 
     if (DEBUG.print_symbol_table) {
         printf("\nSymbol Table:\n");
         
         // print symbol table entries
         for (size_t i = 0; i < array_size(symbol_table); i++){
-            printf("Declared Variable -> %s ", ((symEntry *)array_get(symbol_table, i))->symNode->token.lexeme);
+            const Token *const name = &((symEntry *)array_get(symbol_table, i))->symNode->token;
+            printf("Declared Variable -> %.*s ", (int)name->length, Token_lexeme(name, input));
             printf("Scope -> %s\n", ((symEntry *)array_get(symbol_table, i))->scope);
         }
         // print symbol table entries with errors
         for (size_t i = 0; i < array_size(symbol_table); i++){
             symEntry *entry = (symEntry *)array_get(symbol_table, i);
-            if(entry->symNode->error) printf("Error Detected -> %s\n", entry->symNode->token.lexeme);
+            if(entry->symNode->error) printf("Error Detected -> %.*s\n", (int)entry->symNode->token.length, Token_lexeme(&entry->symNode->token, input));
         }
 }
 
-    array_free(symbol_table);
-
-    ParseTreeNode_free_children(&pt_root);
-    ASTNode_free_children(&ast_root);
-    array_free(tokens);
-    if (must_free_input)
-        free(input);
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&l);
+    source_file_close(&source);
     return 0;
 }
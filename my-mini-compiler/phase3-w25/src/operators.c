@@ -2,12 +2,24 @@
 #include <string.h>
 
 #include "../include/operators.h"
+// generated from operators.h at build time by tools/gen_operator_switch.c
+#include "operator_switch.h"
+
+// reduced_operators is in the same order as the operator TokenTypes.
+_Static_assert(OPERATOR_COUNT == TokenType_MAX - TokenType_FIRST_OPERATOR + 1, "every operator in reduced_operators needs a TokenType");
 
 int operator_index(const char *const s)
 {
-    for (unsigned i = 0; i < (sizeof(reduced_operators) / sizeof(reduced_operators[0])); i++)
-        if (strncmp(reduced_operators[i], s, strlen(reduced_operators[i])) == 0)
-            return i;
-    return -1;
+    unsigned length;
+    return operator_match(s, &length);
 }
 
+TokenType operator_token(const char *const s, size_t *const length)
+{
+    unsigned operator_length;
+    const int i = operator_match(s, &operator_length);
+    if (i < 0)
+        return TOKEN_NULL;
+    *length = operator_length;
+    return (TokenType)(TokenType_FIRST_OPERATOR + i);
+}
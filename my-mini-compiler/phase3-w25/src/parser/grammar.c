@@ -83,6 +83,192 @@ bool ParseToken_can_start_with(const ParseToken t, const ParseToken s, const CFG
     return false;
 }
 
+void CFG_PredictTable_init(CFG_PredictTable *const table, const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL])
+{
+    assert(table != NULL);
+    assert(grammar != NULL);
+    memset(table, 0, sizeof(*table));
+    table->grammar = grammar;
+    // grow the sets until they stop changing, each pass adds at least one terminal (or nullable) to some non-terminal.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t n = 0; n < ParseToken_COUNT_NONTERMINAL; ++n) {
+            uint64_t first = table->first[n];
+            bool nullable = table->nullable[n];
+            for (size_t r = 0; r < grammar[n].num_rules; ++r) {
+                const ParseToken t = grammar[n].rules[r].tokens[0];
+                if (t == grammar[n].lhs)
+                    continue;
+                if (t == PT_NULL) {
+                    nullable = true;
+                } else if (ParseToken_IS_TERMINAL(t)) {
+                    first |= (uint64_t)1 << t;
+                } else {
+                    first |= table->first[t - ParseToken_FIRST_NONTERMINAL];
+                    nullable = nullable || table->nullable[t - ParseToken_FIRST_NONTERMINAL];
+                }
+            }
+            if (first != table->first[n] || nullable != table->nullable[n]) {
+                table->first[n] = first;
+                table->nullable[n] = nullable;
+                changed = true;
+            }
+        }
+    }
+    for (size_t n = 0; n < ParseToken_COUNT_NONTERMINAL; ++n) {
+        assert(grammar[n].num_rules < UINT8_MAX);
+        for (size_t r = grammar[n].num_rules; r-- > 0;) {
+            const ParseToken t = grammar[n].rules[r].tokens[0];
+            if (t == grammar[n].lhs) {
+                table->left_recursive[n] = (uint8_t)(r + 1);
+                continue;
+            }
+            // going backwards, so the first rule that matches a terminal is the one left in the table.
+            for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s)
+                if (CFG_PredictTable_can_start_with(table, t, s))
+                    table->predict[n][s] = (uint8_t)(r + 1);
+        }
+    }
+    const CFG_GrammarCheckResult check = check_cfg_grammar(NULL, grammar);
+    table->deterministic = CFG_GrammarCheckResult_passed(&check);
+}
+
+void CFG_PredictTable_recover(CFG_PredictTable *const table, const CFG_Recovery *const recovery)
+{
+    assert(table != NULL);
+    assert(recovery != NULL);
+    assert(ParseToken_IS_NONTERMINAL(table->grammar[recovery->list - ParseToken_FIRST_NONTERMINAL].rules[0].tokens[0]));
+    table->recovery = recovery;
+    for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s)
+        if (s != recovery->block_end && s != PT_EOF)
+            table->predict[recovery->list - ParseToken_FIRST_NONTERMINAL][s] = 1;
+}
+
+// Whether `rule` is exactly the PT_NULL terminated `tokens`, each converted with AST_FROM_PROMOTION, and promotes token `promote_index`.
+static bool rule_is_promotion(const ProductionRule *const rule, const ParseToken *const tokens, const size_t promote_index)
+{
+    size_t i = 0;
+    for (; tokens[i] != PT_NULL; ++i)
+        if (rule->tokens[i] != tokens[i] || rule->ast_types[i] != AST_FROM_PROMOTION)
+            return false;
+    return rule->tokens[i] == PT_NULL && rule->promote_index == promote_index;
+}
+
+/**
+ * Give the terminals of operator non-terminal `op` level `level` in `levels`, and the ASTNodeType of their node in `types`.
+ * @return false if `op` is not an operator non-terminal (see `CFG_PrecedenceTable_init`) or one of its terminals already has a level.
+ */
+static bool add_operators(const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL], const ParseToken op, const uint8_t level, uint8_t levels[ParseToken_FIRST_NONTERMINAL], ASTNodeType types[ParseToken_FIRST_NONTERMINAL])
+{
+    if (!ParseToken_IS_NONTERMINAL(op))
+        return false;
+    const CFG_GrammarRule *const g = grammar + (op - ParseToken_FIRST_NONTERMINAL);
+    for (const ProductionRule *rule = g->rules; rule != g->rules + g->num_rules; ++rule) {
+        if (rule->tokens[0] == PT_NULL || rule->tokens[1] != PT_NULL || rule->promote_index != 0 || !ASTNodeType_IS_NONTERMINAL(rule->ast_types[0]))
+            return false;
+        ParseToken s = rule->tokens[0];
+        if (ParseToken_IS_NONTERMINAL(s)) {
+            const CFG_GrammarRule *const leaf = grammar + (s - ParseToken_FIRST_NONTERMINAL);
+            if (leaf->num_rules != 1 || !ParseToken_IS_TERMINAL(leaf->rules[0].tokens[0]) || leaf->rules[0].tokens[1] != PT_NULL || leaf->rules[0].ast_types[0] != AST_SKIP)
+                return false;
+            s = leaf->rules[0].tokens[0];
+        }
+        if (levels[s] != 0)
+            return false;
+        levels[s] = level;
+        types[s] = rule->ast_types[0];
+    }
+    return g->num_rules > 0;
+}
+
+// Whether the grammar parses `n` with `rule` when the next token is any of the terminals of level `level` in `levels`, so that precedence climbing makes the same choice.
+static bool predicts_operators(const CFG_PredictTable *const predict, const ParseToken n, const ProductionRule *const rule, const uint8_t levels[ParseToken_FIRST_NONTERMINAL], const uint8_t level)
+{
+    for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s)
+        if (levels[s] == level && CFG_PredictTable_rule(predict, n, s) != rule)
+            return false;
+    return true;
+}
+
+/**
+ * Add the level non-terminal `n` is to `table`, if it is one.
+ * @param level The number of levels so far, incremented if `n` is a level.
+ * @param next Set to the non-terminal below `n` in the chain, PT_NULL if `n` is not part of the chain (it is the primary).
+ * @return false if `n` has the shape of a level but its operators cannot be climbed.
+ */
+static bool add_precedence_level(CFG_PrecedenceTable *const table, const CFG_PredictTable *const predict, const ParseToken n, uint8_t *const level, ParseToken *const next)
+{
+    const CFG_GrammarRule *const grammar = predict->grammar;
+    const CFG_GrammarRule *const g = grammar + (n - ParseToken_FIRST_NONTERMINAL);
+    *next = PT_NULL;
+    if (g->num_rules == 0 || g->num_rules > 2)
+        return true;
+    const ProductionRule *const first = g->rules;
+    const ProductionRule *const second = g->num_rules == 2 ? g->rules + 1 : NULL;
+    size_t length = 0;
+    while (first->tokens[length] != PT_NULL)
+        ++length;
+
+    if (second == NULL && length == 1 && rule_is_promotion(first, first->tokens, 0)) {
+        // E -> N
+        *next = first->tokens[0];
+        return true;
+    }
+    if (second != NULL && length == 3 && first->tokens[0] == n && rule_is_promotion(first, first->tokens, 1)
+        && rule_is_promotion(second, (ParseToken[]){first->tokens[2], PT_NULL}, 0)) {
+        // L -> L OP N | N, the left-recursive rule is repeated while the next token can start OP.
+        *next = first->tokens[2];
+        return add_operators(grammar, first->tokens[1], ++*level, table->binary, table->binary_type);
+    }
+    if (second != NULL && length == 2 && first->tokens[1] == n && rule_is_promotion(first, first->tokens, 0)
+        && ParseToken_IS_NONTERMINAL(second->tokens[0]) && second->tokens[0] != n && rule_is_promotion(second, (ParseToken[]){second->tokens[0], PT_NULL}, 0)) {
+        // U -> OP U | N
+        *next = second->tokens[0];
+        return add_operators(grammar, first->tokens[0], ++*level, table->prefix, table->prefix_type)
+            && predicts_operators(predict, n, first, table->prefix, *level);
+    }
+    if (second == NULL && length == 2 && rule_is_promotion(first, first->tokens, 1) && ParseToken_IS_NONTERMINAL(first->tokens[1])
+        && first->promotion_alternate_if_AST_NULL != NULL && first->promotion_alternate_if_AST_NULL[1] == 0) {
+        // R -> N REST, REST -> OP R | ε
+        const ParseToken rest = first->tokens[1];
+        const CFG_GrammarRule *const r = grammar + (rest - ParseToken_FIRST_NONTERMINAL);
+        if (r->num_rules != 2 || !rule_is_promotion(r->rules, (ParseToken[]){r->rules[0].tokens[0], n, PT_NULL}, 0)
+            || r->rules[1].tokens[0] != PT_NULL || r->rules[1].promote_index != 0)
+            return true;
+        *next = first->tokens[0];
+        table->right_associative[++*level] = true;
+        return add_operators(grammar, r->rules[0].tokens[0], *level, table->binary, table->binary_type)
+            && predicts_operators(predict, rest, r->rules, table->binary, *level);
+    }
+    return true;
+}
+
+bool CFG_PrecedenceTable_init(CFG_PrecedenceTable *const table, const CFG_PredictTable *const predict, const ParseToken expression)
+{
+    assert(table != NULL);
+    assert(predict != NULL);
+    assert(ParseToken_IS_NONTERMINAL(expression));
+    memset(table, 0, sizeof(*table));
+    uint8_t level = 0;
+    ParseToken n = expression;
+    // a chain longer than the number of non-terminals goes around a cycle.
+    for (size_t length = 0; length <= ParseToken_COUNT_NONTERMINAL; ++length) {
+        ParseToken next;
+        if (!add_precedence_level(table, predict, n, &level, &next) || (next != PT_NULL && !ParseToken_IS_NONTERMINAL(next)))
+            break;
+        if (next == PT_NULL) {
+            if (level == 0)
+                break;
+            table->expression = expression;
+            table->primary = n;
+            return true;
+        }
+        n = next;
+    }
+    memset(table, 0, sizeof(*table));
+    return false;
+}
 
 CFG_GrammarCheckResult check_cfg_grammar(FILE *stream, const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL]) {
     CFG_GrammarCheckResult result = {
@@ -150,4 +336,10 @@ CFG_GrammarCheckResult check_cfg_grammar(FILE *stream, const CFG_GrammarRule gra
         fprintf(stream, "contains_indirect_left_recursion: %s\n" , result.contains_indirect_left_recursion ? "true" : "false");
     }
     return result;
-}
\ No newline at end of file
+}
+
+bool CFG_GrammarCheckResult_passed(const CFG_GrammarCheckResult *const result) {
+    assert(result != NULL);
+    return !result->missing_or_mismatched_rules && !result->contains_improperly_terminated_production_rules && result->is_prefix_free
+        && !result->contains_direct_left_recursive_rule_as_last_rule && !result->contains_indirect_left_recursion;
+}
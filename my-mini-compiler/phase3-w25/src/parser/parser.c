@@ -5,9 +5,13 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdint.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "../../include/simd_scan.h"
 #include "../../include/tokens.h"
 #include "../../include/parser.h"
-#include "../../include/simple_dynamic_array.h"
 
 /**
  * This is not actually used very much, but it is more for documentation purposes of what the initial values are for an empty node.
@@ -17,11 +21,13 @@
  * Then allocate memory for the children array if capacity is non-zero.
  * @param node The node to initialize. (must not be NULL).
  * @param capacity The initial capacity of the children array.
+ * @param arena The arena to allocate the children array in (may be NULL if capacity is 0).
  */
-static inline void ParseTreeNode_init(ParseTreeNode *const node, size_t const capacity) {
+static inline void ParseTreeNode_init(ParseTreeNode *const node, size_t const capacity, Arena *const arena) {
     assert(node != NULL);
     node->type = PT_NULL;
-    node->token = NULL;
+    node->has_token = false;
+    node->span = 0;
     node->rule = NULL;
     node->finalized_promo_index = SIZE_MAX;
     node->error = PARSE_ERROR_NONE;
@@ -29,28 +35,11 @@ static inline void ParseTreeNode_init(ParseTreeNode *const node, size_t const ca
     node->capacity = 0;
     node->count = 0;
     if (capacity) {
-        node->children = malloc(capacity * sizeof(ParseTreeNode));
-        if (node->children == NULL) {
-            perror("malloc");
-            exit(EXIT_FAILURE);
-        }
+        node->children = arena_alloc(arena, capacity * sizeof(ParseTreeNode));
         node->capacity = capacity;
     }
 }
 
-void ParseTreeNode_free_children(ParseTreeNode *node) {
-    if (node == NULL || node->children == NULL)
-        return; 
-    // Recursively free all children 
-    for (size_t i = 0; i < node->count; ++i)
-        ParseTreeNode_free_children(node->children + i); 
-    // Free the children array
-    free(node->children);
-    node->children = NULL; 
-    node->capacity = 0;
-    node->count = 0;
-}
-
 void ParseTreeNode_print_simple(ParseTreeNode *node, int level, void (*print_node)(ParseTreeNode*)) {
     for (int i = 0; i < level; ++i)
         printf("  ");
@@ -60,61 +49,83 @@ void ParseTreeNode_print_simple(ParseTreeNode *node, int level, void (*print_nod
         ParseTreeNode_print_simple(node->children + i, level + 1, print_node);
 }
 
-/**
- * WARNING: 
- * - this function naively populates the children of the node according to the production rule, ignore any left-recursion.
- * - if any of `node`, `node->rule`, `input`, `index`, `grammar` are NULL or invalid, then the behavior is undefined.
- * 
- * dependencies:
- * - `parse_cfg_recursive_descent_parse_tree` 
- * 
- * Populate `node->children` (starting from position `node->count` up to at most `node-capacity` children or when `node->rule->tokens` reaches `PT_NULL`, whichever comes first) from the input token stream according to the production rule (`node->rule`) and `grammar`. 
- * 
- * If a child cannot be parsed:
- * - `index` points to the token at the point of the error
- * - `node->error` is set to `PARSE_ERROR_CHILD_ERROR` 
- * - `node->children[node->count]` is initialized with the corresponding error
- * - any remaining `node->children` are left unchanged
- * 
- * In either success or failure:
- * - `node->count` is set to the number of children that were successfully parsed.
- * - `index` is advanced to the first token that is not consumed. 
- * - The populated `node->children` have their types set according to `node->rule->tokens`.
- */
-static inline void initialize_children_by_rule(ParseTreeNode *const node, const Token *const input, size_t *const index, const CFG_GrammarRule *const grammar, const size_t grammar_size) {
-    for (; node->count < node->capacity; ++node->count) {
-        node->children[node->count].type = node->rule->tokens[node->count];
-        parse_cfg_recursive_descent_parse_tree(node->children + node->count, index, input, grammar, grammar_size);
-        if (node->children[node->count].error) {
-            node->error = PARSE_ERROR_CHILD_ERROR;
-            break;
-        }
-    }
-}
-
 // `node->count - 1` children already parsed
 // 1 child failed to parse
-// set remaining children's expected types and error to PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE
-static inline void default_error_recovery(ParseTreeNode *const node) {
+// set remaining children's expected types (child `i` is token `i - offset` of the rule) and error to PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE, up to child `end`.
+static inline void default_error_recovery(ParseTreeNode *const node, const size_t offset, const size_t end) {
     ++node->count; // increment count to accept the first child that failed to parse.
-    for (; node->count < node->capacity; ++node->count) {
-        ParseTreeNode_init(node->children + node->count, 0);
-        node->children[node->count].type = node->rule->tokens[node->count];
+    for (; node->count < end; ++node->count) {
+        ParseTreeNode_init(node->children + node->count, 0, NULL);
+        node->children[node->count].type = node->rule->tokens[node->count - offset];
         node->children[node->count].error = PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE;
     }
 }
 
-bool parse_cfg_recursive_descent_parse_tree(ParseTreeNode *const node, size_t *const index, const Token *const input, const CFG_GrammarRule *const grammar, const size_t grammar_size)
-{
-    assert(node != NULL);
-    assert(index != NULL);
-    assert(input != NULL);
-    assert(grammar != NULL);
-    assert(grammar_size >= ParseToken_COUNT_NONTERMINAL);
+size_t ParseTreeNode_continue_left_recursion(ParseTreeNode *const node, const ProductionRule *const rule, const size_t length, Arena *const arena) {
+    assert(length > 1);
+    // the first repetition nests the node parsed so far as the first child, like any other rule.
+    if (node->rule != rule) {
+        const ParseTreeNode temp = *node;
+        node->children = arena_alloc(arena, length * sizeof(ParseTreeNode));
+        node->has_token = false;
+        node->rule = rule;
+        node->capacity = length;
+        node->children[0] = temp;
+        node->count = 1;
+        return node->count;
+    }
+    // the next ones append the rest of the rule to the children, the array grows geometrically so a chain of n operators is copied O(n) times in total.
+    if (node->count + length - 1 > node->capacity) {
+        size_t capacity = 2 * node->capacity;
+        if (capacity < node->count + length - 1)
+            capacity = node->count + length - 1;
+        node->children = arena_grow(arena, node->children, node->capacity * sizeof(ParseTreeNode), capacity * sizeof(ParseTreeNode));
+        node->capacity = capacity;
+    }
+    return node->count;
+}
+
+size_t CFG_Recovery_skip(const CFG_Recovery *const recovery, const TokenStream *const input, size_t index) {
+    // blocks opened in the skipped tokens.
+    size_t depth = 0;
+    for (ParseToken t; (t = (ParseToken)input->types[index]) != PT_EOF; ++index) {
+        if (t == recovery->block_begin) {
+            ++depth;
+        } else if (t == recovery->block_end) {
+            if (depth == 0)
+                break;
+            --depth;
+        } else if (t == recovery->end && depth == 0) {
+            return index + 1;
+        }
+    }
+    return index;
+}
 
+// A non-terminal whose children are being parsed by `parse_cfg_recursive_descent_parse_tree`, `node->count` of them so far.
+typedef struct _ParseFrame {
+    ParseTreeNode *node;
+    // the left-recursive production rule to continue the node with once its children are parsed, NULL if there is none (or nothing to continue it with).
+    const ProductionRule *left_recursive_rule;
+    size_t left_recursive_rule_num_children;
+    size_t offset; // child `i` of the node is token `i - offset` of `node->rule` (see `ParseTreeNode_continue_left_recursion`).
+    size_t end;    // the children of the rule (or of the repetition of the left-recursive rule) being parsed end before child `end`.
+    size_t start;  // the index of the first token of the node.
+    size_t child;  // the index of the first token of the child being parsed, where the span of a list stops if it is the last one.
+} ParseFrame;
+
+DA_DEFINE(ParseFrames, ParseFrame);
+
+/**
+ * Start parsing `node`: a terminal (or PT_NULL) is parsed right away, a non-terminal gets its production rule and its children array.
+ * @param frame Set to the frame of the node if it has children to parse.
+ * @return true if the children of the node are left to parse (with `frame`), false if the node is finished (`node->error` tells whether it was parsed).
+ */
+static bool parse_tree_node_begin(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena, ParseFrame *const frame) {
     // Initialize the node to default values, leaving node->type as is.
     node->error = PARSE_ERROR_NONE;
-    node->token = NULL;
+    node->has_token = false;
+    node->span = 0;
     node->rule = NULL;
     node->finalized_promo_index = SIZE_MAX;
     node->capacity = 0;
@@ -123,269 +134,2050 @@ bool parse_cfg_recursive_descent_parse_tree(ParseTreeNode *const node, size_t *c
 
     // PT_NULL node does not consume any input and always succeeds.
     if (node->type == PT_NULL)
-        return true;
+        return false;
 
     // terminal token is assigned to the node. However, if it doesn't match the input, the index is not advanced and a wrong token error is set.
     if (ParseToken_IS_TERMINAL(node->type)) {
-        node->token = input + *index;
-        if (node->type == (ParseToken)input[*index].type) {
+        node->has_token = true;
+        if (node->type == (ParseToken)input->types[*index]) {
             ++(*index);
-            return true;
+            node->span = 1;
         } else {
             node->error = PARSE_ERROR_WRONG_TOKEN;
-            return false;
         }
+        return false;
     }
 
     // non-terminal now 
-    const CFG_GrammarRule *const g_rule = grammar + node->type - ParseToken_FIRST_NONTERMINAL;
+    const size_t nonterminal = node->type - ParseToken_FIRST_NONTERMINAL;
+    const CFG_GrammarRule *const g_rule = table->grammar + nonterminal;
 
     // the grammar must be deterministic (no common prefixes in the production rules for a given non-terminal), this ensures that the first rule that matches is the only rule that can match and that there is at most one left-recursive rule.
 
-    // p_rule = a pointer to the first rule that can match the input token
-    // left_recursive_rule = a pointer to the left-recursive production rule to this non-terminal if it exists. 
-    // If multiple left-recursive rules exist, then left_recursive_rule is a pointer to the last one found prior to the first matching non-left-recursive rule. If the grammar is deterministic (which `check_cfg_grammar` in `grammar.h` ensures), then there can be at most one left-recursive rule.
-    const ProductionRule *p_rule = g_rule->rules, *left_recursive_rule = NULL;
-    for (; p_rule < g_rule->rules + g_rule->num_rules; ++p_rule) {
-        if (p_rule->tokens[0] == node->type) {
-            left_recursive_rule = p_rule;
-        } else if (ParseToken_can_start_with(p_rule->tokens[0], (ParseToken)input[*index].type, grammar, grammar_size)) {
-            node->rule = p_rule;
-            break;
-        }
-    }
-    // p_rule and left_recursive_rule are now set to the correct values and are constant pointers form here onwards.
+    // p_rule = a pointer to the first rule that can match the input token (looked up in the predict table)
+    // left_recursive_rule = a pointer to the left-recursive production rule to this non-terminal if it exists and comes before p_rule. 
+    // If the grammar is deterministic (which `check_cfg_grammar` in `grammar.h` ensures), then there can be at most one left-recursive rule.
+    const ProductionRule *const p_rule = CFG_PredictTable_rule(table, node->type, (ParseToken)input->types[*index]);
+    node->rule = p_rule;
     // no rule matched the input token.
-    if (p_rule == g_rule->rules + g_rule->num_rules) {
+    if (p_rule == NULL) {
         node->error = PARSE_ERROR_NO_RULE_MATCHES;
-        node->token = input + *index;
+        node->has_token = true;
         return false;
     }
+    const ProductionRule *left_recursive_rule = NULL;
+    if (table->left_recursive[nonterminal] != 0 && table->left_recursive[nonterminal] - 1 < p_rule - g_rule->rules)
+        left_recursive_rule = g_rule->rules + table->left_recursive[nonterminal] - 1;
+    // the case where the rule is of the form A -> ... | A | ...; there is nothing left to parse after the node.
+    if (left_recursive_rule != NULL && left_recursive_rule->tokens[1] == PT_NULL)
+        left_recursive_rule = NULL;
     // now parse according to p_rule.
     // allocate memory for the children (if no children, then this was an empty string rule that consumes no input).
     while (p_rule->tokens[node->capacity] != PT_NULL) 
         ++node->capacity;
-    if (node->capacity) {
-        node->children = malloc(node->capacity * sizeof(ParseTreeNode));
-        if (node->children == NULL) {
-            perror("malloc");
-            exit(EXIT_FAILURE);
-        }
-    }
-    // parse children (if any). 
-    initialize_children_by_rule(node, input, index, grammar, grammar_size);
-    if (node->error) {
-        // this is where you could perform custom error recovery if desired. Such as continue advancing the input until a semi-colon is found for statements.
-        // Would have to introduce a new error type for recoveries, such as PARSE_ERROR_CHILD_ERROR_RECOVERED indicating that an error occurred but was recovered from and the parent node may continue parsing while ignoring this error. However, this error type would also have to be propagated to the parent node.
-        default_error_recovery(node);
+    if (node->capacity)
+        node->children = arena_alloc(arena, node->capacity * sizeof(ParseTreeNode));
+    if (node->capacity == 0 && left_recursive_rule == NULL)
         return false;
-    }
-    // if the rule is not left-recursive, then this node was successfully parsed.
-    // the second check includes the case where the rule is of the form A -> ... | A | ...; in this case, there is nothing left to parse so the node is finished
-    if (left_recursive_rule == NULL || left_recursive_rule->tokens[1] == PT_NULL)
-        return true;
-
-    size_t left_recursive_rule_num_children = 0;
-    while (left_recursive_rule->tokens[left_recursive_rule_num_children] != PT_NULL) 
-        ++left_recursive_rule_num_children;
-    // Repeatedly parse the rest of the left-recursive rule until it can't be parsed anymore. When it can't be parsed further, just stop and return what worked so far.
-    // This left-recursive parsing is a little bit precarious, it has really only been tested with program_grammar.
-    // See `check_cfg_grammar` in `grammar.h` for more information on grammar validation.
-    while (ParseToken_can_start_with(left_recursive_rule->tokens[1], (ParseToken)input[*index].type, grammar, grammar_size)) {
-        // could get away from copying the whole node. but this is easier to understand.
-        const ParseTreeNode temp = *node;
-        node->children = malloc(left_recursive_rule_num_children * sizeof(ParseTreeNode));
-        if (node->children == NULL) {
-            perror("malloc");
-            exit(EXIT_FAILURE);
-        }
-        node->token = NULL;
-        node->rule = left_recursive_rule;
-        node->capacity = left_recursive_rule_num_children;
-        node->children[0] = temp;
-        node->count = 1;
-        initialize_children_by_rule(node, input, index, grammar, grammar_size);
-        if (node->error) {
-            // this is where you could perform custom error recovery if desired. Such as continue parsing until a semi-colon is found for statements.
-            default_error_recovery(node);
-            return false;
-        }
-    }
+    *frame = (ParseFrame){.node = node, .left_recursive_rule = left_recursive_rule, .offset = 0, .end = node->capacity, .start = *index};
+    if (left_recursive_rule != NULL)
+        while (left_recursive_rule->tokens[frame->left_recursive_rule_num_children] != PT_NULL)
+            ++frame->left_recursive_rule_num_children;
     return true;
 }
 
-void ASTNode_free_children(ASTNode *const node) {
-    if (node == NULL || node->items == NULL)
-        return;
-    for (size_t i = 0; i < node->count; ++i)
-        ASTNode_free_children(node->items + i);
-    free(node->items);
-    node->items = NULL;
-    node->count = 0;
-    node->capacity = 0;
-}
+// An item of the recovery list parsed ahead of time by `parse_cfg_recursive_descent_parse_tree_parallel`, from token `start` up to (excluding) token `end`.
+typedef struct _ParsedItem {
+    size_t start;
+    size_t end;
+    ParseTreeNode node;
+} ParsedItem;
 
-typedef struct _ASTPromo {
-    size_t idx;
-    ASTNodeType type;
-    ASTErrorType error;
-} ASTPromo;
+DA_DEFINE(ParsedItems, ParsedItem);
 
 /**
- * Warning: `absent` must not be NULL, otherwise this function will not work correctly.
- * 
- * @param p Pointer to the ParseTreeNodeWithPromo to determine its promotion type. This function will set p->finalized_promo_index to the index of the promotion that was used. If p->finalize_promo_index is already set (other than SIZE_MAX), then the function will return the corresponding promotion without recursing through children.
- * @param absent Array of p->count bools to keep track of child nodes which resolved to AST_NULL which could not be promoted.
+ * `parse_cfg_recursive_descent_parse_tree`, taking the items of the recovery list that start at a token of `items` from it instead of parsing them.
+ * @param items The items parsed ahead of time in order of `start`, or NULL.
  */
-ASTPromo ASTNode_get_promo(ParseTreeNodeWithPromo *const p, bool *const absent) {
-    ASTPromo promo = {p->rule->promote_index, AST_NULL, AST_ERROR_NONE};
-    if (p->finalized_promo_index != SIZE_MAX) {
-        promo.type = p->rule->ast_types[p->finalized_promo_index];
-        promo.idx = p->finalized_promo_index;
-        return promo;
-    }
-    while (true) {
-        // this promo_idx is valid, it just means that the result is AST_NULL.
-        if (promo.idx == p->count) {
-            p->finalized_promo_index = promo.idx;
-            promo.type = AST_NULL;
-            return promo;
-        }
-        // promo index is invalid, or we have already tried to promote this child.
-        if (promo.idx > p->count || absent[promo.idx]) {
-            promo.error = AST_ERROR_EXPECTED_PROMOTION;
-            return promo;
-        }
-        // promo.idx < p->count
-        promo.type = p->rule->ast_types[promo.idx];
-        if (promo.type != AST_FROM_PROMOTION) {
-            p->finalized_promo_index = promo.idx;
-            return promo;
-        } else {
-            bool child_absent[p->children[promo.idx].count];
-            memset(child_absent, 0, sizeof(child_absent));
-            ASTPromo child_promo = ASTNode_get_promo(p->children + promo.idx, child_absent);
-            if (child_promo.error) {
-                promo.error = child_promo.error;
-                return promo;
-            } else if (child_promo.type == AST_FROM_PROMOTION) {
-                promo.error = AST_ERROR_EXPECTED_PROMOTION;
-                return promo;
-            } else if (child_promo.type == AST_NULL) {
-                // try the alternate promotion index.
-                absent[promo.idx] = true;
-                // no alternates, then return AST_NULL.
-                if (p->rule->promotion_alternate_if_AST_NULL == NULL) {
-                    promo.error = AST_ERROR_EXPECTED_PROMOTION;
-                    return promo;
+static bool parse_tree(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena, const ParsedItems *const items)
+{
+    // the next item that starts at or after the current token.
+    size_t next_item = 0;
+    // the rule whose first child (an item of the list) is recovered from when it fails.
+    const ProductionRule *const recovery_rule = table->recovery == NULL ? NULL : table->grammar[table->recovery->list - ParseToken_FIRST_NONTERMINAL].rules;
+    // the nodes whose children are being parsed, from `node` down to the innermost one: the depth of the tree is only limited by the memory of this stack.
+    ParseFrames frames;
+    da_init(&frames);
+    ParseFrame frame;
+    if (parse_tree_node_begin(node, index, input, table, arena, &frame))
+        da_push(&frames, frame);
+    while (frames.count > 0) {
+        ParseFrame *const top = frames.items + frames.count - 1;
+        ParseTreeNode *const parent = top->node;
+        // parse the next child.
+        if (parent->count < top->end) {
+            ParseTreeNode *const child = parent->children + parent->count;
+            child->type = parent->rule->tokens[parent->count - top->offset];
+            top->child = *index;
+            // an item parsed ahead of time is the same as the one parsed here, since an item does not depend on what it is in.
+            bool parsed_ahead = false;
+            if (items != NULL && parent->rule == recovery_rule && parent->count == 0) {
+                while (next_item < items->count && items->items[next_item].start < *index)
+                    ++next_item;
+                if (next_item < items->count && items->items[next_item].start == *index) {
+                    *child = items->items[next_item].node;
+                    *index = items->items[next_item].end;
+                    parsed_ahead = true;
                 }
-                promo.idx = p->rule->promotion_alternate_if_AST_NULL[promo.idx];
+            }
+            if (!parsed_ahead && parse_tree_node_begin(child, index, input, table, arena, &frame)) {
+                da_push(&frames, frame);
+            } else if (!ParseErrorType_FAILED(child->error)) {
+                if (child->error == PARSE_ERROR_RECOVERED)
+                    parent->error = PARSE_ERROR_RECOVERED;
+                ++parent->count;
             } else {
-                promo.type = child_promo.type;
-                p->finalized_promo_index = promo.idx;
-                return promo;
+                // a child that fails fails every node it is in, up to the list whose item it is in if the table recovers from it.
+                for (; frames.count > 0; --frames.count) {
+                    ParseTreeNode *const failed = frames.items[frames.count - 1].node;
+                    if (failed->rule == recovery_rule && failed->count == 0) {
+                        // the item is kept with its errors, the list goes on after the skipped tokens.
+                        failed->error = PARSE_ERROR_RECOVERED;
+                        ++failed->count;
+                        *index = CFG_Recovery_skip(table->recovery, input, *index);
+                        break;
+                    }
+                    const ParseFrame *const f = frames.items + frames.count - 1;
+                    const bool last = failed->count + 1 == f->end;
+                    failed->error = PARSE_ERROR_CHILD_ERROR;
+                    default_error_recovery(failed, f->offset, f->end);
+                    failed->span = (last && ParseTreeNode_is_list(failed) ? f->child : *index) - f->start;
+                }
             }
-        } 
+            continue;
+        }
+        // Repeatedly parse the rest of the left-recursive rule until it can't be parsed anymore. When it can't be parsed further, just stop and return what worked so far.
+        // This left-recursive parsing is a little bit precarious, it has really only been tested with program_grammar.
+        // See `check_cfg_grammar` in `grammar.h` for more information on grammar validation.
+        const ProductionRule *const left_recursive_rule = top->left_recursive_rule;
+        if (left_recursive_rule != NULL && CFG_PredictTable_can_start_with(table, left_recursive_rule->tokens[1], (ParseToken)input->types[*index])) {
+            // the first repetition nests the node parsed so far, with its span.
+            parent->span = *index - top->start;
+            const size_t first = ParseTreeNode_continue_left_recursion(parent, left_recursive_rule, top->left_recursive_rule_num_children, arena);
+            top->offset = first - 1;
+            top->end = first + top->left_recursive_rule_num_children - 1;
+            continue;
+        }
+        // the node is finished, it is the next child of the node below it (which recovered from what the node recovered from).
+        parent->span = (ParseTreeNode_is_list(parent) ? top->child : *index) - top->start;
+        --frames.count;
+        if (frames.count > 0) {
+            ParseTreeNode *const below = frames.items[frames.count - 1].node;
+            if (parent->error == PARSE_ERROR_RECOVERED)
+                below->error = PARSE_ERROR_RECOVERED;
+            ++below->count;
+        }
     }
+    da_clear(&frames);
+    return node->error == PARSE_ERROR_NONE;
+}
 
+bool parse_cfg_recursive_descent_parse_tree(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena)
+{
+    assert(node != NULL);
+    assert(index != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(arena != NULL);
+    return parse_tree(node, index, input, table, arena, NULL);
 }
 
-bool ASTNode_from_ParseTreeNode_impl(ASTNode *const a, ParseTreeNodeWithPromo *const p) {
-    // we can be sure that the pointers are not NULL because the caller of this function has already checked for that.
+// The result of parsing a non-terminal at a token, remembered by `parse_cfg_packrat_parse_tree`.
+typedef struct _PackratEntry {
+    size_t index; // the token the node starts at.
+    ParseToken type;
+    bool done; // false while the node is being parsed: asking for it again before then is a left recursion through other non-terminals, which fails.
+    ParseTreeNode node; // the node parsed there, `node.error` is not PARSE_ERROR_NONE if it failed.
+    size_t end; // the token after the node if it parsed (its span does not count the rest of a list, see `ParseTreeNode_is_list`).
+} PackratEntry;
 
-    if (p->type == PT_NULL)
-        return true;
-    if (ParseToken_IS_TERMINAL(p->type)) {
-        if (p->token == NULL) {
-            a->error = AST_ERROR_MISSING_TOKEN;
-            return false;
+DA_DEFINE(PackratEntries, PackratEntry);
+
+// A non-terminal whose production rules are being tried by `parse_cfg_packrat_parse_tree`, `node->count` children of the current one parsed so far.
+typedef struct _PackratFrame {
+    ParseTreeNode *node;
+    size_t start; // the index of the first token of the node, where each rule is tried from.
+    size_t rule;  // the index of the rule being tried in the grammar rule of the node.
+    size_t memo;  // the index of the entry of the node in `Packrat.entries`, SIZE_MAX if it is not memoized.
+    // the left-recursive rule to continue the node with, like `ParseFrame`.
+    const ProductionRule *left_recursive_rule;
+    size_t left_recursive_rule_num_children;
+    size_t offset;
+    size_t end;
+    // the node and the index before the repetition of the left-recursive rule being parsed, to go back to if it fails. `repeating` is false before the first one.
+    bool repeating;
+    ParseTreeNode before;
+    size_t before_index;
+    size_t child; // the index of the first token of the child being parsed, like `ParseFrame`.
+} PackratFrame;
+
+DA_DEFINE(PackratFrames, PackratFrame);
+
+// Initial number of slots of the memo table (must be a power of two).
+#define PACKRAT_INITIAL_SLOTS 1024
+
+// The state of `parse_cfg_packrat_parse_tree`: the memo table (open addressing with linear probing, like the intern table) and the explicit stack of frames.
+typedef struct _Packrat {
+    const TokenStream *input;
+    const CFG_PredictTable *table;
+    Arena *arena;
+    PackratEntries entries;
+    uint32_t *slots;   // each slot is the index of an entry + 1, or 0 if the slot is empty.
+    size_t slot_count; // power of two, kept at least twice the number of entries.
+    PackratFrames frames;
+    // the farthest token that could not be parsed and what was expected there, SIZE_MAX if none.
+    size_t farthest;
+    ParseToken expected;
+    ParseErrorType farthest_error;
+} Packrat;
+
+static inline size_t packrat_hash(const ParseToken type, const size_t index)
+{
+    const uint64_t key = (uint64_t)index * ParseToken_COUNT_NONTERMINAL + (uint64_t)(type - ParseToken_FIRST_NONTERMINAL);
+    return (size_t)((key * 0x9E3779B97F4A7C15u) >> 32);
+}
+
+static void packrat_grow(Packrat *const p)
+{
+    free(p->slots);
+    p->slot_count *= 2;
+    p->slots = calloc(p->slot_count, sizeof(uint32_t));
+    if (p->slots == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    const size_t mask = p->slot_count - 1;
+    for (size_t id = 0; id < p->entries.count; ++id) {
+        size_t i = packrat_hash(p->entries.items[id].type, p->entries.items[id].index) & mask;
+        while (p->slots[i] != 0)
+            i = (i + 1) & mask;
+        p->slots[i] = (uint32_t)id + 1;
+    }
+}
+
+/**
+ * Find the entry of `type` at token `index`, or add one that is not done.
+ * @param added Set to whether the entry was added.
+ * @return The index of the entry in `p->entries`.
+ */
+static size_t packrat_entry(Packrat *const p, const ParseToken type, const size_t index, bool *const added)
+{
+    const size_t mask = p->slot_count - 1;
+    size_t i = packrat_hash(type, index) & mask;
+    for (; p->slots[i] != 0; i = (i + 1) & mask) {
+        const PackratEntry *const e = p->entries.items + (p->slots[i] - 1);
+        if (e->index == index && e->type == type) {
+            *added = false;
+            return p->slots[i] - 1;
         }
-        if (ASTNodeType_HAS_TOKEN(a->type))
-            a->token = *p->token;
-        if (p->error || a->token.error) {
-            a->error = AST_ERROR_TOKEN_ERROR;
-            return false;
+    }
+    assert(p->entries.count < UINT32_MAX - 1);
+    const size_t id = p->entries.count;
+    da_push(&p->entries, ((PackratEntry){.index = index, .type = type, .done = false}));
+    p->slots[i] = (uint32_t)id + 1;
+    if (2 * p->entries.count > p->slot_count)
+        packrat_grow(p);
+    *added = true;
+    return id;
+}
+
+// Remember that `expected` could not be parsed at token `index`, if no token after it failed.
+static inline void packrat_expect(Packrat *const p, const size_t index, const ParseToken expected, const ParseErrorType error)
+{
+    if (p->farthest == SIZE_MAX || index > p->farthest) {
+        p->farthest = index;
+        p->expected = expected;
+        p->farthest_error = error;
+    }
+}
+
+/**
+ * Set up the node of `frame` to be parsed with the next production rule from `frame->rule` that can start with the token at `frame->start`, the index goes back there.
+ * The direct left-recursive rule is not one of them, the node is continued with it once it is parsed (if it comes before the rule, like `parse_tree_node_begin`).
+ * @return false if no rule is left to try.
+ */
+static bool packrat_next_rule(Packrat *const p, PackratFrame *const frame, size_t *const index)
+{
+    ParseTreeNode *const node = frame->node;
+    const size_t nonterminal = node->type - ParseToken_FIRST_NONTERMINAL;
+    const CFG_GrammarRule *const g_rule = p->table->grammar + nonterminal;
+    const ParseToken next = (ParseToken)p->input->types[frame->start];
+    for (; frame->rule < g_rule->num_rules; ++frame->rule) {
+        const ProductionRule *const rule = g_rule->rules + frame->rule;
+        if (rule->tokens[0] == node->type || !CFG_PredictTable_can_start_with(p->table, rule->tokens[0], next))
+            continue;
+        size_t length = 0;
+        while (rule->tokens[length] != PT_NULL)
+            ++length;
+        // the children array of a rule that failed is reused if it has the same length, nothing refers to it.
+        if (length != node->capacity) {
+            node->children = length ? arena_alloc(p->arena, length * sizeof(ParseTreeNode)) : NULL;
+            node->capacity = length;
+        }
+        node->rule = rule;
+        node->count = 0;
+        *index = frame->start;
+        frame->offset = 0;
+        frame->end = length;
+        frame->repeating = false;
+        frame->left_recursive_rule = NULL;
+        frame->left_recursive_rule_num_children = 0;
+        const size_t left_recursive = p->table->left_recursive[nonterminal];
+        if (left_recursive != 0 && left_recursive - 1 < frame->rule && g_rule->rules[left_recursive - 1].tokens[1] != PT_NULL) {
+            frame->left_recursive_rule = g_rule->rules + left_recursive - 1;
+            while (frame->left_recursive_rule->tokens[frame->left_recursive_rule_num_children] != PT_NULL)
+                ++frame->left_recursive_rule_num_children;
         }
         return true;
     }
-    // parse_node is a non-terminal.
-    // take the rule used to parse the node and use it to construct the children.
-    const ProductionRule *const rule = p->rule;
-    if (rule == NULL) {
-        a->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+    return false;
+}
+
+/**
+ * Start parsing `node`: a terminal (or PT_NULL) is parsed right away, so is a non-terminal that was already parsed at this token (looked up in the memo table),
+ * otherwise the frame of its first production rule that can match is pushed.
+ * @return true if the frame was pushed, false if the node is finished (`node->error` tells whether it was parsed).
+ */
+static bool packrat_begin(Packrat *const p, ParseTreeNode *const node, size_t *const index)
+{
+    node->error = PARSE_ERROR_NONE;
+    node->has_token = false;
+    node->span = 0;
+    node->rule = NULL;
+    node->finalized_promo_index = SIZE_MAX;
+    node->capacity = 0;
+    node->count = 0;
+    node->children = NULL;
+    if (node->type == PT_NULL)
+        return false;
+    if (ParseToken_IS_TERMINAL(node->type)) {
+        if (node->type == (ParseToken)p->input->types[*index]) {
+            node->has_token = true;
+            ++*index;
+            node->span = 1;
+        } else {
+            node->error = PARSE_ERROR_WRONG_TOKEN;
+            packrat_expect(p, *index, node->type, PARSE_ERROR_WRONG_TOKEN);
+        }
         return false;
     }
-    
-    // evaluate the type of the ASTNode if it is expecting a promotion.
-    // a->type will be set to promo.type at the end of this function.
-    ASTPromo promo = {SIZE_MAX, a->type, AST_ERROR_NONE};
-    bool absent[p->count];
-    memset(absent, 0, sizeof(absent));
-    if (a->type == AST_FROM_PROMOTION ) {
-        promo = ASTNode_get_promo(p, absent);
-        if (promo.error) {
-            a->error = promo.error;
+    // a non-terminal with a single rule is not memoized: parsing it again only parses its children again, which are (a recursion goes through a non-terminal with several rules).
+    size_t memo = SIZE_MAX;
+    if (p->table->grammar[node->type - ParseToken_FIRST_NONTERMINAL].num_rules > 1) {
+        bool added;
+        memo = packrat_entry(p, node->type, *index, &added);
+        if (!added) {
+            const PackratEntry *const e = p->entries.items + memo;
+            if (!e->done) {
+                node->error = PARSE_ERROR_NO_RULE_MATCHES;
+            } else {
+                *node = e->node;
+                if (node->error == PARSE_ERROR_NONE)
+                    *index = e->end;
+            }
             return false;
         }
     }
-    if (promo.type == AST_NULL || promo.type == AST_SKIP) {
-        a->type = AST_SKIP;
-        return true;
+    PackratFrame frame = {.node = node, .start = *index, .rule = 0, .memo = memo};
+    if (!packrat_next_rule(p, &frame, index)) {
+        node->error = PARSE_ERROR_NO_RULE_MATCHES;
+        packrat_expect(p, *index, node->type, PARSE_ERROR_NO_RULE_MATCHES);
+        if (memo != SIZE_MAX) {
+            p->entries.items[memo].node = *node;
+            p->entries.items[memo].done = true;
+        }
+        return false;
     }
-    // now add the children, appending to the dynamic array.
-    for (size_t i = 0; i < p->count; ++i) {
-        // if the type is explicitly AST_SKIP, or if the child would have been promoted but wasn't because it was absent, then skip it.
-        if (rule->ast_types[i] == AST_SKIP || absent[i])
-            continue;
-        // need to add the children directly to the array.
-        if (rule->ast_types[i] == AST_FROM_CHILDREN) {
-            if (!ASTNode_from_ParseTreeNode_impl(a, p->children + i)) {
-                a->error = AST_ERROR_CHILD_ERROR;
-                return false;
+    da_push(&p->frames, frame);
+    return true;
+}
+
+// The node on top of the stack is finished: it is remembered and is the next child of the node below it.
+static void packrat_finish(Packrat *const p, const size_t index)
+{
+    const PackratFrame *const top = p->frames.items + --p->frames.count;
+    ParseTreeNode *const node = top->node;
+    if (node->error == PARSE_ERROR_NONE)
+        node->span = (ParseTreeNode_is_list(node) ? top->child : index) - top->start;
+    if (top->memo != SIZE_MAX) {
+        p->entries.items[top->memo].node = *node;
+        p->entries.items[top->memo].end = index;
+        p->entries.items[top->memo].done = true;
+    }
+    if (p->frames.count > 0 && node->error == PARSE_ERROR_NONE)
+        ++p->frames.items[p->frames.count - 1].node->count;
+}
+
+// A child of the node on top of the stack failed: the repetition of its left-recursive rule is undone, or its next rule is tried, or it fails too (and so on down the stack).
+static void packrat_child_failed(Packrat *const p, size_t *const index)
+{
+    while (p->frames.count > 0) {
+        PackratFrame *const top = p->frames.items + p->frames.count - 1;
+        if (top->repeating) {
+            *top->node = top->before;
+            *index = top->before_index;
+            packrat_finish(p, *index);
+            return;
+        }
+        ++top->rule;
+        if (packrat_next_rule(p, top, index))
+            return;
+        top->node->error = PARSE_ERROR_NO_RULE_MATCHES;
+        top->node->count = 0;
+        *index = top->start;
+        packrat_finish(p, *index);
+    }
+}
+
+bool parse_cfg_packrat_parse_tree(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena)
+{
+    assert(node != NULL);
+    assert(index != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(arena != NULL);
+    if (table->deterministic)
+        return parse_tree(node, index, input, table, arena, NULL);
+    Packrat p = {.input = input, .table = table, .arena = arena, .slot_count = PACKRAT_INITIAL_SLOTS, .farthest = SIZE_MAX};
+    da_init(&p.entries);
+    da_init(&p.frames);
+    p.slots = calloc(p.slot_count, sizeof(uint32_t));
+    if (p.slots == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    const size_t start = *index;
+    if (packrat_begin(&p, node, index)) {
+        while (p.frames.count > 0) {
+            PackratFrame *const top = p.frames.items + p.frames.count - 1;
+            ParseTreeNode *const parent = top->node;
+            if (parent->count < top->end) {
+                ParseTreeNode *const child = parent->children + parent->count;
+                child->type = parent->rule->tokens[parent->count - top->offset];
+                top->child = *index;
+                if (packrat_begin(&p, child, index))
+                    continue;
+                if (child->error == PARSE_ERROR_NONE)
+                    ++parent->count;
+                else
+                    packrat_child_failed(&p, index);
+                continue;
             }
-        } else if (i == promo.idx) {
-            a->type = rule->ast_types[i];
-            // a->type is set according to the promoted child here.
-            if (!ASTNode_from_ParseTreeNode_impl(a, p->children + i)) {
-                a->error = AST_ERROR_CHILD_ERROR;
-                return false;
+            // the left-recursive rule is repeated while it parses, a repetition that fails is undone (unlike `parse_tree`, which fails with it).
+            const ProductionRule *const left_recursive_rule = top->left_recursive_rule;
+            if (left_recursive_rule != NULL && CFG_PredictTable_can_start_with(table, left_recursive_rule->tokens[1], (ParseToken)input->types[*index])) {
+                parent->span = *index - top->start;
+                top->before = *parent;
+                top->before_index = *index;
+                top->repeating = true;
+                const size_t first = ParseTreeNode_continue_left_recursion(parent, left_recursive_rule, top->left_recursive_rule_num_children, arena);
+                top->offset = first - 1;
+                top->end = first + top->left_recursive_rule_num_children - 1;
+                continue;
             }
-        // push only a single child to the array.
-        } else {
-            da_push(a, ((ASTNode){.type = rule->ast_types[i], .error = AST_ERROR_NONE, .token = (Token){0}, .items = NULL, .count = 0, .capacity = 0}));
-            if (!ASTNode_from_ParseTreeNode_impl(a->items + a->count - 1, p->children + i)) {
-                a->error = AST_ERROR_CHILD_ERROR;
+            packrat_finish(&p, *index);
+        }
+    }
+    // the node failed: it gets the token that could not be parsed as its only child, which is where the farthest rule that was tried failed.
+    if (node->error != PARSE_ERROR_NONE && ParseToken_IS_NONTERMINAL(node->type) && p.farthest != SIZE_MAX) {
+        ParseTreeNode *const expected = arena_alloc(arena, sizeof(ParseTreeNode));
+        ParseTreeNode_init(expected, 0, NULL);
+        expected->type = p.expected;
+        expected->error = p.farthest_error;
+        expected->has_token = true; // it starts at the farthest token, where the node ends.
+        node->error = PARSE_ERROR_CHILD_ERROR;
+        node->rule = NULL;
+        node->children = expected;
+        node->count = node->capacity = 1;
+        node->span = p.farthest - start;
+        *index = p.farthest;
+    }
+    da_clear(&p.entries);
+    da_clear(&p.frames);
+    free(p.slots);
+    return node->error == PARSE_ERROR_NONE;
+}
+
+bool parse_cfg_recognize(const ParseToken type, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, RecognizerFrame *const stack, const size_t capacity, SyntaxError *const error)
+{
+    assert(index != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(stack != NULL && capacity > 0);
+    assert(error != NULL);
+    const uint8_t *const types = input->types;
+    size_t i = *index;
+    // the node is recognized as the only token of a rule.
+    const ParseToken root[2] = {type, PT_NULL};
+    size_t count = 0;
+    stack[count++] = (RecognizerFrame){root, NULL};
+    while (count > 0) {
+        RecognizerFrame *const top = stack + count - 1;
+        const ParseToken t = *top->next;
+        if (t == PT_NULL) {
+            // the node is finished, unless it goes on with its left-recursive rule.
+            const ProductionRule *const left_recursive_rule = top->left_recursive_rule;
+            if (left_recursive_rule != NULL && CFG_PredictTable_can_start_with(table, left_recursive_rule->tokens[1], (ParseToken)types[i]))
+                top->next = left_recursive_rule->tokens + 1;
+            else
+                --count;
+            continue;
+        }
+        ++top->next;
+        if (ParseToken_IS_TERMINAL(t)) {
+            if (t != (ParseToken)types[i]) {
+                *error = (SyntaxError){.expected = t, .token_index = i};
+                *index = i;
                 return false;
             }
-            // if it turned out that the child was a skip (determined by promotion), then remove it.
-            if (a->items[a->count - 1].type == AST_SKIP || a->type == AST_NULL) {
-                --(a->count);
-            }
+            ++i;
+            continue;
+        }
+        // the same choice of rule as `parse_tree_node_begin`.
+        const size_t nonterminal = t - ParseToken_FIRST_NONTERMINAL;
+        const ProductionRule *const rule = CFG_PredictTable_rule(table, t, (ParseToken)types[i]);
+        if (rule == NULL) {
+            *error = (SyntaxError){.expected = t, .token_index = i};
+            *index = i;
+            return false;
+        }
+        const ProductionRule *left_recursive_rule = NULL;
+        if (table->left_recursive[nonterminal] != 0 && table->left_recursive[nonterminal] - 1 < rule - table->grammar[nonterminal].rules
+            && table->grammar[nonterminal].rules[table->left_recursive[nonterminal] - 1].tokens[1] != PT_NULL)
+            left_recursive_rule = table->grammar[nonterminal].rules + table->left_recursive[nonterminal] - 1;
+        // a node that is the last token of the rule on top replaces it (a tail call): a right-recursive list takes one frame, not one per item.
+        if (*top->next == PT_NULL && top->left_recursive_rule == NULL)
+            --count;
+        if (count == capacity) {
+            *error = (SyntaxError){.expected = PT_NULL, .token_index = i};
+            *index = i;
+            return false;
         }
+        stack[count++] = (RecognizerFrame){rule->tokens, left_recursive_rule};
     }
+    *index = i;
+    return true;
+}
 
-    switch (p->error) {
-        case PARSE_ERROR_NONE:
-        case PARSE_ERROR_WRONG_TOKEN: // handled in the terminal case.
-            break;
-        case PARSE_ERROR_CHILD_ERROR:
-            a->error = AST_ERROR_CHILD_ERROR;
-            break;
-        case PARSE_ERROR_NO_RULE_MATCHES:
-        case PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE:
-            a->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+// The items of the recovery list that one thread of `parse_cfg_recursive_descent_parse_tree_parallel` parses, in an arena of its own.
+typedef struct _ParseChunk {
+    const TokenStream *input;
+    const CFG_PredictTable *table;
+    size_t begin; // the items are parsed one after the other from token `begin`, as long as they start before token `end`.
+    size_t end;
+    Arena arena;
+    ParsedItems items;
+} ParseChunk;
+
+static void *parse_chunk(void *const arg)
+{
+    ParseChunk *const c = arg;
+    const CFG_Recovery *const recovery = c->table->recovery;
+    const ProductionRule *const item_rule = c->table->grammar[recovery->list - ParseToken_FIRST_NONTERMINAL].rules;
+    // like the list does: an item is parsed wherever the list predicts one, its tokens are skipped if it fails.
+    for (size_t index = c->begin; index < c->end && CFG_PredictTable_rule(c->table, recovery->list, (ParseToken)c->input->types[index]) == item_rule;) {
+        ParsedItem item = {.start = index, .node = {.type = item_rule->tokens[0]}};
+        parse_tree(&item.node, &index, c->input, c->table, &c->arena, NULL);
+        item.end = index;
+        da_push(&c->items, item);
+        if (ParseErrorType_FAILED(item.node.error))
+            index = CFG_Recovery_skip(recovery, c->input, index);
+    }
+    return NULL;
+}
+
+// Run `parse_chunk` on every chunk, one thread per chunk (the calling thread takes the first one).
+static void parse_chunks(ParseChunk *const chunks, const size_t count)
+{
+#ifndef _WIN32
+    pthread_t *const threads = malloc(count * sizeof(pthread_t));
+    bool *const started = calloc(count, sizeof(bool));
+    if (threads == NULL || started == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 1; i < count; ++i)
+        started[i] = pthread_create(&threads[i], NULL, parse_chunk, &chunks[i]) == 0;
+    parse_chunk(&chunks[0]);
+    for (size_t i = 1; i < count; ++i) {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            parse_chunk(&chunks[i]); // out of threads, do it here.
+    }
+    free(threads);
+    free(started);
+#else
+    for (size_t i = 0; i < count; ++i)
+        parse_chunk(&chunks[i]);
+#endif
+}
+
+size_t parse_cfg_parallel_chunk_count(const size_t index, const TokenStream *const input, const CFG_PredictTable *const table, unsigned thread_count, size_t min_chunk_tokens)
+{
+    if (table->recovery == NULL)
+        return 1;
+    if (thread_count == 0) {
+#ifndef _WIN32
+        const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = processors > 0 ? (unsigned)processors : 1;
+#else
+        thread_count = 1;
+#endif
+    }
+    if (min_chunk_tokens == 0)
+        min_chunk_tokens = PARALLEL_PARSER_DEFAULT_MIN_CHUNK_TOKENS;
+    const size_t chunk_count = (input->count - index) / min_chunk_tokens;
+    return chunk_count > thread_count ? thread_count : chunk_count > 0 ? chunk_count : 1;
+}
+
+bool parse_cfg_recursive_descent_parse_tree_parallel(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, unsigned thread_count, size_t min_chunk_tokens, Arena *const arena)
+{
+    assert(node != NULL);
+    assert(index != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(arena != NULL);
+    const size_t chunk_count = parse_cfg_parallel_chunk_count(*index, input, table, thread_count, min_chunk_tokens);
+    if (chunk_count < 2)
+        return parse_tree(node, index, input, table, arena, NULL);
+    const size_t begin = *index, length = input->count - begin;
+
+    // structural pre-scan: a chunk starts at the first item boundary (after an `end` or a `block_end` outside of any block) after every 1/chunk_count of the tokens.
+    // the boundaries are only guesses of where the items start: an item parsed from a wrong one is never looked up.
+    const CFG_Recovery *const recovery = table->recovery;
+    ParseChunk *const chunks = calloc(chunk_count, sizeof(ParseChunk));
+    if (chunks == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 1, depth = 0;
+    chunks[0].begin = begin;
+    for (size_t i = begin; count < chunk_count;) {
+        i += simd_find_any_of3(input->types + i, input->count - i, (unsigned char)recovery->end, (unsigned char)recovery->block_begin, (unsigned char)recovery->block_end);
+        if (i >= input->count)
             break;
+        const ParseToken t = (ParseToken)input->types[i++];
+        if (t == recovery->block_begin) {
+            ++depth;
+            continue;
+        }
+        if (t == recovery->block_end && depth > 0)
+            --depth;
+        else if (t == recovery->block_end)
+            continue;
+        if (depth == 0 && i >= begin + count * (length / chunk_count))
+            chunks[count++].begin = i;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        chunks[i].input = input;
+        chunks[i].table = table;
+        chunks[i].end = i + 1 < count ? chunks[i + 1].begin : input->count;
+        arena_init(&chunks[i].arena, 0);
+        da_init(&chunks[i].items);
+    }
+    parse_chunks(chunks, count);
+
+    // the sequential parse takes the items that start where it expects one, and parses the rest (only what the chunks got wrong).
+    ParsedItems items;
+    da_init(&items);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < chunks[i].items.count; ++k)
+            da_push(&items, chunks[i].items.items[k]);
+        da_clear(&chunks[i].items);
+        arena_adopt(arena, &chunks[i].arena);
     }
+    free(chunks);
+    const bool parsed = parse_tree(node, index, input, table, arena, &items);
+    da_clear(&items);
+    return parsed;
+}
 
-    return a->error == AST_ERROR_NONE;
+TokenEdit TokenEdit_between(const TokenStream *const old_input, const TokenStream *const input)
+{
+    const size_t count = old_input->count < input->count ? old_input->count : input->count;
+    TokenEdit edit = {.start = 0, .old_end = old_input->count, .new_end = input->count};
+    while (edit.start < count && old_input->types[edit.start] == input->types[edit.start])
+        ++edit.start;
+    while (edit.old_end > edit.start && edit.new_end > edit.start && old_input->types[edit.old_end - 1] == input->types[edit.new_end - 1]) {
+        --edit.old_end;
+        --edit.new_end;
+    }
+    return edit;
 }
 
-bool ASTNode_from_ParseTreeNode(ASTNode *const ast_node, ParseTreeNodeWithPromo *const parse_node) {
-    assert(ast_node != NULL);
-    assert(parse_node != NULL);
-    // ast_node->type is already set to the desired type.
-    // initialize the rest of the ASTNode to default values.
-    memset(&(ast_node->error), 0, sizeof(ASTNode) - sizeof(ASTNodeType));
-    // call the function given ast_node is initialized to default values.
-    return ASTNode_from_ParseTreeNode_impl(ast_node, parse_node);
-}
\ No newline at end of file
+// A node on the path from the root of a tree down to an edit: it starts at token `start`, and child `child` of it is the next node on the path.
+typedef struct _TreePathStep {
+    ParseTreeNode *node;
+    size_t start;
+    size_t child;
+} TreePathStep;
+
+DA_DEFINE(TreePath, TreePathStep);
+
+/**
+ * Parse the items of the list `path->items[level]` again, from its start on, until the list is back at a token where it was before the edit (mapped to the new stream):
+ * from there on the tokens are the same, so the rest of the list (kept by reference as it is, its positions are relative) and of the tree are too.
+ * @param items Scratch space for the items parsed again, they are the items of the new list nodes afterwards.
+ * @param consumed Set to the number of nodes of the old list replaced by the new ones, from `path->items[level]` on (the node after them is kept, in a new place).
+ * @return false if the list ends (or the old one does) without getting back in step after the edit, the tree is unchanged then.
+ */
+static bool reparse_list(const TreePath *const path, const size_t level, const TokenEdit *const edit, const TokenStream *const input, const CFG_PredictTable *const table, Arena *const arena, ParsedItems *const items, size_t *const consumed)
+{
+    ParseTreeNode *const list = path->items[level].node;
+    const ProductionRule *const item_rule = list->rule;
+    items->count = 0;
+    *consumed = 0;
+    // the old list node at token `q` (in the old stream) that the new one at token `p` may be in step with.
+    ParseTreeNode *old = list;
+    size_t q = path->items[level].start, p = q;
+    for (;;) {
+        if (p >= edit->new_end) {
+            while (old->count > 0 && q + edit->new_end < p + edit->old_end) {
+                q += old->span;
+                old = old->children + 1;
+                ++*consumed;
+            }
+            if (q + edit->new_end == p + edit->old_end)
+                break;
+            if (old->count == 0)
+                return false;
+        }
+        if (CFG_PredictTable_rule(table, list->type, (ParseToken)input->types[p]) != item_rule)
+            return false;
+        ParsedItem item = {.start = p, .node = {.type = item_rule->tokens[0]}};
+        parse_tree(&item.node, &p, input, table, arena, NULL);
+        item.end = p;
+        da_push(items, item);
+        if (ParseErrorType_FAILED(item.node.error))
+            p = CFG_Recovery_skip(table->recovery, input, p);
+    }
+
+    // link the new items in front of the rest of the old list, the first one in place of `list`.
+    ParseTreeNode next = *old;
+    size_t next_start = p;
+    for (size_t i = items->count; i-- > 0;) {
+        ParseTreeNode *const children = i == 0 ? list->children : arena_alloc(arena, 2 * sizeof(ParseTreeNode));
+        children[0] = items->items[i].node;
+        children[1] = next;
+        const bool recovered = children[0].error != PARSE_ERROR_NONE || children[1].error == PARSE_ERROR_RECOVERED;
+        next = (ParseTreeNode){.type = list->type, .error = recovered ? PARSE_ERROR_RECOVERED : PARSE_ERROR_NONE, .has_token = false,
+            .span = next_start - items->items[i].start, .rule = item_rule, .finalized_promo_index = SIZE_MAX, .count = 2, .capacity = 2, .children = children};
+        next_start = items->items[i].start;
+    }
+    *list = next;
+    return true;
+}
+
+// The error of a node above a list that was parsed again, from the errors of its children: whether it recovered from one (unless it failed on its own).
+static ParseErrorType reparsed_error(const ParseTreeNode *const node, const ProductionRule *const item_rule)
+{
+    if (ParseErrorType_FAILED(node->error))
+        return node->error;
+    bool recovered = node->rule == item_rule && ParseErrorType_FAILED(node->children[0].error);
+    for (size_t k = 0; k < node->count && !recovered; ++k)
+        recovered = node->children[k].error == PARSE_ERROR_RECOVERED;
+    return recovered ? PARSE_ERROR_RECOVERED : PARSE_ERROR_NONE;
+}
+
+/**
+ * Update the nodes above the list `path->items[level]` that was parsed again: their spans cover the edit (except the nodes of a list before the item the edit is in, see `ParseTreeNode_is_list`),
+ * their errors and promotions may have changed.
+ * @param jump The level of the path that `index` led to, entry `entry` of it, or SIZE_MAX. The nodes of the list before it are not on the path: going up them stops at the first one
+ * whose error is the same (the errors of the nodes before it are too).
+ */
+static void reparse_update_path(const TreePath *const path, const size_t level, const TokenEdit *const edit, const ProductionRule *const item_rule, const ParseTreeIndex *const index, const size_t jump, const size_t entry)
+{
+    for (size_t i = level + 1; i-- > 0;) {
+        ParseTreeNode *const node = path->items[i].node;
+        if (i < level) {
+            if (!ParseTreeNode_is_list(node) || path->items[i].child + 1 != node->count)
+                node->span = node->span + edit->new_end - edit->old_end;
+            node->finalized_promo_index = SIZE_MAX; // the promotion found by `ASTNode_from_ParseTreeNode` may have changed.
+            node->error = reparsed_error(node, item_rule);
+        }
+        if (i != jump)
+            continue;
+        for (size_t k = entry; k-- > 0;) {
+            ParseTreeNode *const list = index->items[k].list;
+            const ParseErrorType error = reparsed_error(list, item_rule);
+            if (error == list->error && list->finalized_promo_index == SIZE_MAX)
+                break;
+            list->error = error;
+            list->finalized_promo_index = SIZE_MAX;
+        }
+    }
+}
+
+// Fill `index` with the nodes of the list `list` (which starts at token `start`), up to the empty one at its end.
+static void ParseTreeIndex_fill(ParseTreeIndex *const index, ParseTreeNode *list, size_t start, const ProductionRule *const item_rule)
+{
+    index->count = 0;
+    for (; list->rule == item_rule && list->count == 2; list = list->children + 1) {
+        da_push(index, ((ParseTreeIndexEntry){list, start}));
+        start += list->span;
+    }
+    da_push(index, ((ParseTreeIndexEntry){list, start}));
+}
+
+/**
+ * Update `index` after `reparse_list` replaced `consumed` nodes of the list from entry `entry` on by nodes of `items`: the node after them is kept in a new place,
+ * the ones after it are the same, shifted by the edit.
+ */
+static void ParseTreeIndex_relink(ParseTreeIndex *const index, const size_t entry, const size_t consumed, const ParsedItems *const items, const TokenEdit *const edit)
+{
+    const size_t kept = entry + consumed, count = index->count - consumed + items->count;
+    const size_t kept_start = index->items[kept].start + edit->new_end - edit->old_end;
+    const size_t old_count = index->count;
+    while (index->count < count)
+        da_push(index, ((ParseTreeIndexEntry){NULL, 0}));
+    memmove(index->items + entry + items->count, index->items + kept, (old_count - kept) * sizeof(ParseTreeIndexEntry));
+    index->count = count;
+    ParseTreeNode *list = index->items[entry].list;
+    for (size_t i = 0; i < items->count; ++i, list = list->children + 1)
+        index->items[entry + i] = (ParseTreeIndexEntry){list, items->items[i].start};
+    index->items[entry + items->count] = (ParseTreeIndexEntry){list, kept_start};
+    for (size_t k = entry + items->count + 1; k < count; ++k)
+        index->items[k].start += edit->new_end - edit->old_end;
+}
+
+bool parse_cfg_recursive_descent_reparse(ParseTreeNode *const node, const TokenEdit *const edit, const TokenStream *const input, const CFG_PredictTable *const table, ParseTreeIndex *const index, Arena *const arena)
+{
+    assert(node != NULL);
+    assert(edit != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(arena != NULL);
+    if (edit->start == edit->old_end && edit->start == edit->new_end)
+        return node->error == PARSE_ERROR_NONE;
+
+    bool reparsed = false;
+    // the level of the path that the index led to and its entry, SIZE_MAX if it was not used.
+    size_t jump = SIZE_MAX, entry = SIZE_MAX;
+    if (table->recovery != NULL) {
+        const ProductionRule *const recovery_rule = table->grammar[table->recovery->list - ParseToken_FIRST_NONTERMINAL].rules;
+        // down from the root to the smallest node around the first token of the edit. The node ends before token `end`.
+        TreePath path;
+        da_init(&path);
+        ParseTreeNode *n = node;
+        size_t start = 0, end = ParseTreeNode_end(node, 0);
+        for (;;) {
+            if (index != NULL && jump == SIZE_MAX && n->rule == recovery_rule && n->count == 2) {
+                // the outermost list: the index goes to the item before the last one that starts at or before the edit (the list is parsed again from one of them).
+                if (index->count == 0 || index->items[0].list != n)
+                    ParseTreeIndex_fill(index, n, start, recovery_rule);
+                size_t low = 0, high = index->count - 1;
+                while (high - low > 1) {
+                    const size_t middle = low + (high - low) / 2;
+                    if (index->items[middle].start <= edit->start)
+                        low = middle;
+                    else
+                        high = middle;
+                }
+                jump = path.count;
+                entry = low > 0 ? low - 1 : 0;
+                n = index->items[entry].list;
+                start = index->items[entry].start;
+            }
+            TreePathStep step = {.node = n, .start = start, .child = SIZE_MAX};
+            if (n->rule == recovery_rule && n->count == 2) {
+                // the next item of the list starts after the tokens skipped after this one (if it failed).
+                const size_t next_start = start + n->span;
+                if (next_start <= edit->start && n->children[1].count > 0) {
+                    step.child = 1;
+                    start = next_start;
+                } else if (edit->start < start + n->children[0].span) {
+                    step.child = 0;
+                    end = start + n->children[0].span;
+                }
+            } else {
+                // the children up to the last one end where the next one starts, the last one where the node ends.
+                for (size_t i = 0, child_start = start; i < n->count && child_start <= edit->start; ++i) {
+                    const size_t child_end = i + 1 < n->count ? ParseTreeNode_child_start(n, start, i + 1, child_start) : end;
+                    if (edit->start < child_end) {
+                        step.child = i;
+                        start = child_start;
+                        end = child_end;
+                        break;
+                    }
+                    child_start = child_end;
+                }
+            }
+            da_push(&path, step);
+            if (step.child == SIZE_MAX)
+                break;
+            n = n->children + step.child;
+        }
+
+        // the innermost list around the edit is parsed again from the item before the edit, then the lists around it.
+        // (only the last node of a list on the path before the edit, parsing the list again from an earlier item would end the same way)
+        ParsedItems items;
+        da_init(&items);
+        for (size_t level = path.count; level-- > 0 && !reparsed;) {
+            const TreePathStep *const step = path.items + level;
+            if (step->node->rule != recovery_rule || step->node->count != 2 || step->start >= edit->start)
+                continue;
+            if (step->child == 1 && step[1].start < edit->start)
+                continue;
+            size_t consumed;
+            reparsed = reparse_list(&path, level, edit, input, table, arena, &items, &consumed);
+            if (!reparsed)
+                continue;
+            reparse_update_path(&path, level, edit, recovery_rule, index, jump, entry);
+            if (jump == SIZE_MAX)
+                break;
+            // the nodes of the indexed list on the path, the last one is around the edit.
+            size_t last = jump;
+            while (last + 1 < path.count && path.items[last].child == 1 && path.items[last].node->rule == recovery_rule)
+                ++last;
+            if (level >= jump && level <= last) {
+                ParseTreeIndex_relink(index, entry + level - jump, consumed, &items, edit);
+            } else {
+                for (size_t k = entry + last - jump + 1; k < index->count; ++k)
+                    index->items[k].start += edit->new_end - edit->old_end;
+            }
+        }
+        da_clear(&items);
+        da_clear(&path);
+    }
+    if (!reparsed) {
+        size_t i = 0;
+        parse_tree(node, &i, input, table, arena, NULL);
+    }
+    // the index is filled again by the next reparse if it did not follow this one.
+    if (index != NULL && (!reparsed || jump == SIZE_MAX))
+        index->count = 0;
+    return node->error == PARSE_ERROR_NONE;
+}
+
+typedef struct _ASTPromo {
+    size_t idx;
+    ASTNodeType type;
+    ASTErrorType error;
+} ASTPromo;
+
+DA_DEFINE(AbsentFlags, bool);
+
+// A node of the parse tree as the conversion sees it. A node continued `n > 1` times by its left-recursive rule (see `ParseTreeNode_continue_left_recursion`)
+// stands for the `n` nested nodes the rule describes: repetition `level` has the children of the rule, the first one is repetition `level - 1`
+// (child 0 of the node for the first repetition) and the others start at child `1 + (level - 1) * (length - 1)` of the node, for a rule of `length` tokens.
+// `level` is 0 for any other node, which is seen as it is.
+typedef struct _TreeRef {
+    ParseTreeNodeWithPromo *p;
+    size_t level;
+} TreeRef;
+
+static inline size_t rule_length(const ProductionRule *const rule) {
+    size_t length = 0;
+    while (rule->tokens[length] != PT_NULL)
+        ++length;
+    return length;
+}
+
+static inline TreeRef TreeRef_of(ParseTreeNodeWithPromo *const p) {
+    // only a left-recursive rule starts with the non-terminal it is a rule of, and a node with more than one repetition of it has at least 3 children.
+    if (p->count < 3 || p->rule->tokens[0] != p->type)
+        return (TreeRef){p, 0};
+    const size_t length = rule_length(p->rule);
+    return (TreeRef){p, length > 1 && p->count > length ? (p->count - 1) / (length - 1) : 0};
+}
+
+static inline size_t TreeRef_count(const TreeRef r) {
+    return r.level ? rule_length(r.p->rule) : r.p->count;
+}
+
+static inline TreeRef TreeRef_child(const TreeRef r, const size_t i) {
+    if (r.level == 0)
+        return TreeRef_of(r.p->children + i);
+    if (i > 0)
+        return TreeRef_of(r.p->children + 1 + (r.level - 1) * (rule_length(r.p->rule) - 1) + i - 1);
+    if (r.level == 1)
+        return TreeRef_of(r.p->children);
+    return (TreeRef){r.p, r.level - 1};
+}
+
+// whether `r` is the node itself rather than one of the repetitions nested in it.
+static inline bool TreeRef_is_node(const TreeRef r) {
+    return r.level == 0 || 1 + r.level * (rule_length(r.p->rule) - 1) == r.p->count;
+}
+// the error of the node is the error of its last repetition, the ones before it parsed.
+static inline ParseErrorType TreeRef_error(const TreeRef r) {
+    return TreeRef_is_node(r) ? r.p->error : PARSE_ERROR_NONE;
+}
+
+// the number of tokens of `r`: of the node, or of the children of the repetitions up to `r.level` (which are the first ones). A list goes on to its end (see `ParseTreeNode_end`).
+static inline size_t TreeRef_span(const TreeRef r) {
+    if (TreeRef_is_node(r))
+        return ParseTreeNode_end((const ParseTreeNode *)r.p, 0);
+    size_t span = 0;
+    for (size_t i = 0; i < 1 + r.level * (rule_length(r.p->rule) - 1); ++i)
+        span = ParseTreeNode_end((const ParseTreeNode *)(r.p->children + i), span);
+    return span;
+}
+
+// whether `r` is a list node, whose span stops where its last child starts (see `ParseTreeNode_is_list`).
+static inline bool TreeRef_is_list(const TreeRef r) {
+    return TreeRef_is_node(r) && ParseTreeNode_is_list((const ParseTreeNode *)r.p);
+}
+
+// only the node itself has a `finalized_promo_index`, the promotion of the repetitions nested in it is found again every time (in a few steps, a left-recursive rule is not promoted through its first child).
+static inline size_t TreeRef_finalized_promo_index(const TreeRef r) {
+    return TreeRef_is_node(r) ? r.p->finalized_promo_index : SIZE_MAX;
+}
+
+static inline void TreeRef_finalize_promo_index(const TreeRef r, const size_t idx) {
+    if (TreeRef_is_node(r))
+        r.p->finalized_promo_index = idx;
+}
+
+// A node whose promotion is the promotion of one of its children, while `ASTNode_get_promo` finds the promotion of that child.
+typedef struct _PromoFrame {
+    TreeRef p;
+    ASTPromo promo;
+    size_t absent; // offset of the absent flags of the children of `p` in `ASTConversion.promo_absent`.
+} PromoFrame;
+
+DA_DEFINE(PromoFrames, PromoFrame);
+
+// A node whose children are being converted by `ASTNode_from_ParseTreeNode_impl`.
+typedef struct _ConvertFrame {
+    ASTNode *a;
+    TreeRef p;
+    size_t promo_idx;
+    size_t next;   // index of the child after the one being converted.
+    size_t absent; // offset of the absent flags of the children of `p` in `ASTConversion.absent`.
+    size_t end;    // index of the token after `p` (where its last child starts if it is a list), SIZE_MAX for a repetition nested in the node (see `TreeRef_is_node`), which is followed by the rest of the node.
+} ConvertFrame;
+
+DA_DEFINE(ConvertFrames, ConvertFrame);
+
+// The explicit stacks of a conversion, so that the depth of the tree is only limited by memory. Kept for the whole conversion so they are only allocated once.
+typedef struct _ASTConversion {
+    const TokenStream *tokens;
+    size_t start; // index of the first token of the node converted next, the nodes are converted in the order of their tokens.
+    Arena *arena;
+    ConvertFrames frames;
+    AbsentFlags absent;
+    PromoFrames promo_frames;
+    AbsentFlags promo_absent;
+} ASTConversion;
+
+/**
+ * Start finding the promotion of `p`.
+ * @return true if `promo` is already known: `p` has no rule (it failed to parse) or its promotion was finalized before.
+ */
+static bool ASTNode_begin_promo(const TreeRef p, ASTPromo *const promo) {
+    // a node that failed to parse (or was never parsed) has no rule to be promoted through.
+    if (p.p->rule == NULL) {
+        *promo = (ASTPromo){SIZE_MAX, AST_NULL, AST_ERROR_UNSPECIFIED_PRODUCTION_RULE};
+        return true;
+    }
+    *promo = (ASTPromo){p.p->rule->promote_index, AST_NULL, AST_ERROR_NONE};
+    const size_t finalized_promo_index = TreeRef_finalized_promo_index(p);
+    if (finalized_promo_index != SIZE_MAX) {
+        promo->type = p.p->rule->ast_types[finalized_promo_index];
+        promo->idx = finalized_promo_index;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Follow the rule of `p` from the promotion index `promo->idx`.
+ * @return true if `promo` is known, false if it is the promotion of child `promo->idx` (which is AST_FROM_PROMOTION).
+ */
+static bool ASTNode_advance_promo(const TreeRef p, ASTPromo *const promo, const bool *const absent) {
+    const size_t count = TreeRef_count(p);
+    // this promo_idx is valid, it just means that the result is AST_NULL.
+    if (promo->idx == count) {
+        TreeRef_finalize_promo_index(p, promo->idx);
+        promo->type = AST_NULL;
+        return true;
+    }
+    // promo index is invalid, or we have already tried to promote this child.
+    if (promo->idx > count || absent[promo->idx]) {
+        promo->error = AST_ERROR_EXPECTED_PROMOTION;
+        return true;
+    }
+    // promo.idx < count
+    promo->type = p.p->rule->ast_types[promo->idx];
+    if (promo->type != AST_FROM_PROMOTION) {
+        TreeRef_finalize_promo_index(p, promo->idx);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Take the promotion `child_promo` of child `promo->idx` of `p` as the promotion of `p`.
+ * @return true if `promo` is known, false if the child is absent and `promo->idx` moved to its alternate (to advance from).
+ */
+static bool ASTNode_apply_child_promo(const TreeRef p, ASTPromo *const promo, bool *const absent, const ASTPromo child_promo) {
+    if (child_promo.error) {
+        promo->error = child_promo.error;
+        return true;
+    } else if (child_promo.type == AST_FROM_PROMOTION) {
+        promo->error = AST_ERROR_EXPECTED_PROMOTION;
+        return true;
+    } else if (child_promo.type == AST_NULL) {
+        // try the alternate promotion index.
+        absent[promo->idx] = true;
+        // no alternates, then return AST_NULL.
+        if (p.p->rule->promotion_alternate_if_AST_NULL == NULL) {
+            promo->error = AST_ERROR_EXPECTED_PROMOTION;
+            return true;
+        }
+        promo->idx = p.p->rule->promotion_alternate_if_AST_NULL[promo->idx];
+        return false;
+    }
+    promo->type = child_promo.type;
+    TreeRef_finalize_promo_index(p, promo->idx);
+    return true;
+}
+
+/**
+ * Warning: `absent` must not be NULL, otherwise this function will not work correctly.
+ * 
+ * The chain of promoted children is followed with the stack of `c` instead of recursion, so it can be as long as memory allows.
+ * @param p The node to determine the promotion type of. This function will set p->finalized_promo_index to the index of the promotion that was used. If p->finalize_promo_index is already set (other than SIZE_MAX), then the function will return the corresponding promotion without going through children.
+ * @param absent Array of p->count bools to keep track of child nodes which resolved to AST_NULL which could not be promoted.
+ */
+static ASTPromo ASTNode_get_promo(const TreeRef p, bool *const absent, ASTConversion *const c) {
+    ASTPromo promo;
+    if (ASTNode_begin_promo(p, &promo))
+        return promo;
+    PromoFrames *const frames = &c->promo_frames;
+    AbsentFlags *const flags = &c->promo_absent;
+    da_push(frames, ((PromoFrame){p, promo, 0}));
+    bool known = false;
+    while (true) {
+        PromoFrame *const top = frames->items + frames->count - 1;
+        // the absent flags of `p` are the caller's, the ones of the children below it are on the stack.
+        bool *const top_absent = frames->count == 1 ? absent : flags->items + top->absent;
+        if (!known)
+            known = ASTNode_advance_promo(top->p, &top->promo, top_absent);
+        if (!known) {
+            const TreeRef child = TreeRef_child(top->p, top->promo.idx);
+            ASTPromo child_promo;
+            if (ASTNode_begin_promo(child, &child_promo)) {
+                known = ASTNode_apply_child_promo(top->p, &top->promo, top_absent, child_promo);
+            } else {
+                const size_t offset = flags->count;
+                const size_t count = TreeRef_count(child);
+                for (size_t i = 0; i < count; ++i)
+                    da_push(flags, false);
+                da_push(frames, ((PromoFrame){child, child_promo, offset}));
+            }
+            continue;
+        }
+        if (frames->count == 1)
+            break;
+        // the promotion of the child is known, it is applied to its parent.
+        const PromoFrame child = frames->items[--frames->count];
+        flags->count = child.absent;
+        PromoFrame *const parent = frames->items + frames->count - 1;
+        known = ASTNode_apply_child_promo(parent->p, &parent->promo, frames->count == 1 ? absent : flags->items + parent->absent, child.promo);
+    }
+    promo = frames->items[0].promo;
+    frames->count = 0;
+    return promo;
+}
+
+/**
+ * Start converting `p` into `a`: a terminal (or PT_NULL, or a node that is skipped) is converted right away, otherwise the frame to convert its children is pushed onto the stack of `c`.
+ * @param converted Set to whether the conversion succeeded if it is finished.
+ * @return true if the frame of `p` was pushed, false if the conversion is finished.
+ */
+static bool ASTNode_begin_conversion(ASTNode *const a, const TreeRef r, ASTConversion *const c, bool *const converted) {
+    const ParseTreeNodeWithPromo *const p = r.p;
+    *converted = true;
+    const size_t start = c->start;
+    // the tokens of a node that is not pushed are passed.
+    c->start += p->span;
+    if (p->type == PT_NULL)
+        return false;
+    if (ParseToken_IS_TERMINAL(p->type)) {
+        if (!p->has_token) {
+            a->error = AST_ERROR_MISSING_TOKEN;
+            *converted = false;
+            return false;
+        }
+        if (ASTNodeType_HAS_TOKEN(a->type))
+            a->token = token_stream_get(c->tokens, start);
+        if (p->error || a->token.error) {
+            a->error = AST_ERROR_TOKEN_ERROR;
+            *converted = false;
+        }
+        return false;
+    }
+    // parse_node is a non-terminal.
+    // take the rule used to parse the node and use it to construct the children.
+    if (p->rule == NULL) {
+        a->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+        *converted = false;
+        return false;
+    }
+
+    // evaluate the type of the ASTNode if it is expecting a promotion.
+    // a->type will be set to promo.type when the promoted child is converted.
+    ASTPromo promo = {SIZE_MAX, a->type, AST_ERROR_NONE};
+    const size_t absent = c->absent.count;
+    const size_t count = TreeRef_count(r);
+    for (size_t i = 0; i < count; ++i)
+        da_push(&c->absent, false);
+    if (a->type == AST_FROM_PROMOTION) {
+        promo = ASTNode_get_promo(r, c->absent.items + absent, c);
+        if (promo.error) {
+            a->error = promo.error;
+            c->absent.count = absent;
+            *converted = false;
+            return false;
+        }
+    }
+    if (promo.type == AST_NULL || promo.type == AST_SKIP) {
+        a->type = AST_SKIP;
+        c->absent.count = absent;
+        c->start = start + TreeRef_span(r);
+        return false;
+    }
+    c->start = start;
+    da_push(&c->frames, ((ConvertFrame){.a = a, .p = r, .promo_idx = promo.idx, .next = 0, .absent = absent, .end = TreeRef_is_node(r) ? start + p->span : SIZE_MAX}));
+    return true;
+}
+
+/**
+ * Convert `p` into `a`, with the explicit stacks of `c` (which must be empty) instead of recursion.
+ * Each node adds its children in order: AST_SKIP and absent ones are skipped, AST_FROM_CHILDREN and the promoted one are converted into the node itself, the others are pushed as its items.
+ * @return false if `p` or one of its children could not be converted.
+ */
+static bool ASTNode_from_ParseTreeNode_impl(ASTNode *const a, const TreeRef p, ASTConversion *const c) {
+    bool converted;
+    if (!ASTNode_begin_conversion(a, p, c, &converted))
+        return converted;
+    while (true) {
+        ConvertFrame *const top = c->frames.items + c->frames.count - 1;
+        ASTNode *const node = top->a;
+        const TreeRef parse = top->p;
+        const ProductionRule *const rule = parse.p->rule;
+        const bool *const absent = c->absent.items + top->absent;
+        const size_t count = TreeRef_count(parse);
+        // if the type is explicitly AST_SKIP, or if the child would have been promoted but wasn't because it was absent, then skip it.
+        // so is an item that failed in a node that recovered from it, the AST only has what parsed.
+        const bool recovered = TreeRef_error(parse) == PARSE_ERROR_RECOVERED;
+        size_t i = top->next;
+        for (; i < count && (rule->ast_types[i] == AST_SKIP || absent[i] || (recovered && ParseErrorType_FAILED(TreeRef_error(TreeRef_child(parse, i))))); ++i)
+            c->start += TreeRef_span(TreeRef_child(parse, i));
+        if (i < count) {
+            top->next = i + 1;
+            // the rest of a list starts after the tokens skipped to recover from an error, another last child ends where the node does (see `ParseTreeNode_child_start`).
+            if (i + 1 == count && top->end != SIZE_MAX && TreeRef_is_list(parse))
+                c->start = top->end;
+            else if (i + 1 == count && top->end != SIZE_MAX && !TreeRef_is_list(TreeRef_child(parse, i)))
+                c->start = top->end - TreeRef_span(TreeRef_child(parse, i));
+            // AST_FROM_CHILDREN children are added directly to the array, so they are converted into the node like the promoted one.
+            ASTNode *child = node;
+            if (rule->ast_types[i] != AST_FROM_CHILDREN && i == top->promo_idx) {
+                // node->type is set according to the promoted child here.
+                node->type = rule->ast_types[i];
+            // push only a single child to the array.
+            } else if (rule->ast_types[i] != AST_FROM_CHILDREN) {
+                arena_da_push(c->arena, node, ((ASTNode){.type = rule->ast_types[i], .error = AST_ERROR_NONE, .token = (Token){0}, .items = NULL, .count = 0, .capacity = 0}));
+                child = node->items + node->count - 1;
+            }
+            if (ASTNode_begin_conversion(child, TreeRef_child(parse, i), c, &converted))
+                continue;
+        } else {
+            switch (TreeRef_error(parse)) {
+                case PARSE_ERROR_NONE:
+                case PARSE_ERROR_WRONG_TOKEN: // handled in the terminal case.
+                    break;
+                case PARSE_ERROR_RECOVERED:
+                case PARSE_ERROR_CHILD_ERROR:
+                    node->error = AST_ERROR_CHILD_ERROR;
+                    break;
+                case PARSE_ERROR_NO_RULE_MATCHES:
+                case PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE:
+                    node->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+                    break;
+            }
+            // a node that recovered from a syntax error has an error (so has every node it is in, they recovered too), but what parsed in it is converted.
+            converted = node->error == AST_ERROR_NONE || TreeRef_error(parse) == PARSE_ERROR_RECOVERED;
+            c->absent.count = top->absent;
+            // (the last child of a list ends where the list does)
+            if (top->end != SIZE_MAX && !TreeRef_is_list(parse))
+                c->start = top->end;
+            if (--c->frames.count == 0)
+                return converted;
+        }
+        // a child of the node on top of the stack is converted.
+        if (!converted) {
+            // a child that fails fails every node it is in.
+            for (; c->frames.count > 0; --c->frames.count)
+                c->frames.items[c->frames.count - 1].a->error = AST_ERROR_CHILD_ERROR;
+            c->absent.count = 0;
+            return false;
+        }
+        const ConvertFrame *const parent = c->frames.items + c->frames.count - 1;
+        const size_t j = parent->next - 1;
+        // if it turned out that the child was a skip (determined by promotion), then remove it.
+        if (parent->p.p->rule->ast_types[j] != AST_FROM_CHILDREN && j != parent->promo_idx
+            && (parent->a->items[parent->a->count - 1].type == AST_SKIP || parent->a->type == AST_NULL))
+            --(parent->a->count);
+    }
+}
+
+bool ASTNode_from_ParseTreeNode(ASTNode *const ast_node, ParseTreeNodeWithPromo *const parse_node, const TokenStream *const tokens, Arena *const arena) {
+    assert(ast_node != NULL);
+    assert(parse_node != NULL);
+    assert(arena != NULL);
+    // ast_node->type is already set to the desired type.
+    // initialize the rest of the ASTNode to default values.
+    memset(&(ast_node->error), 0, sizeof(ASTNode) - sizeof(ASTNodeType));
+    ASTConversion c = {.tokens = tokens, .arena = arena};
+    da_init(&c.frames);
+    da_init(&c.absent);
+    da_init(&c.promo_frames);
+    da_init(&c.promo_absent);
+    // call the function given ast_node is initialized to default values.
+    const bool converted = ASTNode_from_ParseTreeNode_impl(ast_node, TreeRef_of(parse_node), &c);
+    da_clear(&c.frames);
+    da_clear(&c.absent);
+    da_clear(&c.promo_frames);
+    da_clear(&c.promo_absent);
+    return converted;
+}
+// What the parent of a node parsed by `parse_ast_node` needs to know about it, the ASTNode the node converts to is built by the parse itself.
+typedef struct _ASTParsedNode {
+    ParseErrorType error; // `ParseTreeNode.error` the node would have.
+    bool converted;       // What `ASTNode_from_ParseTreeNode_impl` would return for the node.
+    ASTPromo promo;       // What `ASTNode_get_promo` would return for the node, only set if it was converted with type AST_FROM_PROMOTION (the only case its parent looks at it).
+} ASTParsedNode;
+
+// State of a whole `parse_cfg_recursive_descent_ast`.
+typedef struct _ASTParser {
+    size_t *index;
+    const TokenStream *input;
+    const CFG_PredictTable *table;
+    Arena *arena;
+    SyntaxErrors *errors;
+    const CFG_PrecedenceTable *precedence;
+    ParseToken expression; // The non-terminal parsed by precedence climbing, PT_NULL while an expression is parsed again by the grammar.
+    bool climbing;         // Whether an enclosing expression is parsed by precedence climbing (and is parsed again if this one fails).
+    const ProductionRule *recovery_rule; // The rule whose first child (an item of the list) is recovered from when it fails, NULL if the table does not recover.
+    Arena stack;           // The frames of the calls being parsed (see `ASTFrame`), instead of the call stack so that the depth of the tree is only limited by memory.
+    struct _ASTFrame *top; // The frame that runs next, NULL once the first one returned.
+    bool climbed;          // What the last `parse_ast_climbing` frame returned.
+    AbsentFlags absent;    // The absent flags of `ASTNode_from_parsed_children`, kept from one node to the next.
+} ASTParser;
+
+/**
+ * Same as `ASTNode_get_promo` for a node parsed with `rule`, from the promotions of its `count` children instead of the children themselves.
+ */
+static ASTPromo ASTNode_get_promo_of_children(const ProductionRule *const rule, const size_t count, const ASTParsedNode *const children, bool *const absent) {
+    ASTPromo promo = {rule->promote_index, AST_NULL, AST_ERROR_NONE};
+    while (true) {
+        if (promo.idx == count) {
+            promo.type = AST_NULL;
+            return promo;
+        }
+        if (promo.idx > count || absent[promo.idx]) {
+            promo.error = AST_ERROR_EXPECTED_PROMOTION;
+            return promo;
+        }
+        promo.type = rule->ast_types[promo.idx];
+        if (promo.type != AST_FROM_PROMOTION)
+            return promo;
+        const ASTPromo child_promo = children[promo.idx].promo;
+        if (child_promo.error) {
+            promo.error = child_promo.error;
+            return promo;
+        } else if (child_promo.type == AST_FROM_PROMOTION) {
+            promo.error = AST_ERROR_EXPECTED_PROMOTION;
+            return promo;
+        } else if (child_promo.type == AST_NULL) {
+            absent[promo.idx] = true;
+            if (rule->promotion_alternate_if_AST_NULL == NULL) {
+                promo.error = AST_ERROR_EXPECTED_PROMOTION;
+                return promo;
+            }
+            promo.idx = rule->promotion_alternate_if_AST_NULL[promo.idx];
+        } else {
+            promo.type = child_promo.type;
+            return promo;
+        }
+    }
+}
+
+/**
+ * @return The type child `i` of a node of type `type` parsed with `rule` is converted with: the type `ASTNode_from_ParseTreeNode_impl` gives it, or AST_SKIP if its conversion is never looked at.
+ */
+static inline ASTNodeType ASTNode_child_type(const ProductionRule *const rule, const size_t i, const ASTNodeType type) {
+    if (type == AST_NULL || type == AST_SKIP)
+        return AST_SKIP;
+    // converted into the node with the node's type, the promotion of such a rule always fails or is AST_NULL (see `CFG_supports_direct_ast`).
+    if (rule->ast_types[i] == AST_FROM_CHILDREN)
+        return type == AST_FROM_PROMOTION ? AST_SKIP : type;
+    return rule->ast_types[i];
+}
+
+/**
+ * Append what `from` was converted to into `a`, as if `from` had been converted into `a` directly.
+ */
+static inline void ASTNode_merge(ASTNode *const a, const ASTNode *const from, Arena *const arena) {
+    a->type = from->type;
+    if (from->token.type != TOKEN_NULL)
+        a->token = from->token;
+    if (a->count == 0) {
+        a->items = from->items;
+        a->count = from->count;
+        a->capacity = from->capacity;
+        return;
+    }
+    for (size_t i = 0; i < from->count; ++i)
+        arena_da_push(arena, a, from->items[i]);
+}
+
+/**
+ * Convert a node parsed with `rule` into `a` like `ASTNode_from_ParseTreeNode_impl` does, from what its children were converted to instead of the children themselves.
+ * @param children The `count` ASTNodes the children were converted to (with the types given by `ASTNode_child_type`), they are moved into `a`.
+ * @param parsed What parsing each child gave.
+ * @param node The parsed node, its promotion is set if `a->type` is AST_FROM_PROMOTION.
+ * @param flags Scratch space for the absent flags of the children, like `ASTConversion.absent`.
+ */
+static bool ASTNode_from_parsed_children(ASTNode *const a, const ProductionRule *const rule, const size_t count, const ASTNode *const children, const ASTParsedNode *const parsed, ASTParsedNode *const node, AbsentFlags *const flags, Arena *const arena) {
+    ASTPromo promo = {SIZE_MAX, a->type, AST_ERROR_NONE};
+    flags->count = 0;
+    for (size_t i = 0; i <= count; ++i)
+        da_push(flags, false);
+    bool *const absent = flags->items;
+    if (a->type == AST_FROM_PROMOTION) {
+        promo = node->promo = ASTNode_get_promo_of_children(rule, count, parsed, absent);
+        if (promo.error) {
+            a->error = promo.error;
+            return false;
+        }
+    }
+    if (promo.type == AST_NULL || promo.type == AST_SKIP) {
+        a->type = AST_SKIP;
+        return true;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (rule->ast_types[i] == AST_SKIP || absent[i] || (node->error == PARSE_ERROR_RECOVERED && ParseErrorType_FAILED(parsed[i].error)))
+            continue;
+        if (rule->ast_types[i] == AST_FROM_CHILDREN || i == promo.idx) {
+            ASTNode_merge(a, children + i, arena);
+            if (!parsed[i].converted) {
+                a->error = AST_ERROR_CHILD_ERROR;
+                return false;
+            }
+        } else {
+            arena_da_push(arena, a, children[i]);
+            if (!parsed[i].converted) {
+                a->error = AST_ERROR_CHILD_ERROR;
+                return false;
+            }
+            if (children[i].type == AST_SKIP || a->type == AST_NULL)
+                --(a->count);
+        }
+    }
+
+    switch (node->error) {
+        case PARSE_ERROR_NONE:
+        case PARSE_ERROR_WRONG_TOKEN:
+            break;
+        case PARSE_ERROR_RECOVERED:
+        case PARSE_ERROR_CHILD_ERROR:
+            a->error = AST_ERROR_CHILD_ERROR;
+            break;
+        case PARSE_ERROR_NO_RULE_MATCHES:
+        case PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE:
+            a->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+            break;
+    }
+    return a->error == AST_ERROR_NONE || node->error == PARSE_ERROR_RECOVERED;
+}
+
+// What a frame of the explicit stack of `parse_cfg_recursive_descent_ast` is a call of.
+typedef enum _ASTFrameKind {
+    AST_FRAME_NODE,       // `parse_ast_node`, with the children of the rule it chose.
+    AST_FRAME_EXPRESSION, // `parse_ast_expression`.
+    AST_FRAME_CLIMBING,   // `parse_ast_climbing`.
+} ASTFrameKind;
+
+// The start of every frame. The frames are allocated in `ASTParser.stack` and released in reverse order, so their addresses stay valid while the frames above them come and go.
+typedef struct _ASTFrame {
+    struct _ASTFrame *caller; // The frame to go back to when this one returns, NULL for the first one.
+    ArenaMark mark;           // Position of `ASTParser.stack` before the frame, it is released back to it when the frame returns.
+    ASTFrameKind kind;
+    uint8_t step;             // Where the call goes on from once the frame it called returns.
+} ASTFrame;
+
+typedef enum _ASTNodeStep {
+    AST_NODE_BEGIN,           // Match the terminal `type`, or choose the rule of the non-terminal and start parsing its children.
+    AST_NODE_PROMOTED_NEXT,   // Parse child `i` of a node converted with AST_FROM_PROMOTION.
+    AST_NODE_PROMOTED_PARSED, // Child `i` of such a node is parsed.
+    AST_NODE_DIRECT_NEXT,     // Parse child `i` of any other node.
+    AST_NODE_DIRECT_PARSED,   // Child `i` of such a node is parsed.
+    AST_NODE_LEFT_RECURSION,  // Parse the rest of `rule` (the left-recursive one) after the node parsed so far, if the next token allows it.
+    AST_NODE_END,             // The node is parsed.
+} ASTNodeStep;
+
+// A call of `parse_ast_node`.
+typedef struct _ASTNodeFrame {
+    ASTFrame frame;
+    ASTNode *a;                               // The ASTNode to convert the node into, its type is the type the node is converted with.
+    ASTParsedNode *node;                      // Set to what the parent needs to know about the node.
+    ParseToken type;                          // The node being parsed, then the last child of each rule converted into the node (a list, by right recursion), which is parsed by the same frame so that lists do not use the stack.
+    bool nested;                              // Whether `type` is such a last child.
+    bool recovered;                           // Whether one of those levels recovered from an error in it.
+    bool left_recursion;                      // Whether `rule` is the left-recursive rule repeated on the node parsed so far.
+    bool converting;                          // Whether the children are still converted into `a` (not used for AST_FROM_PROMOTION).
+    bool leave_last;                          // Whether a last child converted into the node is left to the next `AST_NODE_BEGIN`.
+    ASTNodeType ast_type;                     // The type of `a` when the rule was chosen.
+    const ProductionRule *rule;               // The rule whose children are parsed.
+    const ProductionRule *left_recursive_rule;
+    size_t count;                             // Number of children of `rule`.
+    size_t i;                                 // The child being parsed.
+    ASTNode child;                            // The child being parsed, if it is pushed as an item of `a` once parsed.
+    ASTParsedNode parsed;                     // What parsing that child gave.
+    ASTNode before;                           // `a` before the first child of the recovery rule, restored if it fails.
+    ArenaMark children_mark;                  // Position of `ASTParser.stack` before `children`.
+    ASTNode *children;                        // The children of a node converted with AST_FROM_PROMOTION: its promotion is only known once they are all parsed, so they are converted on their own and moved into the node afterwards.
+    ASTParsedNode *children_parsed;           // What parsing each of them gave.
+} ASTNodeFrame;
+
+typedef enum _ASTExpressionStep {
+    AST_EXPRESSION_BEGIN,
+    AST_EXPRESSION_CLIMBED,  // The expression was parsed by precedence climbing.
+    AST_EXPRESSION_REPARSED, // The expression was parsed again by following the grammar.
+} ASTExpressionStep;
+
+// A call of `parse_ast_expression`, with the state of the parse before the expression to parse it again from.
+typedef struct _ASTExpressionFrame {
+    ASTFrame frame;
+    ASTNode *a;
+    ASTParsedNode *node;
+    bool outermost;
+    ParseToken expression;
+    size_t index;
+    ArenaMark mark;
+    SyntaxErrors errors;
+} ASTExpressionFrame;
+
+typedef enum _ASTClimbingStep {
+    AST_CLIMBING_BEGIN,
+    AST_CLIMBING_OPERAND, // The operand of a prefix operator or the right operand of a binary one is parsed.
+    AST_CLIMBING_PRIMARY, // The operand without a prefix operator is parsed.
+} ASTClimbingStep;
+
+// A call of `parse_ast_climbing`.
+typedef struct _ASTClimbingFrame {
+    ASTFrame frame;
+    ASTNode *a;
+    uint8_t min_level;
+    ASTParsedNode node; // What parsing the primary gave.
+} ASTClimbingFrame;
+
+/**
+ * Push a frame of `size` bytes onto the stack of `parser`, it is the one run next.
+ * @return The frame, only its `ASTFrame` is set.
+ */
+static void *parse_ast_push(ASTParser *const parser, const size_t size, const ASTFrameKind kind, const uint8_t step) {
+    const ArenaMark mark = arena_mark(&parser->stack);
+    ASTFrame *const frame = arena_alloc(&parser->stack, size);
+    *frame = (ASTFrame){.caller = parser->top, .mark = mark, .kind = kind, .step = step};
+    parser->top = frame;
+    return frame;
+}
+
+// Pop the frame on top of the stack of `parser`, its caller goes on.
+static void parse_ast_return(ASTParser *const parser) {
+    ASTFrame *const frame = parser->top;
+    parser->top = frame->caller;
+    arena_reset(&parser->stack, frame->mark);
+}
+
+// Match the terminal `type` at the next token into `a`, like the `AST_NODE_BEGIN` of `parse_ast_node`.
+static void parse_ast_terminal(ASTParser *const parser, ASTNode *const a, ASTParsedNode *const node, const ParseToken type) {
+    const size_t index = *parser->index;
+    if (type == (ParseToken)parser->input->types[index]) {
+        ++*parser->index;
+    } else {
+        node->error = PARSE_ERROR_WRONG_TOKEN;
+        arena_da_push(parser->arena, parser->errors, ((SyntaxError){.expected = type, .token_index = index}));
+    }
+    if (ASTNodeType_HAS_TOKEN(a->type))
+        a->token = token_stream_get(parser->input, index);
+    if (node->error || a->token.error) {
+        a->error = AST_ERROR_TOKEN_ERROR;
+        node->converted = false;
+    }
+}
+
+/**
+ * Call `parse_ast_node` (or `parse_ast_expression` for an expression parsed by precedence climbing): parse a `type` node into `a`.
+ * A terminal is matched right away instead, the caller goes on with the node parsed.
+ * @param node Set to what the parent needs to know about the node.
+ */
+static void parse_ast_call_node(ASTParser *const parser, ASTNode *const a, ASTParsedNode *const node, const ParseToken type) {
+    if (ParseToken_IS_TERMINAL(type)) {
+        *node = (ASTParsedNode){.error = PARSE_ERROR_NONE, .converted = true, .promo = {SIZE_MAX, AST_NULL, AST_ERROR_UNSPECIFIED_PRODUCTION_RULE}};
+        parse_ast_terminal(parser, a, node, type);
+        return;
+    }
+    if (type == parser->expression && type != PT_NULL && a->type == AST_FROM_PROMOTION) {
+        ASTExpressionFrame *const f = parse_ast_push(parser, sizeof(ASTExpressionFrame), AST_FRAME_EXPRESSION, AST_EXPRESSION_BEGIN);
+        f->a = a;
+        f->node = node;
+        return;
+    }
+    ASTNodeFrame *const f = parse_ast_push(parser, sizeof(ASTNodeFrame), AST_FRAME_NODE, AST_NODE_BEGIN);
+    f->a = a;
+    f->node = node;
+    f->type = type;
+    f->nested = false;
+    f->recovered = false;
+}
+
+// Call `parse_ast_climbing`, what it returns is in `parser->climbed`.
+static void parse_ast_call_climbing(ASTParser *const parser, ASTNode *const a, const uint8_t min_level) {
+    ASTClimbingFrame *const f = parse_ast_push(parser, sizeof(ASTClimbingFrame), AST_FRAME_CLIMBING, AST_CLIMBING_BEGIN);
+    f->a = a;
+    f->min_level = min_level;
+}
+
+/**
+ * Start parsing the children of the node of `f` with `f->rule` and converting the node into `f->a`.
+ * Like `initialize_children_by_rule` followed by `default_error_recovery`: parsing stops at the first child that fails, the children after it are converted as the placeholders the parse tree would have.
+ * @param first The first child if it is already parsed (the node parsed so far by a left-recursive rule), NULL otherwise.
+ * @param first_parsed What parsing `first` gave.
+ */
+static void parse_ast_begin_children(ASTNodeFrame *const f, const ASTNode *const first, const ASTParsedNode *const first_parsed, ASTParser *const parser) {
+    ASTNode *const a = f->a;
+    f->node->error = PARSE_ERROR_NONE;
+    f->i = 0;
+    if (a->type == AST_FROM_PROMOTION) {
+        f->children_mark = arena_mark(&parser->stack);
+        f->children = arena_alloc(&parser->stack, (f->count + 1) * sizeof(ASTNode));
+        f->children_parsed = arena_alloc(&parser->stack, (f->count + 1) * sizeof(ASTParsedNode));
+        if (first != NULL) {
+            f->children[0] = *first;
+            f->children_parsed[0] = *first_parsed;
+            f->i = 1;
+        }
+        f->frame.step = AST_NODE_PROMOTED_NEXT;
+        return;
+    }
+    // otherwise each child is converted into the node as soon as it is parsed, the AST_FROM_CHILDREN ones directly (so that a long list is not copied into every level of its recursion).
+    f->converting = a->type != AST_NULL && a->type != AST_SKIP;
+    f->node->converted = true;
+    if (!f->converting)
+        a->type = AST_SKIP;
+    f->frame.step = AST_NODE_DIRECT_NEXT;
+    if (first != NULL) {
+        f->before = *a;
+        f->child = *first;
+        f->parsed = *first_parsed;
+        f->frame.step = AST_NODE_DIRECT_PARSED;
+    }
+}
+
+/**
+ * Convert the node of `f`, converted with AST_FROM_PROMOTION, from its children once parsing them stopped at child `f->i`.
+ */
+static void parse_ast_end_promoted_children(ASTNodeFrame *const f, ASTParser *const parser) {
+    for (size_t i = f->i; i < f->count; ++i) {
+        f->children[i] = (ASTNode){
+            .type = ASTNode_child_type(f->rule, i, AST_FROM_PROMOTION),
+            .error = ParseToken_IS_TERMINAL(f->rule->tokens[i]) ? AST_ERROR_MISSING_TOKEN : AST_ERROR_UNSPECIFIED_PRODUCTION_RULE};
+        f->children_parsed[i] = (ASTParsedNode){.error = PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE, .converted = false, .promo = {SIZE_MAX, AST_NULL, AST_ERROR_UNSPECIFIED_PRODUCTION_RULE}};
+    }
+    f->node->converted = ASTNode_from_parsed_children(f->a, f->rule, f->count, f->children, f->children_parsed, f->node, &parser->absent, parser->arena);
+    arena_reset(&parser->stack, f->children_mark);
+}
+
+/**
+ * Finish converting the node of `f` once parsing its children stopped at child `f->i`.
+ */
+static void parse_ast_end_direct_children(ASTNodeFrame *const f, ASTParser *const parser) {
+    ASTNode *const a = f->a;
+    ASTParsedNode *const node = f->node;
+    // the first placeholder that is converted fails.
+    for (size_t i = f->i; i < f->count && f->converting; ++i) {
+        if (f->rule->ast_types[i] == AST_SKIP)
+            continue;
+        if (f->rule->ast_types[i] != AST_FROM_CHILDREN)
+            arena_da_push(parser->arena, a, ((ASTNode){.type = f->rule->ast_types[i],
+                .error = ParseToken_IS_TERMINAL(f->rule->tokens[i]) ? AST_ERROR_MISSING_TOKEN : AST_ERROR_UNSPECIFIED_PRODUCTION_RULE}));
+        a->error = AST_ERROR_CHILD_ERROR;
+        node->converted = f->converting = false;
+    }
+    if (!f->converting)
+        return;
+    if (node->error == PARSE_ERROR_CHILD_ERROR || node->error == PARSE_ERROR_RECOVERED)
+        a->error = AST_ERROR_CHILD_ERROR;
+    node->converted = a->error == AST_ERROR_NONE || node->error == PARSE_ERROR_RECOVERED;
+}
+
+/**
+ * Go on once the children of `f->rule` are parsed (or the last one is left to the next `AST_NODE_BEGIN`).
+ * @param last The token of the last child if it is left to parse into the node (everything before it succeeded), PT_NULL otherwise.
+ * @return The next step of `f`.
+ */
+static ASTNodeStep parse_ast_children_parsed(ASTNodeFrame *const f, const ParseToken last) {
+    ASTParsedNode *const node = f->node;
+    if (f->left_recursion)
+        return ParseErrorType_FAILED(node->error) ? AST_NODE_END : AST_NODE_LEFT_RECURSION;
+    f->recovered = f->recovered || node->error == PARSE_ERROR_RECOVERED;
+    if (last != PT_NULL) {
+        f->nested = true;
+        f->type = last;
+        return AST_NODE_BEGIN;
+    }
+    const ProductionRule *const left_recursive_rule = f->left_recursive_rule;
+    if (ParseErrorType_FAILED(node->error) || left_recursive_rule == NULL || left_recursive_rule->tokens[1] == PT_NULL)
+        return AST_NODE_END;
+    // the node parsed so far was converted with the type of the first child of the left-recursive rule (see `CFG_supports_direct_ast`).
+    assert(f->ast_type == AST_SKIP || f->ast_type == AST_NULL || f->ast_type == left_recursive_rule->ast_types[0]);
+    f->left_recursion = true;
+    f->rule = left_recursive_rule;
+    f->leave_last = false;
+    f->count = 0;
+    while (left_recursive_rule->tokens[f->count] != PT_NULL)
+        ++f->count;
+    return AST_NODE_LEFT_RECURSION;
+}
+
+/**
+ * Run the `parse_ast_node` frame `f` until it calls another frame or returns.
+ * Parses a node the way `parse_cfg_recursive_descent_parse_tree` does, and builds what `ASTNode_from_ParseTreeNode_impl` would convert it to into `f->a` instead of the ParseTreeNode.
+ */
+static void parse_ast_node(ASTNodeFrame *const f, ASTParser *const parser) {
+    ASTNode *const a = f->a;
+    ASTParsedNode *const node = f->node;
+    while (true) {
+        switch ((ASTNodeStep)f->frame.step) {
+            case AST_NODE_BEGIN: {
+                node->promo = (ASTPromo){SIZE_MAX, AST_NULL, AST_ERROR_UNSPECIFIED_PRODUCTION_RULE};
+                node->error = PARSE_ERROR_NONE;
+                node->converted = true;
+                f->frame.step = AST_NODE_END;
+                if (f->type == PT_NULL)
+                    break;
+                const size_t index = *parser->index;
+                const ParseToken next = (ParseToken)parser->input->types[index];
+
+                if (ParseToken_IS_TERMINAL(f->type)) {
+                    parse_ast_terminal(parser, a, node, f->type);
+                    break;
+                }
+
+                const size_t nonterminal = f->type - ParseToken_FIRST_NONTERMINAL;
+                const CFG_PredictTable *const table = parser->table;
+                const ProductionRule *const p_rule = CFG_PredictTable_rule(table, f->type, next);
+                if (p_rule == NULL) {
+                    node->error = PARSE_ERROR_NO_RULE_MATCHES;
+                    arena_da_push(parser->arena, parser->errors, ((SyntaxError){.expected = f->type, .token_index = index}));
+                    a->error = AST_ERROR_UNSPECIFIED_PRODUCTION_RULE;
+                    node->converted = false;
+                    break;
+                }
+                f->left_recursive_rule = NULL;
+                if (table->left_recursive[nonterminal] != 0 && table->left_recursive[nonterminal] - 1 < p_rule - table->grammar[nonterminal].rules)
+                    f->left_recursive_rule = table->grammar[nonterminal].rules + table->left_recursive[nonterminal] - 1;
+
+                f->ast_type = a->type;
+                f->rule = p_rule;
+                f->left_recursion = false;
+                f->leave_last = f->left_recursive_rule == NULL;
+                f->count = 0;
+                while (p_rule->tokens[f->count] != PT_NULL)
+                    ++f->count;
+                parse_ast_begin_children(f, NULL, NULL, parser);
+                break;
+            }
+            case AST_NODE_PROMOTED_NEXT:
+                if (f->i == f->count) {
+                    parse_ast_end_promoted_children(f, parser);
+                    f->frame.step = parse_ast_children_parsed(f, PT_NULL);
+                    break;
+                }
+                f->children[f->i] = (ASTNode){.type = ASTNode_child_type(f->rule, f->i, AST_FROM_PROMOTION)};
+                f->frame.step = AST_NODE_PROMOTED_PARSED;
+                parse_ast_call_node(parser, f->children + f->i, f->children_parsed + f->i, f->rule->tokens[f->i]);
+                return;
+            case AST_NODE_PROMOTED_PARSED: {
+                const size_t i = f->i++;
+                const ParseErrorType error = f->children_parsed[i].error;
+                f->frame.step = AST_NODE_PROMOTED_NEXT;
+                if (error == PARSE_ERROR_RECOVERED || (error && i == 0 && f->rule == parser->recovery_rule)) {
+                    if (error != PARSE_ERROR_RECOVERED)
+                        *parser->index = CFG_Recovery_skip(parser->table->recovery, parser->input, *parser->index);
+                    node->error = PARSE_ERROR_RECOVERED;
+                } else if (error) {
+                    node->error = PARSE_ERROR_CHILD_ERROR;
+                    parse_ast_end_promoted_children(f, parser);
+                    f->frame.step = parse_ast_children_parsed(f, PT_NULL);
+                }
+                break;
+            }
+            case AST_NODE_DIRECT_NEXT: {
+                if (f->i == f->count) {
+                    parse_ast_end_direct_children(f, parser);
+                    f->frame.step = parse_ast_children_parsed(f, PT_NULL);
+                    break;
+                }
+                const size_t i = f->i;
+                const ASTNodeType ast_type = f->rule->ast_types[i];
+                // what the item was converted to is left out of the AST if it fails.
+                if (i == 0 && f->rule == parser->recovery_rule)
+                    f->before = *a;
+                if (f->converting && ast_type == AST_FROM_CHILDREN && f->leave_last && i + 1 == f->count) {
+                    f->frame.step = parse_ast_children_parsed(f, f->rule->tokens[i]);
+                    break;
+                }
+                f->frame.step = AST_NODE_DIRECT_PARSED;
+                if (f->converting && ast_type == AST_FROM_CHILDREN) {
+                    parse_ast_call_node(parser, a, &f->parsed, f->rule->tokens[i]);
+                } else {
+                    f->child = (ASTNode){.type = f->converting ? ASTNode_child_type(f->rule, i, f->ast_type) : AST_SKIP};
+                    parse_ast_call_node(parser, &f->child, &f->parsed, f->rule->tokens[i]);
+                }
+                return;
+            }
+            case AST_NODE_DIRECT_PARSED: {
+                const size_t i = f->i++;
+                const ASTNodeType ast_type = f->rule->ast_types[i];
+                const ASTParsedNode parsed = f->parsed;
+                f->frame.step = AST_NODE_DIRECT_NEXT;
+                if (i == 0 && f->rule == parser->recovery_rule && ParseErrorType_FAILED(parsed.error)) {
+                    *a = f->before;
+                    *parser->index = CFG_Recovery_skip(parser->table->recovery, parser->input, *parser->index);
+                    node->error = PARSE_ERROR_RECOVERED;
+                    break;
+                }
+                if (f->converting && ast_type != AST_SKIP) {
+                    if (ast_type != AST_FROM_CHILDREN)
+                        arena_da_push(parser->arena, a, f->child);
+                    if (!parsed.converted) {
+                        a->error = AST_ERROR_CHILD_ERROR;
+                        node->converted = f->converting = false;
+                    } else if (ast_type != AST_FROM_CHILDREN && (f->child.type == AST_SKIP || a->type == AST_NULL)) {
+                        --(a->count);
+                    }
+                }
+                if (parsed.error == PARSE_ERROR_RECOVERED) {
+                    node->error = PARSE_ERROR_RECOVERED;
+                } else if (parsed.error) {
+                    node->error = PARSE_ERROR_CHILD_ERROR;
+                    parse_ast_end_direct_children(f, parser);
+                    f->frame.step = parse_ast_children_parsed(f, PT_NULL);
+                }
+                break;
+            }
+            case AST_NODE_LEFT_RECURSION: {
+                // the node parsed so far becomes the first child each time, until the rule cannot be parsed anymore.
+                if (!CFG_PredictTable_can_start_with(parser->table, f->rule->tokens[1], (ParseToken)parser->input->types[*parser->index])) {
+                    f->frame.step = AST_NODE_END;
+                    break;
+                }
+                const ASTNode first = *a;
+                const ASTParsedNode first_parsed = *node;
+                *a = (ASTNode){.type = f->ast_type};
+                parse_ast_begin_children(f, &first, &first_parsed, parser);
+                break;
+            }
+            case AST_NODE_END:
+                // what each enclosing node of the list does with the result of its last child (the same for every level).
+                if (f->nested) {
+                    node->error = ParseErrorType_FAILED(node->error) ? PARSE_ERROR_CHILD_ERROR : f->recovered ? PARSE_ERROR_RECOVERED : PARSE_ERROR_NONE;
+                    if (!node->converted || node->error == PARSE_ERROR_CHILD_ERROR) {
+                        a->error = AST_ERROR_CHILD_ERROR;
+                        node->converted = false;
+                    } else if (node->error == PARSE_ERROR_RECOVERED) {
+                        a->error = AST_ERROR_CHILD_ERROR;
+                    }
+                }
+                parse_ast_return(parser);
+                return;
+        }
+    }
+}
+
+// Return `climbed` from the `parse_ast_climbing` frame on top of the stack.
+static void parse_ast_climbed(ASTParser *const parser, const bool climbed) {
+    parser->climbed = climbed;
+    parse_ast_return(parser);
+}
+
+/**
+ * Run the `parse_ast_climbing` frame `f` until it calls another frame or returns.
+ * Parses the expression at the next token into `f->a` by precedence climbing: each operand is parsed once and only the operators that bind at least as tightly as `f->min_level` are taken,
+ * instead of going through a node for every level of the grammar. Builds the same AST as the grammar would in AST_FROM_PROMOTION (see `CFG_PrecedenceTable_init`).
+ * Returns false if the expression has a syntax or token error, what was parsed is then left to the caller to throw away.
+ */
+static void parse_ast_climbing(ASTClimbingFrame *const f, ASTParser *const parser) {
+    const CFG_PrecedenceTable *const precedence = parser->precedence;
+    const TokenStream *const input = parser->input;
+    ASTNode *const a = f->a;
+    switch ((ASTClimbingStep)f->frame.step) {
+        case AST_CLIMBING_BEGIN: {
+            const ParseToken next = (ParseToken)input->types[*parser->index];
+            const uint8_t level = precedence->prefix[next];
+            if (level >= f->min_level) {
+                if (input->errors[(*parser->index)++]) {
+                    parse_ast_climbed(parser, false);
+                    return;
+                }
+                ASTNode *const operand = arena_alloc(parser->arena, sizeof(ASTNode));
+                *a = (ASTNode){.type = precedence->prefix_type[next], .count = 1, .capacity = 1, .items = operand};
+                f->frame.step = AST_CLIMBING_OPERAND;
+                parse_ast_call_climbing(parser, operand, level);
+                return;
+            }
+            *a = (ASTNode){.type = AST_FROM_PROMOTION};
+            f->frame.step = AST_CLIMBING_PRIMARY;
+            parse_ast_call_node(parser, a, &f->node, precedence->primary);
+            return;
+        }
+        case AST_CLIMBING_PRIMARY:
+            if (f->node.error || !f->node.converted) {
+                parse_ast_climbed(parser, false);
+                return;
+            }
+            break;
+        case AST_CLIMBING_OPERAND:
+            if (!parser->climbed) {
+                parse_ast_climbed(parser, false);
+                return;
+            }
+            break;
+    }
+    // the next binary operator, with its right operand.
+    const ParseToken next = (ParseToken)input->types[*parser->index];
+    const uint8_t level = precedence->binary[next];
+    if (level < f->min_level) {
+        parse_ast_climbed(parser, true);
+        return;
+    }
+    if (input->errors[(*parser->index)++]) {
+        parse_ast_climbed(parser, false);
+        return;
+    }
+    ASTNode *const operands = arena_alloc(parser->arena, 2 * sizeof(ASTNode));
+    operands[0] = *a;
+    *a = (ASTNode){.type = precedence->binary_type[next], .count = 2, .capacity = 2, .items = operands};
+    f->frame.step = AST_CLIMBING_OPERAND;
+    parse_ast_call_climbing(parser, operands + 1, precedence->right_associative[level] ? level : level + 1);
+}
+
+/**
+ * Run the `parse_ast_expression` frame `f` until it calls another frame or returns.
+ * Parses a `parser->expression` node converted with AST_FROM_PROMOTION by precedence climbing.
+ * An expression with an error is parsed again by following the grammar (with everything it allocated and reported thrown away), so that its AST and syntax errors are the grammar's.
+ * Only the outermost expression is parsed again, an error in a nested one (in parentheses) fails all the enclosing ones.
+ */
+static void parse_ast_expression(ASTExpressionFrame *const f, ASTParser *const parser) {
+    switch ((ASTExpressionStep)f->frame.step) {
+        case AST_EXPRESSION_BEGIN:
+            f->outermost = !parser->climbing;
+            f->index = *parser->index;
+            f->mark = arena_mark(parser->arena);
+            f->errors = *parser->errors;
+            parser->climbing = true;
+            f->frame.step = AST_EXPRESSION_CLIMBED;
+            parse_ast_call_climbing(parser, f->a, 1);
+            return;
+        case AST_EXPRESSION_CLIMBED:
+            parser->climbing = !f->outermost;
+            if (parser->climbed) {
+                *f->node = (ASTParsedNode){.error = PARSE_ERROR_NONE, .converted = true, .promo = {0, f->a->type, AST_ERROR_NONE}};
+                break;
+            }
+            if (!f->outermost) {
+                *f->node = (ASTParsedNode){.error = PARSE_ERROR_CHILD_ERROR, .converted = false, .promo = {SIZE_MAX, AST_NULL, AST_ERROR_UNSPECIFIED_PRODUCTION_RULE}};
+                f->a->error = AST_ERROR_CHILD_ERROR;
+                break;
+            }
+            arena_reset(parser->arena, f->mark);
+            *parser->errors = f->errors;
+            *parser->index = f->index;
+            f->expression = parser->expression;
+            parser->expression = PT_NULL;
+            *f->a = (ASTNode){.type = AST_FROM_PROMOTION};
+            f->frame.step = AST_EXPRESSION_REPARSED;
+            parse_ast_call_node(parser, f->a, f->node, f->expression);
+            return;
+        case AST_EXPRESSION_REPARSED:
+            parser->expression = f->expression;
+            break;
+    }
+    parse_ast_return(parser);
+}
+
+bool parse_cfg_recursive_descent_ast(ASTNode *const ast_node, const ParseToken type, size_t *const index, const TokenStream *const input, const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence, Arena *const arena, SyntaxErrors *const errors) {
+    assert(ast_node != NULL);
+    assert(index != NULL);
+    assert(input != NULL);
+    assert(table != NULL);
+    assert(arena != NULL);
+    assert(errors != NULL);
+    memset(&(ast_node->error), 0, sizeof(ASTNode) - sizeof(ASTNodeType));
+    ASTParser parser = {.index = index, .input = input, .table = table, .arena = arena, .errors = errors,
+        .precedence = precedence, .expression = precedence == NULL ? PT_NULL : precedence->expression,
+        .recovery_rule = table->recovery == NULL ? NULL : table->grammar[table->recovery->list - ParseToken_FIRST_NONTERMINAL].rules};
+    arena_init(&parser.stack, 0);
+    da_init(&parser.absent);
+    ASTParsedNode node;
+    parse_ast_call_node(&parser, ast_node, &node, type);
+    while (parser.top != NULL) {
+        switch (parser.top->kind) {
+            case AST_FRAME_NODE:
+                parse_ast_node((ASTNodeFrame *)parser.top, &parser);
+                break;
+            case AST_FRAME_EXPRESSION:
+                parse_ast_expression((ASTExpressionFrame *)parser.top, &parser);
+                break;
+            case AST_FRAME_CLIMBING:
+                parse_ast_climbing((ASTClimbingFrame *)parser.top, &parser);
+                break;
+        }
+    }
+    arena_free(&parser.stack);
+    da_clear(&parser.absent);
+    return node.error == PARSE_ERROR_NONE;
+}
+
+bool CFG_supports_direct_ast(const CFG_GrammarRule grammar[ParseToken_COUNT_NONTERMINAL]) {
+    for (size_t n = 0; n < ParseToken_COUNT_NONTERMINAL; ++n) {
+        for (const ProductionRule *rule = grammar[n].rules; rule != grammar[n].rules + grammar[n].num_rules; ++rule) {
+            size_t count = 0;
+            bool from_children = false;
+            for (; rule->tokens[count] != PT_NULL; ++count) {
+                from_children |= rule->ast_types[count] == AST_FROM_CHILDREN;
+                // a node is converted with the type of its occurrence before it is known whether it is the first child of a left-recursive rule.
+                const ParseToken t = rule->tokens[count];
+                if (ParseToken_IS_TERMINAL(t) || rule->ast_types[count] == AST_SKIP || (count == 0 && t == grammar[n].lhs))
+                    continue;
+                const CFG_GrammarRule *const g = grammar + (t - ParseToken_FIRST_NONTERMINAL);
+                const size_t left_recursive = find_direct_left_recursive(g);
+                if (left_recursive != (size_t)-1 && g->rules[left_recursive].ast_types[0] != rule->ast_types[count])
+                    return false;
+            }
+            // the type of the children converted into the node would depend on its promotion.
+            if (from_children && rule->promote_index < count)
+                return false;
+        }
+    }
+    return true;
+}
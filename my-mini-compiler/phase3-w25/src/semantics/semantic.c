@@ -9,7 +9,9 @@ void ProcessScopeChild(ASTNode *ctx, Array *symbol_table, FILE *stream);
 ASTNodeType ProcessExpression(ASTNode *ctx, Array *symbol_table, FILE *stream);
 void ProcessDeclaration(ASTNode *ctx, Array *symbol_table, FILE *stream);
 ASTNodeType ProcessOperation(ASTNode *ctx, Array *symbol_table, FILE *stream);
-Array* ProcessProgram(ASTNode *head, Array *symbol_table, FILE *stream);
+void EnterScope(ASTNode *ctx, FILE *stream);
+bool BeginOperation(ASTNode *ctx, FILE *stream, ASTNodeType *type);
+Array* ProcessProgram(ASTNode *head, const char *input, Array *symbol_table, FILE *stream, Arena *arena);
 // Scope tracking functions
 void InitializeScopeStack();
 char *GetCurrentScope();
@@ -26,57 +28,95 @@ void CleanupScopeStack();
 // Global scope stack
 static Array* scopeStack = NULL;
 static int* scopeCounters = NULL;  // Array of levels to keep track of highest scope at each level
-static int maxStackSize = 50;      // Maximum nesting level
+static size_t scopeCountersSize = 0; // Number of levels in scopeCounters, it grows with the nesting so the nesting is only limited by memory
+
+/**
+ * The tree is walked with explicit stacks instead of recursion, so that the depth of the scopes and of the expressions is only limited by memory.
+ */
+
+// What is left to analyze in the enclosing statements, popped from the end of `taskStack`.
+typedef enum _SemanticTaskType {
+    TASK_STATEMENT,        // a statement of a scope
+    TASK_SCOPE,            // the scope of a conditional or of a loop
+    TASK_LEAVE_SCOPE,      // the end of the scope at `level`, once all its statements are analyzed
+    TASK_REPEAT_CONDITION, // the condition of a repeat-until loop, analyzed after its scope
+} SemanticTaskType;
+
+typedef struct _SemanticTask {
+    SemanticTaskType type;
+    ASTNode *ctx;
+    size_t level;
+} SemanticTask;
+
+static Array* taskStack = NULL;
+
+// An operation whose operands are being analyzed, see `AnalyzeExpression`.
+typedef struct _OperationFrame {
+    ASTNode *ctx;
+    size_t next;     // Index of the operand being analyzed
+    ASTNodeType lhs; // Type of the first operand, once it is analyzed
+} OperationFrame;
+
+static Array* operationStack = NULL;
 
 static Array* semanticErrors = NULL;
 
+// Arena of the compilation, the scope strings and the list of errors are allocated in it.
+static Arena* semanticArena = NULL;
+
+// Input the tokens of the tree being analyzed were lexed from, their lexemes are slices of it.
+static const char* sourceText = NULL;
+
 // Initialize the scope tracking system
 void InitializeScopeStack() {
-    scopeStack = array_new(10, sizeof(int*));  // Initial capacity of 10
-    
-    scopeCounters = (int*)malloc(maxStackSize * sizeof(int));
-    if (!scopeCounters) {
-        fprintf(stderr, "Failed to allocate memory for scope counters\n");
-        exit(1);
-    }
-    
-    // Initialize all counters to 0
-    for (int i = 0; i < maxStackSize; i++) {
-        scopeCounters[i] = 0;
+    scopeStack = array_new(10, sizeof(int));  // Initial capacity of 10
+    scopeCounters = NULL;
+    scopeCountersSize = 0;
+}
+
+// Counter of the scopes at nesting `level`, the counters grow (initialized to 0) as needed.
+int *ScopeCounter(size_t level) {
+    if (level >= scopeCountersSize) {
+        size_t newSize = scopeCountersSize == 0 ? 64 : scopeCountersSize;
+        while (newSize <= level)
+            newSize *= 2;
+        int *counters = (int*)realloc(scopeCounters, newSize * sizeof(int));
+        if (!counters) {
+            fprintf(stderr, "Failed to allocate memory for scope counters\n");
+            exit(1);
+        }
+        for (size_t i = scopeCountersSize; i < newSize; i++) {
+            counters[i] = 0;
+        }
+        scopeCounters = counters;
+        scopeCountersSize = newSize;
     }
+    return &scopeCounters[level];
 }
 
 void IntializeErrors() {
-    semanticErrors = array_new(10, sizeof(ASTNode*));
+    semanticErrors = array_new_in_arena(semanticArena, 10, sizeof(ASTNode));
 }
 
-// Get the current scope as a string
+// Get the current scope as a string, allocated in the arena (use arena_mark/arena_reset around temporary scope strings).
 char* GetCurrentScope() {
     int stackSize = array_size(scopeStack);
     if (stackSize == 0) {
-        return strdup("0"); // root scope
+        return arena_strndup(semanticArena, "0", 1); // root scope
     }
     
     // Calculate the required buffer size
     // Each scope level needs at most 10 chars for the number, plus '.' separator
-    char* scopeStr = (char*)malloc((stackSize * 11) * sizeof(char));
-    if (!scopeStr) {
-        fprintf(stderr, "Failed to allocate memory for scope string\n");
-        exit(1);
-    }
+    char* scopeStr = (char*)arena_alloc_aligned(semanticArena, (stackSize * 12) * sizeof(char), 1);
     
     scopeStr[0] = '\0';
+    // written at the end of the string so far, so deep scopes do not cost a pass over the string per level
+    size_t length = 0;
     for (int i = 0; i < stackSize; i++) {
         int* level = (int*)array_get(scopeStack, i);
         
         // First number doesn't need a dot
-        if (i == 0) {
-            sprintf(scopeStr, "%d", *level);
-        } else {
-            char temp[12];
-            sprintf(temp, ".%d", *level);
-            strcat(scopeStr, temp);
-        }
+        length += sprintf(scopeStr + length, i == 0 ? "%d" : ".%d", *level);
     }
     
     return scopeStr;
@@ -140,6 +180,7 @@ void CleanupScopeStack() {
     if (scopeCounters) {
         free(scopeCounters);
         scopeCounters = NULL;
+        scopeCountersSize = 0;
     }
 }
 
@@ -147,9 +188,13 @@ bool isNumeric(ASTNodeType type) {
     return type == AST_INTEGER || type == AST_FLOAT;
 }
 
-ASTNodeType ProcessExpression(ASTNode *ctx, Array *symbol_table, FILE *stream) {
+/**
+ * Analyze a leaf of an expression, or start analyzing an operation (see `BeginOperation`).
+ * @param type Set to the type of the expression if it is a leaf.
+ * @return true if an operation was pushed onto `operationStack`, its type is known once its operands are analyzed.
+ */
+bool BeginExpression(ASTNode *ctx, Array *symbol_table, FILE *stream, ASTNodeType *type) {
     if (ctx->type == AST_EXPRESSION) ctx = &CHILD_ITEM(ctx, 0);
-    ASTNodeType typeOP;
 
     switch (ctx->type) {
         case AST_ASSIGN_EQUAL:
@@ -175,38 +220,49 @@ ASTNodeType ProcessExpression(ASTNode *ctx, Array *symbol_table, FILE *stream) {
         case AST_LOGICAL_NOT:
         case AST_NEGATE:
         case AST_FACTORIAL:
-            typeOP = ProcessOperation(ctx, symbol_table, stream);
-            return typeOP;
+            return BeginOperation(ctx, stream, type);
             break;
         case AST_INTEGER:
         case AST_FLOAT:
         case AST_STRING:
-            if (stream) fprintf(stream, "Literal Analyzing -> %s | %s\n", ASTNodeType_to_string(ctx->type), ctx->token.lexeme);
-            return ctx->type;
+            if (stream) fprintf(stream, "Literal Analyzing -> %s | %.*s\n", ASTNodeType_to_string(ctx->type), (int)ctx->token.length, Token_lexeme(&ctx->token, sourceText));
+            *type = ctx->type;
+            return false;
             break;
         case AST_IDENTIFIER:
-            if (stream) fprintf(stream, "Identifier Analyzing -> %s | %s\n", 
-                ASTNodeType_to_string(ctx->type), ctx->token.lexeme);
+            if (stream) fprintf(stream, "Identifier Analyzing -> %s | %.*s\n", 
+                ASTNodeType_to_string(ctx->type), (int)ctx->token.length, Token_lexeme(&ctx->token, sourceText));
+            // the scope string is only needed for the lookup.
+            const ArenaMark mark = arena_mark(semanticArena);
             char *scope = GetCurrentScope();
-            for(size_t item = 0; item < array_size(symbol_table); item++){
+            const symEntry *declaration = NULL;
+            for(size_t item = 0; item < array_size(symbol_table) && declaration == NULL; item++){
                 symEntry *entry = (symEntry *)array_get(symbol_table, item);
-                if (strcmp(entry->symNode->token.lexeme, ctx->token.lexeme) == 0){
+                if (entry->symNode->token.id == ctx->token.id){
                     if (AssignmentExists(scope, entry->scope)){
-                        return entry->type;
+                        declaration = entry;
                     }
                 }
             }
+            arena_reset(semanticArena, mark);
+            if (declaration != NULL) {
+                *type = declaration->type;
+                return false;
+            }
             fprintf(stderr, "Error Reported -> Non-Declared Variable\n");
             ctx->error = AST_ERROR_UNDECLARED_VAR;
             array_push(semanticErrors, (Element *)ctx);
-            return AST_NULL;
+            *type = AST_NULL;
+            return false;
             break;
         default:
             fprintf(stderr, "Error Reported -> Invalid expression node type\n");
-            return AST_NULL;
+            *type = AST_NULL;
+            return false;
             break;
     }
-    return AST_NULL;
+    *type = AST_NULL;
+    return false;
 }
 
 void ProcessDeclaration(ASTNode *ctx, Array *symbol_table, FILE *stream) {
@@ -230,14 +286,14 @@ void ProcessDeclaration(ASTNode *ctx, Array *symbol_table, FILE *stream) {
         other = (symEntry *)array_get(symbol_table, i);
         
         // check if names match
-        if (strcmp(other->symNode->token.lexeme, identifierNode->token.lexeme) == 0) {
+        if (other->symNode->token.id == identifierNode->token.id) {
             // check scopes
             if (ScopesConflict(currentScope, other->scope)) {
                 redeclared = true;
                 identifierNode->error = AST_ERROR_REDECLARATION_VAR;
                 array_push(semanticErrors, (Element *)identifierNode);
-                fprintf(stderr, "Error: Variable '%s' redeclared in conflicting scope.\n", 
-                       identifierNode->token.lexeme);
+                fprintf(stderr, "Error: Variable '%.*s' redeclared in conflicting scope.\n", 
+                       (int)identifierNode->token.length, Token_lexeme(&identifierNode->token, sourceText));
                 break;
             }
         }
@@ -246,31 +302,23 @@ void ProcessDeclaration(ASTNode *ctx, Array *symbol_table, FILE *stream) {
     // if no redeclaration issue, add to symbol table
     if (!redeclared && ctx->error == AST_ERROR_NONE) {
         symEntry entry;
-        entry.scope = currentScope;  // Transfer ownership of the string
+        entry.scope = currentScope;  // Allocated in the arena, like the symbol table
         entry.symNode = &CHILD_ITEM(ctx, 1);
         entry.type = CHILD_TYPE(ctx, 0);
         array_push(symbol_table, (Element *)&entry);
-        if (stream) fprintf(stream, "Added '%s' to symbol table in scope '%s'\n", 
-               entry.symNode->token.lexeme, entry.scope);
-    } else {
-        // Free currentScope if we don't store it
-        free(currentScope);
+        if (stream) fprintf(stream, "Added '%.*s' to symbol table in scope '%s'\n", 
+               (int)entry.symNode->token.length, Token_lexeme(&entry.symNode->token, sourceText), entry.scope);
     }
 }
 
-ASTNodeType ProcessOperator(ASTNode *ctx, Array *symbol_table, FILE *stream){
-    assert(ctx->count == 2); // Binary operator
-    if (stream) fprintf(stream, "Operator Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
-    ASTNodeType LHS = ProcessExpression(&CHILD_ITEM(ctx, 0), symbol_table, stream);
-    ASTNodeType RHS = ProcessExpression(&CHILD_ITEM(ctx, 1), symbol_table, stream);
-
+ASTNodeType FinishOperator(ASTNode *ctx, ASTNodeType LHS, ASTNodeType RHS){
     if (LHS >= AST_INT_TYPE && LHS < AST_SKIP) LHS = VarToLiteral(LHS);
     if (RHS >= AST_INT_TYPE && RHS < AST_SKIP) RHS = VarToLiteral(RHS);
 
-    // Check for division/modulo by zero if RHS is a literal 0
+    // Check for division/modulo by zero if RHS is a literal 0 (the lexer parsed its value, so 00 and 0.0 are caught too)
     if ((ctx->type == AST_DIVIDE || ctx->type == AST_MODULO) &&
-        (CHILD_TYPE(ctx, 1) == AST_INTEGER || CHILD_TYPE(ctx, 1) == AST_FLOAT) &&
-        strcmp(CHILD_ITEM(ctx, 1).token.lexeme, "0") == 0) {
+        ((CHILD_TYPE(ctx, 1) == AST_INTEGER && CHILD_ITEM(ctx, 1).token.value.integer == 0) ||
+         (CHILD_TYPE(ctx, 1) == AST_FLOAT && CHILD_ITEM(ctx, 1).token.value.real == 0.0))) {
 
         ctx->error = AST_ERROR_DIVISION_BY_ZERO;
         array_push(semanticErrors, (Element *)ctx);
@@ -292,25 +340,31 @@ ASTNodeType ProcessOperator(ASTNode *ctx, Array *symbol_table, FILE *stream){
     return AST_NULL;
 }
 
-ASTNodeType ProcessUnaryOperator(ASTNode *ctx, Array *symbol_table, FILE *stream){
-    assert(ctx->count == 1);
-    ASTNodeType type;
-    if (stream) fprintf(stream, "Operator Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
-    type = ProcessExpression(&CHILD_ITEM(ctx, 0), symbol_table, stream);
-    
+ASTNodeType FinishUnaryOperator(ASTNodeType type){
     if (type >= AST_INT_TYPE && type < AST_SKIP) type = VarToLiteral(type);
 
     return type;
 }
 
-void ProcessIO(ASTNode *ctx, Array *symbol_table, FILE *stream){
-    if (stream) fprintf(stream, "IO (print/read) Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
-    assert(ctx->count == 1);
-    ProcessExpression(ctx->items, symbol_table, stream);
+ASTNodeType FinishAssignment(ASTNode *ctx, ASTNodeType LHS, ASTNodeType RHS){
+    LHS = VarToLiteral(LHS);
+    if (RHS >= AST_INT_TYPE && RHS < AST_SKIP) RHS = VarToLiteral(RHS);
+
+    if (LHS != RHS && (LHS == AST_NULL || RHS == AST_NULL)) {
+        ctx->error = AST_ERROR_UNDEFINED_ASSIGNMENT;
+        array_push(semanticErrors, (Element *)ctx);
+        printf("Error Reported -> Undefined Assignment\n");
+    }else if(LHS != RHS){
+        ctx->error = AST_ERROR_INCOMPATIBLE_TYPES;
+        array_push(semanticErrors, (Element *)ctx);
+        printf("Error Reported -> Incompatible Types upon Assignment\n");
+    }
+    return AST_NULL;
 }
 
-// Handles Assignment, Operator, Unary Operator
-ASTNodeType ProcessOperation(ASTNode *ctx, Array *symbol_table, FILE *stream){
+// Handles Assignment, Operator, Unary Operator: checks what can be checked before the operands, then pushes the operation so that its operands are analyzed.
+// Returns false (with `type` set) if there is nothing to analyze.
+bool BeginOperation(ASTNode *ctx, FILE *stream, ASTNodeType *type){
     if (ctx->type == AST_ASSIGN_EQUAL) {
         if (stream) fprintf(stream, "Assignment Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
         assert(ctx->count == 2);
@@ -321,68 +375,114 @@ ASTNodeType ProcessOperation(ASTNode *ctx, Array *symbol_table, FILE *stream){
         if (!(CHILD_TYPE(ctx, 0) == AST_IDENTIFIER)) { 
             ctx->error = AST_ERROR_EXPECTED_IDENTIFIER;
             array_push(semanticErrors, (Element *)ctx);
-            return AST_NULL; 
+            *type = AST_NULL;
+            return false; 
         }
         if ((CHILD_TYPE(ctx, 1) == AST_ASSIGN_EQUAL)) { 
             ctx->error = AST_ERROR_EXPECTED_ASSIGNMENT;
             array_push(semanticErrors, (Element *)ctx);
-            return AST_NULL; 
+            *type = AST_NULL;
+            return false; 
         }
-        ASTNodeType LHS = VarToLiteral(ProcessExpression(&CHILD_ITEM(ctx, 0), symbol_table, stream));
-        ASTNodeType RHS = ProcessExpression(&CHILD_ITEM(ctx, 1), symbol_table, stream);
+    } else if (ctx->type >= AST_LOGICAL_OR && ctx->type < AST_BITWISE_NOT) {
+        assert(ctx->count == 2); // Binary operator
+        if (stream) fprintf(stream, "Operator Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
+    } else if (ctx->type >= AST_BITWISE_NOT) {
+        assert(ctx->count == 1);
+        if (stream) fprintf(stream, "Operator Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
+    } else {
+        *type = AST_NULL;
+        return false;
+    }
+    OperationFrame frame = {.ctx = ctx, .next = 0, .lhs = AST_NULL};
+    array_push(operationStack, (Element *)&frame);
+    return true;
+}
 
-        if (RHS >= AST_INT_TYPE && RHS < AST_SKIP) RHS = VarToLiteral(RHS);
+// Get the type of an operation from the types of its operands.
+ASTNodeType FinishOperation(ASTNode *ctx, ASTNodeType LHS, ASTNodeType RHS){
+    if (ctx->type == AST_ASSIGN_EQUAL) return FinishAssignment(ctx, LHS, RHS);
+    if (ctx->type < AST_BITWISE_NOT) return FinishOperator(ctx, LHS, RHS);
+    return FinishUnaryOperator(LHS);
+}
 
-        if (LHS != RHS && (LHS == AST_NULL || RHS == AST_NULL)) {
-            ctx->error = AST_ERROR_UNDEFINED_ASSIGNMENT;
-            array_push(semanticErrors, (Element *)ctx);
-            printf("Error Reported -> Undefined Assignment\n");
-        }else if(LHS != RHS){
-            ctx->error = AST_ERROR_INCOMPATIBLE_TYPES;
-            array_push(semanticErrors, (Element *)ctx);
-            printf("Error Reported -> Incompatible Types upon Assignment\n");
+/**
+ * Analyze the expression `ctx` (or the operation, which is not unwrapped from an AST_EXPRESSION and is AST_NULL if it is not one, see `ProcessOperation`).
+ * The operations whose operands are being analyzed are kept on `operationStack` instead of the call stack.
+ * @return The type of the expression.
+ */
+ASTNodeType AnalyzeExpression(ASTNode *ctx, bool operation, Array *symbol_table, FILE *stream) {
+    ASTNodeType type;
+    if (!(operation ? BeginOperation(ctx, stream, &type) : BeginExpression(ctx, symbol_table, stream, &type)))
+        return type;
+    while (array_size(operationStack) > 0) {
+        OperationFrame *top = (OperationFrame *)array_get(operationStack, array_size(operationStack) - 1);
+        // `type` is the type of the operand before `next`.
+        if (top->next == 1) top->lhs = type;
+        if (top->next == top->ctx->count) {
+            const OperationFrame done = *top;
+            array_pop(operationStack);
+            type = FinishOperation(done.ctx, done.lhs, type);
+            continue;
         }
-    } else if (ctx->type >= AST_LOGICAL_OR && ctx->type < AST_BITWISE_NOT) {
-        ASTNodeType typeEval = ProcessOperator(ctx, symbol_table, stream);
-        return typeEval;
-    } else if (ctx->type >= AST_BITWISE_NOT) {
-        ASTNodeType typeEval = ProcessUnaryOperator(ctx, symbol_table, stream);
-        return typeEval;
+        ASTNode *operand = &CHILD_ITEM(top->ctx, top->next++);
+        BeginExpression(operand, symbol_table, stream, &type);
     }
+    return type;
+}
 
-    return AST_NULL;
+ASTNodeType ProcessExpression(ASTNode *ctx, Array *symbol_table, FILE *stream) {
+    return AnalyzeExpression(ctx, false, symbol_table, stream);
+}
+
+ASTNodeType ProcessOperation(ASTNode *ctx, Array *symbol_table, FILE *stream) {
+    return AnalyzeExpression(ctx, true, symbol_table, stream);
+}
+
+void ProcessIO(ASTNode *ctx, Array *symbol_table, FILE *stream){
+    if (stream) fprintf(stream, "IO (print/read) Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
+    assert(ctx->count == 1);
+    ProcessExpression(ctx->items, symbol_table, stream);
+}
+
+void PushTask(SemanticTaskType type, ASTNode *ctx, size_t level) {
+    SemanticTask task = {.type = type, .ctx = ctx, .level = level};
+    array_push(taskStack, (Element *)&task);
 }
 
 int currScope;
 
-void ProcessScope(ASTNode *ctx, Array *symbol_table, FILE *stream) {
+// Enter the scope `ctx`, its statements and its end are pushed onto `taskStack`.
+void EnterScope(ASTNode *ctx, FILE *stream) {
     assert(ctx->type == AST_SCOPE);
     
-    int stackSize = array_size(scopeStack);
-    if (stackSize >= maxStackSize) {
-        fprintf(stderr, "Maximum scope nesting level exceeded\n");
-        exit(EXIT_FAILURE);
-    }
+    size_t stackSize = array_size(scopeStack);
     // Get next counter value for this level
-    int newScope = scopeCounters[stackSize]++;
+    int newScope = (*ScopeCounter(stackSize))++;
     array_push(scopeStack, (Element*)&newScope);
     // DEBUG PRINTING
-    char* currentScope = GetCurrentScope();
-    if (stream) fprintf(stream, "\nEntered new scope -> %s\n", currentScope);
-    free(currentScope);  // Free the string after using it
-    
-    for (size_t child = 0; child < ctx->count; child++) {
-        ASTNode *childNode = &ctx->items[child];
-        ProcessScopeChild(childNode, symbol_table, stream);
+    if (stream) {
+        const ArenaMark mark = arena_mark(semanticArena);
+        fprintf(stream, "\nEntered new scope -> %s\n", GetCurrentScope());
+        arena_reset(semanticArena, mark);  // Free the string after using it
     }
     
+    PushTask(TASK_LEAVE_SCOPE, ctx, stackSize);
+    // pushed last to first so that they are analyzed in order.
+    for (size_t child = ctx->count; child > 0; child--) {
+        PushTask(TASK_STATEMENT, &ctx->items[child - 1], 0);
+    }
+}
+
+// Leave the scope at nesting `level` once all its statements are analyzed.
+void LeaveScope(size_t level, FILE *stream) {
     array_pop(scopeStack);
-    scopeCounters[stackSize + 1] = 0; // Reset the next level counter
+    *ScopeCounter(level + 1) = 0; // Reset the next level counter
     // DEBUG PRINTING
-    if (array_size(scopeStack) > 0) {
-        currentScope = GetCurrentScope();
-        if (stream) fprintf(stream, "Returned to scope -> %s\n", currentScope);
-        free(currentScope);
+    if (array_size(scopeStack) > 0 && stream) {
+        const ArenaMark mark = arena_mark(semanticArena);
+        fprintf(stream, "Returned to scope -> %s\n", GetCurrentScope());
+        arena_reset(semanticArena, mark);
     }
 }
 
@@ -400,35 +500,34 @@ void ProcessConditional(ASTNode *ctx, Array *symbol_table, FILE *stream) { // If
             ctx->error = AST_ERROR_INVALID_CONDITIONAL;
             array_push(semanticErrors, (Element *)ctx);
     }
-    ProcessScope(&CHILD_ITEM(ctx, 1), symbol_table, stream); // ThenScope
-    ProcessScope(&CHILD_ITEM(ctx, 2), symbol_table, stream); // ElseScope
+    PushTask(TASK_SCOPE, &CHILD_ITEM(ctx, 2), 0); // ElseScope
+    PushTask(TASK_SCOPE, &CHILD_ITEM(ctx, 1), 0); // ThenScope
+}
+
+void ProcessLoopCondition(ASTNode *ctx, ASTNode *condition, Array *symbol_table, FILE *stream) {
+    ASTNodeType outcome = ProcessExpression(condition, symbol_table, stream);
+    if (outcome == AST_STRING || outcome == AST_NULL){
+        printf("Error Reported -> Incompatible Conditional\n");
+        ctx->error = AST_ERROR_INVALID_CONDITIONAL;
+        array_push(semanticErrors, (Element *)ctx);
+    }
 }
 
 void ProcessLoop(ASTNode *ctx, Array *symbol_table, FILE *stream) {
     assert(ctx->type == AST_WHILE_LOOP || ctx->type == AST_REPEAT_UNTIL_LOOP);
     assert(ctx->count == 2);
-    ASTNodeType outcome = AST_NULL;
 
     if (stream) fprintf(stream, "Loop Analyzing -> %s\n", ASTNodeType_to_string(ctx->type));
 
     if (ctx->type == AST_WHILE_LOOP) {
-        outcome = ProcessExpression(&CHILD_ITEM(ctx, 0), symbol_table, stream);
-        if (outcome == AST_STRING || outcome == AST_NULL){
-            printf("Error Reported -> Incompatible Conditional\n");
-            ctx->error = AST_ERROR_INVALID_CONDITIONAL;
-            array_push(semanticErrors, (Element *)ctx);
-        }
-        ProcessScope(&CHILD_ITEM(ctx, 1), symbol_table, stream);
+        ProcessLoopCondition(ctx, &CHILD_ITEM(ctx, 0), symbol_table, stream);
+        PushTask(TASK_SCOPE, &CHILD_ITEM(ctx, 1), 0);
     }
 
     if(ctx->type == AST_REPEAT_UNTIL_LOOP) {
-        ProcessScope(&CHILD_ITEM(ctx, 0), symbol_table, stream);
-        outcome = ProcessExpression(&CHILD_ITEM(ctx, 1), symbol_table, stream);
-        if (outcome == AST_STRING || outcome == AST_NULL){
-            printf("Error Reported -> Incompatible Conditional\n");
-            ctx->error = AST_ERROR_INVALID_CONDITIONAL;
-            array_push(semanticErrors, (Element *)ctx);
-        }
+        // the condition is analyzed after the scope.
+        PushTask(TASK_REPEAT_CONDITION, ctx, 0);
+        PushTask(TASK_SCOPE, &CHILD_ITEM(ctx, 0), 0);
     }
 }
 
@@ -436,7 +535,7 @@ void ProcessLoop(ASTNode *ctx, Array *symbol_table, FILE *stream) {
 void ProcessScopeChild(ASTNode *ctx, Array *symbol_table, FILE *stream) {
     switch(ctx->type) {
         case AST_SCOPE:
-            ProcessScope(ctx, symbol_table, stream);
+            EnterScope(ctx, stream);
             break;
         case AST_CODITIONAL:
             ProcessConditional(ctx, symbol_table, stream);
@@ -462,12 +561,38 @@ void ProcessScopeChild(ASTNode *ctx, Array *symbol_table, FILE *stream) {
     }
 }
 
-Array* ProcessProgram(ASTNode *head, Array *symbol_table, FILE *stream) {
+// Analyze the scope `ctx` and everything in it, popping what is left to analyze from `taskStack` until it is empty.
+void ProcessScope(ASTNode *ctx, Array *symbol_table, FILE *stream) {
+    EnterScope(ctx, stream);
+    while (array_size(taskStack) > 0) {
+        const SemanticTask task = *(SemanticTask *)array_pop(taskStack);
+        switch (task.type) {
+            case TASK_STATEMENT:
+                ProcessScopeChild(task.ctx, symbol_table, stream);
+                break;
+            case TASK_SCOPE:
+                EnterScope(task.ctx, stream);
+                break;
+            case TASK_LEAVE_SCOPE:
+                LeaveScope(task.level, stream);
+                break;
+            case TASK_REPEAT_CONDITION:
+                ProcessLoopCondition(task.ctx, &CHILD_ITEM(task.ctx, 1), symbol_table, stream);
+                break;
+        }
+    }
+}
+
+Array* ProcessProgram(ASTNode *head, const char *input, Array *symbol_table, FILE *stream, Arena *arena) {
     assert(head->type == AST_PROGRAM);
+    sourceText = input;
+    semanticArena = arena;
     
     // Initialize the scope tracking system
     InitializeScopeStack();
     IntializeErrors();
+    taskStack = array_new(16, sizeof(SemanticTask));
+    operationStack = array_new(16, sizeof(OperationFrame));
     
     // assume that there is only one child to process which is a scope.
     assert(head->count == 1);
@@ -475,7 +600,11 @@ Array* ProcessProgram(ASTNode *head, Array *symbol_table, FILE *stream) {
     ProcessScope(head->items, symbol_table, stream);
     
     // Clean up the scope tracking system
+    array_free(taskStack);
+    taskStack = NULL;
+    array_free(operationStack);
+    operationStack = NULL;
     CleanupScopeStack();
     printf("\n");
     return semanticErrors;
-}
\ No newline at end of file
+}
@@ -0,0 +1,187 @@
+#include <stdbool.h>
+
+#include "../include/simd_scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SCAN_X86
+#include <immintrin.h>
+#endif
+
+SimdLevel simd_level(void)
+{
+#ifdef SIMD_SCAN_X86
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+/* Scalar versions, these also finish the last partial block of the vectorized versions. */
+
+static inline bool is_whitespace(const unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_string_char(const unsigned char c)
+{
+    return c >= ' ' && c < 0x7f && c != '"';
+}
+
+static size_t skip_whitespace_scalar(const char *const s, const size_t n)
+{
+    size_t i = 0;
+    while (i < n && is_whitespace((unsigned char)s[i]))
+        ++i;
+    return i;
+}
+
+static size_t find_line_end_scalar(const char *const s, const size_t n)
+{
+    size_t i = 0;
+    while (i < n && s[i] != '\n' && s[i] != '\0')
+        ++i;
+    return i;
+}
+
+static size_t find_bang_scalar(const char *const s, const size_t n)
+{
+    size_t i = 0;
+    while (i < n && s[i] != '!' && s[i] != '\0')
+        ++i;
+    return i;
+}
+
+static size_t skip_string_chars_scalar(const char *const s, const size_t n)
+{
+    size_t i = 0;
+    while (i < n && is_string_char((unsigned char)s[i]))
+        ++i;
+    return i;
+}
+
+static size_t find_any_of3_scalar(const unsigned char *const s, const size_t n, const unsigned char a, const unsigned char b, const unsigned char c)
+{
+    size_t i = 0;
+    while (i < n && s[i] != a && s[i] != b && s[i] != c)
+        ++i;
+    return i;
+}
+
+#ifdef SIMD_SCAN_X86
+/**
+ * Define `name`, which stops on the first byte for which `stop_mask(v)` (a vector compare of the block `v`) is set.
+ * The last partial block is finished by `scalar`.
+ */
+#define DEFINE_VECTOR_SCANNER(name, isa, vector, load, movemask, width, stop_mask, scalar)  \
+    __attribute__((target(isa)))                                                             \
+    static size_t name(const char *const s, const size_t n)                                  \
+    {                                                                                        \
+        size_t i = 0;                                                                        \
+        for (; i + width <= n; i += width) {                                                 \
+            const vector v = load((const vector *)(s + i));                                  \
+            const unsigned mask = (unsigned)movemask(stop_mask(v));                          \
+            if (mask != 0)                                                                   \
+                return i + (size_t)__builtin_ctz(mask);                                      \
+        }                                                                                    \
+        return i + scalar(s + i, n - i);                                                     \
+    }
+
+// whitespace is ' ' or '\t' (9) to '\r' (13), stop on anything else.
+#define WHITESPACE_STOP_SSE2(v) _mm_xor_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), \
+    _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)))), _mm_set1_epi8(-1))
+#define WHITESPACE_STOP_AVX2(v) _mm256_xor_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), \
+    _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v))), _mm256_set1_epi8(-1))
+
+#define LINE_END_STOP_SSE2(v) _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_setzero_si128()))
+#define LINE_END_STOP_AVX2(v) _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()))
+
+#define BANG_STOP_SSE2(v) _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('!')), _mm_cmpeq_epi8(v, _mm_setzero_si128()))
+#define BANG_STOP_AVX2(v) _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('!')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()))
+
+// as signed bytes, control characters and bytes >= 0x80 are both less than ' ', which leaves DEL (0x7f) and '"'.
+#define STRING_STOP_SSE2(v) _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(' ')), \
+    _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x7f)), _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))
+#define STRING_STOP_AVX2(v) _mm256_or_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(' '), v), \
+    _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7f)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))
+
+#define DEFINE_SCANNERS(name, SSE2_STOP, AVX2_STOP)                                                                                        \
+    DEFINE_VECTOR_SCANNER(name##_sse2, "sse2", __m128i, _mm_loadu_si128, _mm_movemask_epi8, 16, SSE2_STOP, name##_scalar)              \
+    DEFINE_VECTOR_SCANNER(name##_avx2, "avx2", __m256i, _mm256_loadu_si256, _mm256_movemask_epi8, 32, AVX2_STOP, name##_scalar)
+
+DEFINE_SCANNERS(skip_whitespace, WHITESPACE_STOP_SSE2, WHITESPACE_STOP_AVX2)
+DEFINE_SCANNERS(find_line_end, LINE_END_STOP_SSE2, LINE_END_STOP_AVX2)
+DEFINE_SCANNERS(find_bang, BANG_STOP_SSE2, BANG_STOP_AVX2)
+DEFINE_SCANNERS(skip_string_chars, STRING_STOP_SSE2, STRING_STOP_AVX2)
+
+#undef DEFINE_SCANNERS
+#undef DEFINE_VECTOR_SCANNER
+
+// the bytes to stop on are arguments, so these are not made by DEFINE_VECTOR_SCANNER.
+__attribute__((target("sse2")))
+static size_t find_any_of3_sse2(const unsigned char *const s, const size_t n, const unsigned char a, const unsigned char b, const unsigned char c)
+{
+    const __m128i va = _mm_set1_epi8((char)a), vb = _mm_set1_epi8((char)b), vc = _mm_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        const unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_or_si128(_mm_cmpeq_epi8(v, vb), _mm_cmpeq_epi8(v, vc))));
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + find_any_of3_scalar(s + i, n - i, a, b, c);
+}
+
+__attribute__((target("avx2")))
+static size_t find_any_of3_avx2(const unsigned char *const s, const size_t n, const unsigned char a, const unsigned char b, const unsigned char c)
+{
+    const __m256i va = _mm256_set1_epi8((char)a), vb = _mm256_set1_epi8((char)b), vc = _mm256_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        const unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_or_si256(_mm256_cmpeq_epi8(v, vb), _mm256_cmpeq_epi8(v, vc))));
+        if (mask != 0)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+    return i + find_any_of3_scalar(s + i, n - i, a, b, c);
+}
+
+// `__builtin_cpu_supports` only reads a flag that is set up before main, so checking it on every call is cheap.
+#define DISPATCH(name, ...)                       \
+    do {                                          \
+        if (__builtin_cpu_supports("avx2"))       \
+            return name##_avx2(__VA_ARGS__);      \
+        if (__builtin_cpu_supports("sse2"))       \
+            return name##_sse2(__VA_ARGS__);      \
+        return name##_scalar(__VA_ARGS__);        \
+    } while (0)
+#else
+#define DISPATCH(name, ...) return name##_scalar(__VA_ARGS__)
+#endif
+
+size_t simd_skip_whitespace(const char *const s, const size_t n)
+{
+    DISPATCH(skip_whitespace, s, n);
+}
+
+size_t simd_find_line_end(const char *const s, const size_t n)
+{
+    DISPATCH(find_line_end, s, n);
+}
+
+size_t simd_find_bang(const char *const s, const size_t n)
+{
+    DISPATCH(find_bang, s, n);
+}
+
+size_t simd_skip_string_chars(const char *const s, const size_t n)
+{
+    DISPATCH(skip_string_chars, s, n);
+}
+
+size_t simd_find_any_of3(const unsigned char *const s, const size_t n, const unsigned char a, const unsigned char b, const unsigned char c)
+{
+    DISPATCH(find_any_of3, s, n, a, b, c);
+}
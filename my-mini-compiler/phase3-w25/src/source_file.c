@@ -0,0 +1,136 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/source_file.h"
+
+// Size of the first read when the size of the input is not known up front (pipes), doubled every time it fills up.
+#define SOURCE_FILE_INITIAL_READ_SIZE ((size_t)1 << 16)
+
+/**
+ * Read everything from `file` into a heap buffer followed by a null character.
+ * @param size_hint Expected size of the file (0 if unknown), the buffer grows past it if the file is larger.
+ */
+static bool source_file_read(SourceFile *const f, FILE *const file, const size_t size_hint)
+{
+    // room for the null character, and one byte more than expected so that reaching the end of the file is noticed without growing the buffer.
+    size_t capacity = (size_hint > 0 ? size_hint : SOURCE_FILE_INITIAL_READ_SIZE) + 2;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    if (buffer == NULL)
+        return false;
+    while (true) {
+        length += fread(buffer + length, 1, capacity - 1 - length, file);
+        if (length < capacity - 1)
+            break; // end of file or error
+        char *const grown = realloc(buffer, 2 * capacity);
+        if (grown == NULL) {
+            free(buffer);
+            errno = ENOMEM;
+            return false;
+        }
+        buffer = grown;
+        capacity *= 2;
+    }
+    if (ferror(file)) {
+        const int error = errno;
+        free(buffer);
+        errno = error;
+        return false;
+    }
+    buffer[length] = '\0';
+    f->text = f->buffer = buffer;
+    f->length = length;
+    return true;
+}
+
+#ifndef _WIN32
+/**
+ * Map the regular file `fd` of `size` bytes (size > 0) read-only.
+ *
+ * The mapping is placed at the start of a zero-filled anonymous mapping that is at least one byte longer than the file,
+ * so there is always a null character right after the contents, even when the file size is a multiple of the page size.
+ */
+static bool source_file_map(SourceFile *const f, const int fd, const size_t size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t mapping_size = (size + 1 + page_size - 1) / page_size * page_size;
+    void *const mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        return false;
+    if (mmap(mapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(mapping, mapping_size);
+        return false;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(mapping, size, MADV_SEQUENTIAL); // the lexer reads the input front to back.
+#endif
+    f->text = f->mapping = mapping;
+    f->mapping_size = mapping_size;
+    f->length = size;
+    return true;
+}
+#endif
+
+bool source_file_open(SourceFile *const f, const char *const path)
+{
+    *f = (SourceFile){0};
+#ifndef _WIN32
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    const bool is_regular = S_ISREG(st.st_mode);
+    if (is_regular && st.st_size > 0 && source_file_map(f, fd, (size_t)st.st_size)) {
+        close(fd); // the mapping stays valid after the descriptor is closed.
+        return true;
+    }
+    FILE *const file = fdopen(fd, "rb");
+    if (file == NULL) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+    const size_t size_hint = is_regular ? (size_t)st.st_size : 0;
+#else
+    FILE *const file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    size_t size_hint = 0;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        const long size = ftell(file);
+        size_hint = size > 0 ? (size_t)size : 0;
+        fseek(file, 0, SEEK_SET);
+    }
+#endif
+    const bool ok = source_file_read(f, file, size_hint);
+    const int error = errno;
+    fclose(file);
+    errno = error;
+    return ok;
+}
+
+void source_file_close(SourceFile *const f)
+{
+#ifndef _WIN32
+    if (f->mapping != NULL)
+        munmap(f->mapping, f->mapping_size);
+#endif
+    free(f->buffer);
+    *f = (SourceFile){0};
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/token_stream.h"
+
+void token_stream_init(TokenStream *const tokens)
+{
+    *tokens = (TokenStream){0};
+}
+
+void token_stream_free(TokenStream *const tokens)
+{
+    free(tokens->types);
+    free(tokens->errors);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    free(tokens->ids);
+    free(tokens->values);
+    *tokens = (TokenStream){0};
+}
+
+// Resize `items` to `count` elements of `size` bytes, exit if out of memory.
+static void *resize_array(void *const items, const size_t count, const size_t size)
+{
+    void *const resized = realloc(items, count * size);
+    if (resized == NULL)
+    {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    return resized;
+}
+
+void token_stream_reserve(TokenStream *const tokens, const size_t capacity)
+{
+    if (capacity <= tokens->capacity)
+        return;
+    tokens->types = resize_array(tokens->types, capacity, sizeof(*tokens->types));
+    tokens->errors = resize_array(tokens->errors, capacity, sizeof(*tokens->errors));
+    tokens->offsets = resize_array(tokens->offsets, capacity, sizeof(*tokens->offsets));
+    tokens->lengths = resize_array(tokens->lengths, capacity, sizeof(*tokens->lengths));
+    tokens->ids = resize_array(tokens->ids, capacity, sizeof(*tokens->ids));
+    tokens->values = resize_array(tokens->values, capacity, sizeof(*tokens->values));
+    tokens->capacity = capacity;
+}
+
+// Move the elements [end, count) of `items` to start at `to`, then copy `n` elements of `from` to `begin`.
+#define SPLICE_ARRAY(items, from, begin, end, to, count, n)                                     \
+    do {                                                                                      \
+        memmove((items) + (to), (items) + (end), ((count) - (end)) * sizeof(*(items)));      \
+        if ((n) > 0)                                                                          \
+            memcpy((items) + (begin), (from), (n) * sizeof(*(items)));                        \
+    } while (0)
+
+void token_stream_replace(TokenStream *const tokens, const size_t begin, const size_t end, const TokenStream *const replacement)
+{
+    const size_t n = replacement->count, count = tokens->count, to = begin + n;
+    token_stream_reserve(tokens, count - (end - begin) + n);
+    SPLICE_ARRAY(tokens->types, replacement->types, begin, end, to, count, n);
+    SPLICE_ARRAY(tokens->errors, replacement->errors, begin, end, to, count, n);
+    SPLICE_ARRAY(tokens->offsets, replacement->offsets, begin, end, to, count, n);
+    SPLICE_ARRAY(tokens->lengths, replacement->lengths, begin, end, to, count, n);
+    SPLICE_ARRAY(tokens->ids, replacement->ids, begin, end, to, count, n);
+    SPLICE_ARRAY(tokens->values, replacement->values, begin, end, to, count, n);
+    tokens->count = count - (end - begin) + n;
+}
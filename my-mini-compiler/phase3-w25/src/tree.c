@@ -18,20 +18,37 @@
 // Stack structure for booleans
 DA_DEFINE(BoolStack, bool);
 
-// Function to print the tree using a stack of booleans for the prefix
-void print_tree_rec(print_tree_t *t, BoolStack* stack) {
-    const void *const root = t->root;
-    if (root == NULL) 
-        return;
-    // Print the root
-    t->print_head(root);
+// A node whose children are being printed.
+typedef struct _print_tree_frame_t
+{
+    const void *children;
+    size_t count;
+    size_t next; // Index of the next child to print.
+} print_tree_frame_t;
+
+DA_DEFINE(FrameStack, print_tree_frame_t);
+
+// Print the head of `node` and push it so that its children are printed next.
+static void print_tree_enter(const print_tree_t *t, FrameStack *frames, const void *node) {
+    t->print_head(node, t->context);
     putc('\n', stdout);
-    // Recursively print all children
-    const size_t n = t->count(root);
-    const void *cp = t->children(root);
-    for (size_t i = 0; i < n; ++i) {
-        t->root = (char*)cp + i * t->size;
-        const bool is_last = (i == n - 1);
+    da_push(frames, ((print_tree_frame_t){.children = t->children(node), .count = t->count(node), .next = 0}));
+}
+
+// Print the tree using a stack of booleans for the prefix, the nodes being printed are kept on a stack of their own instead of the call stack so that deep trees can be printed.
+void print_tree_iter(const print_tree_t *t, BoolStack* stack) {
+    FrameStack frames = {0};
+    print_tree_enter(t, &frames, t->root);
+    while (frames.count > 0) {
+        print_tree_frame_t *const top = &frames.items[frames.count - 1];
+        if (top->next == top->count) {
+            da_pop(&frames);
+            // Every node but the root pushed its "is_last" status.
+            da_pop(stack);
+            continue;
+        }
+        const void *const child = (const char*)top->children + top->next * t->size;
+        const bool is_last = (++top->next == top->count);
         // Print the prefix based on the stack and whether this node is the last child.
         for (size_t i = 0; i < stack->count; ++i)
             printf("%s", stack->items[i] ? "| " : "  ");
@@ -39,18 +56,15 @@ void print_tree_rec(print_tree_t *t, BoolStack* stack) {
         // Push the current node's "is_last" status (inverted) onto the stack
         // True means "not last" (pipe), False means "last" (spaces)
         da_push(stack, !is_last);
-        print_tree_rec(t, stack);
-        da_pop(stack);
+        print_tree_enter(t, &frames, child);
     }
-    t->root = root; // Reset the root pointer since it was changed in the loop.
+    da_clear(&frames);
 }
 
 void print_tree(const print_tree_t *t) {
     if (t == NULL || t->root == NULL || t->children == NULL || t->count == NULL || t->size == 0 || t->print_head == NULL) return;
     // Create a stack and print the tree
     BoolStack stack = {0};
-    print_tree_t pt = *t; // Copy the struct to avoid modifying the original (the recursive function does modify the struct, however it reverts those modifications before returning, this is just for safety)
-    print_tree_rec(&pt, &stack); // Recursively print the tree
+    print_tree_iter(t, &stack);
     da_clear(&stack);
 }
-
@@ -0,0 +1,24 @@
+# Checks that `--check` reports the same first error (lexical or syntax) as compiling each input.
+#
+# Usage: cmake -DCOMPILER=<my-mini-compiler-phase3> -DINPUTS=<file.cisc;...> -P check_errors_test.cmake
+# Fails (FATAL_ERROR) on the first input where they differ.
+
+# The first compiler message (file:line:column: error: ...) of `output`, empty if there is none.
+function(first_error output result)
+    string(REGEX MATCH "[^\n]*:[0-9]+:[0-9]+: error: [^\n]*" match "${output}")
+    set(${result} "${match}" PARENT_SCOPE)
+endfunction()
+
+foreach(input IN LISTS INPUTS)
+    execute_process(COMMAND ${COMPILER} ${input} OUTPUT_QUIET ERROR_VARIABLE compiled)
+    execute_process(COMMAND ${COMPILER} --check ${input} OUTPUT_QUIET ERROR_VARIABLE checked RESULT_VARIABLE check_result)
+    first_error("${compiled}" compiled_error)
+    first_error("${checked}" checked_error)
+    if(NOT compiled_error STREQUAL checked_error)
+        message(FATAL_ERROR "${input}: --check reports\n  ${checked_error}\ninstead of\n  ${compiled_error}")
+    endif()
+    if(compiled_error STREQUAL "" AND NOT check_result EQUAL 0)
+        message(FATAL_ERROR "${input}: --check fails without reporting an error")
+    endif()
+    message(STATUS "${input}: ${checked_error}")
+endforeach()
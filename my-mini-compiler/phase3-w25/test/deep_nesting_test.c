@@ -0,0 +1,267 @@
+/**
+ * Stress test of the depth of the trees the parser can handle: `parse_cfg_recursive_descent_parse_tree` and `ASTNode_from_ParseTreeNode` use explicit stacks,
+ * so blocks nested 1,000,000 levels deep (and long chains of parentheses, which are long chains of promotions) must parse and convert without overflowing the call stack.
+ * So do `parse_cfg_recursive_descent_ast` and `ProcessProgram`, which the compiler runs on every input: the same inputs must go through them as they do in main.c.
+ * A long chain of a left-associative operator is a single node of the parse tree (see `ParseTreeNode_continue_left_recursion`) and as deep an AST.
+ * The recognizer (`parse_cfg_recognize`) must agree with the parser on the same inputs, with a stack of a few frames per token, and fail cleanly with a small one.
+ *
+ * Usage: deep_nesting_test
+ * Exits with EXIT_FAILURE if any check fails.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/arena.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/semantic.h"
+
+#define DEEP_BLOCKS 1000000
+#define DEEP_PARENTHESES 200000
+#define LONG_CHAIN 1000000
+// Frames of the stack of the recognizer per token of the input: a parenthesis goes through every precedence level of the expressions.
+#define RECOGNIZER_FRAMES_PER_TOKEN 8
+
+/**
+ * @return `depth` copies of `open`, then `middle`, then `depth` copies of `close` (none if it is '\0'), then `end`.
+ */
+static char *nested_input(const size_t depth, const char open, const char *const middle, const char close, const char *const end)
+{
+    char *const input = malloc(2 * depth + strlen(middle) + strlen(end) + 1);
+    if (input == NULL) {
+        perror("Failed to allocate memory for the deep nesting input");
+        exit(EXIT_FAILURE);
+    }
+    char *p = input;
+    memset(p, open, depth);
+    p += depth;
+    strcpy(p, middle);
+    p += strlen(middle);
+    if (close != '\0') {
+        memset(p, close, depth);
+        p += depth;
+    }
+    strcpy(p, end);
+    return input;
+}
+
+/**
+ * @return `operand`, then `count` times `operator` and `operand`, then `end`.
+ */
+static char *chain_input(const size_t count, const char *const operand, const char *const operator, const char *const end)
+{
+    char *const input = malloc((count + 1) * strlen(operand) + count * strlen(operator) + strlen(end) + 1);
+    if (input == NULL) {
+        perror("Failed to allocate memory for the long chain input");
+        exit(EXIT_FAILURE);
+    }
+    char *p = input;
+    strcpy(p, operand);
+    p += strlen(operand);
+    for (size_t i = 0; i < count; ++i) {
+        strcpy(p, operator);
+        p += strlen(operator);
+        strcpy(p, operand);
+        p += strlen(operand);
+    }
+    strcpy(p, end);
+    return input;
+}
+
+/**
+ * @return The declaration of the identifier x followed by `statements`, which are freed.
+ */
+static char *declared_input(char *const statements)
+{
+    static const char declaration[] = "int x;";
+    char *const input = malloc(strlen(declaration) + strlen(statements) + 1);
+    if (input == NULL) {
+        perror("Failed to allocate memory for the declared input");
+        exit(EXIT_FAILURE);
+    }
+    strcat(strcpy(input, declaration), statements);
+    free(statements);
+    return input;
+}
+
+/**
+ * Parse and convert `input` (all of it, up to TOKEN_EOF), which must parse if and only if `valid`, and follow the first item of every node of the AST down to the deepest one.
+ * Then recognize it, which must stop where the parser did.
+ * @param expected_depth The number of nodes below the root on that path, `expected_leaf` is the type of the last one (only checked if `valid`).
+ * @return 0 if the checks pass, otherwise 1.
+ */
+static int check_nesting(const char *const name, const char *const input, const bool valid, const size_t expected_depth, const ASTNodeType expected_leaf, const CFG_PredictTable *const table)
+{
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    Arena arena;
+    arena_init(&arena, 0);
+    ParseTreeNode tree = {.type = PT_PROGRAM};
+    size_t index = 0;
+    const bool parsed = parse_cfg_recursive_descent_parse_tree(&tree, &index, &tokens, table, &arena);
+    ASTNode ast = {.type = AST_PROGRAM};
+    const bool converted = ASTNode_from_ParseTreeNode(&ast, (ParseTreeNodeWithPromo *)&tree, &tokens, &arena);
+    size_t depth = 0;
+    const ASTNode *leaf = &ast;
+    for (; leaf->count > 0; leaf = leaf->items)
+        ++depth;
+    int failed = 0;
+    if (parsed != valid || converted != valid) {
+        fprintf(stderr, "%s: parsed %d and converted %d instead of %d\n", name, parsed, converted, valid);
+        failed = 1;
+    } else if (valid && (index != tokens.count || depth != expected_depth || leaf->type != expected_leaf)) {
+        fprintf(stderr, "%s: stopped at token %zu of %zu, AST %zu deep down to %s instead of %zu deep down to %s\n", name, index, tokens.count,
+            depth, ASTNodeType_to_string(leaf->type), expected_depth, ASTNodeType_to_string(expected_leaf));
+        failed = 1;
+    } else if (!valid && ast.error != AST_ERROR_CHILD_ERROR) {
+        fprintf(stderr, "%s: the root of the AST has error %d instead of AST_ERROR_CHILD_ERROR\n", name, ast.error);
+        failed = 1;
+    }
+    const size_t capacity = RECOGNIZER_FRAMES_PER_TOKEN * tokens.count;
+    RecognizerFrame *const stack = malloc(capacity * sizeof(RecognizerFrame));
+    if (stack == NULL) {
+        perror("Failed to allocate memory for the stack of the recognizer");
+        exit(EXIT_FAILURE);
+    }
+    size_t recognized_index = 0;
+    SyntaxError error;
+    const bool recognized = parse_cfg_recognize(PT_PROGRAM, &recognized_index, &tokens, table, stack, capacity, &error);
+    if (!failed && (recognized != valid || recognized_index != index || (!valid && error.expected == PT_NULL))) {
+        fprintf(stderr, "%s: recognized %d up to token %zu instead of %d up to token %zu\n", name, recognized, recognized_index, valid, index);
+        failed = 1;
+    }
+    free(stack);
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    return failed;
+}
+
+/**
+ * Parse `input` directly to an AST and analyze it, like the compiler does (see main.c), and follow the first item of every node of the AST from the last statement of the program down to the deepest one.
+ * @param valid Whether `input` has no syntax errors, the AST is only checked and analyzed if so.
+ * @param expected_depth The number of nodes below the root on that path, `expected_leaf` is the type of the last one.
+ * @return 0 if the checks pass, otherwise 1.
+ */
+static int check_compiler(const char *const name, const char *const input, const bool valid, const size_t expected_depth, const ASTNodeType expected_leaf, const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence)
+{
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode ast = {.type = AST_PROGRAM};
+    size_t index = 0;
+    SyntaxErrors syntax_errors;
+    da_init(&syntax_errors);
+    const bool parsed = parse_cfg_recursive_descent_ast(&ast, PT_PROGRAM, &index, &tokens, table, precedence, &arena, &syntax_errors);
+    int failed = 0;
+    if (parsed != valid || (syntax_errors.count == 0) != valid) {
+        fprintf(stderr, "%s (compiler): parsed %d with %zu syntax error(s) instead of %d\n", name, parsed, syntax_errors.count, valid);
+        failed = 1;
+    } else if (valid) {
+        size_t depth = 1;
+        const ASTNode *leaf = ast.items;
+        if (leaf->count > 0) {
+            leaf = leaf->items + leaf->count - 1;
+            ++depth;
+        }
+        for (; leaf->count > 0; leaf = leaf->items)
+            ++depth;
+        Array *const symbol_table = array_new_in_arena(&arena, 8, sizeof(symEntry));
+        Array *const semantic_errors = ProcessProgram(&ast, input, symbol_table, NULL, &arena);
+        if (depth != expected_depth || leaf->type != expected_leaf) {
+            fprintf(stderr, "%s (compiler): AST %zu deep down to %s instead of %zu deep down to %s\n", name,
+                depth, ASTNodeType_to_string(leaf->type), expected_depth, ASTNodeType_to_string(expected_leaf));
+            failed = 1;
+        } else if (array_size(semantic_errors) != 0) {
+            fprintf(stderr, "%s (compiler): %zu semantic error(s) instead of none\n", name, array_size(semantic_errors));
+            failed = 1;
+        }
+    }
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    return failed;
+}
+
+int main(void)
+{
+    CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    int failures = 0;
+
+    // each block is a scope in the scope above it, below the scope of the program.
+    char *input = nested_input(DEEP_BLOCKS, '{', "", '}', "");
+    failures += check_nesting("nested blocks", input, true, DEEP_BLOCKS + 1, AST_SCOPE, &table);
+    free(input);
+    // the error is at the end of the input, every enclosing node fails with it.
+    input = nested_input(DEEP_BLOCKS, '{', "", '\0', "");
+    failures += check_nesting("unclosed nested blocks", input, false, 0, AST_NULL, &table);
+    free(input);
+    // parentheses are promoted away: the program scope has an expression statement of the identifier.
+    input = nested_input(DEEP_PARENTHESES, '(', "x", ')', ";");
+    failures += check_nesting("nested parentheses", input, true, 3, AST_IDENTIFIER, &table);
+    free(input);
+    input = nested_input(DEEP_PARENTHESES, '(', "x", ')', "");
+    failures += check_nesting("nested parentheses without a semicolon", input, false, 0, AST_NULL, &table);
+    free(input);
+    // the sum is left-associative: one addition per operator between the expression statement and the first operand.
+    input = chain_input(LONG_CHAIN, "x", "+", ";");
+    failures += check_nesting("long sum", input, true, LONG_CHAIN + 3, AST_IDENTIFIER, &table);
+    free(input);
+    // the error is in the last repetition of the chain.
+    input = chain_input(LONG_CHAIN, "x", "+", "+;");
+    failures += check_nesting("long sum without its last operand", input, false, 0, AST_NULL, &table);
+    free(input);
+
+    // the compiler parses with recovery and precedence climbing.
+    CFG_PredictTable_recover(&table, &program_recovery);
+    CFG_PrecedenceTable precedence;
+    CFG_PrecedenceTable_init(&precedence, &table, PT_EXPRESSION);
+    input = nested_input(DEEP_BLOCKS, '{', "", '}', "");
+    failures += check_compiler("nested blocks", input, true, DEEP_BLOCKS + 1, AST_SCOPE, &table, &precedence);
+    free(input);
+    input = nested_input(DEEP_BLOCKS, '{', "", '\0', "");
+    failures += check_compiler("unclosed nested blocks", input, false, 0, AST_NULL, &table, &precedence);
+    free(input);
+    // the identifier is declared before the statement that uses it.
+    input = declared_input(nested_input(DEEP_BLOCKS, '(', "x", ')', ";"));
+    failures += check_compiler("nested parentheses", input, true, 3, AST_IDENTIFIER, &table, &precedence);
+    free(input);
+    // the operands of every addition are analyzed before it.
+    input = declared_input(chain_input(LONG_CHAIN, "x", "+", ";"));
+    failures += check_compiler("long sum", input, true, LONG_CHAIN + 3, AST_IDENTIFIER, &table, &precedence);
+    free(input);
+
+    // the recognizer runs out of stack instead of overflowing it.
+    input = nested_input(DEEP_BLOCKS, '{', "", '}', "");
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    RecognizerFrame small_stack[16];
+    size_t index = 0;
+    SyntaxError error;
+    if (parse_cfg_recognize(PT_PROGRAM, &index, &tokens, &table, small_stack, sizeof(small_stack) / sizeof(small_stack[0]), &error) || error.expected != PT_NULL) {
+        fprintf(stderr, "nested blocks with a small stack: recognized without running out of stack\n");
+        ++failures;
+    }
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    free(input);
+
+    if (failures) {
+        fprintf(stderr, "%d deep nesting check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All deep nesting checks passed.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,798 @@
+/**
+ * Differential test for the lexer.
+ *
+ * Runs the lexer on every input given on the command line (and a few built in edge cases) and compares the token stream against the original branch-chain lexer, which is kept below as `reference_get_next_token`.
+ * The streaming lexer is compared against the lexer on the same inputs.
+ * The reference lexer is frozen, it must not be updated when the lexer changes (apart from adapting how its tokens are compared in `tokens_match`).
+ * Lexemes are no longer limited to 99 characters, so inputs with longer identifiers, numbers or strings are expected to differ, those are checked separately in `check_long_lexemes`.
+ * Numbers that do not fit in their type are now lexical errors, `tokens_match` expects those (and checks number values against strtoll/strtod).
+ *
+ * Usage: lexer_differential_test [file.cisc ...]
+ * Exits with EXIT_FAILURE if any token differs.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+
+#include "../include/dynamic_array.h"
+#include "../include/lexer.h"
+#include "../include/operators.h"
+#include "../include/source_file.h"
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Reference lexer (copy of the original get_next_token)                                           */
+/* ---------------------------------------------------------------------------------------------- */
+
+// The reference lexer reported string literals that did not fit its lexeme buffer with an error the lexer no longer has.
+#define REFERENCE_ERROR_STRING_TOO_LONG ((ErrorType)(ERROR_LEXEME_TOO_LONG + 1))
+
+typedef struct _ReferenceToken
+{
+    TokenType type;
+    ErrorType error;
+    LexemePosition position;
+    char lexeme[100];
+} ReferenceToken;
+
+typedef struct _ReferenceLexer
+{
+    const char *input_string;
+    int current_position;
+    int current_line;
+    Array *line_start_positions;
+} ReferenceLexer;
+
+static const char *const reference_operators[] = {
+    "==", "!=", ">=", "<=", "<<", ">>", "&&", "||",
+    "=", "+", "-", "*", "/", "%", "~", "&", "|", "^", "!", "<", ">"};
+
+static int reference_operator_index(const char *const s)
+{
+    for (unsigned i = 0; i < (sizeof(reference_operators) / sizeof(reference_operators[0])); i++)
+        if (strncmp(reference_operators[i], s, strlen(reference_operators[i])) == 0)
+            return i;
+    return -1;
+}
+
+static int reference_is_keyword(const char *str)
+{
+    static const char *const keywords[] = {
+        "int", "float", "string", "print", "read", "if", "then", "else", "while",
+        "repeat", "until", "factorial"};
+    for (int i = 0; i < 12; i++)
+        if (strcmp(str, keywords[i]) == 0)
+            return i;
+    return -1;
+}
+
+static void reference_init_lexer(ReferenceLexer *const l, const char *input_string)
+{
+    l->input_string = input_string;
+    l->current_position = 0;
+    l->current_line = 1;
+    l->line_start_positions = array_new(1, sizeof(int));
+    array_push(l->line_start_positions, (Element *)&l->current_position);
+}
+
+static void reference_record_if_newline(ReferenceLexer *const l)
+{
+    if (l->input_string[l->current_position] != '\n')
+        return;
+    ++l->current_line;
+    const int temp_position = l->current_position + 1;
+    array_push(l->line_start_positions, (Element *)&temp_position);
+}
+
+static ReferenceToken reference_get_next_token(ReferenceLexer *const l)
+{
+    char c, cn;
+    while ((c = l->input_string[l->current_position]) != '\0' && isspace(c))
+    {
+        reference_record_if_newline(l);
+        l->current_position++;
+    }
+    ReferenceToken token = {
+        .type = TOKEN_ERROR,
+        .lexeme = "",
+        .position = (LexemePosition){
+            .line = l->current_line,
+            .col_start = l->current_position - *(int *)array_get(l->line_start_positions, l->current_line - 1) + 1,
+            .col_end = l->current_position - *(int *)array_get(l->line_start_positions, l->current_line - 1) + 1},
+        .error = ERROR_NONE};
+    if (l->input_string[l->current_position] == '\0')
+    {
+        token.type = TOKEN_EOF;
+        return token;
+    }
+    c = l->input_string[l->current_position];
+    cn = l->input_string[l->current_position + 1];
+    if (c == '?' && cn == '?')
+    {
+        while (l->input_string[l->current_position] != '\n' && l->input_string[l->current_position] != '\0')
+            l->current_position++;
+        return reference_get_next_token(l);
+    }
+    if (c == '?' && cn == '!')
+    {
+        l->current_position += 2;
+        while (!(l->input_string[l->current_position] == '!' && l->input_string[l->current_position + 1] == '?') && l->input_string[l->current_position] != '\0')
+        {
+            reference_record_if_newline(l);
+            l->current_position++;
+        }
+        if (l->input_string[l->current_position] == '\0')
+        {
+            token.error = ERROR_UNTERMINATED_COMMENT;
+            return token;
+        }
+        l->current_position += 2;
+        return reference_get_next_token(l);
+    }
+    if (isdigit(c))
+    {
+        int i = 0;
+        token.type = TOKEN_INTEGER_CONST;
+        int float_found = 0;
+        do
+        {
+            if (cn == '.' && float_found == 0)
+            {
+                token.lexeme[i++] = c;
+                token.lexeme[i++] = cn;
+                l->current_position += 2;
+                token.type = TOKEN_FLOAT_CONST;
+                float_found = 1;
+            }
+            else
+            {
+                token.lexeme[i++] = c;
+                l->current_position++;
+            }
+            c = l->input_string[l->current_position];
+            cn = c == '\0' ? '\0' : l->input_string[l->current_position + 1];
+        } while (isdigit(c) && i < (int)(sizeof(token.lexeme) - 1));
+        token.position.col_end += i - 1;
+        token.lexeme[i] = '\0';
+        return token;
+    }
+    if (isalpha(c) || c == '_')
+    {
+        int i = 0;
+        do
+        {
+            token.lexeme[i++] = c;
+            l->current_position++;
+            c = l->input_string[l->current_position];
+        } while ((isalnum(c) || c == '_') && i < (int)(sizeof(token.lexeme) - 1));
+        token.lexeme[i] = '\0';
+        token.position.col_end += i - 1;
+        const int keyword_id = reference_is_keyword(token.lexeme);
+        token.type = keyword_id != -1 ? (TokenType)(keyword_id + TOKEN_INT_KEYWORD) : TOKEN_IDENTIFIER;
+        return token;
+    }
+    if (c == '"')
+    {
+        int i = 0;
+        token.lexeme[i++] = c;
+        l->current_position++;
+        while (isprint(c = l->input_string[l->current_position]) && c != '"' && c != '\0')
+        {
+            if (i >= (int)(sizeof(token.lexeme) - 2))
+            {
+                while (isprint(c = l->input_string[l->current_position]) && c != '"' && c != '\0')
+                    l->current_position++;
+                token.lexeme[i] = '\0';
+                token.type = TOKEN_ERROR;
+                token.position.col_end += i - 1;
+                if (c == '"')
+                {
+                    l->current_position++;
+                    token.error = REFERENCE_ERROR_STRING_TOO_LONG;
+                    return token;
+                }
+                token.error = ERROR_UNTERMINATED_STRING;
+                return token;
+            }
+            token.lexeme[i++] = c;
+            l->current_position++;
+        }
+        if (c == '"')
+        {
+            token.lexeme[i++] = c;
+            token.lexeme[i] = '\0';
+            l->current_position++;
+            token.type = TOKEN_STRING_CONST;
+            token.position.col_end += i - 1;
+            return token;
+        }
+        reference_record_if_newline(l);
+        token.lexeme[i] = '\0';
+        token.type = TOKEN_ERROR;
+        token.error = ERROR_UNTERMINATED_STRING;
+        token.position.col_end += i - 1;
+        return token;
+    }
+    const int operator_id = reference_operator_index(l->input_string + l->current_position);
+    if (operator_id != -1)
+    {
+        const size_t operator_len = strlen(reference_operators[operator_id]);
+        token.type = (TokenType)(TokenType_FIRST_OPERATOR + operator_id);
+        strncpy(token.lexeme, l->input_string + l->current_position, operator_len);
+        token.lexeme[operator_len] = '\0';
+        token.position.col_end += operator_len;
+        l->current_position += operator_len;
+        return token;
+    }
+    const char *const punctuation = ";{}(),";
+    const char *punctcheck = strchr(punctuation, c);
+    if (punctcheck)
+    {
+        token.type = (TokenType)((punctcheck - punctuation) + TOKEN_SEMICOLON);
+        token.lexeme[0] = c;
+        token.lexeme[1] = '\0';
+        l->current_position++;
+        return token;
+    }
+    token.error = ERROR_INVALID_CHAR;
+    token.lexeme[0] = c;
+    token.lexeme[1] = '\0';
+    l->current_position++;
+    return token;
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Comparison                                                                                      */
+/* ---------------------------------------------------------------------------------------------- */
+
+static bool tokens_match(Lexer *const l, const Token *const actual, const ReferenceToken *const expected)
+{
+    const LexemePosition position = Token_position(actual, &l->lines);
+    // the reference lexer does not parse numbers, numbers that do not fit in their type are now errors.
+    TokenType type = expected->type;
+    ErrorType error = expected->error;
+    Token value = {0};
+    errno = 0;
+    if (type == TOKEN_INTEGER_CONST)
+        value.value.integer = strtoll(expected->lexeme, NULL, 10);
+    else if (type == TOKEN_FLOAT_CONST)
+        value.value.real = strtod(expected->lexeme, NULL);
+    if ((type == TOKEN_INTEGER_CONST && errno == ERANGE) || (type == TOKEN_FLOAT_CONST && isinf(value.value.real))) {
+        type = TOKEN_ERROR;
+        error = ERROR_INVALID_NUMBER;
+        value.value.integer = 0;
+    }
+    // the reference lexer numbers its own operators, the TokenType of an operator is its index in reduced_operators (which may have more of them enabled).
+    size_t length;
+    if (type >= TokenType_FIRST_OPERATOR && type <= TokenType_FIRST_OPERATOR + (int)(sizeof(reference_operators) / sizeof(reference_operators[0])) - 1
+        && operator_token(expected->lexeme, &length) != TOKEN_NULL && length == strlen(expected->lexeme))
+        type = operator_token(expected->lexeme, &length);
+    return actual->type == type
+        && actual->error == error
+        && actual->value.integer == value.value.integer // the same bits for doubles too.
+        && position.line == expected->position.line
+        && position.col_start == expected->position.col_start
+        && position.col_end == expected->position.col_end
+        && actual->length == strlen(expected->lexeme)
+        && memcmp(l->input_string + actual->offset, expected->lexeme, actual->length) == 0;
+}
+
+static void print_reference_token(const ReferenceToken *const t)
+{
+    fprintf(stderr, "%s \"%s\" %zu:%zu-%zu (%s)", TokenType_to_string(t->type), t->lexeme,
+        t->position.line, t->position.col_start, t->position.col_end, ErrorType_to_error_message(t->error));
+}
+
+static void print_actual_token(Lexer *const l, const Token *const t)
+{
+    const LexemePosition position = Token_position(t, &l->lines);
+    fprintf(stderr, "%s \"%.*s\" %zu:%zu-%zu (%s)", TokenType_to_string(t->type), (int)t->length, l->input_string + t->offset,
+        position.line, position.col_start, position.col_end, ErrorType_to_error_message(t->error));
+}
+
+/**
+ * Lex `input` with both lexers and compare the token streams.
+ * @return the number of tokens compared, or -1 if the streams differ.
+ */
+static long compare_token_streams(const char *const name, const char *const input)
+{
+    ReferenceLexer reference = {0};
+    reference_init_lexer(&reference, input);
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+
+    long count = 0;
+    ReferenceToken expected;
+    Token actual;
+    do {
+        expected = reference_get_next_token(&reference);
+        actual = get_next_token(&lexer);
+        if (!tokens_match(&lexer, &actual, &expected)) {
+            fprintf(stderr, "%s: token %ld differs\n  expected: ", name, count);
+            print_reference_token(&expected);
+            fprintf(stderr, "\n  actual:   ");
+            print_actual_token(&lexer, &actual);
+            fprintf(stderr, "\n");
+            count = -1;
+            break;
+        }
+        ++count;
+    } while (expected.type != TOKEN_EOF);
+
+    array_free(reference.line_start_positions);
+    free_lexer(&lexer);
+    return count;
+}
+
+/**
+ * Lex `input` with the streaming lexer (through a temporary file, with several buffer sizes so that tokens and comments span refills)
+ * and compare the tokens against `get_next_token` on the whole input.
+ * @param length Number of bytes of `input` to write to the file (it may go past a null character).
+ * @return 0 if the streams match, otherwise 1.
+ */
+static int compare_stream_lexer(const char *const name, const char *const input, const size_t length)
+{
+    static const size_t buffer_sizes[] = {1, 2, 3, 7, 64, 0};
+    FILE *file = tmpfile();
+    if (file == NULL || fwrite(input, 1, length, file) != length || fflush(file) != 0) {
+        fprintf(stderr, "%s: unable to write a temporary file for the streaming lexer\n", name);
+        if (file != NULL)
+            fclose(file);
+        return 1;
+    }
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]) && !failed; ++i) {
+        rewind(file);
+        StreamLexer stream = {0};
+        init_stream_lexer(&stream, fileno(file), buffer_sizes[i]);
+        Lexer lexer = {0};
+        init_lexer(&lexer, input, 0);
+        long count = 0;
+        Token expected, actual;
+        do {
+            const char *lexeme;
+            LexemePosition position;
+            expected = get_next_token(&lexer);
+            actual = stream_get_next_token(&stream, &lexeme, &position);
+            const LexemePosition expected_position = Token_position(&expected, &lexer.lines);
+            if (actual.type != expected.type || actual.error != expected.error || actual.id != expected.id
+                || actual.value.integer != expected.value.integer || actual.offset != expected.offset || actual.length != expected.length
+                || memcmp(lexeme, input + expected.offset, expected.length) != 0
+                || position.line != expected_position.line
+                || position.col_start != expected_position.col_start
+                || position.col_end != expected_position.col_end) {
+                fprintf(stderr, "%s: streaming lexer (buffer size %zu) token %ld differs\n  expected: ", name, buffer_sizes[i], count);
+                print_actual_token(&lexer, &expected);
+                fprintf(stderr, "\n  actual:   %s \"%.*s\" %zu:%zu-%zu\n", TokenType_to_string(actual.type), (int)actual.length, lexeme,
+                    position.line, position.col_start, position.col_end);
+                failed = 1;
+                break;
+            }
+            ++count;
+        } while (expected.type != TOKEN_EOF);
+        free_lexer(&lexer);
+        free_stream_lexer(&stream);
+    }
+    fclose(file);
+    return failed;
+}
+
+/**
+ * Lex `input` with the parallel lexer (with several thread counts, and chunks small enough that block comments span several of them)
+ * and compare the tokens against `get_next_token`, including their IDs. A single thread checks `lex_all`.
+ * @return 0 if the tokens match, otherwise 1.
+ */
+static int compare_parallel_lexer(const char *const name, const char *const input)
+{
+    static const struct {
+        unsigned thread_count;
+        size_t min_chunk_size;
+    } configurations[] = {{1, 1}, {2, 1}, {3, 5}, {16, 1}, {8, 64}};
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(configurations) / sizeof(configurations[0]) && !failed; ++i) {
+        Lexer lexer = {0}, parallel = {0};
+        init_lexer(&lexer, input, 0);
+        init_lexer(&parallel, input, 0);
+        TokenStream tokens;
+        token_stream_init(&tokens);
+        lex_parallel(&parallel, configurations[i].thread_count, configurations[i].min_chunk_size, &tokens);
+        const size_t count = tokens.count;
+        size_t k = 0;
+        Token expected, token;
+        do {
+            expected = get_next_token(&lexer);
+            if (k < count)
+                token = token_stream_get(&tokens, k);
+            const Token *const actual = k < count ? &token : NULL;
+            if (actual == NULL || actual->type != expected.type || actual->error != expected.error || actual->id != expected.id
+                || actual->value.integer != expected.value.integer
+                || actual->offset != expected.offset || actual->length != expected.length) {
+                fprintf(stderr, "%s: parallel lexer (%u threads, chunks of at least %zu) token %zu differs\n  expected: ", name,
+                    configurations[i].thread_count, configurations[i].min_chunk_size, k);
+                print_actual_token(&lexer, &expected);
+                fprintf(stderr, "\n  actual:   ");
+                if (actual != NULL)
+                    print_actual_token(&parallel, actual);
+                fprintf(stderr, "\n");
+                failed = 1;
+                break;
+            }
+            ++k;
+        } while (expected.type != TOKEN_EOF);
+        if (!failed && k != count) {
+            fprintf(stderr, "%s: parallel lexer (%u threads) returned %zu tokens instead of %zu\n", name, configurations[i].thread_count, count, k);
+            failed = 1;
+        }
+        token_stream_free(&tokens);
+        free_lexer(&lexer);
+        free_lexer(&parallel);
+    }
+    return failed;
+}
+
+/**
+ * Check that identifiers, numbers and string literals longer than the reference lexer's 99 character buffer are lexed as a single token.
+ * @return the number of failed checks.
+ */
+static int check_long_lexemes(void)
+{
+    static const struct {
+        const char *input;
+        TokenType type;
+        ErrorType error;
+    } cases[] = {
+        {"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", TOKEN_IDENTIFIER, ERROR_NONE},
+        {"00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000042", TOKEN_INTEGER_CONST, ERROR_NONE},
+        {"12345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890", TOKEN_ERROR, ERROR_INVALID_NUMBER},
+        {"0.00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000125", TOKEN_FLOAT_CONST, ERROR_NONE},
+        {"\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\"", TOKEN_STRING_CONST, ERROR_NONE},
+        {"\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", TOKEN_ERROR, ERROR_UNTERMINATED_STRING},
+    };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const char *const input = cases[i].input;
+        const size_t length = strlen(input);
+        Lexer lexer = {0};
+        init_lexer(&lexer, input, 0);
+        const Token token = get_next_token(&lexer);
+        const Token eof = get_next_token(&lexer);
+        const LexemePosition position = Token_position(&token, &lexer.lines);
+        failures += compare_stream_lexer("long lexeme", input, strlen(input));
+        if (token.type != cases[i].type || token.error != cases[i].error || token.offset != 0 || token.length != length
+            || position.col_start != 1 || position.col_end != length || eof.type != TOKEN_EOF
+            || (token.type == TOKEN_INTEGER_CONST && token.value.integer != strtoll(input, NULL, 10))
+            || (token.type == TOKEN_FLOAT_CONST && token.value.real != strtod(input, NULL))) {
+            fprintf(stderr, "long lexeme %zu: expected a single %s of length %zu, got ", i, TokenType_to_string(cases[i].type), length);
+            print_actual_token(&lexer, &token);
+            fprintf(stderr, "\n");
+            ++failures;
+        }
+        free_lexer(&lexer);
+    }
+    // a float too large for a double.
+    char huge[400];
+    memset(huge, '9', sizeof(huge));
+    memcpy(huge + sizeof(huge) - 3, ".5", 3);
+    Lexer lexer = {0};
+    init_lexer(&lexer, huge, 0);
+    const Token token = get_next_token(&lexer);
+    if (token.type != TOKEN_ERROR || token.error != ERROR_INVALID_NUMBER || token.length != sizeof(huge) - 1) {
+        fprintf(stderr, "long lexeme: expected a %zu digit float to be an invalid number, got ", sizeof(huge) - 2);
+        print_actual_token(&lexer, &token);
+        fprintf(stderr, "\n");
+        ++failures;
+    }
+    free_lexer(&lexer);
+    return failures;
+}
+
+// Text inserted by the edits of `compare_relex`, chosen to open and close comments and strings and to join or split tokens.
+static const char *const relex_insertions[] = {"", "x", " ", "\n", "?!", "!?", "??", "!", "?", "\"", "=", "1", ".5", "&", "int y;", "\"a b\"", "?! c !?"};
+
+// The input with `removed` characters at `offset` replaced by `inserted` (allocated, null-terminated).
+static char *apply_edit(const char *const input, const size_t length, const size_t offset, const size_t removed, const char *const inserted)
+{
+    const size_t inserted_length = strlen(inserted);
+    char *const edited = malloc(length - removed + inserted_length + 1);
+    if (edited == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(edited, input, offset);
+    memcpy(edited + offset, inserted, inserted_length);
+    memcpy(edited + offset + inserted_length, input + offset + removed, length - offset - removed + 1);
+    return edited;
+}
+
+/**
+ * Compare tokens updated by `relex_edit` against `lex_all` on the edited input. IDs come from different tables, so the interned text is compared instead.
+ * @return 0 if the tokens match, otherwise 1.
+ */
+static int compare_relexed_tokens(const char *const name, Lexer *const l, const TokenStream *const tokens)
+{
+    Lexer fresh = {0};
+    init_lexer(&fresh, l->input_string, 0);
+    TokenStream expected;
+    token_stream_init(&expected);
+    lex_all(&fresh, &expected);
+    int failed = tokens->count != expected.count;
+    for (size_t i = 0; i < expected.count && !failed; ++i) {
+        const Token a = token_stream_get(tokens, i), b = token_stream_get(&expected, i);
+        const bool same_id = a.id == INTERN_ID_NONE ? b.id == INTERN_ID_NONE
+            : b.id != INTERN_ID_NONE && strcmp(intern_get(l->symbols, a.id, NULL), intern_get(fresh.symbols, b.id, NULL)) == 0;
+        if (a.type != b.type || a.error != b.error || a.offset != b.offset || a.length != b.length
+            || a.value.integer != b.value.integer || !same_id) {
+            fprintf(stderr, "%s: relexed token %zu differs\n  expected: ", name, i);
+            print_actual_token(&fresh, &b);
+            fprintf(stderr, "\n  actual:   ");
+            print_actual_token(l, &a);
+            fprintf(stderr, "\n");
+            failed = 1;
+        }
+    }
+    if (failed && tokens->count != expected.count)
+        fprintf(stderr, "%s: relexing gave %zu tokens instead of %zu\n", name, tokens->count, expected.count);
+    token_stream_free(&expected);
+    free_lexer(&fresh);
+    return failed;
+}
+
+/**
+ * Apply a fixed sequence of pseudo-random edits to `input` (each edit applies to the result of the previous one),
+ * updating the tokens with `relex_edit` and comparing them against lexing the edited input from scratch.
+ * @return 0 if the tokens match after every edit, otherwise 1.
+ */
+static int compare_relex(const char *const name, const char *const input)
+{
+    size_t length = strlen(input);
+    char *text = apply_edit(input, length, 0, 0, "");
+    Lexer lexer = {0};
+    init_lexer(&lexer, text, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    unsigned seed = 12345;
+    int failed = 0;
+    for (int edit = 0; edit < 64 && !failed; ++edit) {
+        seed = seed * 1103515245u + 12345u;
+        const size_t offset = (seed >> 8) % (length + 1);
+        const size_t removed = (seed >> 4) % 4 < 2 ? 0 : (seed >> 16) % (length - offset + 1) % 4;
+        const char *const inserted = relex_insertions[(seed >> 20) % (sizeof(relex_insertions) / sizeof(relex_insertions[0]))];
+        char *const edited = apply_edit(text, length, offset, removed, inserted);
+        relex_edit(&lexer, &tokens, edited, offset, removed, strlen(inserted));
+        free(text);
+        text = edited;
+        length = length - removed + strlen(inserted);
+        char edit_name[64];
+        snprintf(edit_name, sizeof(edit_name), "%.30s, edit %d", name, edit);
+        failed = compare_relexed_tokens(edit_name, &lexer, &tokens);
+    }
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    free(text);
+    return failed;
+}
+
+/**
+ * A small edit in a large input only relexes the tokens around it, unless it opens a comment that runs to the end of the input.
+ * @return the number of failed checks.
+ */
+static int check_relex_cost(void)
+{
+    static const char line[] = "x = 1; print \"s\"; ?? comment\n";
+    const size_t lines = 10000, line_length = sizeof(line) - 1;
+    char *const input = malloc(lines * line_length + 1);
+    if (input == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < lines; ++i)
+        memcpy(input + i * line_length, line, line_length);
+    input[lines * line_length] = '\0';
+    const size_t middle = lines / 2 * line_length;
+    static const struct {
+        size_t offset, removed;
+        const char *inserted;
+        size_t max_relexed; // at most this many tokens may be relexed, 0 for no limit.
+    } edits[] = {
+        {0, 1, "xyz", 3},   // rename an identifier
+        {4, 1, "42", 3},    // change a number
+        {14, 0, "\"", 4},  // open a string literal, it ends at the end of the line
+        {21, 1, "\n", 4},  // end a line comment early
+        {0, 0, "?!", 0},    // open a block comment that is never closed
+    };
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(edits) / sizeof(edits[0]); ++i) {
+        Lexer lexer = {0};
+        init_lexer(&lexer, input, 0);
+        TokenStream tokens;
+        token_stream_init(&tokens);
+        lex_all(&lexer, &tokens);
+        const size_t offset = middle + edits[i].offset;
+        char *const edited = apply_edit(input, lines * line_length, offset, edits[i].removed, edits[i].inserted);
+        const RelexResult result = relex_edit(&lexer, &tokens, edited, offset, edits[i].removed, strlen(edits[i].inserted));
+        char name[32];
+        snprintf(name, sizeof(name), "relex cost edit %zu", i);
+        failures += compare_relexed_tokens(name, &lexer, &tokens);
+        if (edits[i].max_relexed > 0 && result.inserted_count > edits[i].max_relexed) {
+            fprintf(stderr, "%s: relexed %zu tokens, expected at most %zu\n", name, result.inserted_count, edits[i].max_relexed);
+            ++failures;
+        }
+        token_stream_free(&tokens);
+        free_lexer(&lexer);
+        free(edited);
+    }
+    free(input);
+    return failures;
+}
+
+/**
+ * Check runs of whitespace, comment text and string characters of lengths around the 16 and 32 character blocks of the vectorized scanners
+ * (at a few alignments), ending in each kind of character that stops them.
+ * @return the number of failed checks.
+ */
+static int check_skipped_runs(void)
+{
+    static const struct {
+        const char *open;
+        const char *fill; // repeated to the length of the run.
+        const char *close[6];
+    } runs[] = {
+        {"x", " \t\n\v\f\r", {"x", "\x08", "\x0e", "?!x!?", ""}},
+        {"??", "a !?\t\"?", {"\nx", "\r\nx", ""}},
+        {"?!", "a ?\n\"!x", {"!?x", "!!?x", "!\n?x", ""}},
+        // not "\n": the reference lexer counts a newline that ends an unterminated string twice.
+        {"\"", "a ?!.;{#~", {"\" x", "\x01\"", "\t\"", "\x7f\"", "\x80\"", ""}},
+    };
+    static const size_t lengths[] = {0, 1, 2, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65};
+    int failures = 0;
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r)
+        for (size_t c = 0; c < sizeof(runs[r].close) / sizeof(runs[r].close[0]) && runs[r].close[c] != NULL; ++c)
+            for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i)
+                for (size_t align = 0; align < 3; ++align) {
+                    char input[128];
+                    size_t n = 0;
+                    for (size_t k = 0; k < align; ++k)
+                        input[n++] = ';';
+                    n += (size_t)sprintf(input + n, "%s", runs[r].open);
+                    const size_t fill_length = strlen(runs[r].fill);
+                    for (size_t k = 0; k < lengths[i]; ++k)
+                        input[n++] = runs[r].fill[k % fill_length];
+                    sprintf(input + n, "%s", runs[r].close[c]);
+                    char name[64];
+                    snprintf(name, sizeof(name), "run %zu, end %zu, length %zu, alignment %zu", r, c, lengths[i], align);
+                    if (compare_token_streams(name, input) < 0)
+                        ++failures;
+                    failures += compare_stream_lexer(name, input, strlen(input));
+                }
+    return failures;
+}
+
+// The linear scan of reduced_operators (longest first) that the generated matcher replaced.
+static int linear_operator_index(const char *const s)
+{
+    for (unsigned i = 0; i < (sizeof(reduced_operators) / sizeof(reduced_operators[0])); i++)
+        if (strncmp(reduced_operators[i], s, strlen(reduced_operators[i])) == 0)
+            return i;
+    return -1;
+}
+
+/**
+ * The generated operator matcher must find the same operator as the linear scan it replaced, for every string of up to three operator characters.
+ * The lexer's DFA (whose operator states are generated from the same table) must lex each of those strings into the operators the matcher finds one after the other,
+ * so it stays in sync with reduced_operators when an operator is enabled.
+ * @return 0 if both hold, otherwise 1.
+ */
+static int check_operator_table(void)
+{
+    static const char alphabet[] = "=!<>&|+-*/%~^ax";
+    const size_t n = sizeof(alphabet); // includes the null character.
+    int failed = 0;
+    for (size_t i = 0; i < n * n * n && !failed; ++i) {
+        const char s[4] = {alphabet[i % n], alphabet[i / n % n], alphabet[i / n / n], '\0'};
+        size_t length = 0;
+        const int expected = linear_operator_index(s);
+        const TokenType type = operator_token(s, &length);
+        if (operator_index(s) != expected || (expected < 0 ? type != TOKEN_NULL
+                : type != (TokenType)(TokenType_FIRST_OPERATOR + expected) || length != strlen(reduced_operators[expected]))) {
+            fprintf(stderr, "operators: \"%s\" matches operator %d, expected %d\n", s, operator_index(s), expected);
+            failed = 1;
+        }
+        Lexer lexer = {0};
+        init_lexer(&lexer, s, 0);
+        for (Token token = get_next_token(&lexer); token.type != TOKEN_EOF && !failed; token = get_next_token(&lexer)) {
+            const TokenType operator = operator_token(s + token.offset, &length);
+            if (operator != TOKEN_NULL && (token.type != operator || token.length != length)) {
+                fprintf(stderr, "operators: \"%s\" is lexed as %s of length %u at %zu instead of %s\n", s, TokenType_to_string(token.type), token.length, token.offset, TokenType_to_string(operator));
+                failed = 1;
+            }
+        }
+        free_lexer(&lexer);
+    }
+    return failed;
+}
+
+/**
+ * Check that equal identifiers and string literals get equal IDs, and different ones get different IDs.
+ * @return the number of failed checks.
+ */
+static int check_interning(void)
+{
+    const char *const input = "x y x \"x\" \"x\" int xy int";
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    Token t[8];
+    for (int i = 0; i < 8; ++i)
+        t[i] = get_next_token(&lexer);
+    const bool ok = t[0].id == t[2].id && t[0].id != t[1].id  // identifiers
+        && t[3].id == t[4].id && t[3].id != t[0].id           // string literals
+        && t[5].id == t[7].id && t[5].id != t[6].id           // keywords
+        && t[0].id != INTERN_ID_NONE && t[1].id != INTERN_ID_NONE && t[6].id != INTERN_ID_NONE
+        && strcmp(intern_get(lexer.symbols, t[6].id, NULL), "xy") == 0;
+    free_lexer(&lexer);
+    if (!ok)
+        fprintf(stderr, "interning: tokens of \"%s\" have unexpected IDs\n", input);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const edge_cases[] = {
+        "",
+        "   \t\r\n\v\f  ",
+        "?? comment only",
+        "?? comment\nx",
+        "?! unterminated block comment\n\n",
+        "x ?! a\n b !? y ?!!? z ?!?!? w",
+        "1.2.3 12. .5 007 0.0",
+        "0 00 12345678 1234567890123456789 9223372036854775807 9223372036854775808 99999999999999999999",
+        "00.000 0.1 3.14159 1. 4.35 0.30000000000000004 9007199254740993.0 123456789012345678.5 2.2250738585072014 7/00 7/0.0",
+        "==!=>=<=<<>>&&||=+-*/%~&|^!<> <<= >>= ===",
+        "if then else while repeat until factorial int float string print read iff _int int_",
+        "\"string\" \"\" \"tab\tinside\" \"unterminated",
+        "@ # $ ` \\ ' ? ?x \x7f \x80",
+        "x\ny\r\n  z ;{}()",
+        "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstu",
+        "123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789",
+        "\"abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqr\" x",
+        "a\n?! b\nc\n!\n!? d\n?! e\n f\n g !?\nh ?!\n",
+        "?!\nfoo\n!? bar foo\nbaz\n\"s\" ?? ?!\n\"s\" ?!\n!\n?\nfoo !? \"t\"\n?! never\nclosed\n\nat all",
+        "x\n\n\n?!\n\n\n\n!?\n\n\n",
+    };
+    int failures = check_long_lexemes() + check_interning() + check_skipped_runs() + check_operator_table() + check_relex_cost();
+    for (size_t i = 0; i < sizeof(edge_cases) / sizeof(edge_cases[0]); ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "edge case %zu", i);
+        if (compare_token_streams(name, edge_cases[i]) < 0)
+            ++failures;
+        failures += compare_stream_lexer(name, edge_cases[i], strlen(edge_cases[i]));
+        failures += compare_parallel_lexer(name, edge_cases[i]);
+        failures += compare_relex(name, edge_cases[i]);
+    }
+    for (int i = 1; i < argc; ++i) {
+        // load the file the same way main.c does.
+        SourceFile source;
+        if (!source_file_open(&source, argv[i])) {
+            fprintf(stderr, "Error: Unable to open file %s\n", argv[i]);
+            ++failures;
+            continue;
+        }
+        const long count = compare_token_streams(argv[i], source.text);
+        if (count < 0)
+            ++failures;
+        else
+            printf("%s: %ld tokens match\n", argv[i], count);
+        failures += compare_stream_lexer(argv[i], source.text, source.length);
+        failures += compare_parallel_lexer(argv[i], source.text);
+        failures += compare_relex(argv[i], source.text);
+        source_file_close(&source);
+    }
+    if (failures) {
+        fprintf(stderr, "%d input(s) produced different token streams\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All token streams match the reference lexer.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,770 @@
+/**
+ * Tests for the parser and its grammar tables.
+ *
+ * The predict table must choose exactly the production rule the parser used to find by walking the grammar with `ParseToken_can_start_with`,
+ * which is kept as the reference for what a non-terminal can start with.
+ * The generated parser (`parse_program_grammar`) must build the same trees as the interpreted parser, on the inputs given on the command line and a few built in ones (with syntax errors),
+ * and so must parsing the statements on several threads (`parse_cfg_recursive_descent_parse_tree_parallel`, with chunks of a few tokens so that the small inputs are split too).
+ * Building the AST while parsing (`parse_cfg_recursive_descent_ast`) must give the same AST and syntax errors as converting the parse tree, on the same inputs and on random token sequences,
+ * with the expressions parsed by following the grammar and by precedence climbing (also on random valid expressions).
+ * The backtracking parser (`parse_cfg_packrat_parse_tree`) must build the same trees as the interpreted parser without error recovery when it is made to backtrack on program_grammar, and fail at the same token,
+ * and parse a grammar that needs backtracking in linear time.
+ * Reparsing a tree after an edit (`parse_cfg_recursive_descent_reparse`) must give the same tree and AST as parsing the edited program, on random edits of random programs.
+ * All of them recover from the syntax errors in statements (see `CFG_PredictTable_recover`), so a program reports each of its independent errors and keeps its valid statements.
+ * The arena the trees are allocated in must hand out aligned, disjoint memory and call malloc once per block, not once per node.
+ *
+ * Usage: parser_test [file.cisc ...]
+ * Exits with EXIT_FAILURE if any check fails.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/arena.h"
+#include "../include/grammar.h"
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/source_file.h"
+
+/**
+ * @return the rule `parse_cfg_recursive_descent_parse_tree` used to choose for non-terminal `t` when the next token is `s`: the first rule that is not
+ * direct left-recursive and whose first token can start with `s`.
+ */
+static const ProductionRule *reference_rule(const CFG_GrammarRule *const grammar, const ParseToken t, const ParseToken s)
+{
+    const CFG_GrammarRule *const g_rule = grammar + t - ParseToken_FIRST_NONTERMINAL;
+    for (const ProductionRule *p_rule = g_rule->rules; p_rule < g_rule->rules + g_rule->num_rules; ++p_rule)
+        if (p_rule->tokens[0] != t && ParseToken_can_start_with(p_rule->tokens[0], s, grammar, ParseToken_COUNT_NONTERMINAL))
+            return p_rule;
+    return NULL;
+}
+
+/**
+ * Compare the predict table of `program_grammar` against walking the grammar, for every pair of non-terminal and terminal.
+ * @return the number of pairs that differ.
+ */
+static int check_predict_table(void)
+{
+    CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    int failures = 0;
+    for (ParseToken t = ParseToken_FIRST_NONTERMINAL; t <= ParseToken_MAX; ++t) {
+        for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s) {
+            const bool expected_start = ParseToken_can_start_with(t, s, program_grammar, ParseToken_COUNT_NONTERMINAL);
+            const ProductionRule *const expected_rule = reference_rule(program_grammar, t, s);
+            const ProductionRule *const rule = CFG_PredictTable_rule(&table, t, s);
+            if (CFG_PredictTable_can_start_with(&table, t, s) != expected_start || rule != expected_rule) {
+                fprintf(stderr, "predict table: %s with next token %s: can start %d (expected %d), rule %ld (expected %ld)\n",
+                    ParseToken_to_string(t), ParseToken_to_string(s), CFG_PredictTable_can_start_with(&table, t, s), expected_start,
+                    rule == NULL ? -1L : (long)(rule - program_grammar[t - ParseToken_FIRST_NONTERMINAL].rules),
+                    expected_rule == NULL ? -1L : (long)(expected_rule - program_grammar[t - ParseToken_FIRST_NONTERMINAL].rules));
+                ++failures;
+            }
+        }
+        const size_t left_recursive = find_direct_left_recursive(program_grammar + t - ParseToken_FIRST_NONTERMINAL);
+        if (table.left_recursive[t - ParseToken_FIRST_NONTERMINAL] != (left_recursive == (size_t)-1 ? 0 : left_recursive + 1)) {
+            fprintf(stderr, "predict table: wrong left-recursive rule for %s\n", ParseToken_to_string(t));
+            ++failures;
+        }
+    }
+    return failures;
+}
+
+// Whether two production rules have the same tokens, AST types and promotion (the parsers point into different copies of program_grammar).
+static bool same_rule(const ProductionRule *const a, const ProductionRule *const b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
+    size_t i = 0;
+    for (; a->tokens[i] != PT_NULL && a->tokens[i] == b->tokens[i] && a->ast_types[i] == b->ast_types[i]; ++i);
+    return a->tokens[i] == b->tokens[i] && a->ast_types[i] == b->ast_types[i] && a->promote_index == b->promote_index;
+}
+
+/**
+ * @param path Indices of the nodes from the root to `a` (for the error message).
+ * @return whether the trees rooted at `a` and `b` are the same.
+ */
+static bool same_tree(const ParseTreeNode *const a, const ParseTreeNode *const b, const char *const name, char *const path, const size_t depth)
+{
+    if (a->type != b->type || a->error != b->error || a->has_token != b->has_token || a->span != b->span || !same_rule(a->rule, b->rule)
+        || a->finalized_promo_index != b->finalized_promo_index || a->count != b->count || a->capacity != b->capacity) {
+        fprintf(stderr, "%s: node %.*s differs: %s (%s, %zu tokens, %zu children) instead of %s (%s, %zu tokens, %zu children)\n", name, (int)depth, path,
+            ParseToken_to_string(a->type), ParseErrorType_to_string(a->error), a->span, a->count,
+            ParseToken_to_string(b->type), ParseErrorType_to_string(b->error), b->span, b->count);
+        return false;
+    }
+    for (size_t i = 0; i < a->count; ++i) {
+        // deep trees only show the last part of the path.
+        if (depth < 255)
+            path[depth] = (char)('0' + i % 10);
+        if (!same_tree(a->children + i, b->children + i, name, path, depth < 255 ? depth + 1 : depth))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @param path Indices of the nodes from the root to `a` (for the error message).
+ * @return whether the ASTs rooted at `a` and `b` are the same.
+ */
+static bool same_ast(const ASTNode *const a, const ASTNode *const b, const char *const name, char *const path, const size_t depth)
+{
+    if (a->type != b->type || a->error != b->error || a->token.type != b->token.type || a->token.error != b->token.error
+        || a->token.offset != b->token.offset || a->token.length != b->token.length || a->count != b->count) {
+        fprintf(stderr, "%s: AST node %.*s differs: %s (%s, token at %zu, %zu children) instead of %s (%s, token at %zu, %zu children)\n", name, (int)depth, path,
+            ASTNodeType_to_string(a->type), ASTErrorType_to_string(a->error), a->token.offset, a->count,
+            ASTNodeType_to_string(b->type), ASTErrorType_to_string(b->error), b->token.offset, b->count);
+        return false;
+    }
+    for (size_t i = 0; i < a->count; ++i) {
+        if (depth < 255)
+            path[depth] = (char)('0' + i % 10);
+        if (!same_ast(a->items + i, b->items + i, name, path, depth < 255 ? depth + 1 : depth))
+            return false;
+    }
+    return true;
+}
+
+// Append the syntax errors of the tree (which starts at token `start`) in the order the compiler reports them (see `report_syntax_errors` in main.c).
+static void tree_syntax_errors(const ParseTreeNode *const node, const size_t start, SyntaxErrors *const errors, Arena *const arena)
+{
+    if (node->error == PARSE_ERROR_CHILD_ERROR || node->error == PARSE_ERROR_RECOVERED) {
+        for (size_t i = 0, child_start = start; i < node->count; ++i) {
+            child_start = ParseTreeNode_child_start(node, start, i, child_start);
+            tree_syntax_errors(node->children + i, child_start, errors, arena);
+        }
+    } else if ((node->error == PARSE_ERROR_NO_RULE_MATCHES || node->error == PARSE_ERROR_WRONG_TOKEN) && node->has_token) {
+        arena_da_push(arena, errors, ((SyntaxError){.expected = node->type, .token_index = start}));
+    }
+}
+
+/**
+ * Build the AST of `tree` (parsed from `tokens`) while parsing and compare it and the syntax errors against converting `tree`.
+ * @param precedence The precedence table to parse the expressions with, NULL to follow the grammar.
+ * @return 0 if they are the same, otherwise 1.
+ */
+static int compare_direct_ast(const char *const name, const ParseTreeNode *const tree, const bool tree_ok, const size_t tree_index, const TokenStream *const tokens, const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence, Arena *const arena)
+{
+    ASTNode converted = {.type = AST_PROGRAM}, direct = {.type = AST_PROGRAM};
+    ASTNode_from_ParseTreeNode(&converted, (ParseTreeNodeWithPromo *)tree, tokens, arena);
+    SyntaxErrors expected_errors, errors;
+    da_init(&expected_errors);
+    da_init(&errors);
+    tree_syntax_errors(tree, 0, &expected_errors, arena);
+    size_t index = 0;
+    const bool ok = parse_cfg_recursive_descent_ast(&direct, PT_PROGRAM, &index, tokens, table, precedence, arena, &errors);
+    char path[256] = "";
+    if (ok != tree_ok || index != tree_index) {
+        fprintf(stderr, "%s%s: building the AST while parsing returned %d at token %zu instead of %d at token %zu\n", name, precedence ? " (precedence climbing)" : "", ok, index, tree_ok, tree_index);
+        return 1;
+    }
+    if (errors.count != expected_errors.count) {
+        fprintf(stderr, "%s%s: %zu syntax error(s) instead of %zu\n", name, precedence ? " (precedence climbing)" : "", errors.count, expected_errors.count);
+        return 1;
+    }
+    for (size_t i = 0; i < errors.count; ++i) {
+        if (errors.items[i].expected != expected_errors.items[i].expected || errors.items[i].token_index != expected_errors.items[i].token_index) {
+            fprintf(stderr, "%s%s: syntax error %zu is %s at token %zu instead of %s at token %zu\n", name, precedence ? " (precedence climbing)" : "", i,
+                ParseToken_to_string(errors.items[i].expected), errors.items[i].token_index,
+                ParseToken_to_string(expected_errors.items[i].expected), expected_errors.items[i].token_index);
+            return 1;
+        }
+    }
+    return same_ast(&direct, &converted, name, path, 0) ? 0 : 1;
+}
+
+// Frames of the stack of the recognizer in the tests, the inputs are not nested deeper.
+#define TEST_RECOGNIZER_FRAMES 4096
+
+/**
+ * Recognize `tokens` with `table` and compare the result against the tree parsed from them with the same table:
+ * whether they parse, where the node ends if it does, otherwise the first syntax error of the tree.
+ * @return 0 if they are the same, otherwise 1.
+ */
+static int compare_recognizer(const char *const name, const ParseTreeNode *const tree, const bool tree_ok, const size_t tree_index, const TokenStream *const tokens, const CFG_PredictTable *const table, Arena *const arena)
+{
+    static RecognizerFrame stack[TEST_RECOGNIZER_FRAMES];
+    SyntaxError error = {PT_NULL, SIZE_MAX};
+    size_t index = 0;
+    const bool ok = parse_cfg_recognize(PT_PROGRAM, &index, tokens, table, stack, TEST_RECOGNIZER_FRAMES, &error);
+    SyntaxErrors expected_errors;
+    da_init(&expected_errors);
+    tree_syntax_errors(tree, 0, &expected_errors, arena);
+    if (ok != tree_ok || (ok && index != tree_index)) {
+        fprintf(stderr, "%s: recognizer returned %d at token %zu instead of %d at token %zu\n", name, ok, index, tree_ok, tree_index);
+        return 1;
+    }
+    if (!ok && (expected_errors.count == 0 || error.expected != expected_errors.items[0].expected || error.token_index != expected_errors.items[0].token_index || index != error.token_index)) {
+        fprintf(stderr, "%s: recognizer found %s at token %zu instead of the first syntax error of the tree\n", name, ParseToken_to_string(error.expected), error.token_index);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Parse `tokens` with the backtracking parser (made to backtrack on program_grammar, which does not need it) and compare it against the deterministic parser without error recovery:
+ * the same tree if the program parses, otherwise a failure at the same token.
+ * @param strict The predict table of program_grammar, without error recovery.
+ * @return 0 if they are the same, otherwise 1.
+ */
+static int compare_packrat(const char *const name, const TokenStream *const tokens, const CFG_PredictTable *const strict, Arena *const arena)
+{
+    CFG_PredictTable backtracking = *strict;
+    backtracking.deterministic = false;
+    ParseTreeNode expected = {.type = PT_PROGRAM}, packrat = {.type = PT_PROGRAM};
+    size_t expected_index = 0, packrat_index = 0;
+    const bool expected_ok = parse_cfg_recursive_descent_parse_tree(&expected, &expected_index, tokens, strict, arena);
+    const bool packrat_ok = parse_cfg_packrat_parse_tree(&packrat, &packrat_index, tokens, &backtracking, arena);
+    char path[256] = "";
+    if (packrat_ok != expected_ok || packrat_index != expected_index) {
+        fprintf(stderr, "%s: backtracking parser returned %d at token %zu instead of %d at token %zu\n", name, packrat_ok, packrat_index, expected_ok, expected_index);
+        return 1;
+    }
+    if (expected_ok && !same_tree(&packrat, &expected, name, path, 0))
+        return 1;
+    return compare_recognizer(name, &expected, expected_ok, expected_index, tokens, strict, arena);
+}
+
+// Threads and tokens per chunk of the parallel parser in the tests.
+#define TEST_PARSER_THREADS 4
+#define TEST_PARSER_MIN_CHUNK_TOKENS 2
+
+/**
+ * Parse `input` with the interpreted, the generated and the parallel parser and compare the trees, then compare building the AST while parsing (with and without `precedence`) against converting the tree,
+ * and the backtracking parser against the interpreted one with `strict` (the same grammar without error recovery).
+ * @return 0 if the trees are the same, otherwise 1.
+ */
+static int compare_parsers(const char *const name, const char *const input, const CFG_PredictTable *const table, const CFG_PredictTable *const strict, const CFG_PrecedenceTable *const precedence)
+{
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    Arena arena;
+    arena_init(&arena, 0);
+    ParseTreeNode interpreted = {.type = PT_PROGRAM}, generated = {.type = PT_PROGRAM}, parallel = {.type = PT_PROGRAM};
+    size_t interpreted_index = 0, generated_index = 0, parallel_index = 0;
+    const bool interpreted_ok = parse_cfg_recursive_descent_parse_tree(&interpreted, &interpreted_index, &tokens, table, &arena);
+    const bool generated_ok = parse_program_grammar(&generated, &generated_index, &tokens, &arena);
+    const bool parallel_ok = parse_cfg_recursive_descent_parse_tree_parallel(&parallel, &parallel_index, &tokens, table, TEST_PARSER_THREADS, TEST_PARSER_MIN_CHUNK_TOKENS, &arena);
+    char path[256] = "";
+    int failed = 0;
+    if (generated_ok != interpreted_ok || generated_index != interpreted_index) {
+        fprintf(stderr, "%s: generated parser returned %d at token %zu instead of %d at token %zu\n", name, generated_ok, generated_index, interpreted_ok, interpreted_index);
+        failed = 1;
+    } else if (parallel_ok != interpreted_ok || parallel_index != interpreted_index) {
+        fprintf(stderr, "%s: parallel parser returned %d at token %zu instead of %d at token %zu\n", name, parallel_ok, parallel_index, interpreted_ok, interpreted_index);
+        failed = 1;
+    } else if (!same_tree(&generated, &interpreted, name, path, 0) || !same_tree(&parallel, &interpreted, name, path, 0)) {
+        failed = 1;
+    } else {
+        failed = compare_direct_ast(name, &interpreted, interpreted_ok, interpreted_index, &tokens, table, NULL, &arena)
+            || compare_direct_ast(name, &interpreted, interpreted_ok, interpreted_index, &tokens, table, precedence, &arena)
+            || compare_recognizer(name, &interpreted, interpreted_ok, interpreted_index, &tokens, table, &arena)
+            || compare_packrat(name, &tokens, strict, &arena);
+    }
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    return failed;
+}
+
+// Number of bytes of children arrays in the tree rooted at `node`.
+static size_t tree_children_size(const ParseTreeNode *const node)
+{
+    size_t size = node->capacity * sizeof(ParseTreeNode);
+    for (size_t i = 0; i < node->count; ++i)
+        size += tree_children_size(node->children + i);
+    return size;
+}
+
+#define ARENA_CHECK(condition)                                              \
+    do {                                                                    \
+        if (!(condition)) {                                                 \
+            fprintf(stderr, "arena: check failed: %s\n", #condition);       \
+            ++failures;                                                     \
+        }                                                                   \
+    } while (0)
+
+/**
+ * Check allocation, growth and reset of an arena, then that parsing a large input calls malloc once per block.
+ * @return the number of failed checks.
+ */
+static int check_arena(void)
+{
+    int failures = 0;
+    Arena arena;
+    arena_init(&arena, 256);
+    // allocations are aligned and do not overlap, larger ones get a block of their own.
+    unsigned char *previous = NULL;
+    size_t previous_size = 0;
+    for (size_t size = 1; size <= 1024; size = size * 3 + 1) {
+        unsigned char *const p = arena_alloc(&arena, size);
+        ARENA_CHECK((uintptr_t)p % alignof(max_align_t) == 0);
+        memset(p, (int)size, size);
+        if (previous != NULL)
+            ARENA_CHECK(previous[previous_size - 1] == (unsigned char)previous_size && previous[0] == (unsigned char)previous_size);
+        previous = p;
+        previous_size = size;
+    }
+    ARENA_CHECK(arena.block_count >= 2);
+    // the last allocation grows in place, others are copied.
+    char *const s = arena_strndup(&arena, "abc", 3);
+    char *const grown = arena_grow(&arena, s, 4, 8);
+    ARENA_CHECK(grown == s);
+    char *const other = arena_alloc(&arena, 16);
+    char *const moved = arena_grow(&arena, grown, 8, 16);
+    ARENA_CHECK(moved != grown && moved != other && strcmp(moved, "abc") == 0);
+    // a reset releases what was allocated after the mark, including whole blocks.
+    const ArenaMark mark = arena_mark(&arena);
+    const size_t block_count = arena.block_count;
+    void *const first = arena_alloc(&arena, 64);
+    for (int i = 0; i < 10; ++i)
+        arena_alloc(&arena, 200);
+    arena_reset(&arena, mark);
+    ARENA_CHECK(arena.block_count == block_count);
+    ARENA_CHECK(arena_alloc(&arena, 64) == first);
+    ARENA_CHECK(strcmp(moved, "abc") == 0);
+    arena_free(&arena);
+    ARENA_CHECK(arena.block_count == 0 && arena.blocks == NULL);
+
+    // a tree of many nodes takes a few blocks: every block but the last is at least half full since the children arrays are small.
+    static const char line[] = "x = (a + b * 3 - c) / (d % 7) << 2 == 4 && !x || b;\n";
+    const size_t line_count = 2000;
+    char *const input = malloc(line_count * (sizeof(line) - 1) + 1);
+    if (input == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < line_count; ++i)
+        memcpy(input + i * (sizeof(line) - 1), line, sizeof(line) - 1);
+    input[line_count * (sizeof(line) - 1)] = '\0';
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    arena_init(&arena, 0);
+    ParseTreeNode root = {.type = PT_PROGRAM};
+    size_t index = 0;
+    ARENA_CHECK(parse_program_grammar(&root, &index, &tokens, &arena));
+    const size_t children_size = tree_children_size(&root);
+    ARENA_CHECK(arena.block_count <= 1 + children_size / (ARENA_DEFAULT_BLOCK_SIZE / 2));
+    ARENA_CHECK(arena.block_count * 100 < children_size / sizeof(ParseTreeNode));
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    free(input);
+    return failures;
+}
+
+/**
+ * Check the levels `CFG_PrecedenceTable_init` derives from the expressions of `program_grammar`, and that it rejects a non-terminal that is not an expression.
+ * @return the number of checks that failed.
+ */
+static int check_precedence_table(const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence)
+{
+    int failures = 0;
+    if (precedence->expression != PT_EXPRESSION || precedence->primary != PT_FACTOR) {
+        fprintf(stderr, "precedence table: expression %s with primary %s instead of PT_EXPRESSION with primary PT_FACTOR\n",
+            ParseToken_to_string(precedence->expression), ParseToken_to_string(precedence->primary));
+        return 1;
+    }
+    // from the loosest to the tightest, a level per line.
+    static const ParseToken levels[][6] = {
+        {PT_EQUAL}, {PT_PIPE_PIPE}, {PT_AMPERSAND_AMPERSAND}, {PT_PIPE}, {PT_CARET}, {PT_AMPERSAND},
+        {PT_EQUAL_EQUAL, PT_BANG_EQUAL, PT_LESS_THAN_EQUAL, PT_LESS_THAN, PT_GREATER_THAN_EQUAL, PT_GREATER_THAN},
+        {PT_LESS_THAN_LESS_THAN, PT_GREATER_THAN_GREATER_THAN}, {PT_PLUS, PT_MINUS}, {PT_STAR, PT_FORWARD_SLASH, PT_PERCENT},
+    };
+    const size_t level_count = sizeof(levels) / sizeof(levels[0]);
+    for (size_t level = 0; level < level_count; ++level) {
+        for (const ParseToken *s = levels[level]; s != levels[level] + 6 && *s != PT_NULL; ++s) {
+            if (precedence->binary[*s] != level + 1) {
+                fprintf(stderr, "precedence table: %s has binary level %u instead of %zu\n", ParseToken_to_string(*s), precedence->binary[*s], level + 1);
+                ++failures;
+            }
+        }
+        if (precedence->right_associative[level + 1] != (level == 0)) {
+            fprintf(stderr, "precedence table: level %zu is %s-associative\n", level + 1, precedence->right_associative[level + 1] ? "right" : "left");
+            ++failures;
+        }
+    }
+    static const ParseToken prefixes[] = {PT_TILDE, PT_BANG, PT_MINUS};
+    static const ASTNodeType prefix_types[] = {AST_BITWISE_NOT, AST_LOGICAL_NOT, AST_NEGATE};
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i) {
+        if (precedence->prefix[prefixes[i]] != level_count + 1 || precedence->prefix_type[prefixes[i]] != prefix_types[i]) {
+            fprintf(stderr, "precedence table: prefix %s has level %u and type %s\n", ParseToken_to_string(prefixes[i]),
+                precedence->prefix[prefixes[i]], ASTNodeType_to_string(precedence->prefix_type[prefixes[i]]));
+            ++failures;
+        }
+    }
+    if (precedence->binary_type[PT_EQUAL] != AST_ASSIGN_EQUAL || precedence->binary_type[PT_MINUS] != AST_SUBTRACT) {
+        fprintf(stderr, "precedence table: wrong ASTNodeType of a binary operator\n");
+        ++failures;
+    }
+    CFG_PrecedenceTable statements;
+    if (CFG_PrecedenceTable_init(&statements, table, PT_STATEMENT_LIST) || statements.expression != PT_NULL) {
+        fprintf(stderr, "precedence table: PT_STATEMENT_LIST is not an expression\n");
+        ++failures;
+    }
+    return failures;
+}
+
+/**
+ * Check that a program with errors in several statements (and in a block) reports all of them and keeps the other statements in the AST.
+ * @return the number of checks that failed.
+ */
+static int check_error_recovery(const CFG_PredictTable *const table, const CFG_PrecedenceTable *const precedence)
+{
+    static const char input[] = "int x; x = ; print x; { y = ) ; int z; } read 1 +; x = 2;";
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    Arena arena;
+    arena_init(&arena, 0);
+    ASTNode ast = {.type = AST_PROGRAM};
+    SyntaxErrors errors;
+    da_init(&errors);
+    size_t index = 0;
+    const bool ok = parse_cfg_recursive_descent_ast(&ast, PT_PROGRAM, &index, &tokens, table, precedence, &arena, &errors);
+    int failures = 0;
+    // the program scope has `int x`, `print x`, the block (with `int z`) and `x = 2`.
+    const ASTNode *const scope = ast.count == 1 ? ast.items : NULL;
+    if (ok || index != tokens.count || errors.count != 3) {
+        fprintf(stderr, "error recovery: returned %d at token %zu of %zu with %zu syntax error(s) instead of 3\n", ok, index, tokens.count, errors.count);
+        ++failures;
+    } else if (scope == NULL || scope->count != 4 || scope->items[2].count != 1) {
+        fprintf(stderr, "error recovery: the program scope has %zu statement(s) instead of 4\n", scope == NULL ? 0 : scope->count);
+        ++failures;
+    } else if (ast.error != AST_ERROR_CHILD_ERROR || scope->error != AST_ERROR_CHILD_ERROR || scope->items[2].error != AST_ERROR_CHILD_ERROR || scope->items[1].error != AST_ERROR_NONE) {
+        // the nodes that recovered from an error (the program, its scope and the block) have an error, the statements that parsed do not.
+        fprintf(stderr, "error recovery: the program has %s, its scope %s and the block %s instead of %s\n", ASTErrorType_to_string(ast.error), ASTErrorType_to_string(scope->error),
+            ASTErrorType_to_string(scope->items[2].error), ASTErrorType_to_string(AST_ERROR_CHILD_ERROR));
+        ++failures;
+    }
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    return failures;
+}
+
+// Nesting of the parentheses each followed by `()` that the backtracking parser must parse in linear time.
+#define BACKTRACKING_NESTING 100000
+
+/**
+ * Parse `input` with `table` by backtracking and convert the tree, which must parse (up to the end) if and only if `valid`.
+ * @param expected_index The token the parse must fail at (only checked if not `valid`).
+ * @param expected What the only child of the tree that failed must have expected there.
+ * @return the number of checks that failed.
+ */
+static int check_packrat_input(const char *const name, const char *const input, const CFG_PredictTable *const table, const bool valid, const size_t expected_index, const ParseToken expected)
+{
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    Arena arena;
+    arena_init(&arena, 0);
+    ParseTreeNode tree = {.type = PT_PROGRAM};
+    size_t index = 0;
+    const bool ok = parse_cfg_packrat_parse_tree(&tree, &index, &tokens, table, &arena);
+    ASTNode ast = {.type = AST_PROGRAM};
+    const bool converted = ok && ASTNode_from_ParseTreeNode(&ast, (ParseTreeNodeWithPromo *)&tree, &tokens, &arena);
+    int failures = 0;
+    if (ok != valid || converted != valid || index != (valid ? tokens.count : expected_index)) {
+        fprintf(stderr, "%s: backtracking parser returned %d (converted %d) at token %zu instead of %d at token %zu\n", name, ok, converted, index, valid, valid ? tokens.count : expected_index);
+        ++failures;
+    } else if (!valid && (tree.count != 1 || tree.children[0].type != expected || !tree.children[0].has_token || ParseTreeNode_child_start(&tree, 0, 0, 0) != expected_index)) {
+        fprintf(stderr, "%s: the error is not %s at token %zu\n", name, ParseToken_to_string(expected), expected_index);
+        ++failures;
+    }
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    return failures;
+}
+
+/**
+ * Check the backtracking parser on program_grammar extended with rules that share a prefix with another rule of their non-terminal (so it does not pass `check_cfg_grammar`):
+ * a declaration with an initializer, and a call `(f)()` of a parenthesized expression, tried before the parenthesized expression.
+ * Each `(` of deeply nested parentheses is first parsed as a call that fails at its end, the memo table makes backtracking over the expression in it linear instead of exponential.
+ * @return the number of checks that failed.
+ */
+static int check_backtracking(const CFG_PredictTable *const table)
+{
+    const ProductionRule declaration_rules[] = {
+        {
+            .tokens = (ParseToken[]){PT_TYPE_KEYWORD, PT_IDENTIFIER, PT_STATEMENT_END, PT_NULL},
+            .ast_types = (ASTNodeType[]){AST_FROM_PROMOTION, AST_IDENTIFIER, AST_SKIP, AST_NULL},
+            .promote_index = -1,
+            .promotion_alternate_if_AST_NULL = NULL},
+        {
+            .tokens = (ParseToken[]){PT_TYPE_KEYWORD, PT_IDENTIFIER, PT_ASSIGNMENT_OPERATOR, PT_EXPRESSION, PT_STATEMENT_END, PT_NULL},
+            .ast_types = (ASTNodeType[]){AST_FROM_PROMOTION, AST_IDENTIFIER, AST_SKIP, AST_FROM_PROMOTION, AST_SKIP, AST_NULL},
+            .promote_index = -1,
+            .promotion_alternate_if_AST_NULL = NULL}};
+    const ProductionRule call_rule = {
+        .tokens = (ParseToken[]){PT_LEFT_PAREN, PT_EXPRESSION, PT_RIGHT_PAREN, PT_LEFT_PAREN, PT_RIGHT_PAREN, PT_NULL},
+        .ast_types = (ASTNodeType[]){AST_SKIP, AST_FROM_PROMOTION, AST_SKIP, AST_SKIP, AST_SKIP, AST_NULL},
+        .promote_index = 1,
+        .promotion_alternate_if_AST_NULL = NULL};
+    static CFG_GrammarRule extended[ParseToken_COUNT_NONTERMINAL];
+    static ProductionRule factor_rules[8];
+    memcpy(extended, program_grammar, sizeof(extended));
+    extended[PT_DECLARATION - ParseToken_FIRST_NONTERMINAL].rules = declaration_rules;
+    extended[PT_DECLARATION - ParseToken_FIRST_NONTERMINAL].num_rules = 2;
+    // the call goes before the last rule of the factor, the parenthesized expression.
+    CFG_GrammarRule *const factor = extended + (PT_FACTOR - ParseToken_FIRST_NONTERMINAL);
+    if (factor->num_rules + 1 > sizeof(factor_rules) / sizeof(factor_rules[0])) {
+        fprintf(stderr, "backtracking: the factor of program_grammar has too many rules to extend\n");
+        return 1;
+    }
+    memcpy(factor_rules, factor->rules, (factor->num_rules - 1) * sizeof(ProductionRule));
+    factor_rules[factor->num_rules - 1] = call_rule;
+    factor_rules[factor->num_rules] = factor->rules[factor->num_rules - 1];
+    factor->rules = factor_rules;
+    ++factor->num_rules;
+
+    CFG_PredictTable backtracking;
+    CFG_PredictTable_init(&backtracking, extended);
+    int failures = 0;
+    if (!table->deterministic || backtracking.deterministic) {
+        fprintf(stderr, "backtracking: program_grammar is %sdeterministic and the extended grammar is %sdeterministic\n", table->deterministic ? "" : "not ", backtracking.deterministic ? "" : "not ");
+        ++failures;
+    }
+    failures += check_packrat_input("backtracking", "int x = 1 + 2; int y; y = (x)() * (y); print ((x)()) - x;", &backtracking, true, 0, PT_NULL);
+    // the declaration without an initializer fails at `=`, the one with an initializer at `;`, which is farther.
+    failures += check_packrat_input("backtracking error", "int x; int y = ;", &backtracking, false, 6, PT_EXPRESSION);
+    failures += check_packrat_input("backtracking call error", "x = (y)(;", &backtracking, false, 6, PT_RIGHT_PAREN);
+
+    char *const input = malloc(4 * BACKTRACKING_NESTING + 3);
+    if (input == NULL) {
+        perror("Failed to allocate memory for the backtracking input");
+        exit(EXIT_FAILURE);
+    }
+    memset(input, '(', BACKTRACKING_NESTING);
+    input[BACKTRACKING_NESTING] = 'x';
+    for (size_t i = 0; i < BACKTRACKING_NESTING; ++i)
+        memcpy(input + BACKTRACKING_NESTING + 1 + 3 * i, i % 2 ? ")()" : ")  ", 3);
+    strcpy(input + 4 * BACKTRACKING_NESTING + 1, ";");
+    failures += check_packrat_input("deep backtracking", input, &backtracking, true, 0, PT_NULL);
+    free(input);
+    return failures;
+}
+
+/**
+ * Parse a random program of statements (some with syntax errors), edit one of them (replace, remove or insert statements or tokens),
+ * and compare reparsing the tree of the program against parsing the edited program, and the ASTs they are converted to.
+ * Then undo the edit the same way: every other program is reparsed with an index (`ParseTreeIndex`), which the first reparse fills and the second one uses.
+ * @return the number of edits for which they differ.
+ */
+static int check_reparse(const CFG_PredictTable *const table, const char *const *const lexemes, const size_t lexeme_count)
+{
+    static const char *const statements[] = {
+        "int x; ", "x = 1 + 2 * y; ", "print x << 1; ", "read y; ", "{ int z; z = 3; } ", "if x then { y = 1; } else { y = 2; } ", "if (x) then { } ",
+        "while x { x = x - 1; } ", "repeat { print 1; } until x == 0; ", "factorial(3); ", "{ { x = 1; } print x; } ",
+        "x = ; ", "int ; ", "{ x = ) ; } ", "else { } ", "print (1 + ; ", "x = 1 ",
+    };
+    const size_t statement_count = sizeof(statements) / sizeof(statements[0]);
+    int failures = 0;
+    for (int i = 0; i < 1000; ++i) {
+        // the program, then the program with statements `[edit_at, edit_at + removed)` replaced by `inserted`.
+        const int line_count = 1 + rand() % 12, edit_at = rand() % (line_count + 1), removed = edit_at < line_count ? rand() % 2 + (rand() % 4 == 0) : 0;
+        char inserted[128] = "";
+        if (rand() % 2) {
+            strcat(inserted, statements[rand() % statement_count]);
+        } else {
+            for (int k = rand() % 3; k >= 0; --k)
+                strcat(inserted, lexemes[rand() % lexeme_count]);
+        }
+        char input[1024] = "", edited[1024] = "";
+        for (int line = 0; line <= line_count; ++line) {
+            if (line == edit_at)
+                strcat(edited, inserted);
+            if (line == line_count)
+                break;
+            const char *const statement = statements[rand() % statement_count];
+            strcat(input, statement);
+            if (line < edit_at || line >= edit_at + removed)
+                strcat(edited, statement);
+        }
+
+        Lexer lexer = {0}, edited_lexer = {0};
+        init_lexer(&lexer, input, 0);
+        init_lexer(&edited_lexer, edited, 0);
+        TokenStream tokens, edited_tokens;
+        token_stream_init(&tokens);
+        token_stream_init(&edited_tokens);
+        lex_all(&lexer, &tokens);
+        lex_all(&edited_lexer, &edited_tokens);
+        Arena arena;
+        arena_init(&arena, 0);
+        // the old tree is converted first, so that the promotions it keeps are those of a converted tree.
+        ParseTreeNode reparsed = {.type = PT_PROGRAM}, parsed = {.type = PT_PROGRAM};
+        size_t index = 0;
+        parse_cfg_recursive_descent_parse_tree(&reparsed, &index, &tokens, table, &arena);
+        ASTNode old_ast = {.type = AST_PROGRAM}, reparsed_ast = {.type = AST_PROGRAM}, parsed_ast = {.type = AST_PROGRAM};
+        ASTNode_from_ParseTreeNode(&old_ast, (ParseTreeNodeWithPromo *)&reparsed, &tokens, &arena);
+        ParseTreeIndex tree_index;
+        da_init(&tree_index);
+        ParseTreeIndex *const used_index = i % 2 ? &tree_index : NULL;
+        const TokenEdit edit = TokenEdit_between(&tokens, &edited_tokens);
+        const bool reparsed_ok = parse_cfg_recursive_descent_reparse(&reparsed, &edit, &edited_tokens, table, used_index, &arena);
+        index = 0;
+        const bool parsed_ok = parse_cfg_recursive_descent_parse_tree(&parsed, &index, &edited_tokens, table, &arena);
+        // both trees are converted before they are compared, so that they both have their promotions.
+        ASTNode_from_ParseTreeNode(&reparsed_ast, (ParseTreeNodeWithPromo *)&reparsed, &edited_tokens, &arena);
+        ASTNode_from_ParseTreeNode(&parsed_ast, (ParseTreeNodeWithPromo *)&parsed, &edited_tokens, &arena);
+        char name[64], path[256] = "";
+        snprintf(name, sizeof(name), "reparse %d", i);
+        if (reparsed_ok != parsed_ok || reparsed.span != index) {
+            fprintf(stderr, "%s: reparsing returned %d with %zu tokens instead of %d with %zu tokens\n", name, reparsed_ok, reparsed.span, parsed_ok, index);
+            ++failures;
+        } else if (!same_tree(&reparsed, &parsed, name, path, 0) || !same_ast(&reparsed_ast, &parsed_ast, name, path, 0)) {
+            fprintf(stderr, "%s: \"%s\" edited to \"%s\"\n", name, input, edited);
+            ++failures;
+        } else {
+            // and back to the program.
+            const TokenEdit undo = TokenEdit_between(&edited_tokens, &tokens);
+            const bool undone_ok = parse_cfg_recursive_descent_reparse(&reparsed, &undo, &tokens, table, used_index, &arena);
+            ParseTreeNode original = {.type = PT_PROGRAM};
+            index = 0;
+            const bool original_ok = parse_cfg_recursive_descent_parse_tree(&original, &index, &tokens, table, &arena);
+            ASTNode undone_ast = {.type = AST_PROGRAM}, original_ast = {.type = AST_PROGRAM};
+            ASTNode_from_ParseTreeNode(&undone_ast, (ParseTreeNodeWithPromo *)&reparsed, &tokens, &arena);
+            ASTNode_from_ParseTreeNode(&original_ast, (ParseTreeNodeWithPromo *)&original, &tokens, &arena);
+            snprintf(name, sizeof(name), "reparse %d undone", i);
+            if (undone_ok != original_ok || !same_tree(&reparsed, &original, name, path, 0) || !same_ast(&undone_ast, &original_ast, name, path, 0)) {
+                fprintf(stderr, "%s: \"%s\" edited back to \"%s\"\n", name, edited, input);
+                ++failures;
+            }
+        }
+        da_clear(&tree_index);
+        arena_free(&arena);
+        token_stream_free(&tokens);
+        token_stream_free(&edited_tokens);
+        free_lexer(&lexer);
+        free_lexer(&edited_lexer);
+    }
+    return failures;
+}
+
+// Append a random expression of at most `depth` nested operators to `out`, written with as few parentheses as possible so that precedence decides most of its shape.
+static void random_expression(char *const out, const int depth)
+{
+    static const char *const operands[] = {"x", "y", "1", "2.5", "\"s\""};
+    static const char *const binary[] = {" = ", " || ", " && ", " | ", " ^ ", " & ", " == ", " != ", " < ", " <= ", " > ", " >= ", " << ", " >> ", " + ", " - ", " * ", " / ", " % "};
+    static const char *const prefix[] = {"-", "!", "~"};
+    const int choice = depth <= 0 ? 0 : rand() % 8;
+    if (choice <= 1) {
+        strcat(out, operands[rand() % (sizeof(operands) / sizeof(operands[0]))]);
+    } else if (choice == 2) {
+        strcat(out, prefix[rand() % (sizeof(prefix) / sizeof(prefix[0]))]);
+        random_expression(out, depth - 1);
+    } else if (choice == 3) {
+        strcat(out, rand() % 2 ? "factorial(" : "(");
+        random_expression(out, depth - 1);
+        strcat(out, ")");
+    } else {
+        random_expression(out, depth - 1);
+        strcat(out, binary[rand() % (sizeof(binary) / sizeof(binary[0]))]);
+        random_expression(out, depth - 1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *const inputs[] = {
+        "",
+        "int x; x = 1 + 2 * 3 - 4 / 5 % 6; print x << 2 >> 1; read x;",
+        "x = y = z = !~-1 == 2 != 3 <= 4 < 5 >= 6 > 7 && 8 || 9 & 10 | 11 ^ 12;",
+        "if (x) then { print \"a\"; } else { if x then {} } while x { repeat { x = x - 1; } until x == 0; }",
+        "{{{{ int u; }}}} factorial(factorial(3));",
+        // syntax errors at every level.
+        "int;",
+        "x = ;",
+        "x = 1 +;",
+        "print (1 + 2;",
+        "if x { }",
+        "while { }",
+        "repeat { } until ;",
+        "{ int x;",
+        "}",
+        "x = 1",
+        "1 + 2 * * 3;",
+        "factorial 3;",
+        "x = (1 + (2 * -(y - )) / 3) + 4;",
+        "print ((x) + factorial((y = 2) * 3)) <<;",
+        "int x = 1;",
+        "@ x;",
+        "\"unterminated",
+        // several errors, recovered from at the end of their statement or block.
+        "int x; x = ; print x; { y = ) ; int z; } read 1 +; x = 2;",
+        "{ x = 1 { print ; } int y; } if x then { ) } else { } @; repeat { } until (;",
+        "x = 1 } y = 2;",
+    };
+    CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    CFG_PredictTable_recover(&table, &program_recovery);
+    CFG_PredictTable strict;
+    CFG_PredictTable_init(&strict, program_grammar);
+    CFG_PrecedenceTable precedence;
+    CFG_PrecedenceTable_init(&precedence, &table, PT_EXPRESSION);
+    int failures = check_predict_table() + check_arena() + check_precedence_table(&table, &precedence) + check_error_recovery(&table, &precedence)
+        + check_backtracking(&strict);
+    if (!CFG_supports_direct_ast(program_grammar)) {
+        fprintf(stderr, "program_grammar does not support building the AST while parsing\n");
+        ++failures;
+    }
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "input %zu", i);
+        failures += compare_parsers(name, inputs[i], &table, &strict, &precedence);
+    }
+    // random token sequences, mostly syntax errors in every rule, with a fixed seed so failures can be reproduced.
+    static const char *const lexemes[] = {
+        "int ", "float ", "string ", "x ", "y ", "1 ", "2.5 ", "\"s\" ", "= ", "+ ", "- ", "* ", "/ ", "% ", "<< ", ">> ", "== ", "!= ", "< ", "<= ",
+        "&& ", "|| ", "! ", "~ ", "& ", "| ", "^ ", "( ", ") ", "{ ", "} ", "; ", "if ", "then ", "else ", "while ", "repeat ", "until ", "print ", "read ", "factorial ",
+    };
+    const size_t lexeme_count = sizeof(lexemes) / sizeof(lexemes[0]);
+    srand(458);
+    for (int i = 0; i < 2000; ++i) {
+        char input[512] = "";
+        const int length = 1 + rand() % 40;
+        for (int j = 0; j < length; ++j)
+            strcat(input, lexemes[rand() % lexeme_count]);
+        char name[32];
+        snprintf(name, sizeof(name), "random input %d", i);
+        failures += compare_parsers(name, input, &table, &strict, &precedence);
+    }
+    failures += check_reparse(&table, lexemes, lexeme_count);
+    for (int i = 0; i < 1000; ++i) {
+        char input[8192] = "";
+        random_expression(input, 1 + rand() % 6);
+        strcat(input, ";");
+        char name[32];
+        snprintf(name, sizeof(name), "random expression %d", i);
+        failures += compare_parsers(name, input, &table, &strict, &precedence);
+    }
+    for (int i = 1; i < argc; ++i) {
+        SourceFile source;
+        if (!source_file_open(&source, argv[i])) {
+            fprintf(stderr, "Error: Unable to open file %s\n", argv[i]);
+            ++failures;
+            continue;
+        }
+        failures += compare_parsers(argv[i], source.text, &table, &strict, &precedence);
+        source_file_close(&source);
+    }
+    if (failures) {
+        fprintf(stderr, "%d parser check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All parser checks passed.\n");
+    return EXIT_SUCCESS;
+}
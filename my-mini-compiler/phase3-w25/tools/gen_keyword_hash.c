@@ -0,0 +1,248 @@
+/**
+ * Build-time generator for the keyword perfect hash used by the lexer.
+ *
+ * Reads the `TokenType` enum from tokens.h, collects every `TOKEN_<NAME>_KEYWORD` enumerator (the keyword is `<NAME>` in lower case) and searches for a hash of
+ * (length, first character, last character) that maps every keyword to a distinct slot of a power of two sized table.
+ * The result is written as a header with the table and inline `keyword_index`/`keyword_lookup` functions so that recognising a keyword costs one hash and one confirming compare.
+ *
+ * This runs as a CMake custom command, so adding a keyword to tokens.h regenerates the table.
+ *
+ * Usage: gen_keyword_hash <path/to/tokens.h> <path/to/keyword_hash.h>
+ */
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KEYWORDS 255 // keyword_table stores indices plus one in an unsigned char.
+#define MAX_NAME_LENGTH 64
+#define MAX_TABLE_SIZE 4096
+
+typedef struct _Keyword
+{
+    char enumerator[MAX_NAME_LENGTH]; // e.g. TOKEN_INT_KEYWORD
+    char lexeme[MAX_NAME_LENGTH];     // e.g. int
+    size_t length;
+} Keyword;
+
+static char *read_file(const char *const path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = malloc((size_t)size + 1);
+    if (text == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    const size_t read = fread(text, 1, (size_t)size, file);
+    text[read] = '\0';
+    fclose(file);
+    return text;
+}
+
+/**
+ * Collect the keyword enumerators of `enum _TokenType` in `text`.
+ * @return the number of keywords found, or -1 if the enum could not be found.
+ */
+static int parse_keywords(const char *text, Keyword keywords[MAX_KEYWORDS])
+{
+    static const char prefix[] = "TOKEN_", suffix[] = "_KEYWORD";
+    const char *p = strstr(text, "enum _TokenType");
+    if (p == NULL || (p = strchr(p, '{')) == NULL)
+        return -1;
+    int count = 0;
+    for (++p; *p != '\0' && *p != '}';) {
+        // skip comments, they may contain anything.
+        if (p[0] == '/' && p[1] == '/') {
+            while (*p != '\0' && *p != '\n')
+                ++p;
+            continue;
+        }
+        if (p[0] == '/' && p[1] == '*') {
+            const char *end = strstr(p + 2, "*/");
+            p = end == NULL ? p + strlen(p) : end + 2;
+            continue;
+        }
+        if (!(isalpha((unsigned char)*p) || *p == '_')) {
+            ++p;
+            continue;
+        }
+        const char *const start = p;
+        while (isalnum((unsigned char)*p) || *p == '_')
+            ++p;
+        const size_t length = (size_t)(p - start);
+        if (length >= MAX_NAME_LENGTH
+            || length <= sizeof(prefix) - 1 + sizeof(suffix) - 1
+            || strncmp(start, prefix, sizeof(prefix) - 1) != 0
+            || strncmp(p - (sizeof(suffix) - 1), suffix, sizeof(suffix) - 1) != 0)
+            continue;
+        if (count == MAX_KEYWORDS)
+            return -1;
+        Keyword *const k = keywords + count++;
+        memcpy(k->enumerator, start, length);
+        k->enumerator[length] = '\0';
+        k->length = length - (sizeof(prefix) - 1) - (sizeof(suffix) - 1);
+        for (size_t i = 0; i < k->length; ++i)
+            k->lexeme[i] = (char)tolower((unsigned char)start[sizeof(prefix) - 1 + i]);
+        k->lexeme[k->length] = '\0';
+    }
+    return count;
+}
+
+static inline unsigned keyword_hash(const char *const s, const size_t length, const unsigned first_multiplier, const unsigned last_multiplier, const unsigned mask)
+{
+    return ((unsigned)length + (unsigned char)s[0] * first_multiplier + (unsigned char)s[length - 1] * last_multiplier) & mask;
+}
+
+/**
+ * Search for multipliers such that every keyword hashes to a distinct slot of a table with `mask + 1` entries.
+ */
+static bool find_perfect_hash(const Keyword *const keywords, const int count, const unsigned mask, unsigned *const first_multiplier, unsigned *const last_multiplier)
+{
+    static bool used[MAX_TABLE_SIZE];
+    for (unsigned a = 1; a < 256; ++a) {
+        for (unsigned b = 0; b < 256; ++b) {
+            memset(used, 0, (mask + 1) * sizeof(bool));
+            int i;
+            for (i = 0; i < count; ++i) {
+                const unsigned h = keyword_hash(keywords[i].lexeme, keywords[i].length, a, b, mask);
+                if (used[h])
+                    break;
+                used[h] = true;
+            }
+            if (i == count) {
+                *first_multiplier = a;
+                *last_multiplier = b;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <path/to/tokens.h> <path/to/keyword_hash.h>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    char *const text = read_file(argv[1]);
+    if (text == NULL) {
+        fprintf(stderr, "Error: Unable to read %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    static Keyword keywords[MAX_KEYWORDS];
+    const int count = parse_keywords(text, keywords);
+    free(text);
+    if (count <= 0) {
+        fprintf(stderr, "Error: no TOKEN_*_KEYWORD enumerators found in enum _TokenType of %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    size_t min_length = SIZE_MAX, max_length = 0;
+    for (int i = 0; i < count; ++i) {
+        if (keywords[i].length < min_length) min_length = keywords[i].length;
+        if (keywords[i].length > max_length) max_length = keywords[i].length;
+    }
+
+    unsigned size = 16, first_multiplier = 0, last_multiplier = 0;
+    while (size < (unsigned)count)
+        size *= 2;
+    for (; size <= MAX_TABLE_SIZE; size *= 2)
+        if (find_perfect_hash(keywords, count, size - 1, &first_multiplier, &last_multiplier))
+            break;
+    if (size > MAX_TABLE_SIZE) {
+        fprintf(stderr, "Error: unable to find a perfect hash for %d keywords\n", count);
+        return EXIT_FAILURE;
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    // index of the keyword in each slot of the table, -1 if the slot is empty.
+    static int slot_keyword[MAX_TABLE_SIZE];
+    memset(slot_keyword, -1, sizeof(slot_keyword));
+    for (int i = 0; i < count; ++i)
+        slot_keyword[keyword_hash(keywords[i].lexeme, keywords[i].length, first_multiplier, last_multiplier, size - 1)] = i;
+
+    fprintf(out,
+        "/* keyword_hash.h */\n"
+        "/* Generated by gen_keyword_hash from %s, do not edit. */\n"
+        "/* tokens.h must be included before this header. */\n"
+        "#ifndef KEYWORD_HASH_H\n"
+        "#define KEYWORD_HASH_H\n"
+        "\n"
+        "#include <stddef.h>\n"
+        "#include <string.h>\n"
+        "\n"
+        "#define KEYWORD_COUNT %d\n"
+        "#define KEYWORD_MIN_LENGTH %zu\n"
+        "#define KEYWORD_MAX_LENGTH %zu\n"
+        "#define KEYWORD_HASH_SIZE %u\n"
+        "\n"
+        "static inline unsigned keyword_hash(const char *const s, const size_t length)\n"
+        "{\n"
+        "    return ((unsigned)length + (unsigned char)s[0] * %uU + (unsigned char)s[length - 1] * %uU) & %uU;\n"
+        "}\n"
+        "\n"
+        "/* Keywords in the order they are declared in TokenType, this is the order keyword_index() counts in. */\n"
+        "static const struct\n"
+        "{\n"
+        "    const char *lexeme;\n"
+        "    size_t length;\n"
+        "    TokenType type;\n"
+        "} keyword_list[KEYWORD_COUNT] = {\n",
+        argv[1], count, min_length, max_length, size, first_multiplier, last_multiplier, size - 1);
+    for (int i = 0; i < count; ++i)
+        fprintf(out, "    {\"%s\", %zu, %s},\n", keywords[i].lexeme, keywords[i].length, keywords[i].enumerator);
+    fprintf(out,
+        "};\n"
+        "\n"
+        "/* Hash table of keyword_list indices plus one, 0 marks an empty slot. */\n"
+        "static const unsigned char keyword_table[KEYWORD_HASH_SIZE] = {\n");
+    for (unsigned h = 0; h < size; ++h) {
+        if (slot_keyword[h] < 0)
+            continue;
+        fprintf(out, "    [%u] = %d, // %s\n", h, slot_keyword[h] + 1, keywords[slot_keyword[h]].lexeme);
+    }
+    fprintf(out,
+        "};\n"
+        "\n"
+        "/**\n"
+        " * @param s The lexeme to look up, it does not need to be null-terminated.\n"
+        " * @param length The number of characters in the lexeme (must be at least 1).\n"
+        " * @return The index of the lexeme in keyword_list, or -1 if it is not a keyword.\n"
+        " */\n"
+        "static inline int keyword_index(const char *const s, const size_t length)\n"
+        "{\n"
+        "    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH)\n"
+        "        return -1;\n"
+        "    const int i = keyword_table[keyword_hash(s, length)] - 1;\n"
+        "    if (i >= 0 && keyword_list[i].length == length && memcmp(keyword_list[i].lexeme, s, length) == 0)\n"
+        "        return i;\n"
+        "    return -1;\n"
+        "}\n"
+        "\n"
+        "/**\n"
+        " * @param s The lexeme to look up, it does not need to be null-terminated.\n"
+        " * @param length The number of characters in the lexeme (must be at least 1).\n"
+        " * @return The keyword TokenType of the lexeme, or TOKEN_IDENTIFIER if it is not a keyword.\n"
+        " */\n"
+        "static inline TokenType keyword_lookup(const char *const s, const size_t length)\n"
+        "{\n"
+        "    const int i = keyword_index(s, length);\n"
+        "    return i < 0 ? TOKEN_IDENTIFIER : keyword_list[i].type;\n"
+        "}\n"
+        "\n"
+        "#endif /* KEYWORD_HASH_H */\n");
+    fclose(out);
+    return EXIT_SUCCESS;
+}
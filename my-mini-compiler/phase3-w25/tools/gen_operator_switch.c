@@ -0,0 +1,277 @@
+/**
+ * Build-time generator for the operator matcher and the operator part of the lexer's DFA.
+ *
+ * Compiled against operators.h, it builds a trie of `reduced_operators` and writes it out as nested `switch` statements on the characters of the input,
+ * so that finding the longest operator at a position costs at most one switch per character of the operator instead of a `strncmp` per table entry.
+ * The same trie is written out as rows of the lexer's tables (see src/lexer/lexer.c): a character class per operator character and a DFA state per operator.
+ * It also checks that every operator in `reduced_operators` is one of the `extended_operators`, and that every prefix of an operator is an operator too (the DFA never backs up),
+ * so enabling a compound assignment operator is only a matter of uncommenting it and adding its TokenType at the same place in tokens.h.
+ *
+ * This runs as a CMake custom command, so changing the operator tables regenerates the matcher and the lexer's tables.
+ *
+ * Usage: gen_operator_switch <path/to/operator_switch.h> <path/to/operator_dfa.h>
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/operators.h"
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+static bool is_extended_operator(const char *const op)
+{
+    for (size_t i = 0; i < COUNT(extended_operators); ++i)
+        if (strcmp(extended_operators[i], op) == 0)
+            return true;
+    return false;
+}
+
+// Index of the operator equal to the first `length` characters of `prefix`, or -1.
+static int operator_with_prefix(const char *const prefix, const size_t length)
+{
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i)
+        if (strlen(reduced_operators[i]) == length && strncmp(reduced_operators[i], prefix, length) == 0)
+            return (int)i;
+    return -1;
+}
+
+// Whether some operator is longer than `length` and starts with the first `length` characters of `prefix`.
+static bool operator_extends(const char *const prefix, const size_t length)
+{
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i)
+        if (strlen(reduced_operators[i]) > length && strncmp(reduced_operators[i], prefix, length) == 0)
+            return true;
+    return false;
+}
+
+static void print_char_literal(FILE *const out, const char c)
+{
+    if (c == '\'' || c == '\\')
+        fprintf(out, "'\\%c'", c);
+    else
+        fprintf(out, "'%c'", c);
+}
+
+/**
+ * Write the code matching the rest of an operator after the first `length` characters (`prefix`) matched.
+ * Every path ends with a return: the longest operator found, or -1 if the prefix is not an operator itself.
+ */
+static void emit_node(FILE *const out, char *const prefix, const size_t length, const int indent)
+{
+    if (operator_extends(prefix, length)) {
+        fprintf(out, "%*sswitch (s[%zu]) {\n", indent, "", length);
+        // every character that continues an operator, once each, in table order.
+        for (size_t i = 0; i < COUNT(reduced_operators); ++i) {
+            const char *const op = reduced_operators[i];
+            if (strlen(op) <= length || strncmp(op, prefix, length) != 0)
+                continue;
+            bool seen = false;
+            for (size_t j = 0; j < i && !seen; ++j)
+                seen = strlen(reduced_operators[j]) > length && strncmp(reduced_operators[j], op, length + 1) == 0;
+            if (seen)
+                continue;
+            prefix[length] = op[length];
+            fprintf(out, "%*scase ", indent, "");
+            print_char_literal(out, op[length]);
+            fprintf(out, ":\n");
+            emit_node(out, prefix, length + 1, indent + 4);
+        }
+        fprintf(out, "%*s}\n", indent, "");
+    }
+    const int i = length == 0 ? -1 : operator_with_prefix(prefix, length);
+    if (i < 0)
+        fprintf(out, "%*sreturn -1;\n", indent, "");
+    else
+        fprintf(out, "%*s*length = %zu;\n%*sreturn %d; // \"%s\"\n", indent, "", length, indent, "", i, reduced_operators[i]);
+}
+
+// The lexer's own class of '!', which also ends a block comment: it is not one of the classes of the operator characters.
+#define BANG '!'
+
+// Characters of the operators in order of first appearance in reduced_operators, '!' left out. Operator character `c` is in class CC_FIRST_OPERATOR + (index of `c`).
+static char operator_chars[256];
+static size_t operator_char_count = 0;
+
+static void print_char_class(FILE *const out, const char c)
+{
+    if (c == BANG) {
+        fprintf(out, "CC_BANG");
+        return;
+    }
+    const size_t k = (size_t)(strchr(operator_chars, c) - operator_chars);
+    fprintf(out, "CC_FIRST_OPERATOR + %zu", k);
+}
+
+/**
+ * Write the macros the lexer builds its tables with: the class of each character of extended_operators, the transitions of the states of the operators and what each of them accepts.
+ * Operator `i` of reduced_operators is state S_FIRST_OPERATOR + i of the DFA, it is reached from the state of the operator without its last character (or from S_START).
+ */
+static void emit_dfa(FILE *const out)
+{
+    fprintf(out,
+        "/* operator_dfa.h */\n"
+        "/* Generated by gen_operator_switch from operators.h, do not edit. */\n"
+        "#ifndef OPERATOR_DFA_H\n"
+        "#define OPERATOR_DFA_H\n"
+        "\n"
+        "// One DFA state per operator of reduced_operators, from S_FIRST_OPERATOR on, in the same order.\n"
+        "#define OPERATOR_STATE_COUNT %zu\n"
+        "// One character class per character of the operators, from CC_FIRST_OPERATOR on ('!' is CC_BANG, which also ends a block comment).\n"
+        "#define OPERATOR_CHAR_CLASS_COUNT %zu\n"
+        "\n"
+        "// The class of every character of extended_operators but '!', CC_PRINTABLE (an invalid character) if it is in no operator of reduced_operators.\n"
+        "#define OPERATOR_CHAR_CLASS_TABLE \\\n",
+        COUNT(reduced_operators), operator_char_count);
+    char seen[256] = {0};
+    for (size_t i = 0; i < COUNT(extended_operators); ++i) {
+        for (const char *c = extended_operators[i]; *c != '\0'; ++c) {
+            if (*c == BANG || seen[(unsigned char)*c])
+                continue;
+            seen[(unsigned char)*c] = 1;
+            fprintf(out, "    [");
+            print_char_literal(out, *c);
+            fprintf(out, "] = ");
+            if (strchr(operator_chars, *c) != NULL)
+                print_char_class(out, *c);
+            else
+                fprintf(out, "CC_PRINTABLE");
+            fprintf(out, ", \\\n");
+        }
+    }
+    fprintf(out,
+        "\n"
+        "// Every class of the operator characters (but CC_BANG) goes to state `next`, for the states they do not end (strings and comments).\n"
+        "#define OPERATOR_CHAR_CLASSES_TO(next) \\\n");
+    for (size_t k = 0; k < operator_char_count; ++k)
+        fprintf(out, "    [CC_FIRST_OPERATOR + %zu] = next, \\\n", k);
+
+    // S_START goes to the state of each operator of one character, and '!' is an invalid character if it is not one.
+    fprintf(out,
+        "\n"
+        "// The transitions of S_START to the operators of one character.\n"
+        "#define OPERATOR_START_TRANSITIONS \\\n");
+    bool bang = false;
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i) {
+        const char *const op = reduced_operators[i];
+        if (op[1] != '\0')
+            continue;
+        bang = bang || op[0] == BANG;
+        fprintf(out, "    [");
+        print_char_class(out, op[0]);
+        fprintf(out, "] = S_FIRST_OPERATOR + %zu, /* \"%s\" */ \\\n", i, op);
+    }
+    if (!bang)
+        fprintf(out, "    [CC_BANG] = S_INVALID, \\\n");
+
+    fprintf(out,
+        "\n"
+        "// The transitions of the state of each operator to the operators one character longer, every other character ends it.\n"
+        "#define OPERATOR_TRANSITIONS \\\n");
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i) {
+        const char *const op = reduced_operators[i];
+        const size_t length = strlen(op);
+        if (!operator_extends(op, length))
+            continue;
+        fprintf(out, "    [S_FIRST_OPERATOR + %zu] = { /* \"%s\" */ \\\n", i, op);
+        for (size_t j = 0; j < COUNT(reduced_operators); ++j) {
+            const char *const next = reduced_operators[j];
+            if (strlen(next) != length + 1 || strncmp(next, op, length) != 0)
+                continue;
+            fprintf(out, "        [");
+            print_char_class(out, next[length]);
+            fprintf(out, "] = S_FIRST_OPERATOR + %zu, /* \"%s\" */ \\\n", j, next);
+        }
+        fprintf(out, "    }, \\\n");
+    }
+
+    fprintf(out,
+        "\n"
+        "// What the state of each operator accepts: its TokenType.\n"
+        "#define OPERATOR_ACCEPTS \\\n");
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i)
+        fprintf(out, "    [S_FIRST_OPERATOR + %zu] = {(TokenType)(TokenType_FIRST_OPERATOR + %zu), ERROR_NONE}, /* \"%s\" */ \\\n", i, i, reduced_operators[i]);
+    fprintf(out,
+        "\n"
+        "#endif /* OPERATOR_DFA_H */\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <path/to/operator_switch.h> <path/to/operator_dfa.h>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    size_t max_length = 0;
+    for (size_t i = 0; i < COUNT(reduced_operators); ++i) {
+        const char *const op = reduced_operators[i];
+        if (op[0] == '\0') {
+            fprintf(stderr, "Error: empty operator at index %zu of reduced_operators\n", i);
+            return EXIT_FAILURE;
+        }
+        if (!is_extended_operator(op)) {
+            fprintf(stderr, "Error: operator \"%s\" of reduced_operators is not in extended_operators\n", op);
+            return EXIT_FAILURE;
+        }
+        if (operator_with_prefix(op, strlen(op)) != (int)i) {
+            fprintf(stderr, "Error: operator \"%s\" appears more than once in reduced_operators\n", op);
+            return EXIT_FAILURE;
+        }
+        // the DFA stops at the first character that does not continue the operator, so the operator without its last character must be one too.
+        if (strlen(op) > 1 && operator_with_prefix(op, strlen(op) - 1) < 0) {
+            fprintf(stderr, "Error: operator \"%s\" of reduced_operators starts with \"%.*s\", which is not in reduced_operators\n", op, (int)strlen(op) - 1, op);
+            return EXIT_FAILURE;
+        }
+        if (strlen(op) > max_length)
+            max_length = strlen(op);
+        for (const char *c = op; *c != '\0'; ++c)
+            if (*c != BANG && strchr(operator_chars, *c) == NULL)
+                operator_chars[operator_char_count++] = *c;
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out,
+        "/* operator_switch.h */\n"
+        "/* Generated by gen_operator_switch from operators.h, do not edit. */\n"
+        "#ifndef OPERATOR_SWITCH_H\n"
+        "#define OPERATOR_SWITCH_H\n"
+        "\n"
+        "#define OPERATOR_COUNT %zu\n"
+        "#define OPERATOR_MAX_LENGTH %zu\n"
+        "\n"
+        "/**\n"
+        " * Find the longest operator of reduced_operators at the start of `s`.\n"
+        " * @param s The input, it is not read past the first character that cannot continue an operator (e.g. its null character).\n"
+        " * @param length Set to the number of characters of the operator, unchanged if there is none.\n"
+        " * @return The index of the operator in reduced_operators, or -1 if `s` does not start with an operator.\n"
+        " */\n"
+        "static inline int operator_match(const char *const s, unsigned *const length)\n"
+        "{\n",
+        COUNT(reduced_operators), max_length);
+    char prefix[64];
+    if (max_length >= sizeof(prefix)) {
+        fprintf(stderr, "Error: operators longer than %zu characters are not supported\n", sizeof(prefix) - 1);
+        fclose(out);
+        return EXIT_FAILURE;
+    }
+    emit_node(out, prefix, 0, 4);
+    fprintf(out,
+        "}\n"
+        "\n"
+        "#endif /* OPERATOR_SWITCH_H */\n");
+    fclose(out);
+
+    out = fopen(argv[2], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    emit_dfa(out);
+    fclose(out);
+    return EXIT_SUCCESS;
+}
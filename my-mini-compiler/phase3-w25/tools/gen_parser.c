@@ -0,0 +1,325 @@
+/**
+ * Build-time generator for the parser of program_grammar.
+ *
+ * Compiled against grammar.h, it writes a C file with one function per non-terminal that does what `parse_cfg_recursive_descent_parse_tree` does
+ * for that non-terminal, with the grammar walk resolved at build time:
+ * - the production rule is chosen by a `switch` on the next token (cases from the predict table, see `CFG_PredictTable_init`),
+ * - terminals are matched inline, non-terminals are parsed by a direct call to their function,
+ * - the children array of every rule is allocated in the arena with its size known at build time,
+ * - left recursion is a loop only in the functions of the non-terminals that have a left-recursive rule, which appends each repetition to the same node (see `ParseTreeNode_continue_left_recursion`),
+ * - the errors in the items of the list of program_recovery are recovered from where the item is parsed, the nodes that can contain the list take PARSE_ERROR_RECOVERED from their children.
+ * The trees (including errors and the `rule` pointers, which point into the program_grammar of the generated file) are the same as the interpreted parser's.
+ *
+ * This runs as a CMake custom command, so changing program_grammar regenerates the parser.
+ *
+ * Usage: gen_parser <path/to/program_parser.c>
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/grammar.h"
+
+static const CFG_GrammarRule *grammar_rule(const ParseToken t)
+{
+    return program_grammar + t - ParseToken_FIRST_NONTERMINAL;
+}
+
+// Whether a node of each non-terminal can contain the list of program_recovery, and so recover from an error.
+static bool can_recover[ParseToken_COUNT_NONTERMINAL];
+
+static void init_can_recover(void)
+{
+    can_recover[program_recovery.list - ParseToken_FIRST_NONTERMINAL] = true;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (ParseToken t = ParseToken_FIRST_NONTERMINAL; t <= ParseToken_MAX; ++t) {
+            const CFG_GrammarRule *const g_rule = grammar_rule(t);
+            for (size_t r = 0; r < g_rule->num_rules && !can_recover[t - ParseToken_FIRST_NONTERMINAL]; ++r) {
+                for (const ParseToken *s = g_rule->rules[r].tokens; *s != PT_NULL; ++s) {
+                    if (ParseToken_IS_NONTERMINAL(*s) && can_recover[*s - ParseToken_FIRST_NONTERMINAL]) {
+                        can_recover[t - ParseToken_FIRST_NONTERMINAL] = changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static size_t rule_length(const ProductionRule *const rule)
+{
+    size_t length = 0;
+    while (rule->tokens[length] != PT_NULL)
+        ++length;
+    return length;
+}
+
+/**
+ * Write the index of child `i` of `rule` in `node->children` to `buffer`: `i` itself, or `first + i - 1` for the repetition of a left-recursive rule whose children start at `first`.
+ */
+static const char *child_index(char buffer[32], const bool repetition, const size_t i)
+{
+    if (!repetition)
+        snprintf(buffer, 32, "%zu", i);
+    else if (i == 1)
+        snprintf(buffer, 32, "first");
+    else
+        snprintf(buffer, 32, "first + %zu", i - 1);
+    return buffer;
+}
+
+// Whether `rule` of non-terminal `t` is right-recursive: the span of its nodes stops before their last child (see `ParseTreeNode_is_list`).
+static bool is_list_rule(const ParseToken t, const ProductionRule *const rule)
+{
+    const size_t length = rule_length(rule);
+    return length > 1 && rule->tokens[0] != t && rule->tokens[length - 1] == t;
+}
+
+/**
+ * Write the code parsing the children of `rule` into `node->children`, returning from the function on the first child that fails (except the item of the list of program_recovery).
+ * @param repetition Whether this is a repetition of the left-recursive `rule`: its children after the first one are parsed from `first` on (see `ParseTreeNode_continue_left_recursion`),
+ * otherwise all of them are parsed from 0 on.
+ * @param list Whether `rule` is right-recursive: the span of the node is set before its last child.
+ */
+static void emit_children(FILE *const out, const ProductionRule *const rule, const bool repetition, const bool list, const int indent)
+{
+    const size_t length = rule_length(rule);
+    char index[32], end[32];
+    // the arguments of `child_failed` after the failed child: where the children of the rule start and end.
+    const char *const bounds = repetition ? "first - 1, first + %zu" : "0, %zu";
+    child_index(end, repetition, length);
+    for (size_t i = repetition ? 1 : 0; i < length; ++i) {
+        const ParseToken t = rule->tokens[i];
+        child_index(index, repetition, i);
+        if (list && i + 1 == length)
+            fprintf(out, "%*snode->span = *index - start;\n", indent, "");
+        if (ParseToken_IS_TERMINAL(t)) {
+            fprintf(out, "%*snode->children[%s] = terminal_node(%s, true);\n", indent, "", index, ParseToken_to_string(t));
+            fprintf(out, "%*sif (input->types[*index] != %s) {\n", indent, "", ParseToken_to_string(t));
+            fprintf(out, "%*s    node->children[%s].error = PARSE_ERROR_WRONG_TOKEN;\n", indent, "", index);
+            fprintf(out, "%*s    return child_failed(node, %s, ", indent, "", index);
+        } else if (rule == grammar_rule(program_recovery.list)->rules && i == 0) {
+            // the item of the list: its tokens are skipped if it fails, and the list goes on.
+            fprintf(out, "%*snode->children[0].type = %s;\n", indent, "", ParseToken_to_string(t));
+            fprintf(out, "%*sif (!parse_%s(node->children, index, input, arena)) {\n", indent, "", ParseToken_to_string(t));
+            fprintf(out, "%*s    *index = CFG_Recovery_skip(&program_recovery, input, *index);\n", indent, "");
+            fprintf(out, "%*s    node->error = PARSE_ERROR_RECOVERED;\n", indent, "");
+            fprintf(out, "%*s} else if (node->children[0].error) {\n", indent, "");
+            fprintf(out, "%*s    node->error = PARSE_ERROR_RECOVERED;\n", indent, "");
+            fprintf(out, "%*s}\n", indent, "");
+            continue;
+        } else {
+            fprintf(out, "%*snode->children[%s].type = %s;\n", indent, "", index, ParseToken_to_string(t));
+            fprintf(out, "%*sif (!parse_%s(node->children + %s, index, input, arena))\n", indent, "", ParseToken_to_string(t), index);
+            fprintf(out, "%*s    return child_failed(node, %s, ", indent, "", index);
+        }
+        fprintf(out, bounds, repetition ? length - 1 : length);
+        fprintf(out, list && i + 1 == length ? ", node->span);\n" : ", *index - start);\n");
+        if (ParseToken_IS_TERMINAL(t)) {
+            fprintf(out, "%*s}\n", indent, "");
+            fprintf(out, "%*snode->children[%s].span = 1;\n", indent, "", index);
+            fprintf(out, "%*s++(*index);\n", indent, "");
+        } else if (can_recover[t - ParseToken_FIRST_NONTERMINAL]) {
+            // a child that parsed has an error only if it recovered from one.
+            fprintf(out, "%*sif (node->children[%s].error)\n", indent, "", index);
+            fprintf(out, "%*s    node->error = PARSE_ERROR_RECOVERED;\n", indent, "");
+        }
+    }
+    fprintf(out, "%*snode->count = %s;\n", indent, "", end);
+}
+
+/**
+ * Write the condition under which the parser continues the left-recursive rule: its second token can start with the next token.
+ */
+static void emit_can_start_with(FILE *const out, const CFG_PredictTable *const table, const ParseToken t)
+{
+    if (ParseToken_IS_TERMINAL(t))
+        fprintf(out, "input->types[*index] == %s", ParseToken_to_string(t));
+    else if (table->nullable[t - ParseToken_FIRST_NONTERMINAL])
+        fprintf(out, "true");
+    else
+        fprintf(out, "(UINT64_C(0x%016llx) >> input->types[*index]) & 1", (unsigned long long)table->first[t - ParseToken_FIRST_NONTERMINAL]);
+}
+
+static void emit_rule(FILE *const out, const CFG_PredictTable *const table, const ParseToken t, const size_t r)
+{
+    const CFG_GrammarRule *const g_rule = grammar_rule(t);
+    const ProductionRule *const rule = g_rule->rules + r;
+    const size_t length = rule_length(rule);
+    fprintf(out, "        node->rule = RULE(%s, %zu);\n", ParseToken_to_string(t), r);
+    if (length > 0) {
+        fprintf(out, "        node->children = arena_alloc(arena, %zu * sizeof(ParseTreeNode));\n", length);
+        fprintf(out, "        node->capacity = %zu;\n", length);
+    }
+    const bool list = is_list_rule(t, rule);
+    emit_children(out, rule, false, list, 8);
+    // the interpreted parser only takes the left-recursive rule into account if it comes before the chosen rule.
+    const size_t left_recursive = table->left_recursive[t - ParseToken_FIRST_NONTERMINAL];
+    if (left_recursive == 0 || left_recursive - 1 > r || g_rule->rules[left_recursive - 1].tokens[1] == PT_NULL) {
+        if (!list)
+            fprintf(out, "        node->span = *index - start;\n");
+        fprintf(out, "        return true;\n");
+        return;
+    }
+    const ProductionRule *const lr_rule = g_rule->rules + left_recursive - 1;
+    const size_t lr_length = rule_length(lr_rule);
+    fprintf(out, "        while (");
+    emit_can_start_with(out, table, lr_rule->tokens[1]);
+    fprintf(out, ") {\n");
+    fprintf(out, "            node->span = *index - start;\n");
+    fprintf(out, "            const size_t first = ParseTreeNode_continue_left_recursion(node, RULE(%s, %zu), %zu, arena);\n", ParseToken_to_string(t), left_recursive - 1, lr_length);
+    emit_children(out, lr_rule, true, false, 12);
+    fprintf(out, "        }\n");
+    fprintf(out, "        node->span = *index - start;\n");
+    fprintf(out, "        return true;\n");
+}
+
+static void emit_nonterminal(FILE *const out, const CFG_PredictTable *const table, const ParseToken t)
+{
+    const CFG_GrammarRule *const g_rule = grammar_rule(t);
+    const uint8_t *const predict = table->predict[t - ParseToken_FIRST_NONTERMINAL];
+    // the rule that the most terminals predict becomes the default case if every terminal predicts some rule.
+    size_t default_rule = SIZE_MAX, most = 0;
+    bool every_terminal = true;
+    for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s)
+        every_terminal = every_terminal && predict[s] != 0;
+    for (size_t r = 0; every_terminal && r < g_rule->num_rules; ++r) {
+        size_t count = 0;
+        for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s)
+            count += predict[s] == r + 1;
+        if (count > most) {
+            most = count;
+            default_rule = r;
+        }
+    }
+
+    fprintf(out, "static bool parse_%s(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, Arena *const arena)\n{\n", ParseToken_to_string(t));
+    fprintf(out, "    start_node(node);\n");
+    fprintf(out, "    const size_t start = *index;\n");
+    fprintf(out, "    switch (input->types[*index]) {\n");
+    for (size_t r = 0; r < g_rule->num_rules; ++r) {
+        if (r == default_rule)
+            continue;
+        bool any = false;
+        for (ParseToken s = ParseToken_FIRST_TERMINAL; s < ParseToken_FIRST_NONTERMINAL; ++s) {
+            if (predict[s] == r + 1) {
+                fprintf(out, "    case %s:\n", ParseToken_to_string(s));
+                any = true;
+            }
+        }
+        if (!any)
+            continue;
+        fprintf(out, "    {\n");
+        emit_rule(out, table, t, r);
+        fprintf(out, "    }\n");
+    }
+    fprintf(out, "    default:\n");
+    if (default_rule != SIZE_MAX) {
+        fprintf(out, "    {\n");
+        emit_rule(out, table, t, default_rule);
+        fprintf(out, "    }\n");
+    } else {
+        fprintf(out, "        node->error = PARSE_ERROR_NO_RULE_MATCHES;\n");
+        fprintf(out, "        node->has_token = true;\n");
+        fprintf(out, "        return false;\n");
+    }
+    fprintf(out, "    }\n}\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <path/to/program_parser.c>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const CFG_GrammarCheckResult check = check_cfg_grammar(NULL, program_grammar);
+    if (!CFG_GrammarCheckResult_passed(&check)) {
+        fprintf(stderr, "Error: program_grammar does not pass check_cfg_grammar, no parser can be generated for it\n");
+        return EXIT_FAILURE;
+    }
+    static CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    CFG_PredictTable_recover(&table, &program_recovery);
+    init_can_recover();
+
+    FILE *out = fopen(argv[1], "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Unable to write %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    fprintf(out,
+        "/* program_parser.c */\n"
+        "/* Generated by gen_parser from program_grammar in grammar.h, do not edit. */\n"
+        "#include <stdbool.h>\n"
+        "#include <stdint.h>\n"
+        "\n"
+        "#include \"parser.h\"\n"
+        "\n"
+        "#define RULE(t, r) (program_grammar[(t) - ParseToken_FIRST_NONTERMINAL].rules + (r))\n"
+        "\n"
+        "// Initialize the node to default values, leaving node->type as is.\n"
+        "static inline void start_node(ParseTreeNode *const node)\n"
+        "{\n"
+        "    node->error = PARSE_ERROR_NONE;\n"
+        "    node->has_token = false;\n"
+        "    node->span = 0;\n"
+        "    node->rule = NULL;\n"
+        "    node->finalized_promo_index = SIZE_MAX;\n"
+        "    node->capacity = 0;\n"
+        "    node->count = 0;\n"
+        "    node->children = NULL;\n"
+        "}\n"
+        "\n"
+        "static inline ParseTreeNode terminal_node(const ParseToken type, const bool has_token)\n"
+        "{\n"
+        "    return (ParseTreeNode){.type = type, .error = PARSE_ERROR_NONE, .has_token = has_token, .span = 0, .rule = NULL,\n"
+        "        .finalized_promo_index = SIZE_MAX, .count = 0, .capacity = 0, .children = NULL};\n"
+        "}\n"
+        "\n"
+        "// child `failed` of `node` failed to parse after `span` tokens: accept it and set the remaining children's expected types (child `i` is token `i - offset` of the rule) and error to PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE, up to child `end`.\n"
+        "static bool child_failed(ParseTreeNode *const node, const size_t failed, const size_t offset, const size_t end, const size_t span)\n"
+        "{\n"
+        "    node->error = PARSE_ERROR_CHILD_ERROR;\n"
+        "    node->span = span;\n"
+        "    for (node->count = failed + 1; node->count < end; ++node->count) {\n"
+        "        node->children[node->count] = terminal_node(node->rule->tokens[node->count - offset], false);\n"
+        "        node->children[node->count].error = PARSE_ERROR_PREVIOUS_TOKEN_FAILED_TO_PARSE;\n"
+        "    }\n"
+        "    return false;\n"
+        "}\n"
+        "\n");
+    for (ParseToken t = ParseToken_FIRST_NONTERMINAL; t <= ParseToken_MAX; ++t)
+        fprintf(out, "static bool parse_%s(ParseTreeNode *node, size_t *index, const TokenStream *input, Arena *arena);\n", ParseToken_to_string(t));
+    fprintf(out, "\n");
+    for (ParseToken t = ParseToken_FIRST_NONTERMINAL; t <= ParseToken_MAX; ++t)
+        emit_nonterminal(out, &table, t);
+
+    fprintf(out,
+        "bool parse_program_grammar(ParseTreeNode *const node, size_t *const index, const TokenStream *const input, Arena *const arena)\n"
+        "{\n"
+        "    switch (node->type) {\n");
+    for (ParseToken t = ParseToken_FIRST_NONTERMINAL; t <= ParseToken_MAX; ++t)
+        fprintf(out, "    case %s:\n        return parse_%s(node, index, input, arena) && node->error == PARSE_ERROR_NONE;\n", ParseToken_to_string(t), ParseToken_to_string(t));
+    fprintf(out,
+        "    default:\n"
+        "        break;\n"
+        "    }\n"
+        "    start_node(node);\n"
+        "    // PT_NULL node does not consume any input and always succeeds.\n"
+        "    if (node->type == PT_NULL)\n"
+        "        return true;\n"
+        "    node->has_token = true;\n"
+        "    if (node->type != (ParseToken)input->types[*index]) {\n"
+        "        node->error = PARSE_ERROR_WRONG_TOKEN;\n"
+        "        return false;\n"
+        "    }\n"
+        "    ++(*index);\n"
+        "    node->span = 1;\n"
+        "    return true;\n"
+        "}\n");
+    fclose(out);
+    return EXIT_SUCCESS;
+}
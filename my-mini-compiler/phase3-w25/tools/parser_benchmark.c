@@ -0,0 +1,274 @@
+/**
+ * Benchmark of the generated parser (`parse_program_grammar`) against the interpreted one (`parse_cfg_recursive_descent_parse_tree` with a predict table),
+ * of parsing the statements on several threads (`parse_cfg_recursive_descent_parse_tree_parallel`, which recovers from errors, so it is compared with the interpreted parser that does too),
+ * of backtracking with a memo table (`parse_cfg_packrat_parse_tree`), of only recognizing the program (`parse_cfg_recognize`),
+ * and of building the AST from the parse tree (`ASTNode_from_ParseTreeNode`) against building it while parsing (`parse_cfg_recursive_descent_ast`), with the expressions parsed by following the grammar or by precedence climbing.
+ *
+ * The input is lexed once, then each parser builds its tree of the whole token stream `repeat` times (taking turns) and the best time is reported, with the memory of the arena.
+ * Without a file, the input is a generated program of many expression statements, which is where the parsers spend most of their calls.
+ *
+ * Then `parse_cfg_recursive_descent_reparse` updates the tree of a generated program of REPARSE_LINES lines after one of its lines is replaced (in the middle, and at the end where the list before the edit is longest),
+ * which must take less than REPARSE_TARGET_MICROSECONDS: the benchmark fails otherwise.
+ *
+ * Usage: parser_benchmark [file.cisc] [repeat]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/lexer.h"
+#include "../include/parser.h"
+#include "../include/source_file.h"
+
+#define GENERATED_LINES 20000
+#define RECOGNIZER_FRAMES 4096
+#define REPARSE_LINES 50000
+#define REPARSE_TARGET_MICROSECONDS 1000.0
+
+static double seconds_since(const struct timespec *const start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// A program that declares a few variables and assigns `lines` expressions to them, line `edited_line` is a shorter assignment (none if it is not less than `lines`).
+static char *generate_input(const size_t lines, const size_t edited_line)
+{
+    static const char declarations[] = "int a; int b; int c; int d; int x;\n";
+    static const char line[] = "x = (a + b * 3 - c) / (d % 7) << 2 == 4 && !x || b;\n";
+    static const char edited[] = "x = a + 1;\n";
+    char *const input = malloc(sizeof(declarations) + lines * (sizeof(line) - 1));
+    if (input == NULL) {
+        perror("Failed to allocate memory for the benchmark input");
+        exit(EXIT_FAILURE);
+    }
+    char *p = input;
+    memcpy(p, declarations, sizeof(declarations) - 1);
+    p += sizeof(declarations) - 1;
+    for (size_t i = 0; i < lines; ++i) {
+        const char *const text = i == edited_line ? edited : line;
+        const size_t length = i == edited_line ? sizeof(edited) - 1 : sizeof(line) - 1;
+        memcpy(p, text, length);
+        p += length;
+    }
+    *p = '\0';
+    return input;
+}
+
+/**
+ * Time updating the tree of the generated program of REPARSE_LINES lines once line `edited_line` is edited, and once the edit is undone, `repeat` times each.
+ * The tree keeps its index (`ParseTreeIndex`) from one reparse to the next, like an editor would: it is filled before the first timed one.
+ * @param parse Set to the best time to parse the edited program from scratch, to compare with.
+ * @return the best time of `parse_cfg_recursive_descent_reparse`, not counting lexing the edited program or finding the edit.
+ */
+static double time_reparse(const size_t edited_line, const CFG_PredictTable *const recovering, const int repeat, double *const parse)
+{
+    char *const input = generate_input(REPARSE_LINES, SIZE_MAX), *const edited_input = generate_input(REPARSE_LINES, edited_line);
+    Lexer lexer = {0}, edited_lexer = {0};
+    init_lexer(&lexer, input, 0);
+    init_lexer(&edited_lexer, edited_input, 0);
+    TokenStream tokens, edited_tokens;
+    token_stream_init(&tokens);
+    token_stream_init(&edited_tokens);
+    lex_all(&lexer, &tokens);
+    lex_all(&edited_lexer, &edited_tokens);
+    const TokenEdit edit = TokenEdit_between(&tokens, &edited_tokens), undo = TokenEdit_between(&edited_tokens, &tokens);
+    for (int i = 0; i < repeat; ++i) {
+        Arena arena;
+        arena_init(&arena, 0);
+        ParseTreeNode root = {.type = PT_PROGRAM};
+        size_t token_index = 0;
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        parse_cfg_recursive_descent_parse_tree(&root, &token_index, &edited_tokens, recovering, &arena);
+        const double parsed = seconds_since(&start);
+        if (i == 0 || parsed < *parse)
+            *parse = parsed;
+        arena_free(&arena);
+    }
+
+    // the tree of the program before the edit, updated in place (each reparse allocates its new nodes in the arena).
+    Arena arena;
+    arena_init(&arena, 0);
+    ParseTreeNode root = {.type = PT_PROGRAM};
+    size_t token_index = 0;
+    parse_cfg_recursive_descent_parse_tree(&root, &token_index, &tokens, recovering, &arena);
+    ParseTreeIndex index;
+    da_init(&index);
+    parse_cfg_recursive_descent_reparse(&root, &edit, &edited_tokens, recovering, &index, &arena);
+    parse_cfg_recursive_descent_reparse(&root, &undo, &tokens, recovering, &index, &arena);
+    double best = 0.0;
+    for (int i = 0; i < 2 * repeat; ++i) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (i % 2 == 0)
+            parse_cfg_recursive_descent_reparse(&root, &edit, &edited_tokens, recovering, &index, &arena);
+        else
+            parse_cfg_recursive_descent_reparse(&root, &undo, &tokens, recovering, &index, &arena);
+        const double elapsed = seconds_since(&start);
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+    da_clear(&index);
+    arena_free(&arena);
+    token_stream_free(&tokens);
+    token_stream_free(&edited_tokens);
+    free_lexer(&lexer);
+    free_lexer(&edited_lexer);
+    free(input);
+    free(edited_input);
+    return best;
+}
+
+typedef enum _BenchmarkedParser {
+    INTERPRETED_PARSE_TREE,
+    INTERPRETED_PARSE_TREE_RECOVERING,
+    PARALLEL_PARSE_TREE,
+    PACKRAT_PARSE_TREE, // the backtracking parser, made to backtrack on program_grammar (which does not need it), to measure the cost of memoizing every non-terminal.
+    RECOGNIZER, // builds no tree, so its arena stays empty.
+    GENERATED_PARSE_TREE,
+    GENERATED_PARSE_TREE_TO_AST, // the generated parser followed by `ASTNode_from_ParseTreeNode`, what the compiler does when it prints the parse tree.
+    DIRECT_AST,
+    DIRECT_AST_PRECEDENCE_CLIMBING,
+    BENCHMARKED_PARSER_COUNT
+} BenchmarkedParser;
+
+static const char *const benchmarked_parser_names[BENCHMARKED_PARSER_COUNT] = {
+    "interpreted parser:      ",
+    "interpreted, recovering: ",
+    "parallel parser:         ",
+    "backtracking parser:     ",
+    "recognizer:              ",
+    "generated parser:        ",
+    "generated parser + AST:  ",
+    "AST built while parsing: ",
+    "AST, precedence climbing:",
+};
+
+/**
+ * @param bytes Set to the number of bytes of the arena the tree was built in.
+ * @return the time to parse `tokens`, not counting freeing the tree.
+ */
+static double time_parser(const BenchmarkedParser parser, const TokenStream *const tokens, const CFG_PredictTable *const table, const CFG_PredictTable *const recovering, const CFG_PredictTable *const backtracking, const CFG_PrecedenceTable *const precedence, size_t *const bytes)
+{
+    Arena arena;
+    arena_init(&arena, 0);
+    ParseTreeNode root = {.type = PT_PROGRAM};
+    ASTNode ast = {.type = AST_PROGRAM};
+    SyntaxErrors errors;
+    da_init(&errors);
+    size_t token_index = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    switch (parser) {
+        case INTERPRETED_PARSE_TREE:
+            parse_cfg_recursive_descent_parse_tree(&root, &token_index, tokens, table, &arena);
+            break;
+        case INTERPRETED_PARSE_TREE_RECOVERING:
+            parse_cfg_recursive_descent_parse_tree(&root, &token_index, tokens, recovering, &arena);
+            break;
+        case PARALLEL_PARSE_TREE:
+            parse_cfg_recursive_descent_parse_tree_parallel(&root, &token_index, tokens, recovering, 0, 0, &arena);
+            break;
+        case PACKRAT_PARSE_TREE:
+            parse_cfg_packrat_parse_tree(&root, &token_index, tokens, backtracking, &arena);
+            break;
+        case RECOGNIZER: {
+            static RecognizerFrame stack[RECOGNIZER_FRAMES];
+            SyntaxError error;
+            parse_cfg_recognize(PT_PROGRAM, &token_index, tokens, table, stack, RECOGNIZER_FRAMES, &error);
+            break;
+        }
+        case GENERATED_PARSE_TREE:
+            parse_program_grammar(&root, &token_index, tokens, &arena);
+            break;
+        case GENERATED_PARSE_TREE_TO_AST:
+            parse_program_grammar(&root, &token_index, tokens, &arena);
+            ASTNode_from_ParseTreeNode(&ast, (ParseTreeNodeWithPromo *)&root, tokens, &arena);
+            break;
+        case DIRECT_AST:
+            parse_cfg_recursive_descent_ast(&ast, PT_PROGRAM, &token_index, tokens, table, NULL, &arena, &errors);
+            break;
+        case DIRECT_AST_PRECEDENCE_CLIMBING:
+            parse_cfg_recursive_descent_ast(&ast, PT_PROGRAM, &token_index, tokens, table, precedence, &arena, &errors);
+            break;
+        case BENCHMARKED_PARSER_COUNT:
+            break;
+    }
+    const double elapsed = seconds_since(&start);
+    *bytes = 0;
+    for (const ArenaBlock *block = arena.blocks; block != NULL; block = block->next)
+        *bytes += block->used;
+    arena_free(&arena);
+    return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    SourceFile source = {0};
+    char *generated_input = NULL;
+    const char *input;
+    if (argc > 1) {
+        if (!source_file_open(&source, argv[1])) {
+            fprintf(stderr, "Error: Unable to open file %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+        input = source.text;
+    } else {
+        input = generated_input = generate_input(GENERATED_LINES, SIZE_MAX);
+    }
+    const int repeat = argc > 2 ? atoi(argv[2]) : 5;
+    if (repeat < 1) {
+        fprintf(stderr, "Usage: %s [file.cisc] [repeat]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Lexer lexer = {0};
+    init_lexer(&lexer, input, 0);
+    TokenStream tokens;
+    token_stream_init(&tokens);
+    lex_all(&lexer, &tokens);
+    CFG_PredictTable table;
+    CFG_PredictTable_init(&table, program_grammar);
+    CFG_PredictTable recovering = table;
+    CFG_PredictTable_recover(&recovering, &program_recovery);
+    CFG_PredictTable backtracking = table;
+    backtracking.deterministic = false;
+    CFG_PrecedenceTable precedence;
+    CFG_PrecedenceTable_init(&precedence, &table, PT_EXPRESSION);
+
+    // alternate between the parsers so that they all see the same state of the heap.
+    double best[BENCHMARKED_PARSER_COUNT];
+    size_t bytes[BENCHMARKED_PARSER_COUNT];
+    for (int i = 0; i < repeat; ++i) {
+        for (BenchmarkedParser parser = 0; parser < BENCHMARKED_PARSER_COUNT; ++parser) {
+            const double elapsed = time_parser(parser, &tokens, &table, &recovering, &backtracking, &precedence, bytes + parser);
+            if (i == 0 || elapsed < best[parser])
+                best[parser] = elapsed;
+        }
+    }
+    printf("%zu tokens, best of %d\n", tokens.count, repeat);
+    for (BenchmarkedParser parser = 0; parser < BENCHMARKED_PARSER_COUNT; ++parser)
+        printf("%s%8.3f ms (%.2fx), %zu KiB\n", benchmarked_parser_names[parser], best[parser] * 1e3,
+            best[parser] > 0 ? best[INTERPRETED_PARSE_TREE] / best[parser] : 0.0, bytes[parser] / 1024);
+
+    int result = EXIT_SUCCESS;
+    const size_t edited_lines[] = {REPARSE_LINES / 2, REPARSE_LINES - 1};
+    for (size_t i = 0; i < sizeof(edited_lines) / sizeof(edited_lines[0]); ++i) {
+        double parse;
+        const double reparse = time_reparse(edited_lines[i], &recovering, repeat, &parse);
+        printf("reparse, line %zu of %d: %8.1f us (parsing again: %.3f ms)\n", edited_lines[i] + 1, REPARSE_LINES, reparse * 1e6, parse * 1e3);
+        if (reparse * 1e6 > REPARSE_TARGET_MICROSECONDS) {
+            fprintf(stderr, "Error: reparsing took more than %.0f us\n", REPARSE_TARGET_MICROSECONDS);
+            result = EXIT_FAILURE;
+        }
+    }
+
+    token_stream_free(&tokens);
+    free_lexer(&lexer);
+    source_file_close(&source);
+    free(generated_input);
+    return result;
+}